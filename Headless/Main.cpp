@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include "AllocationCounter.h"
+#include "HeadlessScene.h"
+#include "ThreadPool.h"
+
+// The simulation, culling and draw recording of a frame without a window or a GPU, on any
+// platform with a C++14 compiler. Runs a seeded HeadlessScene at a fixed 60 Hz and writes the
+// per-frame averages to the report in the game's -headless format.
+//   -frames <n>      frames to run (default 600)
+//   -crowd <n>       members per zone (default 2000)
+//   -props <n>       scattered props (default 4000)
+//   -seed <n>        level and crowd seed (default 1)
+//   -threads <n>     workers besides the main thread (default hardware_concurrency - 1)
+//   -simrate <hz> and -bgrate <hz> as in the game (default 25 and 5)
+//   -bindings <constants|tables>  draw constants as root constants, or the seven descriptor
+//                    tables every draw bound before the bindless materials (default constants)
+//   -report <file>   (default HeadlessBenchmark.txt)
+// Exits with 1 when a frame after the warm-up allocated, or when the run failed.
+
+int main(int argc, char* argv[])
+{
+	unsigned int frameCount = 600;
+	unsigned int threadCount = 0;
+	std::string reportName = "HeadlessBenchmark.txt";
+	HeadlessSettings settings;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const char* option = argv[i];
+		const char* value = argv[i + 1];
+		if (std::strcmp(option, "-frames") == 0)
+			frameCount = (unsigned int)std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "-crowd") == 0)
+			settings.Population = (uint32_t)std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "-props") == 0)
+			settings.PropCount = (uint32_t)std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "-seed") == 0)
+			settings.Seed = (uint32_t)std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "-threads") == 0)
+			threadCount = (unsigned int)std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "-simrate") == 0)
+			settings.ActiveRate = std::strtof(value, nullptr);
+		else if (std::strcmp(option, "-bgrate") == 0)
+			settings.BackgroundRate = std::strtof(value, nullptr);
+		else if (std::strcmp(option, "-bindings") == 0)
+			settings.TableBindings = std::strcmp(value, "tables") == 0;
+		else if (std::strcmp(option, "-report") == 0)
+			reportName = value;
+		else
+		{
+			std::printf("Unknown option %s\n", option);
+			return 1;
+		}
+	}
+
+	try
+	{
+		ThreadPool threadPool(threadCount);
+		HeadlessScene scene(&threadPool);
+		scene.Build(settings);
+
+		// Counted once the first frames have sized every buffer
+		const unsigned int warmupFrames = 60;
+		const float dt = 1.0f / 60.0f;
+
+		HeadlessFrameStats total;
+		double updateTime = 0.0;
+		double drawTime = 0.0;
+		double recordTime = 0.0;
+		double crowdTime = 0.0;
+		double flowTime = 0.0;
+		double flowMaxTime = 0.0;
+		double cullTime = 0.0;
+		double occlusionTime = 0.0;
+		double lightTime = 0.0;
+		uint64_t visible = 0;
+		uint64_t occluded = 0;
+		uint64_t lights = 0;
+		uint64_t hits = 0;
+		uint64_t commandLists = 0;
+		uint64_t rootBindings = 0;
+		uint64_t uploadBytes = 0;
+		uint64_t frameAllocations = 0;
+		uint32_t firstFlowRebuild = scene.GetFlowField().GetRebuildCount();
+
+		for (unsigned int frame = 0; frame < frameCount; ++frame)
+		{
+			uint64_t allocations = AllocationCounter::GetTotalCount();
+			HeadlessFrameStats stats;
+			scene.Frame(dt, stats);
+			if (frame >= warmupFrames)
+				frameAllocations += AllocationCounter::GetTotalCount() - allocations;
+
+			updateTime += stats.UpdateTime;
+			drawTime += stats.DrawTime;
+			recordTime += stats.RecordTime;
+			crowdTime += stats.CrowdTime;
+			flowTime += stats.FlowTime;
+			flowMaxTime = (std::max)(flowMaxTime, (double)stats.FlowTime);
+			cullTime += stats.CullTime;
+			occlusionTime += stats.OcclusionTime;
+			lightTime += stats.LightTime;
+			visible += stats.Visible;
+			occluded += stats.Occluded;
+			lights += stats.Lights;
+			hits += stats.Hits;
+			commandLists += stats.CommandLists;
+			rootBindings += stats.RootBindings;
+			uploadBytes += stats.UploadBytes;
+			total.Counts += stats.Counts;
+		}
+
+		if (frameCount == 0)
+			return 0;
+
+		float playerPosition[3];
+		scene.GetPlayerPosition(playerPosition);
+		const ZoneScheduler& zones = scene.GetZoneScheduler();
+		const CommandCounts& counts = total.Counts;
+
+		std::ofstream fileOut(reportName);
+		fileOut << std::setprecision(9);
+		fileOut << "Seed " << settings.Seed << "\n";
+		fileOut << "Frames " << frameCount << "\n";
+		fileOut << "Threads " << threadPool.GetThreadCount() + 1 << "\n";
+		fileOut << "UpdateMs " << updateTime / frameCount << "\n";
+		fileOut << "DrawMs " << drawTime / frameCount << "\n";
+		fileOut << "SimRate " << zones.GetActiveRate() << " " << zones.GetBackgroundRate() << "\n";
+		for (uint32_t i = 0; i < zones.GetZoneCount(); ++i)
+			fileOut << "Zone" << i << "Ms " << zones.GetStats(i).Time << " OverBudget " << zones.GetStats(i).OverBudget << "\n";
+		fileOut << "Crowd " << settings.Population << "\n";
+		fileOut << "CrowdMs " << crowdTime / frameCount << "\n";
+		fileOut << "Alive " << scene.GetAliveCount() << "\n";
+		fileOut << "Hits " << (double)hits / frameCount << "\n";
+		fileOut << "PlayerDamage " << scene.GetPlayerDamage() << "\n";
+		if (AllocationCounter::IsCounting())
+			fileOut << "FrameAllocs " << frameAllocations << "\n";
+		else
+			fileOut << "FrameAllocs not counted, build with ALLOCATION_COUNTER\n";
+		fileOut << "FlowRebuilds " << scene.GetFlowField().GetRebuildCount() - firstFlowRebuild << "\n";
+		fileOut << "FlowMs " << flowTime / frameCount << " Max " << flowMaxTime << "\n";
+		fileOut << "CullMs " << cullTime / frameCount << " OcclusionMs " << occlusionTime / frameCount << "\n";
+		fileOut << "Visible " << (double)visible / frameCount << " Occluded " << (double)occluded / frameCount << "\n";
+		fileOut << "LightMs " << lightTime / frameCount << " Lights " << (double)lights / frameCount << "\n";
+		fileOut << "Bindings " << (settings.TableBindings ? "tables" : "constants") << "\n";
+		fileOut << "RecordMs " << recordTime / frameCount << "\n";
+		fileOut << "CommandLists " << (double)commandLists / frameCount << "\n";
+		fileOut << "Commands " << counts.GetCommandCount() / frameCount << "\n";
+		fileOut << "Draws " << counts.Draws / frameCount << "\n";
+		fileOut << "PipelineStates " << counts.PipelineStates / frameCount << "\n";
+		fileOut << "RootConstants " << counts.RootConstants / frameCount << "\n";
+		fileOut << "RootBuffers " << counts.RootBuffers / frameCount << "\n";
+		fileOut << "DescriptorTables " << counts.DescriptorTables / frameCount << "\n";
+		fileOut << "RootBindings " << rootBindings / frameCount << "\n";
+		fileOut << "Instances " << counts.Instances / frameCount << "\n";
+		fileOut << "UploadBytes " << uploadBytes / frameCount << "\n";
+		fileOut << "PlayerPosition " << playerPosition[0] << " " << playerPosition[1] << " " << playerPosition[2] << "\n";
+		fileOut.close();
+
+		std::ifstream report(reportName);
+		std::string line;
+		while (std::getline(report, line))
+			std::printf("%s\n", line.c_str());
+
+		// A steady frame must not touch the heap
+		return frameAllocations == 0 ? 0 : 1;
+	}
+	catch (std::exception& e)
+	{
+		std::printf("Headless run failed: %s\n", e.what());
+		return 1;
+	}
+}
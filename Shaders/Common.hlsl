@@ -15,9 +15,60 @@
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
-Texture2D			gDiffuseMap	: register(t0);
-Texture2D			gNormalMap	: register(t1);
-TextureCube		gCubeMap		: register(t2);
+struct MaterialData
+{
+	float4   DiffuseAlbedo;
+	float3   FresnelR0;
+	float    Roughness;
+	float4x4 MatTransform;
+	int      DiffuseMapIndex;
+	int      NormalMapIndex;
+	uint     MatPad0;
+	uint     MatPad1;
+};
+
+struct ObjectData
+{
+	float4x4 World;
+	float4x4 TexTransform;
+};
+
+struct InstanceData
+{
+	float4x4 World;
+	float4x4 TexTransform;
+	uint     MaterialIndex;
+	uint     PaletteOffset;
+	uint     InstancePad0;
+	uint     InstancePad1;
+};
+
+struct UIData
+{
+	float4x4 World;
+	float4x4 TexTransform;
+	float    Scale;
+	float3   UIPad0;
+};
+
+TextureCube		gCubeMap		: register(t0);
+
+StructuredBuffer<MaterialData>	gMaterialData	: register(t1);
+StructuredBuffer<ObjectData>	gObjectData		: register(t2);
+StructuredBuffer<UIData>		gUIData			: register(t3);
+StructuredBuffer<UIData>		gMonsterUIData	: register(t4);
+// 96 bones per skinned instance, indexed from gPaletteOffset
+StructuredBuffer<float4x4>	gBonePalette	: register(t5);
+// Instanced draws read gInstanceData[gObjIndex + SV_InstanceID]
+StructuredBuffer<InstanceData>	gInstanceData	: register(t6);
+// Point and spot lights binned per froxel, see LightClusters. SpotPower 0 marks a point light.
+StructuredBuffer<Light>		gClusterLights	: register(t7);
+// (offset, count) into gLightIndices per cluster
+StructuredBuffer<uint2>		gLightClusters	: register(t8);
+StructuredBuffer<uint>		gLightIndices	: register(t9);
+
+// Bindless range of diffuse and normal maps, indexed through MaterialData.
+Texture2D		gTextureMaps[]	: register(t0, space1);
 
 SamplerState	gsamPointWrap					: register(s0);
 SamplerState	gsamPointClamp				: register(s1);
@@ -26,23 +77,14 @@ SamplerState	gsamLinearClamp			: register(s3);
 SamplerState	gsamAnisotropicWrap	: register(s4);
 SamplerState	gsamAnisotropicClamp	: register(s5);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
-{
-	float4x4 gWorld;
-	float4x4 gTexTransform;
-};
-
-// Constant data that varies per material.
-cbuffer cbMaterial : register(b1)
+// Constant data that varies per draw.
+cbuffer cbDraw : register(b0)
 {
-	float4   gDiffuseAlbedo;
-	float3   gFresnelR0;
-	float    gRoughness;
-	float4x4 gMatTransform;
+	uint gObjIndex;
+	uint gMatIndex;
 };
 
-cbuffer cbPass : register(b2)
+cbuffer cbPass : register(b1)
 {
 	float4x4 gView;
 	float4x4 gInvView;
@@ -70,32 +112,43 @@ cbuffer cbPass : register(b2)
 	// indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
 	// are spot lights for a maximum of MaxLights per object.
 	Light gLights[MaxLights];
+
+	uint3 gClusterDims;
+	uint gClusterLightCount;
+	float gClusterSliceScale;
+	float gClusterSliceBias;
+	float2 cbPerObjectPad3;
 };
 
-cbuffer cbPlayer : register(b3)
+// Player, bound per draw. Monsters are instanced and use gInstanceData.
+cbuffer cbSkinned : register(b2)
 {
 	float4x4 gChaWorld;
 	float4x4 gChaTexTransform;
-	float4x4 gBoneTransforms[96];
+	uint gPaletteOffset;
+	uint3 cbSkinnedPad;
 };
 
-cbuffer cbMonster : register(b4)
+// Point and spot lights of the cluster holding this pixel
+float3 ComputeClusteredLighting(Material mat, float4 posH, float3 posW, float3 normal, float3 toEye)
 {
-	float4x4 gMonsterWorld;
-	float4x4 gMonsterTexTransform;
-	float4x4 gMonsterBoneTransforms[96];
-};
+	if (gClusterLightCount == 0)
+		return 0.0f;
 
-cbuffer cbUI : register(b5)
-{
-	float4x4 gUIWorld;
-	float4x4 gUITexTransform;
-	float gScale;
-	float3 cbPerUIPad1;
-};
+	// SV_Position carries the pixel in xy and the view depth in w
+	uint2 tile = min((uint2)(posH.xy * gInvRenderTargetSize * (float2)gClusterDims.xy), gClusterDims.xy - 1);
+	uint slice = min((uint)max(log(posH.w) * gClusterSliceScale + gClusterSliceBias, 0.0f), gClusterDims.z - 1);
+	uint2 range = gLightClusters[(slice * gClusterDims.y + tile.y) * gClusterDims.x + tile.x];
 
-cbuffer cbMonsterUI : register(b6)
-{
-	float4x4 gMonsterUIWorld;
-	float4x4 gMonsterUITexTransform;
-};
+	float3 result = 0.0f;
+	for (uint i = 0; i < range.y; ++i)
+	{
+		Light L = gClusterLights[gLightIndices[range.x + i]];
+		if (L.SpotPower > 0.0f)
+			result += ComputeSpotLight(L, mat, posW, normal, toEye);
+		else
+			result += ComputePointLight(L, mat, posW, normal, toEye);
+	}
+
+	return result;
+}
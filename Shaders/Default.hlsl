@@ -28,12 +28,15 @@ struct VertexOut
 #ifdef SKINNED
 	uint4 BoneIndices : BONEINDICES;
 #endif
+	nointerpolation uint MatIndex : MATINDEX;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+	uint matIndex = gMatIndex;
+
 #ifdef SKINNED
 	float weights[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
 	weights[0] = vin.BoneWeights.x;
@@ -49,10 +52,10 @@ VertexOut VS(VertexIn vin)
 	{
 		// Assume no nonuniform scaling when transforming normals, so 
 		// that we do not have to use the inverse-transpose.
-		posL += weights[i] * mul(float4(vin.PosL, 1.0f), gBoneTransforms[vin.BoneIndices[i]]).xyz;
-		normalL += weights[i] * mul(vin.NormalL, (float3x3)gBoneTransforms[vin.BoneIndices[i]]);
-		tangentL += weights[i] * mul(vin.TangentL, (float3x3)gBoneTransforms[vin.BoneIndices[i]]);
-		binormalL += weights[i] * mul(vin.BinormalL, (float3x3)gBoneTransforms[vin.BoneIndices[i]]);
+		posL += weights[i] * mul(float4(vin.PosL, 1.0f), gBonePalette[gPaletteOffset + vin.BoneIndices[i]]).xyz;
+		normalL += weights[i] * mul(vin.NormalL, (float3x3)gBonePalette[gPaletteOffset + vin.BoneIndices[i]]);
+		tangentL += weights[i] * mul(vin.TangentL, (float3x3)gBonePalette[gPaletteOffset + vin.BoneIndices[i]]);
+		binormalL += weights[i] * mul(vin.BinormalL, (float3x3)gBonePalette[gPaletteOffset + vin.BoneIndices[i]]);
 	}
 
 	vin.PosL = posL;
@@ -75,32 +78,54 @@ VertexOut VS(VertexIn vin)
 
 	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gChaTexTransform);
 #elif UI
+	UIData uiData = gUIData[gObjIndex];
+
 	// Transform to world space.
-	float4 posW = mul(float4(vin.PosL, 1.0f), gUIWorld);
+	float4 posW = mul(float4(vin.PosL, 1.0f), uiData.World);
 	vout.PosW = posW.xyz;
 
 	// Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-	vout.NormalW = mul(vin.NormalL, (float3x3)gUIWorld);
-	vout.TangentW = mul(vin.TangentL, (float3x3)gUIWorld);
-	vout.BinormalW = mul(vin.BinormalL, (float3x3)gUIWorld);
+	vout.NormalW = mul(vin.NormalL, (float3x3)uiData.World);
+	vout.TangentW = mul(vin.TangentL, (float3x3)uiData.World);
+	vout.BinormalW = mul(vin.BinormalL, (float3x3)uiData.World);
 
 	// Output vertex attributes for interpolation across triangle.
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gUITexTransform);
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), uiData.TexTransform);
+#elif INSTANCED
+	InstanceData instData = gInstanceData[gObjIndex + instanceID];
+	matIndex = instData.MaterialIndex;
+
+	// Transform to world space.
+	float4 posW = mul(float4(vin.PosL, 1.0f), instData.World);
+	vout.PosW = posW.xyz;
+
+	// Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
+	vout.NormalW = mul(vin.NormalL, (float3x3)instData.World);
+	vout.TangentW = mul(vin.TangentL, (float3x3)instData.World);
+	vout.BinormalW = mul(vin.BinormalL, (float3x3)instData.World);
+
+	// Output vertex attributes for interpolation across triangle.
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), instData.TexTransform);
 #else
+	ObjectData objData = gObjectData[gObjIndex];
+
 	// Transform to world space.
-	float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+	float4 posW = mul(float4(vin.PosL, 1.0f), objData.World);
 	vout.PosW = posW.xyz;
 
 	// Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-	vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
-	vout.TangentW = mul(vin.TangentL, (float3x3)gWorld);
-	vout.BinormalW = mul(vin.BinormalL, (float3x3)gWorld);
+	vout.NormalW = mul(vin.NormalL, (float3x3)objData.World);
+	vout.TangentW = mul(vin.TangentL, (float3x3)objData.World);
+	vout.BinormalW = mul(vin.BinormalL, (float3x3)objData.World);
 
 	// Output vertex attributes for interpolation across triangle.
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), objData.TexTransform);
 #endif
 
-	vout.TexC = mul(texC, gMatTransform).xy;
+	MaterialData matData = gMaterialData[matIndex];
+	vout.MatIndex = matIndex;
+
+	vout.TexC = mul(texC, matData.MatTransform).xy;
 	
 	// Transform to homogeneous clip space.
 	vout.PosH = mul(posW, gViewProj);
@@ -110,15 +135,20 @@ VertexOut VS(VertexIn vin)
 
 float4 PS(VertexOut pin) : SV_Target
 {
-	float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
+	MaterialData matData = gMaterialData[pin.MatIndex];
+
+	// Instanced draws carry a material per instance, so the texture index can differ across a wave
+	float4 diffuseAlbedo = gTextureMaps[NonUniformResourceIndex(matData.DiffuseMapIndex)].Sample(gsamAnisotropicWrap, pin.TexC) * matData.DiffuseAlbedo;
 	//float4 diffuseAlbedo = float4(231.0f / 255.0f, 221.0f / 255.0f, 255.0f / 255.0f, 1.0f);
-	float4 normalMap = gNormalMap.Sample(gsamAnisotropicWrap, pin.TexC);
-	// 0.0f ~ 1.0f -> -1.0f ~ 1.0f
-	normalMap = (normalMap * 2.0f) - 1.0f;
+	if (matData.NormalMapIndex >= 0)
+	{
+		float4 normalMap = gTextureMaps[NonUniformResourceIndex(matData.NormalMapIndex)].Sample(gsamAnisotropicWrap, pin.TexC);
+		// 0.0f ~ 1.0f -> -1.0f ~ 1.0f
+		normalMap = (normalMap * 2.0f) - 1.0f;
 
-	
-	float3 normal =  normalMap.x * pin.TangentW + normalMap.y * pin.BinormalW +  normalMap.z * pin.NormalW;
-	pin.NormalW = normalize(normal);
+		float3 normal =  normalMap.x * pin.TangentW + normalMap.y * pin.BinormalW +  normalMap.z * pin.NormalW;
+		pin.NormalW = normalize(normal);
+	}
 	//diffuseAlbedo = float4(pin.NormalW, 1.0f);
 
 	float3 toEyeW = gEyePosW - pin.PosW;
@@ -127,11 +157,12 @@ float4 PS(VertexOut pin) : SV_Target
 
 	float4 ambient = gAmbientLight * diffuseAlbedo;
 
-	const float shininess = 1.0f - gRoughness;
-	Material mat = { diffuseAlbedo, gFresnelR0, shininess };
+	const float shininess = 1.0f - matData.Roughness;
+	Material mat = { diffuseAlbedo, matData.FresnelR0, shininess };
 	float3 shadowFactor = 1.0f;
 	float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
 		pin.NormalW, toEyeW, shadowFactor);
+	directLight.rgb += ComputeClusteredLighting(mat, pin.PosH, pin.PosW, pin.NormalW, toEyeW);
 
 	float4 litColor = ambient + directLight;
 
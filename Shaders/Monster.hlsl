@@ -24,12 +24,18 @@ struct VertexOut
 	float3 TangentW : TANGENT;
 	float3 BinormalW : BINORMAL;
 	uint4 BoneIndices : BONEINDICES;
+	nointerpolation uint MatIndex : MATINDEX;
 };
 
-VertexOut VS(VertexIn vin)
+// Always instanced: one instance per monster, each with its own palette
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+	InstanceData instData = gInstanceData[gObjIndex + instanceID];
+	MaterialData matData = gMaterialData[instData.MaterialIndex];
+	vout.MatIndex = instData.MaterialIndex;
+
 	float weights[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
 	weights[0] = vin.BoneWeights.x;
 	weights[1] = vin.BoneWeights.y;
@@ -42,10 +48,10 @@ VertexOut VS(VertexIn vin)
 	float3 binormalL = float3(0.0f, 0.0f, 0.0f);
 	for (int i = 0; i < 4; ++i)
 	{
-		posL += weights[i] * mul(float4(vin.PosL, 1.0f), gMonsterBoneTransforms[vin.BoneIndices[i]]).xyz;
-		normalL += weights[i] * mul(vin.NormalL, (float3x3)gMonsterBoneTransforms[vin.BoneIndices[i]]);
-		tangentL += weights[i] * mul(vin.TangentL, (float3x3)gMonsterBoneTransforms[vin.BoneIndices[i]]);
-		binormalL += weights[i] * mul(vin.BinormalL, (float3x3)gMonsterBoneTransforms[vin.BoneIndices[i]]);
+		posL += weights[i] * mul(float4(vin.PosL, 1.0f), gBonePalette[instData.PaletteOffset + vin.BoneIndices[i]]).xyz;
+		normalL += weights[i] * mul(vin.NormalL, (float3x3)gBonePalette[instData.PaletteOffset + vin.BoneIndices[i]]);
+		tangentL += weights[i] * mul(vin.TangentL, (float3x3)gBonePalette[instData.PaletteOffset + vin.BoneIndices[i]]);
+		binormalL += weights[i] * mul(vin.BinormalL, (float3x3)gBonePalette[instData.PaletteOffset + vin.BoneIndices[i]]);
 	}
 
 	vin.PosL = posL;
@@ -55,20 +61,20 @@ VertexOut VS(VertexIn vin)
 
 	vout.BoneIndices = vin.BoneIndices;
 
-	float4 posW = mul(float4(vin.PosL, 1.0f), gMonsterWorld);
+	float4 posW = mul(float4(vin.PosL, 1.0f), instData.World);
 	vout.PosW = posW.xyz;
 
-	vout.NormalW = mul(vin.NormalL, (float3x3)gMonsterWorld);
-	vout.TangentW = mul(vin.TangentL, (float3x3)gMonsterWorld);
-	vout.BinormalW = mul(vin.BinormalL, (float3x3)gMonsterWorld);
+	vout.NormalW = mul(vin.NormalL, (float3x3)instData.World);
+	vout.TangentW = mul(vin.TangentL, (float3x3)instData.World);
+	vout.BinormalW = mul(vin.BinormalL, (float3x3)instData.World);
 
 	vout.NormalW = normalize(vout.NormalW);
 	vout.TangentW = normalize(vout.TangentW);
 	vout.BinormalW = normalize(vout.BinormalW);
 	
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gMonsterTexTransform);
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), instData.TexTransform);
 
-	vout.TexC = mul(texC, gMatTransform).xy;
+	vout.TexC = mul(texC, matData.MatTransform).xy;
 	// Transform to homogeneous clip space.
 	vout.PosH = mul(posW, gViewProj);
 	
@@ -77,14 +83,19 @@ VertexOut VS(VertexIn vin)
 
 float4 PS(VertexOut pin) : SV_Target
 {
-	float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
-	float4 normalMap = gNormalMap.Sample(gsamAnisotropicWrap, pin.TexC);
+	MaterialData matData = gMaterialData[pin.MatIndex];
+
+	float4 diffuseAlbedo = gTextureMaps[NonUniformResourceIndex(matData.DiffuseMapIndex)].Sample(gsamAnisotropicWrap, pin.TexC) * matData.DiffuseAlbedo;
+	if (matData.NormalMapIndex >= 0)
+	{
+		float4 normalMap = gTextureMaps[NonUniformResourceIndex(matData.NormalMapIndex)].Sample(gsamAnisotropicWrap, pin.TexC);
 
-	// 0.0f ~ 1.0f -> -1.0f ~ 1.0f
-	normalMap = (normalMap * 2.0f) - 1.0f;
+		// 0.0f ~ 1.0f -> -1.0f ~ 1.0f
+		normalMap = (normalMap * 2.0f) - 1.0f;
 
-	float3 normal =  normalMap.x * pin.TangentW + normalMap.y * pin.BinormalW +  normalMap.z * pin.NormalW;
-	pin.NormalW = normalize(normal);
+		float3 normal =  normalMap.x * pin.TangentW + normalMap.y * pin.BinormalW +  normalMap.z * pin.NormalW;
+		pin.NormalW = normalize(normal);
+	}
 
 	float3 toEyeW = gEyePosW - pin.PosW;
 	float distanceToEye = length(toEyeW);
@@ -92,11 +103,12 @@ float4 PS(VertexOut pin) : SV_Target
 
 	float4 ambient = gAmbientLight * diffuseAlbedo;
 
-	const float shininess = 1.0f - gRoughness;
-	Material mat = { diffuseAlbedo, gFresnelR0, shininess };
+	const float shininess = 1.0f - matData.Roughness;
+	Material mat = { diffuseAlbedo, matData.FresnelR0, shininess };
 	float3 shadowFactor = 1.0f;
 	float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
 		pin.NormalW, toEyeW, shadowFactor);
+	directLight.rgb += ComputeClusteredLighting(mat, pin.PosH, pin.PosW, pin.NormalW, toEyeW);
 
 	float4 litColor = ambient + directLight;
 
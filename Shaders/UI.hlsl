@@ -30,27 +30,33 @@ VertexOut VS(VertexIn vin)
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+	MaterialData matData = gMaterialData[gMatIndex];
+
 #ifdef MONSTER
+	UIData uiData = gMonsterUIData[gObjIndex];
+
 	// Transform to world space.
-	float4 posW = mul(float4(vin.PosL, 1.0f), gMonsterUIWorld);
+	float4 posW = mul(float4(vin.PosL, 1.0f), uiData.World);
 	vout.PosW = posW.xyz;
 	// Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-	vout.NormalW = mul(vin.NormalL, (float3x3)gMonsterUIWorld);
+	vout.NormalW = mul(vin.NormalL, (float3x3)uiData.World);
 
 	// Output vertex attributes for interpolation across triangle.
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gMonsterUITexTransform);
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), uiData.TexTransform);
 #else
 	// skill Delay
 	vout.Row = vin.Row;
 
-	float4 posW = mul(float4(vin.PosL, 1.0f), gUIWorld);
+	UIData uiData = gUIData[gObjIndex];
+
+	float4 posW = mul(float4(vin.PosL, 1.0f), uiData.World);
 	vout.PosW = posW.xyz;
-	vout.NormalW = mul(vin.NormalL, (float3x3)gUIWorld);
+	vout.NormalW = mul(vin.NormalL, (float3x3)uiData.World);
 
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gUITexTransform);
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), uiData.TexTransform);
 #endif
 
-	vout.TexC = mul(texC, gMatTransform).xy;
+	vout.TexC = mul(texC, matData.MatTransform).xy;
 	// Transform to homogeneous clip space.
 	vout.PosH = mul(posW, gViewProj);
 	
@@ -59,9 +65,16 @@ VertexOut VS(VertexIn vin)
 
 float4 PS(VertexOut pin) : SV_Target
 {
-	float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
+	MaterialData matData = gMaterialData[gMatIndex];
+
+	float4 diffuseAlbedo = gTextureMaps[matData.DiffuseMapIndex].Sample(gsamAnisotropicWrap, pin.TexC) * matData.DiffuseAlbedo;
 
-	float delayChk = pin.Row + gScale *  10.0f;
+#ifdef MONSTER
+	float scale = gMonsterUIData[gObjIndex].Scale;
+#else
+	float scale = gUIData[gObjIndex].Scale;
+#endif
+	float delayChk = pin.Row + scale *  10.0f;
 	diffuseAlbedo = delayChk > 10.0f ? diffuseAlbedo - float4(0.4f, 0.4f, 0.4f, 0.0f) : diffuseAlbedo;
 
 	float4 litColor = diffuseAlbedo;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Common/d3dUtil.h"
+#include "Culling.h"
 
 class Camera
 {
@@ -23,6 +24,8 @@ public:
 	DirectX::XMVECTOR GetEyeRight() const;
 	DirectX::XMMATRIX GetView() const;
 	DirectX::XMMATRIX GetProj() const;
+	// From the current view and projection
+	Frustum GetFrustum() const;
 
 	void SetEyePosition(DirectX::XMVECTOR inEyePosition);
 	void SetEyeLook(DirectX::XMVECTOR inEyeLook);
@@ -2,6 +2,7 @@
 
 #include "Materials.h"
 #include "RenderItem.h"
+#include "SkinnedBounds.h"
 
 class GameTimer;
 class Character
@@ -14,12 +15,12 @@ public:
 	virtual int GetHealth(int i  = 0) const = 0;
 	virtual CharacterInfo& GetCharacterInfo(int cIndex = 0) = 0;
 	virtual void Damage(int damage, DirectX::XMVECTOR Position, DirectX::XMVECTOR Look) = 0;
+	// The bind-pose box, for moving against the level
 	const DirectX::BoundingBox& GetBoundingBox() const { return mInitBoundsBox; }
 	MeshGeometry* GetMeshGeometry() const { return  mGeometry.get(); }
 
 	virtual void BuildGeometry(
-		ID3D12Device * device, 
-		ID3D12GraphicsCommandList* cmdList, 
+		RenderDevice* device,
 		const std::vector<CharacterVertex>& inVertices,
 		const std::vector<std::uint32_t>& inIndices, 
 		const SkinnedData& inSkinInfo, std::string geoName);
@@ -27,10 +28,16 @@ public:
 	
 	virtual void UpdateCharacterShadows(const Light& mMainLight) = 0;
 
+protected:
+	// The posed mesh under world, from its palette; the bind-pose box when the mesh has no weights
+	void UpdateSkinnedBounds(const std::vector<DirectX::XMFLOAT4X4>& palette,
+		DirectX::FXMMATRIX world, DirectX::BoundingBox& bounds) const;
+
 public: 
 	bool mTransformDirty = false;
 
 private:
 	DirectX::BoundingBox mInitBoundsBox;
+	SkinnedBounds mSkinnedBounds;
 	std::unique_ptr<MeshGeometry> mGeometry;
 };
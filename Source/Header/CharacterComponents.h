@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// Character data split into EntityWorld components, each system touching only what it needs.
+// Plain floats like CullBox, so the storage stays free of DirectXMath.
+
+// Placement in the world; rotation is a quaternion (x, y, z, w)
+struct TransformComponent
+{
+	float Position[3];
+	float Rotation[4];
+	float Scale;
+};
+
+// Where the AI walks: unit heading on the ground plane, units and radians per second
+struct MovementComponent
+{
+	float Look[3];
+	float Speed;
+	float TurnRate;
+};
+
+struct HealthComponent
+{
+	int Health;
+	int FullHealth;
+};
+
+// Clip index into the skinned model and the playback position in seconds
+struct AnimationComponent
+{
+	uint32_t Clip;
+	float TimePos;
+	float ClipLength;
+};
+
+// When the current attack or death started, in simulation seconds, and whether the attack
+// still has to land
+struct AttackComponent
+{
+	float StartTime;
+	uint32_t Pending;
+};
+
+// What the instance upload needs to draw the entity
+struct RenderComponent
+{
+	uint32_t InstanceIndex;
+	uint32_t MaterialIndex;
+	uint32_t PaletteOffset;
+};
+
+// Posed world box, laid out like CullBox
+struct BoundsComponent
+{
+	float Center[3];
+	float Extents[3];
+};
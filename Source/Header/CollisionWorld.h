@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Culling.h"
+
+// First contact of a swept box
+struct SweepHit
+{
+	// Fraction of the motion travelled before touching, 0 to 1
+	float Time;
+	// Surface normal at the contact, pointing back at the moving box
+	float Normal[3];
+	// Index of the box hit: static boxes first, then the dynamic ones
+	uint32_t Item;
+};
+
+// Collision against the level's boxes, built once from the static architecture.
+// The static boxes sit in a binary AABB tree, so a query only opens the nodes its swept
+// bounds overlap and its cost follows the boxes near the path, not the size of the level.
+// A few dynamic boxes (doors and walls that move between rounds) are tested flat.
+// Moving boxes are swept against the Minkowski sum of each candidate, which gives the
+// time of impact and the face normal; Move slides along the faces it touches.
+class CollisionWorld
+{
+public:
+	void Build(const CullBox* boxes, uint32_t count);
+	// Replaces the dynamic boxes, numbered after the static ones
+	void SetDynamicBoxes(const CullBox* boxes, uint32_t count);
+
+	// The earliest box hit by box moving by delta, false when the path is clear.
+	// A box already overlapping only counts when the motion goes deeper into it.
+	bool Sweep(const CullBox& box, const float delta[3], SweepHit& hit) const;
+
+	// Moves box by delta as far as it can, sliding along what it touches.
+	// Writes the motion allowed to outDelta and appends one hit per contact to contacts.
+	void Move(const CullBox& box, const float delta[3], float outDelta[3], std::vector<SweepHit>& contacts) const;
+
+	uint32_t GetStaticCount() const;
+	uint32_t GetNodeCount() const;
+	// Boxes tested by the narrowphase in the last Sweep or Move
+	uint32_t GetTestCount() const;
+
+	struct BenchmarkResult
+	{
+		// ns per Move through the tree and through every box
+		float TreeTime;
+		float BruteForceTime;
+		// Boxes tested per Move by the tree
+		float TestsPerMove;
+		// Moves whose outcome differs from the brute force
+		uint32_t Mismatches;
+	};
+
+	// Props scattered over a level that grows with their count, a probe walking among them
+	static void Benchmark(uint32_t propCount, uint32_t moveCount, BenchmarkResult& result);
+
+private:
+	static const uint32_t LeafSize = 4;
+
+	struct Node
+	{
+		float Min[3];
+		float Max[3];
+		// Children at Left and Left + 1, or a leaf of Count items from First
+		uint32_t Left;
+		uint32_t First;
+		uint32_t Count;
+	};
+
+	void BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count);
+	void TestBox(const CullBox& target, uint32_t item, const CullBox& box, const float delta[3], SweepHit& hit, bool& found) const;
+	bool SweepBruteForce(const CullBox& box, const float delta[3], SweepHit& hit) const;
+
+private:
+	std::vector<Node> mNodes;
+	std::vector<CullBox> mStatic;
+	// Static box indices in tree order
+	std::vector<uint32_t> mItems;
+	std::vector<CullBox> mDynamic;
+	mutable uint32_t mTestCount = 0;
+};
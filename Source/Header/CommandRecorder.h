@@ -0,0 +1,108 @@
+#pragma once
+
+#include "RenderTypes.h"
+
+// The commands a frame records, as issued by DrawList and the frame setup.
+// D3D12CommandRecorder forwards them to a command list. NullCommandRecorder only counts them,
+// so the frame can be generated without submitting anything to a GPU, or without Windows at all.
+class CommandRecorder
+{
+public:
+	virtual ~CommandRecorder() {}
+
+	virtual void SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect) = 0;
+	virtual void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil) = 0;
+	virtual void SetDescriptorHeap(ID3D12DescriptorHeap* heap) = 0;
+	virtual void SetRootSignature(ID3D12RootSignature* rootSignature) = 0;
+	virtual void SetStencilRef(UINT stencilRef) = 0;
+
+	virtual void SetPipelineState(ID3D12PipelineState* pipelineState) = 0;
+	virtual void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) = 0;
+	virtual void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) = 0;
+	virtual void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY primitiveTopology) = 0;
+
+	virtual void SetRootConstants(UINT parameter, UINT count, const void* data) = 0;
+	virtual void SetRootConstantBuffer(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+	virtual void SetRootShaderResource(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+	virtual void SetRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) = 0;
+
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation) = 0;
+};
+
+#ifdef _WIN32
+class D3D12CommandRecorder : public CommandRecorder
+{
+public:
+	explicit D3D12CommandRecorder(ID3D12GraphicsCommandList* cmdList);
+
+	virtual void SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect) override;
+	virtual void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil) override;
+	virtual void SetDescriptorHeap(ID3D12DescriptorHeap* heap) override;
+	virtual void SetRootSignature(ID3D12RootSignature* rootSignature) override;
+	virtual void SetStencilRef(UINT stencilRef) override;
+
+	virtual void SetPipelineState(ID3D12PipelineState* pipelineState) override;
+	virtual void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) override;
+	virtual void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) override;
+	virtual void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY primitiveTopology) override;
+
+	virtual void SetRootConstants(UINT parameter, UINT count, const void* data) override;
+	virtual void SetRootConstantBuffer(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) override;
+	virtual void SetRootShaderResource(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) override;
+	virtual void SetRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override;
+
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation) override;
+
+private:
+	ID3D12GraphicsCommandList* mCmdList;
+};
+#endif
+
+// What a NullCommandRecorder has seen since its last Reset
+struct CommandCounts
+{
+	UINT FrameState = 0;
+	UINT PipelineStates = 0;
+	UINT BufferViews = 0;
+	UINT Topologies = 0;
+	UINT RootConstants = 0;
+	UINT RootBuffers = 0;
+	UINT DescriptorTables = 0;
+	UINT Draws = 0;
+	UINT64 Indices = 0;
+	UINT64 Instances = 0;
+	// Bytes that would have gone into the command list as root arguments
+	UINT64 RootBytes = 0;
+
+	UINT GetCommandCount() const;
+	CommandCounts& operator+=(const CommandCounts& rhs);
+};
+
+// Counts commands instead of recording them. One recorder per thread.
+class NullCommandRecorder : public CommandRecorder
+{
+public:
+	void Reset();
+	const CommandCounts& GetCounts() const;
+
+	virtual void SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect) override;
+	virtual void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil) override;
+	virtual void SetDescriptorHeap(ID3D12DescriptorHeap* heap) override;
+	virtual void SetRootSignature(ID3D12RootSignature* rootSignature) override;
+	virtual void SetStencilRef(UINT stencilRef) override;
+
+	virtual void SetPipelineState(ID3D12PipelineState* pipelineState) override;
+	virtual void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) override;
+	virtual void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) override;
+	virtual void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY primitiveTopology) override;
+
+	virtual void SetRootConstants(UINT parameter, UINT count, const void* data) override;
+	virtual void SetRootConstantBuffer(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) override;
+	virtual void SetRootShaderResource(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) override;
+	virtual void SetRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override;
+
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation) override;
+
+private:
+	CommandCounts mCounts;
+};
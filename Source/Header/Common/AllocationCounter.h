@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts heap allocations made through operator new, which AllocationCounter.cpp replaces
+// for the whole program, aligned forms included when the compiler has C++17 aligned new.
+// Only builds defining ALLOCATION_COUNTER replace it, so the others keep the CRT debug heap
+// and its leak check; there every count stays 0 and IsCounting is false.
+// Per thread counts let a caller measure a span of its own work while other threads
+// allocate; the total covers every thread.
+//
+//	uint64_t before = AllocationCounter::GetThreadCount();
+//	Simulate();
+//	uint64_t allocations = AllocationCounter::GetThreadCount() - before;
+class AllocationCounter
+{
+public:
+	// Allocations by the calling thread since it started
+	static uint64_t GetThreadCount();
+	// Allocations by every thread since the program started
+	static uint64_t GetTotalCount();
+	// Whether operator new is replaced in this build
+	static bool IsCounting();
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+// Accumulates frame time and hands it out in fixed simulation steps.
+// The simulation runs at its own rate whatever the frame rate; rendering blends the last
+// two simulated states by GetAlpha. A slow frame runs at most MaxSteps steps and drops
+// the rest, so the simulation slows down instead of spiralling.
+//
+//	step.Accumulate(gt.DeltaTime());
+//	while (step.Step())
+//		Simulate(step.GetTime(), step.GetStep());
+//	Render(step.GetAlpha());
+class FixedStep
+{
+public:
+	static const unsigned int MaxSteps = 8;
+
+	// Steps per second
+	explicit FixedStep(float rate = 25.0f);
+
+	void SetRate(float rate);
+	float GetRate() const;
+	// Seconds per step
+	float GetStep() const;
+
+	void Accumulate(float deltaTime);
+	// Takes one step off the accumulator, false when less than a step is left
+	bool Step();
+
+	// Simulated seconds, counting the steps taken
+	float GetTime() const;
+	// How far the accumulator is into the next step, 0 to 1
+	float GetAlpha() const;
+	// Steps taken since the last Accumulate
+	unsigned int GetStepCount() const;
+
+private:
+	float mRate;
+	float mStep;
+	float mAccumulator = 0.0f;
+	double mTime = 0.0;
+	unsigned int mStepCount = 0;
+};
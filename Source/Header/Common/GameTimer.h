@@ -18,9 +18,18 @@ public:
 	void Stop();  // Call when paused.
 	void Tick();  // Call every frame.
 
+	// TotalTime and DeltaTime in clock counts, for recording the frame times exactly
+	__int64 DeltaCounts()const;
+	__int64 TotalCounts()const;
+	__int64 CountsPerSecond()const;
+	void SetCountsPerSecond(__int64 countsPerSec);
+	// Call instead of Tick to step to recorded counts.
+	void Advance(__int64 deltaCounts, __int64 totalCounts);
+
 private:
 	double mSecondsPerCount;
 	double mDeltaTime;
+	__int64 mDeltaCounts;
 
 	__int64 mBaseTime;
 	__int64 mPausedTime;
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <exception>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of tasks.
+class ThreadPool
+{
+public:
+	// 0 picks hardware_concurrency - 1 (at least one worker)
+	explicit ThreadPool(unsigned int threadCount = 0);
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+	~ThreadPool();
+
+	unsigned int GetThreadCount() const;
+
+	void Enqueue(std::function<void()> task);
+
+	// Block until every queued task has finished
+	void Wait();
+
+	// Run body(0..count-1) on the workers and the calling thread, return when all are done.
+	// The caller takes part in the loop, so this is safe to call from inside a task.
+	// An exception thrown by body skips the indices not yet started and is rethrown here,
+	// after every running index has finished.
+	// The body is called through a plain function pointer and the loop state is reused, so
+	// once as many loops have run at once as ever will, a call allocates nothing.
+	template<typename Fn>
+	void ParallelFor(unsigned int count, const Fn& body);
+
+private:
+	// One ParallelFor in flight. Kept for the next call when it is done.
+	struct Loop
+	{
+		void (*Invoke)(const void* body, unsigned int index) = nullptr;
+		const void* Body = nullptr;
+		unsigned int Count = 0;
+		std::atomic<unsigned int> Next{ 0 };
+		std::atomic<unsigned int> Done{ 0 };
+		// Workers still to join and workers running it, both under mMutex
+		unsigned int Wanted = 0;
+		unsigned int Active = 0;
+		// First exception thrown by the body, rethrown on the caller once every index is done
+		std::exception_ptr Error;
+		std::atomic<bool> Failed{ false };
+	};
+
+	void Run(unsigned int count, void (*invoke)(const void*, unsigned int), const void* body);
+	void RunLoop(Loop& loop);
+	void WorkerMain();
+
+private:
+	std::vector<std::thread> mWorkers;
+	std::deque<std::function<void()>> mTasks;
+
+	// Loops asking for workers, the newest at the back so nested loops finish first
+	std::vector<Loop*> mLoopQueue;
+	std::vector<std::unique_ptr<Loop>> mLoops;
+	std::vector<Loop*> mFreeLoops;
+
+	std::mutex mMutex;
+	std::condition_variable mTaskReady;
+	std::condition_variable mTaskDone;
+	std::condition_variable mLoopDone;
+
+	unsigned int mActiveTasks = 0;
+	bool mStop = false;
+};
+
+template<typename Fn>
+void ThreadPool::ParallelFor(unsigned int count, const Fn& body)
+{
+	Run(count, [](const void* f, unsigned int i) { (*static_cast<const Fn*>(f))(i); }, &body);
+}
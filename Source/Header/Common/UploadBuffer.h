@@ -1,12 +1,13 @@
 #pragma once
 
 #include "d3dUtil.h"
+#include "RenderDevice.h"
 
 template<typename T>
 class UploadBuffer
 {
 public:
-    UploadBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer) : 
+    UploadBuffer(RenderDevice* device, UINT elementCount, bool isConstantBuffer) : 
         mIsConstantBuffer(isConstantBuffer)
     {
         mElementByteSize = sizeof(T);
@@ -21,44 +22,51 @@ public:
         if(isConstantBuffer)
             mElementByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(T));
 
-        ThrowIfFailed(device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(mElementByteSize*elementCount),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&mUploadBuffer)));
-
-        ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
-
-        // We do not need to unmap until we are done with the resource.  However, we must not write to
+        // Stays mapped until the buffer is destroyed.  However, we must not write to
         // the resource while it is in use by the GPU (so we must use synchronization techniques).
+        mUploadBuffer = device->CreateUploadBuffer((UINT64)mElementByteSize*elementCount, nullptr);
+        mMappedData = mUploadBuffer.GetCPU();
     }
 
     UploadBuffer(const UploadBuffer& rhs) = delete;
     UploadBuffer& operator=(const UploadBuffer& rhs) = delete;
-    ~UploadBuffer()
+
+    // Where the shaders read element 0
+    D3D12_GPU_VIRTUAL_ADDRESS GetGPUAddress()const
+    {
+        return mUploadBuffer.GetGPU();
+    }
+
+    void CopyData(int elementIndex, const T& data)
     {
-        if(mUploadBuffer != nullptr)
-            mUploadBuffer->Unmap(0, nullptr);
+        memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
+        mBytesWritten += sizeof(T);
+    }
 
-        mMappedData = nullptr;
+    // Contiguous elements, structured buffers only
+    void CopyData(int elementIndex, const T* data, UINT count)
+    {
+        assert(!mIsConstantBuffer);
+        memcpy(&mMappedData[elementIndex*mElementByteSize], data, sizeof(T) * count);
+        mBytesWritten += sizeof(T) * count;
     }
 
-    ID3D12Resource* Resource()const
+    // Bytes copied since the last reset, for per-frame upload stats
+    UINT64 GetBytesWritten()const
     {
-        return mUploadBuffer.Get();
+        return mBytesWritten;
     }
 
-    void CopyData(int elementIndex, const T& data)
+    void ResetBytesWritten()
     {
-        memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
+        mBytesWritten = 0;
     }
 
 private:
-    Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
+    UploadMemory mUploadBuffer;
     BYTE* mMappedData = nullptr;
 
     UINT mElementByteSize = 0;
     bool mIsConstantBuffer = false;
+    UINT64 mBytesWritten = 0;
 };
\ No newline at end of file
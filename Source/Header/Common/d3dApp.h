@@ -53,6 +53,9 @@ protected:
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)  { }
 	virtual void OnMouseMove(WPARAM btnState, int x, int y){ }
 
+	// Called once a second, before the caption is set, to refresh mFrameStatsText
+	virtual void UpdateFrameStatsText(){ }
+
 protected:
 
 	bool InitMainWindow();
@@ -119,6 +122,8 @@ protected:
 
 	// Derived class should set these in derived constructor to customize starting values.
 	std::wstring mMainWndCaption = L"d3d App";
+	// Extra per-frame statistics appended to the caption
+	std::wstring mFrameStatsText;
 	D3D_DRIVER_TYPE md3dDriverType = D3D_DRIVER_TYPE_HARDWARE;
     DXGI_FORMAT mBackBufferFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
     DXGI_FORMAT mDepthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
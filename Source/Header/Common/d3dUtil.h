@@ -26,6 +26,7 @@
 #include <sstream>
 #include <cassert>
 #include "d3dx12.h"
+#include "RenderTypes.h"
 // 
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
@@ -189,7 +190,8 @@ struct MeshGeometry
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
-		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
+		// No buffer on a NullRenderDevice
+		vbv.BufferLocation = VertexBufferGPU ? VertexBufferGPU->GetGPUVirtualAddress() : 0;
 		vbv.StrideInBytes = VertexByteStride;
 		vbv.SizeInBytes = VertexBufferByteSize;
 
@@ -199,7 +201,7 @@ struct MeshGeometry
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
 	{
 		D3D12_INDEX_BUFFER_VIEW ibv;
-		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
+		ibv.BufferLocation = IndexBufferGPU ? IndexBufferGPU->GetGPUVirtualAddress() : 0;
 		ibv.Format = IndexFormat;
 		ibv.SizeInBytes = IndexBufferByteSize;
 
@@ -238,6 +240,8 @@ struct MaterialConstants
 
 // Simple struct to represent a material for our demos.  A production 3D engine
 // would likely create a class hierarchy of Materials.
+// Only FbxLoader fills these now, as the load-time record of an FBX material before
+// it is added to Materials; nothing reads MatCBIndex or NumFramesDirty any more.
 struct Material
 {
 	// Unique material name for lookup.
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "SpatialGrid.h"
+
+class FlowField;
+
+// What a crowd member is doing, the clip it plays
+enum class eCrowdClip : uint32_t
+{
+	Idle,
+	Walking,
+	Attack,
+	Death,
+	Count
+};
+
+// A zone population simulated as structure of arrays. Every per-member field lives in its
+// own array, padded to a multiple of 4, and the steering, state and timers run 4 members
+// per SSE instruction. Only the separation from neighbours is scalar, through a SpatialGrid,
+// so the cost grows linearly with the population at a fixed density.
+// Members behave like the zone monsters: they turn toward the target within aggro range,
+// walk up to it, back off when too close, strike on a cooldown and respawn after dying.
+// With a flow field, members beyond attack range follow it around the walls instead.
+class Crowd
+{
+public:
+	void Spawn(uint32_t count, float minX, float minZ, float maxX, float maxZ, float health, std::mt19937& engine);
+	void Clear();
+
+	// Steps every member toward (targetX, targetZ), along field when given.
+	// Returns how many struck the target.
+	uint32_t Update(float targetX, float targetZ, float dt, const FlowField* field = nullptr);
+	// Damages members within radius of (x, z). Returns how many were hit.
+	uint32_t Damage(float x, float z, float radius, float damage);
+
+	uint32_t GetCount() const;
+	uint32_t GetAliveCount() const;
+	float GetPositionX(uint32_t i) const;
+	float GetPositionZ(uint32_t i) const;
+	// Unit heading on the ground plane
+	float GetHeadingX(uint32_t i) const;
+	float GetHeadingZ(uint32_t i) const;
+	float GetHealth(uint32_t i) const;
+	eCrowdClip GetClip(uint32_t i) const;
+	const SpatialGrid& GetGrid() const;
+	// ms spent in the last Update
+	float GetUpdateTime() const;
+
+	// Members chasing a target through their zone, ms per Update
+	static float Benchmark(uint32_t count, uint32_t frames);
+
+private:
+	void ReadFlow(const FlowField& field, float targetX, float targetZ);
+	void UpdateLanes(float targetX, float targetZ, float dt);
+	void Separate(float dt);
+
+private:
+	uint32_t mCount = 0;
+	uint32_t mAttacks = 0;
+	float mFullHealth = 0.0f;
+	float mUpdateTime = 0.0f;
+
+	std::vector<float> mPosX, mPosZ;
+	std::vector<float> mHeadingX, mHeadingZ;
+	// Heading read from the flow field this step, zero to head straight for the target
+	std::vector<float> mFlowX, mFlowZ;
+	std::vector<float> mSpawnX, mSpawnZ;
+	std::vector<float> mHealth;
+	// Counts down the attack cooldown, or the respawn while dead
+	std::vector<float> mTimer;
+	std::vector<uint32_t> mClip;
+
+	SpatialGrid mGrid;
+	std::vector<uint32_t> mQueryIds;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Frustum culling on axis-aligned boxes. No graphics API or DirectXMath dependency,
+// boxes are tested four at a time with SSE (scalar fallback elsewhere).
+
+struct CullBox
+{
+	float Center[3];
+	float Extents[3];
+};
+
+struct Frustum
+{
+	// (a, b, c, d) with the inside where a*x + b*y + c*z + d >= 0: left, right, bottom, top, near, far
+	float Planes[6][4];
+
+	// Row-major view-projection for row vectors (v * M) and a [0, 1] clip depth
+	static Frustum FromViewProj(const float m[16]);
+};
+
+// visible[i] = 1 when box i intersects the frustum or lies inside it, else 0
+void CullBoxes(const Frustum& frustum, const CullBox* boxes, uint32_t count, uint8_t* visible);
+// CullBoxes without SSE, as built where it is unavailable; the reference for the vector path
+void CullBoxesScalar(const Frustum& frustum, const CullBox* boxes, uint32_t count, uint8_t* visible);
+
+// Four-wide bounding volume hierarchy over static boxes.
+// Each subtree owns a contiguous range of items, so a node fully inside the frustum
+// is accepted as a whole and only the nodes crossing a plane are opened.
+class CullBVH
+{
+public:
+	// Items are referred to by their index in boxes
+	void Build(const CullBox* boxes, uint32_t count);
+
+	// Appends the indices of the visible items, in tree order
+	void Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	uint32_t GetItemCount() const;
+	uint32_t GetNodeCount() const;
+
+private:
+	static const uint32_t LeafSize = 4;
+	static const int32_t Leaf = -1;
+
+	// Four child boxes in SoA layout. Count is 0 for unused slots.
+	struct Node
+	{
+		float CenterX[4], CenterY[4], CenterZ[4];
+		float ExtentX[4], ExtentY[4], ExtentZ[4];
+		int32_t Child[4];
+		uint32_t First[4];
+		uint32_t Count[4];
+	};
+
+	void BuildRange(uint32_t first, uint32_t count, Node& node, uint32_t slot);
+	uint32_t BuildNode(uint32_t first, uint32_t count);
+	void TestLeaf(const Frustum& frustum, uint32_t first, uint32_t count, std::vector<uint32_t>& visible) const;
+
+private:
+	std::vector<Node> mNodes;
+
+	// Items in tree order; the SoA copies are padded for the four-lane leaf tests
+	std::vector<uint32_t> mItems;
+	std::vector<CullBox> mBoxes;
+	std::vector<float> mItemCenters[3];
+	std::vector<float> mItemExtents[3];
+};
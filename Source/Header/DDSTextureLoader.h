@@ -24,6 +24,8 @@
 
 #include <wrl.h>
 #include <d3d11_1.h>
+#include <memory>
+#include <vector>
 #include "../Common/d3dx12.h"
 
 #pragma warning(push)
@@ -92,6 +94,14 @@ namespace DirectX
 		_Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 	);
 
+	// Decode only, no device work. subresources point into ddsData.
+	HRESULT LoadDDSTextureDataFromFile12(_In_z_ const wchar_t* szFileName,
+		_Out_ std::unique_ptr<uint8_t[]>& ddsData,
+		_Out_ D3D12_RESOURCE_DESC& texDesc,
+		_Out_ std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+		_In_ size_t maxsize = 0
+	);
+
 	// Standard version with optional auto-gen mipmap support
 	HRESULT CreateDDSTextureFromMemory(_In_ ID3D11Device* d3dDevice,
 		_In_opt_ ID3D11DeviceContext* d3dContext,
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include "RenderTypes.h"
+#include "CommandRecorder.h"
+
+// One draw with every piece of state it needs.
+// Zero Instances, SkinnedCB or Palette means the draw does not use that root parameter.
+struct DrawCommand
+{
+	UINT Layer = 0;
+	UINT PSO = 0;
+	// Identifies the vertex and index buffers for the key; only compared, never read
+	const void* Geo = nullptr;
+	D3D12_VERTEX_BUFFER_VIEW VertexBuffer = {};
+	D3D12_INDEX_BUFFER_VIEW IndexBuffer = {};
+	MaterialHandle Mat = 0;
+	// View depth scaled to [0, 1], sorted front to back inside a state group
+	float Depth = 0.0f;
+	// Only layer and PSO are sorted, the rest keeps submission order (UI, where overlap order shows)
+	bool KeepOrder = false;
+
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+	UINT InstanceCount = 1;
+
+	DrawConstants Constants;
+	D3D12_GPU_VIRTUAL_ADDRESS Instances = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS SkinnedCB = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS Palette = 0;
+};
+
+// Collects the draws of a frame and records them in three stages:
+// 64-bit sort keys are built from (layer, PSO, geometry, material, depth),
+// the keys are radix sorted, and Execute emits only the state that differs from the previous draw.
+// Equal keys keep their submission order. Disjoint ranges of the sorted list can be executed
+// into separate command lists at the same time.
+class DrawList
+{
+public:
+	DrawList();
+	~DrawList();
+
+	// Pipeline states addressed by DrawCommand::PSO
+	void SetPipelineStates(const std::vector<ID3D12PipelineState*>& pipelineStates);
+	void SetRootParameters(UINT drawConstants, UINT skinnedCB, UINT palette, UINT instances);
+
+	void Clear();
+	void Add(const DrawCommand& command);
+
+	// Stage 1 and 2
+	void Sort();
+	// Stage 3, no state is assumed to be set on the recorder
+	void Execute(CommandRecorder& recorder);
+	// Draws [first, first + count) of the sorted list, thread safe for disjoint ranges
+	void Execute(CommandRecorder& recorder, UINT first, UINT count);
+
+	UINT GetDrawCount() const;
+	// Set* calls emitted by Execute since the last Sort, root bindings included
+	UINT GetStateChanges() const;
+	UINT GetRootBindings() const;
+	// State changes plus draws
+	UINT GetCommandCount() const;
+	float GetKeyTime() const;
+	float GetSortTime() const;
+
+	// Times key generation and sorting of drawCount random draws, in ms per iteration
+	static void Benchmark(UINT drawCount, UINT iterations, float& keyTime, float& sortTime);
+
+private:
+	void BuildKeys();
+	void RadixSort();
+	UINT GetGeometryId(const void* geo);
+
+private:
+	std::vector<ID3D12PipelineState*> mPipelineStates;
+	UINT mDrawConstantsParameter = 0;
+	UINT mSkinnedCBParameter = 0;
+	UINT mPaletteParameter = 0;
+	UINT mInstancesParameter = 0;
+
+	std::vector<DrawCommand> mCommands;
+	std::vector<UINT64> mKeys;
+	std::vector<UINT> mOrder;
+	std::vector<UINT64> mTempKeys;
+	std::vector<UINT> mTempOrder;
+
+	// Small ids for the geometry field, kept across frames
+	std::unordered_map<const void*, UINT> mGeometryIds;
+
+	std::atomic<UINT> mStateChanges{ 0 };
+	std::atomic<UINT> mRootBindings{ 0 };
+	float mKeyTime = 0.0f;
+	float mSortTime = 0.0f;
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Handle to an entity; the generation tells a reused slot from the entity that held it
+struct Entity
+{
+	uint32_t Index;
+	uint32_t Generation;
+};
+
+// Archetype entity storage. Every set of component types is an archetype, and its entities
+// live in fixed-size chunks holding one array per component (structure of arrays), so a
+// query walks contiguous memory chunk by chunk instead of chasing pointers per entity.
+// Entities stay packed: destroying one moves the archetype's last entity into the hole.
+// Components are plain data copied with memcpy when an entity changes archetype.
+// Not thread safe; systems may split the chunks of a query across threads themselves.
+class EntityWorld
+{
+public:
+	static const uint32_t ChunkBytes = 16 * 1024;
+	static const uint32_t MaxComponents = 32;
+
+	EntityWorld() = default;
+	EntityWorld(const EntityWorld& rhs) = delete;
+	EntityWorld& operator=(const EntityWorld& rhs) = delete;
+
+	// Ids are handed out on first use, shared by every world
+	template<typename T>
+	static uint32_t ComponentId();
+
+	// A new entity with value-initialized components
+	template<typename... Ts>
+	Entity Create();
+	void Destroy(Entity e);
+	bool IsAlive(Entity e) const;
+
+	template<typename T>
+	bool Has(Entity e) const;
+	// Null when the entity does not have T. Valid until the next structural change.
+	template<typename T>
+	T* Get(Entity e);
+	// Moves the entity to the archetype with (or without) T
+	template<typename T>
+	T* Add(Entity e);
+	template<typename T>
+	void Remove(Entity e);
+
+	// fn(count, entities, Ts* ...) once per chunk of every archetype having all of Ts
+	template<typename... Ts, typename Fn>
+	void Each(Fn fn);
+
+	uint32_t GetEntityCount() const;
+	uint32_t GetArchetypeCount() const;
+	uint32_t GetChunkCount() const;
+
+	struct BenchmarkResult
+	{
+		// ms per frame of AI, animation, instance and health bar updates
+		float ClassTime;
+		float EntityTime;
+		// Instances that differ between the two
+		uint32_t Mismatches;
+	};
+
+	// Characters as owned objects with separate render items against entities in chunks
+	static void Benchmark(uint32_t characterCount, uint32_t frames, BenchmarkResult& result);
+
+private:
+	typedef uint32_t ComponentMask;
+
+	struct ComponentInfo
+	{
+		uint32_t Size;
+		uint32_t Align;
+	};
+
+	struct Chunk
+	{
+		std::unique_ptr<uint8_t[]> Data;
+		uint32_t Count = 0;
+	};
+
+	struct Archetype
+	{
+		ComponentMask Mask = 0;
+		uint32_t Capacity = 0;
+		// Byte offset of each component array in a chunk, the entities at 0
+		uint32_t Offsets[MaxComponents];
+		std::vector<Chunk> Chunks;
+		// The last chunk to empty, kept so an entity that dies and spawns again does not reallocate
+		std::unique_ptr<uint8_t[]> Spare;
+	};
+
+	struct Record
+	{
+		uint32_t Archetype;
+		uint32_t Chunk;
+		uint32_t Row;
+		uint32_t Generation;
+		bool Alive;
+	};
+
+	static std::vector<ComponentInfo>& Components();
+	static uint32_t RegisterComponent(uint32_t size, uint32_t align);
+
+	template<typename... Ts>
+	static ComponentMask MaskOf();
+
+	uint32_t FindArchetype(ComponentMask mask);
+	Entity Allocate();
+	// Appends a zeroed row for e to the archetype, updating its record
+	void Insert(Entity e, uint32_t archetype);
+	// Takes the row out of its archetype, filling the hole with the last row
+	void Erase(const Record& record);
+	void Move(Entity e, ComponentMask mask);
+	uint8_t* Column(const Record& record, uint32_t id);
+
+private:
+	std::vector<Archetype> mArchetypes;
+	std::unordered_map<ComponentMask, uint32_t> mArchetypeIndex;
+
+	std::vector<Record> mRecords;
+	std::vector<uint32_t> mFreeIndices;
+	uint32_t mEntityCount = 0;
+};
+
+template<typename T>
+uint32_t EntityWorld::ComponentId()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components are copied with memcpy");
+	static const uint32_t id = RegisterComponent((uint32_t)sizeof(T), (uint32_t)alignof(T));
+	return id;
+}
+
+template<typename... Ts>
+EntityWorld::ComponentMask EntityWorld::MaskOf()
+{
+	ComponentMask mask = 0;
+	for (uint32_t id : std::initializer_list<uint32_t>{ ComponentId<Ts>()... })
+		mask |= 1u << id;
+	return mask;
+}
+
+template<typename... Ts>
+Entity EntityWorld::Create()
+{
+	Entity e = Allocate();
+	Insert(e, FindArchetype(MaskOf<Ts...>()));
+	return e;
+}
+
+template<typename T>
+bool EntityWorld::Has(Entity e) const
+{
+	if (!IsAlive(e))
+		return false;
+	return (mArchetypes[mRecords[e.Index].Archetype].Mask & (1u << ComponentId<T>())) != 0;
+}
+
+template<typename T>
+T* EntityWorld::Get(Entity e)
+{
+	if (!Has<T>(e))
+		return nullptr;
+	return reinterpret_cast<T*>(Column(mRecords[e.Index], ComponentId<T>())) + mRecords[e.Index].Row;
+}
+
+template<typename T>
+T* EntityWorld::Add(Entity e)
+{
+	if (!IsAlive(e))
+		return nullptr;
+	if (!Has<T>(e))
+		Move(e, mArchetypes[mRecords[e.Index].Archetype].Mask | (1u << ComponentId<T>()));
+	return Get<T>(e);
+}
+
+template<typename T>
+void EntityWorld::Remove(Entity e)
+{
+	if (Has<T>(e))
+		Move(e, mArchetypes[mRecords[e.Index].Archetype].Mask & ~(1u << ComponentId<T>()));
+}
+
+template<typename... Ts, typename Fn>
+void EntityWorld::Each(Fn fn)
+{
+	ComponentMask mask = MaskOf<Ts...>();
+	for (auto& archetype : mArchetypes)
+	{
+		if ((archetype.Mask & mask) != mask)
+			continue;
+
+		for (auto& chunk : archetype.Chunks)
+		{
+			uint8_t* data = chunk.Data.get();
+			fn(chunk.Count, reinterpret_cast<const Entity*>(data),
+				reinterpret_cast<Ts*>(data + archetype.Offsets[ComponentId<Ts>()])...);
+		}
+	}
+}
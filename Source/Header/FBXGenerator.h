@@ -1,17 +1,20 @@
 #pragma once
 #include "SkinnedData.h"
 
+class RenderDevice;
 class Textures;
 class Materials;
+class TextureManifest;
 class Player;
 class Monster;
+struct CullBox;
 class FBXGenerator
 {
 public:
 	FBXGenerator();
 	~FBXGenerator();
 
-	void Begin(ID3D12Device * device, ID3D12GraphicsCommandList * cmdList, ID3D12DescriptorHeap * cbvHeap);
+	void Begin(RenderDevice * device, ID3D12DescriptorHeap * cbvHeap, TextureManifest * textureManifest);
 	void End();
 
 	void BuildFBXTexture(std::vector<Material>& outMaterial, std::string inTextureName, std::string inMaterialName, Textures & mTexDiffuse, Textures & mTexturesNormal, Materials & mMaterials);
@@ -22,14 +25,17 @@ public:
 
 	void LoadFBXSubMonster(std::vector<std::unique_ptr<Monster>>& mMonstersByZone, std::vector<Material>& outMaterial, std::string & inMaterialName, std::string & FileName, bool isEvenX, bool isEvenZ);
 
-	void LoadFBXArchitecture(std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& mGeometries, Textures& mTexDiffuse, Textures& mTexturesNormal, Materials& mMaterials);
+	// Also fills mOccluders with the occluder boxes of each architecture mesh, by submesh name
+	void LoadFBXArchitecture(std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& mGeometries, std::unordered_map<std::string, std::vector<CullBox>>& mOccluders, Textures& mTexDiffuse, Textures& mTexturesNormal, Materials& mMaterials);
+
+	void LoadOccluder(const std::string& fileName, const std::vector<Vertex>& vertices, const std::vector<std::uint32_t>& indices, std::vector<CullBox>& outBoxes);
 
 	void BuildArcheGeometry(const std::vector<std::vector<Vertex>>& outVertices, const std::vector<std::vector<std::uint32_t>>& outIndices, const std::vector<std::string>& geoName, std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& mGeometries);
 
 private:
-	ID3D12Device * mDevice;
-	ID3D12GraphicsCommandList* mCommandList;
+	RenderDevice * mDevice;
 	ID3D12DescriptorHeap* mCbvHeap;
+	TextureManifest* mTextureManifest;
 
 	bool mInBeginEndPair;
 };
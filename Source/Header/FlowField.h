@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Culling.h"
+
+// Shared navigation toward one goal over a grid on the ground plane (x, z).
+// Build marks the cells the static boxes cover, grown by the agents' radius. A rebuild runs a
+// Dijkstra over the free cells (Dial's bucket queue, 8-connected without cutting corners)
+// and stores in every cell the direction of its cheapest neighbour, but only when the goal
+// moves to another cell. Agents then read their heading in O(1) whatever their number.
+// The field is double buffered: a rebuild fills the back buffers a slice of cells per Step
+// while agents keep reading the previous field, and the two are swapped once it is done.
+// Slices are counted in cells, not time, so replays swap on the same frame.
+class FlowField
+{
+public:
+	void Build(const CullBox* boxes, uint32_t count,
+		float minX, float minZ, float maxX, float maxZ,
+		float cellSize, float agentRadius);
+
+	// Returns true when the goal changed cell, which queues a rebuild toward it
+	bool SetGoal(float x, float z);
+	// Works on the queued rebuild for at most cellBudget cells, each settled or pointed cell
+	// counting one. A goal set mid-rebuild is started once the current one is swapped in.
+	// Returns true when a new field was swapped in.
+	bool Step(uint32_t cellBudget = UINT32_MAX);
+
+	// Unit direction toward the goal from (x, z). False outside the grid, in a blocked or
+	// unreachable cell, and in the goal cell itself.
+	bool GetDirection(float x, float z, float& dirX, float& dirZ) const;
+	// Walking distance to the goal, negative when unreachable
+	float GetDistance(float x, float z) const;
+
+	uint32_t GetWidth() const;
+	uint32_t GetHeight() const;
+	uint32_t GetBlockedCount() const;
+	// ms the last swapped-in rebuild took over all its steps, ms spent in the last Step,
+	// and rebuilds swapped in since Build
+	float GetRebuildTime() const;
+	float GetStepTime() const;
+	uint32_t GetRebuildCount() const;
+
+	struct BenchmarkResult
+	{
+		// ms per rebuild done in one Step, and the longest Step and the Steps per rebuild
+		// with the budget
+		float RebuildTime = 0.0f;
+		float MaxStepTime = 0.0f;
+		float StepsPerRebuild = 0.0f;
+		// Cells whose direction differs between the two, should be 0
+		uint32_t Mismatches = 0;
+	};
+
+	// Random boxes over a side x side grid, rebuilt toward random goals at once and in slices
+	static void Benchmark(uint32_t side, uint32_t rebuilds, uint32_t cellBudget, BenchmarkResult& result);
+
+private:
+	static const uint32_t None = 8;
+	static const uint32_t Unreachable = UINT32_MAX;
+
+	enum class eBuild
+	{
+		Idle,
+		Search,
+		Directions
+	};
+
+	bool CellOf(float x, float z, uint32_t& cellX, uint32_t& cellZ) const;
+	void BeginRebuild(uint32_t goal);
+	// False when the budget ran out first
+	bool ContinueRebuild(uint32_t cellBudget);
+
+private:
+	float mMinX = 0.0f;
+	float mMinZ = 0.0f;
+	float mCellSize = 1.0f;
+	float mInvCellSize = 1.0f;
+	uint32_t mWidth = 0;
+	uint32_t mHeight = 0;
+	uint32_t mBlockedCount = 0;
+
+	// The goal cell of the field agents read, and of the last SetGoal
+	uint32_t mGoal = UINT32_MAX;
+	uint32_t mRequestedGoal = UINT32_MAX;
+	float mRebuildTime = 0.0f;
+	float mStepTime = 0.0f;
+	uint32_t mRebuildCount = 0;
+
+	// Per cell, row-major in z: blocked flag, cost (10 per straight step, 14 per diagonal)
+	// and the neighbour to walk to (None at the goal and where unreachable)
+	std::vector<uint8_t> mBlocked;
+	std::vector<uint32_t> mCost;
+	std::vector<uint8_t> mDirection;
+
+	// The rebuild in progress: its goal, back buffers, and where the search or the direction
+	// pass stopped
+	eBuild mBuildState = eBuild::Idle;
+	uint32_t mBuildGoal = UINT32_MAX;
+	float mBuildTime = 0.0f;
+	std::vector<uint32_t> mBuildCost;
+	std::vector<uint8_t> mBuildDirection;
+	uint32_t mSearchCost = 0;
+	uint32_t mBucketIndex = 0;
+	uint32_t mPending = 0;
+	uint32_t mDirectionCell = 0;
+
+	// Dial's buckets, one per cost modulo the largest step
+	std::vector<std::vector<uint32_t>> mBuckets;
+};
@@ -3,6 +3,7 @@
 #include "d3dUtil.h"
 #include "MathHelper.h"
 #include "UploadBuffer.h"
+#include "UploadAllocator.h"
 
 struct PassConstants
 {
@@ -28,6 +29,30 @@ struct PassConstants
 	DirectX::XMFLOAT2 cbPerObjectPad2 = { 0.0f, 0.0f };
 
 	Light Lights[MaxLights];
+
+	// Point and spot lights binned into froxels, see LightClusters
+	UINT ClusterDimX = 0;
+	UINT ClusterDimY = 0;
+	UINT ClusterDimZ = 0;
+	UINT ClusterLightCount = 0;
+	float ClusterSliceScale = 0.0f;
+	float ClusterSliceBias = 0.0f;
+	DirectX::XMFLOAT2 cbPerObjectPad3 = { 0.0f, 0.0f };
+};
+
+// Per-material data read by index from a structured buffer.
+struct MaterialData
+{
+	DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+	float Roughness = 0.5f;
+	DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// Absolute indices into the bindless texture range (-1 if unused).
+	int DiffuseMapIndex = -1;
+	int NormalMapIndex = -1;
+	UINT MaterialPad0;
+	UINT MaterialPad1;
 };
 
 struct ObjectConstants
@@ -35,9 +60,26 @@ struct ObjectConstants
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 };
+// Bone matrices per skinned instance in the palette buffers
+const UINT gBonePaletteSize = 96;
+
+// Per submesh; the bones live once per instance at PaletteOffset
 struct CharacterConstants : ObjectConstants
 {
-	DirectX::XMFLOAT4X4 BoneTransforms[96];
+	UINT PaletteOffset = 0;
+	UINT CharacterPad0;
+	UINT CharacterPad1;
+	UINT CharacterPad2;
+};
+// One instance of an InstanceBatch, read at gObjIndex + SV_InstanceID
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+	UINT MaterialIndex = 0;
+	UINT PaletteOffset = 0;
+	UINT InstancePad0;
+	UINT InstancePad1;
 };
 struct UIConstants : ObjectConstants
 {
@@ -79,22 +121,11 @@ struct UIVertex : Vertex
 	float Row;
 };
 
-enum class eUploadBufferIndex : int
-{
-	ObjectCB,
-	PlayerCB,
-	MonsterCB,
-	MaterialCB,
-	PassCB,
-	UICB,
-	MonsterUICB
-};
-
 // Stores the resources needed for the CPU to build the command lists for a frame.  
 struct FrameResource
 {
 public:
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT PlayerCount, UINT MonsterCount, UINT UICount, UINT MonsterUICount);
+    FrameResource(RenderDevice* device, UINT objectCount, UINT materialCount, UINT UICount, UINT MonsterUICount, UINT64 UploadCapacity, UINT WorkerCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -102,40 +133,26 @@ public:
 	
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
+	// One allocator and list per recording worker, created closed. Null on a NullRenderDevice.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> WorkerCmdListAllocs;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> WorkerCmdLists;
+
+	// Persistent data rewritten only when dirty. ObjectCB, MaterialBuffer, UICB and MonsterUICB
+	// are structured buffers indexed in the shaders.
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
-	std::unique_ptr<UploadBuffer<MaterialConstants>>  MaterialCB = nullptr;
-    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-	std::unique_ptr<UploadBuffer<CharacterConstants>> PlayerCB = nullptr;
-	std::unique_ptr<UploadBuffer<CharacterConstants>> MonsterCB = nullptr;
+	std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
     std::unique_ptr<UploadBuffer<UIConstants>> UICB = nullptr;
     std::unique_ptr<UploadBuffer<UIConstants>> MonsterUICB = nullptr;
 
+	// Everything written every frame (pass constants, skinned constants, bone palettes, visible instances)
+	// is allocated here and bound by address
+	std::unique_ptr<UploadAllocator> Allocator = nullptr;
+
+	// Bytes written to every upload buffer since the last reset
+	UINT64 GetUploadBytes() const;
+	void ResetUploadBytes();
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
-
-	static ID3D12Resource* GetResourceByIndex(
-		const FrameResource* mFrameResources, eUploadBufferIndex e)
-	{
-		switch (e)
-		{
-		case eUploadBufferIndex::ObjectCB:
-			return mFrameResources->ObjectCB->Resource();
-		case eUploadBufferIndex::PlayerCB:
-			return  mFrameResources->PlayerCB->Resource();
-		case eUploadBufferIndex::MonsterCB:
-			return  mFrameResources->MonsterCB->Resource();
-		case eUploadBufferIndex::MaterialCB:
-			return  mFrameResources->MaterialCB->Resource();
-		case eUploadBufferIndex::PassCB:
-			return  mFrameResources->PassCB->Resource();
-		case eUploadBufferIndex::UICB:
-			return  mFrameResources->UICB->Resource();
-		case eUploadBufferIndex::MonsterUICB:
-			return  mFrameResources->MonsterUICB->Resource();
-		default:
-			return nullptr;
-		}
-	}
-
 };
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "RenderTypes.h"
+#include "CommandRecorder.h"
+#include "DrawList.h"
+#include "Culling.h"
+#include "Crowd.h"
+#include "CollisionWorld.h"
+#include "FlowField.h"
+#include "HitQueue.h"
+#include "OcclusionCuller.h"
+#include "LightClusters.h"
+#include "LinearAllocator.h"
+#include "ZoneScheduler.h"
+
+class ThreadPool;
+
+struct HeadlessSettings
+{
+	uint32_t Seed = 1;
+	uint32_t ZoneCount = 3;
+	// Crowd members per zone
+	uint32_t Population = 2000;
+	uint32_t PropCount = 4000;
+	uint32_t HouseCount = 24;
+	float ActiveRate = 25.0f;
+	float BackgroundRate = 5.0f;
+	// Every draw binds the seven descriptor tables it did before the bindless materials,
+	// instead of the two root constants, to compare what recording costs with each
+	bool TableBindings = false;
+};
+
+// What one Frame did
+struct HeadlessFrameStats
+{
+	// ms for the simulation, culling and uploads, and for collecting and recording the draws
+	float UpdateTime = 0.0f;
+	float DrawTime = 0.0f;
+	// Part of DrawTime spent recording the sorted draws
+	float RecordTime = 0.0f;
+	float CrowdTime = 0.0f;
+	float FlowTime = 0.0f;
+	float CullTime = 0.0f;
+	float OcclusionTime = 0.0f;
+	float LightTime = 0.0f;
+
+	uint32_t Visible = 0;
+	uint32_t Occluded = 0;
+	uint32_t Lights = 0;
+	uint32_t Hits = 0;
+	uint32_t CommandLists = 0;
+	// Root constants, buffers and tables bound by the frame state of every list and by the draws
+	uint32_t RootBindings = 0;
+	uint64_t UploadBytes = 0;
+	CommandCounts Counts;
+};
+
+// The game's frame without the window, the device and the assets: a seeded level of houses and
+// props, a crowd per zone stepped by the ZoneScheduler along the shared FlowField, hits resolved
+// through the HitQueue, a scripted player moving through the CollisionWorld, frustum and
+// occlusion culling, clustered lights, per-frame uploads into host memory and a sorted DrawList
+// recorded in parallel into NullCommandRecorders.
+// It only uses the modules that build without the Windows SDK, so the whole path runs and is
+// timed anywhere. Meshes, pipeline states and descriptors are stand-ins with fake addresses;
+// what the recorders count matches what the same draws would record on a command list.
+class HeadlessScene
+{
+public:
+	explicit HeadlessScene(ThreadPool* threadPool);
+	HeadlessScene(const HeadlessScene& rhs) = delete;
+	HeadlessScene& operator=(const HeadlessScene& rhs) = delete;
+
+	void Build(const HeadlessSettings& settings);
+	// One frame of dt seconds
+	void Frame(float dt, HeadlessFrameStats& stats);
+
+	const ZoneScheduler& GetZoneScheduler() const;
+	const FlowField& GetFlowField() const;
+	uint32_t GetAliveCount() const;
+	// Where the scripted player is, which tells two runs of one seed apart
+	void GetPlayerPosition(float position[3]) const;
+	float GetPlayerDamage() const;
+
+private:
+	struct Mesh
+	{
+		D3D12_VERTEX_BUFFER_VIEW VertexBuffer;
+		D3D12_INDEX_BUFFER_VIEW IndexBuffer;
+		UINT IndexCount;
+	};
+
+	// Static items drawn instanced, one draw per batch
+	struct Batch
+	{
+		const Mesh* Geo;
+		MaterialHandle Mat;
+		UINT Layer;
+		std::vector<uint32_t> Items;
+		UINT InstanceBase;
+		UINT InstanceCount;
+		D3D12_GPU_VIRTUAL_ADDRESS Instances;
+	};
+
+	struct HitFlash
+	{
+		float Position[3];
+		float Age;
+	};
+
+	// Counts like NullCommandRecorder. With table bindings it keeps the draw constants and binds
+	// the old tables from them before each draw, found by offset in the heap as they were.
+	class BindingRecorder : public NullCommandRecorder
+	{
+	public:
+		void SetTableBindings(bool tableBindings);
+
+		virtual void SetRootConstants(UINT parameter, UINT count, const void* data) override;
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation) override;
+
+	private:
+		bool mTableBindings = false;
+		DrawConstants mConstants;
+	};
+
+	void BuildLevel(std::mt19937& engine);
+	void MovePlayer(float dt);
+	void StepZones(float dt, HeadlessFrameStats& stats);
+	// Returns the number of hits resolved
+	uint32_t ResolveHits();
+	void UpdateCamera();
+	void CullItems(HeadlessFrameStats& stats);
+	void UploadInstances();
+	void UpdateLights(float dt, HeadlessFrameStats& stats);
+	void CollectDraws();
+	void RecordDraws(HeadlessFrameStats& stats);
+	void SetFrameState(CommandRecorder& recorder) const;
+
+	D3D12_GPU_VIRTUAL_ADDRESS Upload(const void* data, uint64_t size);
+	BYTE* Allocate(uint64_t size, D3D12_GPU_VIRTUAL_ADDRESS& address);
+
+private:
+	ThreadPool* mThreadPool;
+	HeadlessSettings mSettings;
+	float mTime = 0.0f;
+
+	std::vector<Mesh> mMeshes;
+	std::vector<Batch> mBatches;
+	std::vector<CullBox> mStaticBoxes;
+	CullBVH mStaticBVH;
+	std::vector<uint32_t> mVisibleStatic;
+	std::vector<uint8_t> mStaticVisible;
+
+	CollisionWorld mCollision;
+	std::vector<SweepHit> mPlayerContacts;
+	FlowField mFlowField;
+	OcclusionCuller mOcclusion;
+	LightClusters mLightClusters;
+
+	ZoneScheduler mZoneScheduler;
+	std::vector<Crowd> mCrowds;
+	HitQueue mHits;
+	uint32_t mActiveZone = 0;
+	uint32_t mHitSequence = 0;
+	float mNextAttack = 0.0f;
+
+	CullBox mPlayerBox = {};
+	float mPlayerYaw = 0.0f;
+	float mPlayerDamage = 0.0f;
+
+	// Row-major for row vectors, as the culling modules take them
+	float mView[16] = {};
+	float mViewProj[16] = {};
+	Frustum mFrustum = {};
+
+	std::vector<CullBox> mCrowdBoxes;
+	std::vector<uint8_t> mCrowdVisible;
+	UINT mCrowdInstances = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mCrowdInstanceAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mPaletteAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mPassAddress = 0;
+	std::vector<float> mClipPalettes;
+
+	std::vector<float> mTorches;
+	std::vector<HitFlash> mHitFlashes;
+	std::vector<LightBounds> mLightBounds;
+	D3D12_GPU_VIRTUAL_ADDRESS mLightAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mClusterAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mLightIndexAddress = 0;
+
+	// Host memory standing in for the frame's upload heap
+	std::vector<BYTE> mUploadMemory;
+	LinearAllocator mUploadAllocator{ 0 };
+
+	DrawList mDrawList;
+	std::vector<BindingRecorder> mRecorders;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+enum class eHitSource : uint32_t
+{
+	Player,
+	Monster
+};
+
+// One attack landing this tick, queued by the attacker and resolved later
+struct HitEvent
+{
+	eHitSource Source;
+	// Zone of the attacking monster, or of the monsters the player swings at
+	uint32_t Zone;
+	// Attacking slot within the zone, 0 for the player
+	uint32_t Attacker;
+	// Slot hit, or NoTarget when the hit covers an area around Position
+	uint32_t Target;
+	// Orders the hits of one attacker within one step
+	uint32_t Sequence;
+	// Simulation time of the step that queued it
+	float Time;
+	int Damage;
+	float Position[3];
+	float Look[3];
+};
+
+// Hits written by many threads during the parallel AI phase and resolved in one pass.
+// Push claims a slot with a single atomic add, so producers never lock or wait. The queue
+// is sized for the worst case up front: which hits a full queue would lose depends on thread
+// timing, so an overflow is reported by Sort as an error instead of dropping hits quietly.
+// Once the producers are joined, Sort puts the hits in an order that only depends on their
+// contents, so resolution is the same whichever thread queued what first. That needs every
+// hit to have its own (Source, Zone, Time, Attacker, Sequence), which Sort checks too.
+class HitQueue
+{
+public:
+	static const uint32_t NoTarget = UINT32_MAX;
+
+	explicit HitQueue(uint32_t capacity = 1024);
+	HitQueue(const HitQueue& rhs) = delete;
+	HitQueue& operator=(const HitQueue& rhs) = delete;
+
+	// Only while the queue is empty, before the producers start
+	void SetCapacity(uint32_t capacity);
+	uint32_t GetCapacity() const;
+
+	// Any thread
+	void Push(const HitEvent& e);
+
+	// Only once every producer has finished. Throws std::runtime_error if the queue
+	// overflowed or two hits share an ordering key.
+	void Sort();
+	uint32_t GetCount() const;
+	const HitEvent& operator[](uint32_t i) const;
+	void Clear();
+
+	struct BenchmarkResult
+	{
+		// ns per hit to queue it from the workers, and to sort and apply it
+		float PushTime;
+		float ResolveTime;
+		float HitsPerFrame;
+		// Combatants whose health differs from a single-threaded run
+		uint32_t Mismatches;
+	};
+
+	// Combatants in groups of 64 striking each other across groups, groups stepped in parallel
+	static void Benchmark(uint32_t combatantCount, uint32_t frames, ThreadPool* threadPool, BenchmarkResult& result);
+
+private:
+	std::vector<HitEvent> mEvents;
+	std::atomic<uint32_t> mCount{ 0 };
+};
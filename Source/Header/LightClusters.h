@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// View-space sphere holding everything a point or spot light reaches
+struct LightBounds
+{
+	float Center[3];
+	float Radius;
+};
+
+// Clustered light binning on the CPU. The view frustum is cut into DimX x DimY screen tiles and
+// DimZ depth slices spaced exponentially between the near and far planes (froxels).
+// Every light whose bounds touch a froxel is appended to that froxel's list. The lists come out
+// as one (offset, count) pair per cluster into a flat index list, the layout the shaders read.
+// Depth slices are binned in parallel, each one writing only its own clusters, into one flat
+// list per slice rather than a list per cluster. Reserve sizes them up front.
+class LightClusters
+{
+public:
+	static const uint32_t DimX = 16;
+	static const uint32_t DimY = 8;
+	static const uint32_t DimZ = 24;
+	static const uint32_t ClusterCount = DimX * DimY * DimZ;
+
+	struct Range
+	{
+		uint32_t Offset;
+		uint32_t Count;
+	};
+
+	LightClusters();
+
+	// Same parameters as the camera projection, rebuilds the froxel bounds
+	void SetProjection(float fovY, float aspect, float nearZ, float farZ);
+
+	// Sizes the lists for up to maxLights lights touching every cluster, so Build never allocates
+	void Reserve(uint32_t maxLights);
+
+	// threadPool may be null to bin on the calling thread
+	void Build(const LightBounds* lights, uint32_t count, ThreadPool* threadPool);
+
+	// Cluster (x, y, z) is at (z * DimY + y) * DimX + x, tile row 0 at the top of the screen
+	const std::vector<Range>& GetRanges() const;
+	const std::vector<uint32_t>& GetIndices() const;
+
+	// The depth slice of view depth d is log(d) * scale + bias
+	float GetSliceScale() const;
+	float GetSliceBias() const;
+	// ms spent in the last Build
+	float GetBuildTime() const;
+
+	// Random lights around the view, ms per Build
+	static float Benchmark(uint32_t lightCount, uint32_t iterations, ThreadPool* threadPool);
+
+private:
+	void BuildSlice(uint32_t slice, const LightBounds* lights, uint32_t count);
+
+private:
+	float mNearZ = 1.0f;
+	float mFarZ = 1000.0f;
+	float mSliceScale = 0.0f;
+	float mSliceBias = 0.0f;
+
+	// View-space bounds of the tile columns and rows on each slice, x grows left to right, y top to bottom
+	std::vector<float> mTileMinX, mTileMaxX;
+	std::vector<float> mTileMinY, mTileMaxY;
+	std::vector<float> mSliceNear, mSliceFar;
+
+	// Per slice, the (tile, light) pairs it touches in light order
+	struct TileLight
+	{
+		uint32_t Tile;
+		uint32_t Light;
+	};
+	std::vector<std::vector<TileLight>> mSlicePairs;
+
+	std::vector<Range> mRanges;
+	std::vector<uint32_t> mIndices;
+	float mBuildTime = 0.0f;
+};
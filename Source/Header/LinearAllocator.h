@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// Bump sub-allocator for per-frame upload memory.
+// Works on byte offsets only, so it does not depend on the graphics API.
+// Everything is freed at once by Reset, after the GPU is done with the frame.
+class LinearAllocator
+{
+public:
+	static const uint64_t InvalidOffset = UINT64_MAX;
+
+	explicit LinearAllocator(uint64_t capacity);
+
+	// Returns InvalidOffset when the rest of the range is too small
+	uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+	void Reset();
+	// Start over on new backing memory of the given size
+	void Reset(uint64_t capacity);
+
+	uint64_t GetCapacity() const;
+	uint64_t GetUsedSize() const;
+
+private:
+	uint64_t mCapacity;
+	uint64_t mOffset = 0;
+};
@@ -2,6 +2,8 @@
 
 #include "FrameResource.h"
 
+// Materials are stored densely (SoA) and referenced by MaterialHandle.
+// Name lookup is meant for load time only; per-frame code works on handles.
 class Materials
 {
 public:
@@ -10,29 +12,54 @@ public:
 
 	UINT GetSize() const;
 
-	Material* Get(std::string Name);
+	MaterialHandle Get(const std::string& Name) const;
+	const std::string& GetName(MaterialHandle Handle) const;
+	int GetDiffuseSrvHeapIndex(MaterialHandle Handle) const;
+	int GetNormalSrvHeapIndex(MaterialHandle Handle) const;
 
-	void SetMaterial(
+	MaterialHandle SetMaterial(
 		const std::string& Name,
 		const DirectX::XMFLOAT4& DiffuseAlbedo,
 		const DirectX::XMFLOAT3& FresnelR0,
-		const float& Roughness, const int& MatIndex,
+		const float& Roughness,
 		const int& DiffuseSrvHeapIndex,
 		const int& NormalSrvHeapIndex = -1);
 	void SetMaterial(
 		const std::vector<std::string>& Name,
 		const std::vector<DirectX::XMFLOAT4>& DiffuseAlbedo,
 		const std::vector<DirectX::XMFLOAT3>& FresnelR0,
-		const std::vector<float>& Roughness, int MatIndex,
+		const std::vector<float>& Roughness,
 		const std::vector<int>& DiffuseSrvHeapIndex,
 		const std::vector<int>& NormalSrvHeapIndex = std::vector<int>(1, -1));
 
-	void UpdateMaterialCB(UploadBuffer<MaterialConstants>* currMaterialCB);
+	void SetDiffuseAlbedo(MaterialHandle Handle, const DirectX::XMFLOAT4& DiffuseAlbedo);
+	void SetMatTransform(MaterialHandle Handle, const DirectX::XMFLOAT4X4& MatTransform);
+
+	// Normal maps live after the diffuse maps in the bindless texture range
+	void SetNormalSrvHeapOffset(int Offset);
+
+	// Upload the materials on the dirty list as one contiguous block
+	void UpdateMaterialBuffer(UploadBuffer<MaterialData>* currMaterialBuffer);
 
 private:
-	ID3D12Device * mDevice;
-	ID3D12DescriptorHeap* mCbvHeap;
+	void MarkDirty(MaterialHandle Handle);
+
+private:
+	std::unordered_map<std::string, MaterialHandle> mLookup;
+
+	std::vector<std::string> mName;
+	std::vector<int> mDiffuseSrvHeapIndex;
+	std::vector<int> mNormalSrvHeapIndex;
+	std::vector<int> mNumFramesDirty;
+	std::vector<DirectX::XMFLOAT4> mDiffuseAlbedo;
+	std::vector<DirectX::XMFLOAT3> mFresnelR0;
+	std::vector<float> mRoughness;
+	std::vector<DirectX::XMFLOAT4X4> mMatTransform;
+
+	std::vector<MaterialHandle> mDirtyList;
+	// Staging for the block UpdateMaterialBuffer writes
+	std::vector<MaterialData> mUploadData;
 
-	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
+	int mNormalSrvHeapOffset = 0;
 };
 
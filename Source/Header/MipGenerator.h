@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class ThreadPool;
+
+// Builds a full mip chain for a decoded 8-bit, 4-channel image on the CPU.
+// Filtering is separable and runs four channels at a time (SSE where available), rows are split across the ThreadPool.
+// With sRGB the color channels are filtered in linear space; alpha is always linear.
+// Has no graphics API dependency; the caller decides which pixel formats qualify.
+class MipGenerator
+{
+public:
+	enum class Filter : int
+	{
+		BOX,
+		KAISER,
+		Count
+	};
+
+	explicit MipGenerator(ThreadPool* threadPool = nullptr);
+
+	static uint32_t CalcMipCount(uint32_t width, uint32_t height);
+	// Bytes needed for levels 1..mipLevels-1, tightly packed
+	static uint64_t CalcChainSize(uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// Writes levels 1..mipLevels-1 back to back into outMips, each with a row pitch of width * 4
+	void Generate(
+		const uint8_t* src, uint32_t width, uint32_t height, uint32_t rowPitch,
+		uint32_t mipLevels, uint8_t* outMips,
+		Filter filter = Filter::KAISER, bool sRGB = true, bool wrap = true);
+
+	// Source pixels and time of the last Generate
+	uint64_t GetLastPixels() const;
+	double GetLastSeconds() const;
+
+	// Full chains of a random width x height image, best of runs, in source megapixels per second
+	static double Benchmark(uint32_t width, uint32_t height, Filter filter, ThreadPool* threadPool, int runs = 5);
+
+private:
+	void ForEachRowBand(uint32_t rows, const std::function<void(uint32_t, uint32_t)>& body);
+
+private:
+	ThreadPool* mThreadPool;
+
+	uint64_t mLastPixels = 0;
+	double mLastSeconds = 0.0;
+};
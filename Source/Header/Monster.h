@@ -2,6 +2,40 @@
 
 #include "MonsterUI.h"
 #include "Character.h"
+#include "RandomStreams.h"
+#include "SpatialGrid.h"
+#include "Crowd.h"
+#include "EntityWorld.h"
+#include "CharacterComponents.h"
+
+class OcclusionCuller;
+class FlowField;
+class HitQueue;
+
+// What a zone sees of the player during a step. Zones may step on worker threads,
+// so they read this copy and queue their strikes as hits instead of touching the player.
+struct ZoneTarget
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Look;
+	int Health;
+	// Shared paths toward the player, read only during the step; null to head straight
+	const FlowField* Field;
+	// Shared by every zone, resolved once the steps are done
+	HitQueue* Hits;
+};
+
+// Where a monster slot is in its lifecycle. Slots are never added or removed: the slot of
+// a dead monster goes to the free list and a spawn takes it back, keeping its render items,
+// palette and UI constant buffer indices. Only the live slots have an entity.
+enum class eMonsterState
+{
+	Alive,
+	// Playing the death clip
+	Dying,
+	// Hidden, waiting on the free list
+	Free
+};
 
 class Monster : public Character
 {
@@ -23,17 +57,35 @@ public:
 
 	UINT GetNumberOfMonster() const;
 	UINT GetUISize() const;
-	UINT GetAllRitemsSize() const;
 	const std::vector<RenderItem*> GetRenderItem(RenderLayer Type) const;
+	const std::vector<InstanceBatch>& GetInstanceBatches(RenderLayer Type) const;
+	// Bone palettes of the batches, valid for the frame of the last UpdateCharacterCBs
+	D3D12_GPU_VIRTUAL_ADDRESS GetPaletteAddress() const;
+	// Bodies and shadows that passed culling in the last UpdateCharacterCBs
+	UINT GetVisibleInstanceCount() const;
+	// Bodies and shadows in the frustum that the occluders hid
+	UINT GetOccludedInstanceCount() const;
+	// Appends where monsters were hit since the last call
+	void TakeHitPositions(std::vector<DirectX::XMFLOAT3>& outPositions);
 
 	void SetClipName(const std::string & inClipName, int cIndex);
 	void SetMaterialName(const std::string& inMaterialName);
 	void SetMonsterIndex(int inMonsterIndex);
+	// Spawn positions and attack choice draw from the zone's streams
+	void SetRandomStreams(const RandomStreams& streams, UINT zone);
+	// Before BuildRenderItem, members of the zone crowd spawned beside the monsters
+	void SetCrowdPopulation(UINT population);
+	// Seconds a freed slot waits before its monster spawns again; 0 keeps the dead down
+	void SetRespawnDelay(float seconds);
+
+	eMonsterState GetState(UINT cIndex) const;
+	UINT GetFreeCount() const;
+	// Spawns that reused a freed slot
+	UINT GetRespawnCount() const;
 
 public:
 	virtual void BuildGeometry(
-		ID3D12Device * device,
-		ID3D12GraphicsCommandList * cmdList,
+		RenderDevice* device,
 		const std::vector<CharacterVertex>& inVertices,
 		const std::vector<std::uint32_t>& inIndices,
 		const SkinnedData & inSkinInfo, std::string geoName) override;
@@ -45,21 +97,104 @@ public:
 	void UpdateCharacterCBs(
 		FrameResource* mCurrFrameResource,
 		const Light& mMainLight,
+		const Frustum& frustum,
+		const OcclusionCuller& occlusion,
 		const GameTimer & gt);
 	virtual void UpdateCharacterShadows(const Light & mMainLight);
-	void UpdateMonsterPosition(Character& Player, const GameTimer & gt);
+	// One simulation step of dt seconds ending at simTime. Touches only this zone.
+	void UpdateMonsterPosition(const ZoneTarget& target, float simTime, float dt);
+	void UpdateCrowd(const ZoneTarget& target, float dt);
+	// Drawn transforms blend the last two simulation steps, 0 the older one and 1 the newer
+	void SetInterpolation(float alpha);
+	// For a zone that is not drawn: poses its monsters at the latest step so hits see current bounds
+	void UpdatePosedBounds();
+
+	// Monster positions on the ground plane, indexed like the monsters
+	const SpatialGrid& GetGrid() const;
+	const Crowd& GetCrowd() const;
+
+private:
+	void UpdateGrid(UINT cIndex);
+	// Scale, rotation quaternion and position between the last two simulation steps
+	void GetDrawnTransform(UINT cIndex, DirectX::XMVECTOR& scale, DirectX::XMVECTOR& rotation, DirectX::XMVECTOR& position) const;
+	// The slot's entity, drawn with its render item's material, its attack clock at startTime
+	void CreateEntity(UINT cIndex, float startTime);
+	// Copies the drawn transform and posed box to the slot's entity for the instance upload
+	void UpdateEntity(UINT cIndex, TransformComponent& transform, BoundsComponent& bounds);
+	// Poses the monster at timePos and refreshes its bounds and the hit reach
+	void PoseMonster(UINT cIndex, float timePos);
+	// Hides the slot and queues it on the free list
+	void Release(UINT cIndex);
+	// Brings the slot back at its spawn point with full health
+	void Respawn(UINT cIndex, float simTime);
 
 private:
 	std::vector<CharacterInfo> mMonsterInfo;
+	std::vector<eMonsterState> mStates;
+	std::vector<DirectX::XMFLOAT3> mSpawnPoints;
+	// Freed slots, oldest first, in a ring with room for every monster, and when each died
+	std::vector<UINT> mFreeSlots;
+	std::vector<float> mFreeTimes;
+	UINT mFreeHead = 0;
+	UINT mFreeCount = 0;
+	UINT mRespawnCount = 0;
+	float mRespawnDelay = 0.0f;
+	// Transforms before the last simulation step
+	std::vector<WorldTransform> mPrevTransforms;
+	float mInterpolation = 1.0f;
+	// Length of the last simulation step, the animation clocks move with it
+	float mStepTime = 0.0f;
 
 	SkinnedData mSkinnedInfo;
 	std::vector<std::unique_ptr<SkinnedModelInstance>> mSkinnedModelInst;
 
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
+	// One item per monster; the submeshes are drawn through mBatches
 	std::vector<RenderItem*> mRitems[(int)RenderLayer::Count];
+	std::vector<InstanceBatch> mBatches[(int)RenderLayer::Count];
+
+	D3D12_GPU_VIRTUAL_ADDRESS mPaletteAddress = 0;
+
+	// The live monsters, one entity per slot that is not free. The AI, the animation clocks,
+	// the health bars and the instance upload all walk its chunks, so only what can act or
+	// be drawn is visited; the render component's instance index names the slot.
+	EntityWorld mEntities;
+	std::vector<Entity> mSlotEntities;
+	UINT mShadowMaterial = 0;
+	// Flattens a world onto the ground away from the main light
+	DirectX::XMFLOAT4X4 mShadowTransform;
+
+	// Per-frame staging for the culled instance upload, bodies then shadows in entity order
+	std::vector<InstanceData> mInstanceData;
+	std::vector<CullBox> mCullBoxes;
+	std::vector<uint8_t> mCullVisible;
+	UINT mVisibleInstanceCount = 0;
+	UINT mOccludedInstanceCount = 0;
+	std::vector<DirectX::XMMATRIX> mUIWorlds;
+	std::vector<DirectX::XMVECTOR> mUIEyeLeft;
+
+	std::vector<DirectX::XMFLOAT3> mHitPositions;
+
+	// Slots whose death clip ran out during the step, released once the chunks are walked
+	std::vector<UINT> mDeadSlots;
+	// The attack clocks of the first monsters start with the zone's first step
+	bool mAttackClockStarted = false;
+
+	std::mt19937 mSpawnEngine;
+	std::mt19937 mAIEngine;
+
+	SpatialGrid mGrid;
+	std::vector<uint32_t> mQueryIds;
+	// Farthest any posed box reaches from its monster's position, widening the hit query
+	float mHitReach = 0.0f;
+
+	// Simulated only, the monsters above are the ones drawn
+	Crowd mCrowd;
+	UINT mCrowdPopulation = 0;
 
 private:
 	int mMonsterIndex;
+	UINT mZone = 0;
 	UINT numOfCharacter;
 	UINT mAliveMonster;
 	UINT mDamage;
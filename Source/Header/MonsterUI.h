@@ -12,8 +12,6 @@ public:
 
 	void SetDamageScale(int cIndex, float inScale);
 
-	void DeleteMonsterUI(int cIndex);
-
 	void BuildRenderItem(
 		std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& mGeometries,
 		Materials & mMaterials,
@@ -22,8 +20,8 @@ public:
 
 	void UpdateUICBs(
 		UploadBuffer<UIConstants>* currUICB,
-		std::vector<DirectX::XMMATRIX> playerWorlds,
-		std::vector<DirectX::XMVECTOR> inEyeLeft,
+		const std::vector<DirectX::XMMATRIX>& playerWorlds,
+		const std::vector<DirectX::XMVECTOR>& inEyeLeft,
 		bool mTransformDirty);
 
 private:
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include "Culling.h"
+
+// Low-poly stand-ins of a render mesh for the occlusion culler, a few boxes in mesh space.
+// Cooking voxelizes the mesh surface, takes the cells that cannot be reached from outside
+// as the solid interior, and greedily grows the boxes that cover most of it.
+// The boxes stay inside the surface (to within a fraction of a cell), so they hide only what
+// the mesh hides. An open mesh leaks and cooks to fewer boxes or none.
+class Occluder
+{
+public:
+	// Sides of the mesh bounds for closedSides
+	enum : uint32_t
+	{
+		SideNegX = 1 << 0,
+		SidePosX = 1 << 1,
+		SideNegY = 1 << 2,
+		SidePosY = 1 << 3,
+		SideNegZ = 1 << 4,
+		SidePosZ = 1 << 5
+	};
+
+	static const uint32_t DefaultResolution = 32;
+	static const uint32_t DefaultMaxBoxes = 6;
+
+	// Positions are read as three floats every stride bytes. Closed sides are treated as walls,
+	// for meshes left open where they stand on the ground. Resolution is the cell count along
+	// the longest side of the bounds; boxes of fewer than minCells cells are dropped.
+	static void Cook(const void* positions, uint32_t stride, uint32_t vertexCount,
+		const uint32_t* indices, uint32_t indexCount, std::vector<CullBox>& outBoxes,
+		uint32_t closedSides = 0, uint32_t resolution = DefaultResolution, uint32_t maxBoxes = DefaultMaxBoxes, uint32_t minCells = 8);
+
+	static bool Load(const std::string& fileName, std::vector<CullBox>& outBoxes);
+	static bool Save(const std::string& fileName, const std::vector<CullBox>& boxes);
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Culling.h"
+
+// Software occlusion culling, fully on the CPU. Occluder triangles are rasterized into a small
+// depth buffer four pixels at a time with SSE (scalar fallback elsewhere), and a pyramid keeping
+// the farthest depth of every 2x2 block (HiZ) is built over it.
+// A box is occluded when its nearest depth lies behind the farthest occluder depth of the texels
+// under its screen rectangle. Only covered pixel centers are written and the pyramid keeps the
+// farthest depth, so the test errs towards visible.
+class OcclusionCuller
+{
+public:
+	// Width and height are powers of two, the width at least 4
+	OcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+
+	void ClearOccluders();
+	// Adds the twelve triangles of box transformed by a row-major world matrix
+	void AddOccluder(const CullBox& box, const float world[16]);
+
+	// Clears the depth, rasterizes the occluders seen through viewProj and builds the pyramid.
+	// Row-major view-projection for row vectors (v * M) and a [0, 1] clip depth.
+	void Render(const float viewProj[16]);
+
+	// Against the depth of the last Render. Boxes crossing the near plane are visible.
+	bool IsVisible(const CullBox& box) const;
+	// Clears visible[i] of the boxes found occluded, boxes already culled are skipped.
+	// Returns the number of boxes it cleared.
+	uint32_t TestBoxes(const CullBox* boxes, uint32_t count, uint8_t* visible) const;
+
+	uint32_t GetWidth() const;
+	uint32_t GetHeight() const;
+	uint32_t GetTriangleCount() const;
+	// Triangles of the last Render that were front facing and on screen
+	uint32_t GetRasterizedCount() const;
+
+	struct BenchmarkResult
+	{
+		// ms per Render, ns per box test
+		float RenderTime = 0.0f;
+		float TestTime = 0.0f;
+		uint32_t Tested = 0;
+		uint32_t Occluded = 0;
+		// Occluded by ray casts from the eye to points spread over each box
+		uint32_t ReferenceOccluded = 0;
+		// Culled while a reference ray reached the box
+		uint32_t FalseOccluded = 0;
+	};
+
+	// Random boxes behind a row of walls, timed over iterations and checked against ray casts
+	static void Benchmark(uint32_t boxCount, uint32_t iterations, BenchmarkResult& result);
+
+private:
+	void RasterizeTriangle(const float* v0, const float* v1, const float* v2);
+	void BuildPyramid();
+
+private:
+	uint32_t mWidth;
+	uint32_t mHeight;
+
+	// xyz of three vertices per triangle, world space
+	std::vector<float> mTriangles;
+	uint32_t mRasterizedCount = 0;
+	float mViewProj[16] = {};
+
+	// Level 0 is the rasterized depth, level i is (width >> i) x (height >> i)
+	std::vector<std::vector<float>> mLevels;
+};
@@ -4,6 +4,8 @@
 #include "PlayerUI.h"
 #include "Character.h"
 
+class HitQueue;
+
 enum class ePlayerMoveList
 {
 	Walk,
@@ -26,24 +28,29 @@ public:
 	virtual int GetHealth(int i = 0) const override;
 	virtual CharacterInfo& GetCharacterInfo(int cIndex = 0);
 	virtual void Damage(int damage, DirectX::XMVECTOR Position, DirectX::XMVECTOR Look) override;
-	void Attack(Character* inMonster, std::string clipName);
+	// Plays the clip and queues a hit on the zone's monsters, dealt when the hits are resolved
+	void Attack(HitQueue& hits, UINT zone, const std::string& clipName);
 
 public:
 	bool isClipEnd();
 	eClipList GetCurrentClip() const;
 
 	DirectX::XMMATRIX GetWorldTransformMatrix() const;
+	// The posed shadow, every shadow submesh sharing it
+	const DirectX::BoundingBox& GetShadowBounds() const;
 
 	UINT GetAllRitemsSize() const;
 	const std::vector<RenderItem*> GetRenderItem(RenderLayer Type) const;
+	// Valid for the frame of the last UpdateCharacterCBs
+	D3D12_GPU_VIRTUAL_ADDRESS GetSkinnedCBAddress(int playerCBIndex) const;
+	D3D12_GPU_VIRTUAL_ADDRESS GetPaletteAddress() const;
 
 	void SetClipName(const std::string & inClipName);
 	void SetClipTime(float time);
 
 public:
 	virtual void BuildGeometry(
-		ID3D12Device * device,
-		ID3D12GraphicsCommandList * cmdList,
+		RenderDevice* device,
 		const std::vector<CharacterVertex>& inVertices,
 		const std::vector<std::uint32_t>& inIndices,
 		const SkinnedData & inSkinInfo, std::string geoName);
@@ -61,6 +68,8 @@ public:
 	virtual void UpdateCharacterShadows(const Light & mMainLight);
 
 	void UpdatePlayerPosition(ePlayerMoveList move, float velocity);
+	// Moves by a world-space offset, for motion the collision world has resolved
+	void TranslatePlayer(DirectX::FXMVECTOR offset);
 
 	void UpdateTransformationMatrix();
 	
@@ -72,8 +81,15 @@ private:
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 	std::vector<RenderItem*> mRitems[(int)RenderLayer::Count];
 
+	D3D12_GPU_VIRTUAL_ADDRESS mSkinnedCBAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mPaletteAddress = 0;
+
+	DirectX::BoundingBox mShadowBounds;
+
 private:
 	UINT mDamage;
+	// Orders the player's hits within a tick
+	UINT mAttackSequence = 0;
 	UINT mFullHealth;
 	bool DeathCamFinished = false;
 
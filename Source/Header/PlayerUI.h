@@ -22,8 +22,7 @@ public:
 	void SetGameover();
 
 	void BuildGeometry(
-		ID3D12Device * device, 
-		ID3D12GraphicsCommandList * cmdList,
+		RenderDevice* device,
 		const std::vector<UIVertex>& inVertices, 
 		const std::vector<std::uint32_t>& inIndices, 
 		std::string geoName);
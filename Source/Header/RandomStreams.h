@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+// Every system draws from its own engine, derived from one session seed.
+// A system's sequence then depends only on the seed and its own draws, so adding
+// a draw in one system does not shift the numbers another one sees.
+class RandomStreams
+{
+public:
+	enum eStream : uint32_t
+	{
+		Scene,
+		MonsterSpawn,
+		MonsterAI,
+		Count
+	};
+
+	explicit RandomStreams(uint32_t seed = 0);
+
+	void Seed(uint32_t seed);
+	uint32_t GetSeed() const;
+
+	// Engine of a stream; index tells instances of one system apart (monster zones)
+	std::mt19937 Create(eStream stream, uint32_t index = 0) const;
+
+private:
+	uint32_t mSeed;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// Upload heap memory, mapped for its whole life and read by the GPU at GetGPU.
+// Without a device it is host memory whose address stands in for the GPU one.
+class UploadMemory
+{
+public:
+	UploadMemory() = default;
+	UploadMemory(Microsoft::WRL::ComPtr<ID3D12Resource> resource, BYTE* mappedData);
+	explicit UploadMemory(UINT64 size);
+	UploadMemory(const UploadMemory& rhs) = delete;
+	UploadMemory& operator=(const UploadMemory& rhs) = delete;
+	UploadMemory(UploadMemory&& rhs) noexcept;
+	UploadMemory& operator=(UploadMemory&& rhs) noexcept;
+	~UploadMemory();
+
+	BYTE* GetCPU() const;
+	D3D12_GPU_VIRTUAL_ADDRESS GetGPU() const;
+
+private:
+	void Release();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Resource> mResource;
+	std::unique_ptr<BYTE[]> mHostData;
+	BYTE* mMappedData = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS mAddress = 0;
+};
+
+// Descriptor heap space and the shader resource views written into it
+struct DescriptorCounts
+{
+	UINT Heaps = 0;
+	UINT Descriptors = 0;
+	UINT TextureViews = 0;
+	UINT CubeViews = 0;
+	// Views written at an index past the end of their heap
+	UINT OutOfRange = 0;
+};
+
+// The objects the frame setup creates: buffers, textures, descriptors, root signatures and pipeline states.
+// D3D12RenderDevice creates them on a device and records uploads into the initialization command list.
+// NullRenderDevice creates nothing but upload memory, so Update and the draw recording run
+// without a window, a device or a GPU.
+class RenderDevice
+{
+public:
+	virtual ~RenderDevice() {}
+
+	virtual UploadMemory CreateUploadBuffer(UINT64 size, const wchar_t* name) = 0;
+	// A GPU-only buffer filled with initData; uploadBuffer must live until the copy has executed
+	virtual Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
+		const void* initData, UINT64 byteSize, Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer) = 0;
+	// Creates tex->Resource from tex->Filename and records its upload
+	virtual void CreateTexture(Texture* tex) = 0;
+
+	// Shader visible CBV/SRV/UAV heap
+	virtual Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(UINT descriptorCount) = 0;
+	// All mips of texture at index in heap
+	virtual void CreateTextureView(ID3D12Resource* texture, D3D12_SRV_DIMENSION dimension, ID3D12DescriptorHeap* heap, UINT index) = 0;
+	virtual D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptor(ID3D12DescriptorHeap* heap, UINT index) const = 0;
+
+	virtual Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateRootSignature(ID3DBlob* serializedRootSig) = 0;
+	virtual Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) = 0;
+
+	virtual Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CreateCommandAllocator() = 0;
+	// Created closed
+	virtual Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CreateCommandList(ID3D12CommandAllocator* allocator) = 0;
+
+	// Every heap and view created so far
+	const DescriptorCounts& GetDescriptorCounts() const { return mDescriptorCounts; }
+
+protected:
+	void CountDescriptorHeap(UINT descriptorCount);
+	void CountTextureView(D3D12_SRV_DIMENSION dimension, UINT index);
+
+private:
+	DescriptorCounts mDescriptorCounts;
+	// Size of the heap views are written to; there is only ever one
+	UINT mHeapSize = 0;
+};
+
+class D3D12RenderDevice : public RenderDevice
+{
+public:
+	// Uploads are recorded into cmdList, which the caller executes
+	D3D12RenderDevice(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList);
+
+	virtual UploadMemory CreateUploadBuffer(UINT64 size, const wchar_t* name) override;
+	virtual Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
+		const void* initData, UINT64 byteSize, Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer) override;
+	virtual void CreateTexture(Texture* tex) override;
+
+	virtual Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(UINT descriptorCount) override;
+	virtual void CreateTextureView(ID3D12Resource* texture, D3D12_SRV_DIMENSION dimension, ID3D12DescriptorHeap* heap, UINT index) override;
+	virtual D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptor(ID3D12DescriptorHeap* heap, UINT index) const override;
+
+	virtual Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateRootSignature(ID3DBlob* serializedRootSig) override;
+	virtual Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) override;
+
+	virtual Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CreateCommandAllocator() override;
+	virtual Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CreateCommandList(ID3D12CommandAllocator* allocator) override;
+
+private:
+	ID3D12Device* mDevice;
+	ID3D12GraphicsCommandList* mCommandList;
+	UINT mDescriptorSize;
+};
+
+// Creates host memory for uploads and empty objects for the rest.
+// Descriptors are numbered by index, so bindings still tell tables apart, and views are only
+// counted, so the report shows the heap the scene would have written.
+class NullRenderDevice : public RenderDevice
+{
+public:
+	virtual UploadMemory CreateUploadBuffer(UINT64 size, const wchar_t* name) override;
+	virtual Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
+		const void* initData, UINT64 byteSize, Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer) override;
+	virtual void CreateTexture(Texture* tex) override;
+
+	virtual Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(UINT descriptorCount) override;
+	virtual void CreateTextureView(ID3D12Resource* texture, D3D12_SRV_DIMENSION dimension, ID3D12DescriptorHeap* heap, UINT index) override;
+	virtual D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptor(ID3D12DescriptorHeap* heap, UINT index) const override;
+
+	virtual Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateRootSignature(ID3DBlob* serializedRootSig) override;
+	virtual Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) override;
+
+	virtual Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CreateCommandAllocator() override;
+	virtual Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CreateCommandList(ID3D12CommandAllocator* allocator) override;
+};
@@ -2,6 +2,7 @@
 
 #include "SkinnedData.h"
 #include "CharacterMovement.h"
+#include "Culling.h"
 
 enum class eClipList
 {
@@ -45,8 +46,18 @@ struct SkinnedModelInstance
 	std::vector<DirectX::XMFLOAT4X4> FinalTransforms;
 	float TimePos = 0.0f;
 	eClipList mState;
+	// Bone scratch for GetFinalTransforms, kept between frames
+	std::vector<DirectX::XMFLOAT4X4> ToParentTransforms;
+	std::vector<DirectX::XMFLOAT4X4> ToRootTransforms;
 	
-	void UpdateSkinnedAnimation(std::string ClipName, float dt)
+	void UpdateSkinnedAnimation(const std::string& ClipName, float dt)
+	{
+		AdvanceTime(ClipName, dt);
+		UpdatePose(ClipName, TimePos);
+	}
+
+	// Moves the clip clock without posing; Idle and Walking loop, a change of state starts over
+	void AdvanceTime(const std::string& ClipName, float dt)
 	{
 		TimePos += dt;
 
@@ -80,9 +91,12 @@ struct SkinnedModelInstance
 			TimePos = 0.0f;
 			mState = state;
 		}
+	}
 
-		// Compute the final transforms for this time position.
-		SkinnedInfo->GetFinalTransforms(ClipName, TimePos, FinalTransforms);
+	// Compute the final transforms for this time position.
+	void UpdatePose(const std::string& ClipName, float timePos)
+	{
+		SkinnedInfo->GetFinalTransforms(ClipName, timePos, FinalTransforms, ToParentTransforms, ToRootTransforms);
 	}
 };
 
@@ -117,15 +131,19 @@ struct RenderItem
 	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
 	int ObjCBIndex = -1;
 	int PlayerCBIndex = -1;
-	int MonsterCBIndex = -1;
 
 	int NumFramesDirty = gNumFrameResources;
 	
-	Material* Mat = nullptr;
+	MaterialHandle Mat = -1;
 	MeshGeometry* Geo = nullptr;
 	SkinnedModelInstance* SkinnedModelInst = nullptr;
 	DirectX::BoundingBox Bounds;
 
+	// Written by the culling stage every frame
+	bool Visible = true;
+	// Mesh-space occluder boxes of the submesh, null when it hides nothing
+	const std::vector<CullBox>* Occluder = nullptr;
+
 	// Primitive topology.
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -134,3 +152,29 @@ struct RenderItem
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
 };
+
+// Render items sharing geometry and material, merged at build time and drawn
+// with one DrawIndexedInstanced. Instance i reads its InstanceData at InstanceBase + i
+// from InstanceAddress; only the visible instances are packed there each frame.
+struct InstanceBatch
+{
+	MaterialHandle Mat = -1;
+	MeshGeometry* Geo = nullptr;
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+
+	D3D12_GPU_VIRTUAL_ADDRESS InstanceAddress = 0;
+	UINT InstanceBase = 0;
+	UINT InstanceCount = 0;
+
+	// Source items of a static batch
+	std::vector<RenderItem*> Instances;
+};
+
+inline CullBox ToCullBox(const DirectX::BoundingBox& box)
+{
+	return { { box.Center.x, box.Center.y, box.Center.z }, { box.Extents.x, box.Extents.y, box.Extents.z } };
+}
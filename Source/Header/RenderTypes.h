@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The few Direct3D 12 types the frame recording passes around: descriptor handles, buffer views
+// and GPU addresses. On Windows they come from d3d12.h. Elsewhere they are plain structs with the
+// same fields, so DrawList, the command recorders and the headless scene build without the SDK.
+#ifdef _WIN32
+
+#include <windows.h>
+#include <d3d12.h>
+
+#else
+
+typedef unsigned char BYTE;
+typedef unsigned int UINT;
+typedef unsigned long long UINT64;
+typedef long LONG;
+
+typedef UINT64 D3D12_GPU_VIRTUAL_ADDRESS;
+
+struct D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	size_t ptr;
+};
+
+struct D3D12_GPU_DESCRIPTOR_HANDLE
+{
+	UINT64 ptr;
+};
+
+struct D3D12_VIEWPORT
+{
+	float TopLeftX;
+	float TopLeftY;
+	float Width;
+	float Height;
+	float MinDepth;
+	float MaxDepth;
+};
+
+struct D3D12_RECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R32_UINT = 42,
+	DXGI_FORMAT_R16_UINT = 57
+};
+
+struct D3D12_VERTEX_BUFFER_VIEW
+{
+	D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+	UINT SizeInBytes;
+	UINT StrideInBytes;
+};
+
+struct D3D12_INDEX_BUFFER_VIEW
+{
+	D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+	UINT SizeInBytes;
+	DXGI_FORMAT Format;
+};
+
+enum D3D_PRIMITIVE_TOPOLOGY
+{
+	D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+	D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+	D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED,
+	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+};
+typedef D3D_PRIMITIVE_TOPOLOGY D3D12_PRIMITIVE_TOPOLOGY;
+
+// Only ever passed through by pointer
+struct ID3D12DescriptorHeap;
+struct ID3D12RootSignature;
+struct ID3D12PipelineState;
+struct ID3D12GraphicsCommandList;
+
+#endif
+
+// Dense index into Materials (also the material's structured buffer element).
+typedef int MaterialHandle;
+
+// Root constants set once per draw.
+struct DrawConstants
+{
+	UINT ObjIndex = 0;
+	UINT MatIndex = 0;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "GameTimer.h"
+
+// Keys the game reads, as bits of FrameInput::Keys
+enum class eInputKey : uint32_t
+{
+	Wireframe,		// 7
+	FbxWireframe,	// 8
+	DetachCamera,	// 9
+	AttachCamera,	// 0
+	Forward,		// W
+	Backward,		// S
+	Punch,			// 1
+	Kick,			// 2
+	Kick2,			// 3
+	TurnLeft,		// A
+	TurnRight,		// D
+	Run,			// Left shift
+	Count
+};
+
+// What the player did during one frame
+struct FrameInput
+{
+	uint32_t Keys = 0;
+	// Mouse look in radians since the previous frame
+	float CameraPitch = 0.0f;
+	float CameraYaw = 0.0f;
+	// Yaw that turns the player along with the camera (right button)
+	float PlayerYaw = 0.0f;
+
+	bool IsDown(eInputKey key) const;
+	void SetDown(eInputKey key, bool down);
+};
+
+// Records the clock and input of every frame of a session and plays them back.
+// The game sees only the recorded times, so with the same random seed a playback
+// repeats the session exactly, at whatever speed the frames are run.
+class Replay
+{
+public:
+	enum class eMode
+	{
+		Off,
+		Record,
+		Play
+	};
+
+	void StartRecording(uint32_t seed);
+	bool Save(const std::string& fileName) const;
+	// Switches to playback
+	bool Load(const std::string& fileName);
+
+	eMode GetMode() const;
+	uint32_t GetSeed() const;
+	size_t GetFrameCount() const;
+	// Playback has used up its frames
+	bool IsFinished() const;
+
+	// Call once per frame before the simulation. Recording keeps clock and input;
+	// playback overwrites input with the recorded one.
+	// Returns the timer to simulate the frame with.
+	const GameTimer& BeginFrame(const GameTimer& clock, FrameInput& input);
+
+private:
+	struct Frame
+	{
+		__int64 DeltaCounts;
+		__int64 TotalCounts;
+		FrameInput Input;
+	};
+
+	eMode mMode = eMode::Off;
+	uint32_t mSeed = 0;
+	__int64 mCountsPerSecond = 0;
+	std::vector<Frame> mFrames;
+	size_t mNextFrame = 0;
+
+	GameTimer mTimer;
+};
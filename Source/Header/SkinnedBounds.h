@@ -0,0 +1,51 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+struct CharacterVertex;
+
+// Bounds of a skinned mesh in its current pose. At import every bone gets the box of the
+// bind-pose vertices it moves; each frame those boxes go through the palette and the world
+// and their union is the instance box. A skinned vertex is a weighted blend of its positions
+// under each of its bones, so it always lies inside the union, whatever the pose or scale.
+// The cost is one matrix per weighted bone rather than one per vertex.
+class SkinnedBounds
+{
+public:
+	void Build(const CharacterVertex* vertices, uint32_t count, uint32_t boneCount);
+
+	// palette holds the bone transforms transposed, as uploaded for the shader.
+	// False when nothing was built.
+	bool Compute(const DirectX::XMFLOAT4X4* palette, DirectX::FXMMATRIX world, DirectX::BoundingBox& bounds) const;
+
+	// Bones with at least one weighted vertex
+	uint32_t GetBoneCount() const;
+
+	struct BenchmarkResult
+	{
+		// us per instance: every vertex skinned on the CPU, against the bone boxes
+		float VertexTime;
+		float BoneTime;
+		// Instances whose skinned vertices leave the bone box, should be 0
+		uint32_t Escapes;
+		// Bone box volume over the exact box volume, averaged
+		float Slack;
+	};
+
+	// A synthetic rig posed at random per instance
+	static void Benchmark(uint32_t instanceCount, uint32_t vertexCount, BenchmarkResult& result);
+
+private:
+	// Mesh-space center (w = 1) and half extents of each bone's vertices
+	struct BoneBox
+	{
+		DirectX::XMFLOAT4 Center;
+		DirectX::XMFLOAT4 Extents;
+		uint32_t Bone;
+	};
+
+	std::vector<BoneBox> mBoxes;
+};
@@ -94,6 +94,11 @@ public:
 	// the same timePos.
 	void GetFinalTransforms(const std::string& clipName, float timePos,
 		std::vector<DirectX::XMFLOAT4X4>& finalTransforms)const;
+	// Same, with the bone scratch kept by the caller so that a per-frame update does not allocate
+	void GetFinalTransforms(const std::string& clipName, float timePos,
+		std::vector<DirectX::XMFLOAT4X4>& finalTransforms,
+		std::vector<DirectX::XMFLOAT4X4>& toParentTransforms,
+		std::vector<DirectX::XMFLOAT4X4>& toRootTransforms)const;
 
 
 private:
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Spatial hash of character positions on the ground plane (x, z).
+// Space is cut into square cells and each cell hashes into a bucket of ids, so the grid
+// is unbounded and costs memory only for the characters in it. Ids are small dense
+// indices. Move touches the buckets only when a character crosses into another cell.
+// Buckets are lists linked through the ids, so once every id has been inserted and the
+// buckets have grown for the most characters seen, nothing allocates.
+// Query results come out in ascending id order (nearest first for QueryNearest),
+// whatever the hash layout, so callers iterate them deterministically.
+class SpatialGrid
+{
+public:
+	explicit SpatialGrid(float cellSize = 8.0f);
+
+	void Clear();
+	void Insert(uint32_t id, float x, float z);
+	void Move(uint32_t id, float x, float z);
+	void Remove(uint32_t id);
+	bool Contains(uint32_t id) const;
+	uint32_t GetCount() const;
+
+	// Ids within radius of (x, z)
+	void QueryRadius(float x, float z, float radius, std::vector<uint32_t>& outIds) const;
+	// Up to k ids within maxRadius, nearest first, ties by id
+	void QueryNearest(float x, float z, uint32_t k, float maxRadius, std::vector<uint32_t>& outIds) const;
+	// Ids within radius whose direction from (x, z) is within halfAngle of (dirX, dirZ)
+	void QueryCone(float x, float z, float dirX, float dirZ, float radius, float halfAngle, std::vector<uint32_t>& outIds) const;
+
+	struct BenchmarkResult
+	{
+		// ms to insert every character, and to move all of them one step
+		float BuildTime;
+		float MoveTime;
+		// ns per query
+		float RadiusTime;
+		float NearestTime;
+		float ConeTime;
+		float BruteForceTime;
+		// Radius queries that disagree with the brute force
+		uint32_t Mismatches;
+	};
+
+	// Characters spread over a square that keeps about 4 of them per 100 square units
+	static void Benchmark(uint32_t characterCount, uint32_t queryCount, BenchmarkResult& result);
+
+private:
+	static const uint32_t NoId = UINT32_MAX;
+
+	int CellCoord(float v) const;
+	uint32_t Bucket(int cellX, int cellZ) const;
+	void Grow();
+	void Link(uint32_t id);
+	void Unlink(uint32_t id);
+
+	// Calls visit(id, distanceSquared) for every id within radius
+	template<typename Visit>
+	void ForEachInRadius(float x, float z, float radius, Visit visit) const;
+
+private:
+	float mCellSize;
+	float mInvCellSize;
+	uint32_t mCount = 0;
+
+	// First id of each bucket, NoId when empty
+	std::vector<uint32_t> mBuckets;
+	uint32_t mBucketMask = 0;
+
+	// Per id: position, cell, its neighbours in the bucket (NoId at the ends) and whether it is in the grid
+	std::vector<float> mX, mZ;
+	std::vector<int> mCellX, mCellZ;
+	std::vector<uint32_t> mNext, mPrev;
+	std::vector<uint8_t> mPresent;
+};
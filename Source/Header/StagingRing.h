@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// Fixed-size ring sub-allocator for upload memory.
+// Works on byte offsets only, so it does not depend on the graphics API.
+// Allocations are tagged with a fence value by Retire and handed back by
+// Release once that fence has completed, oldest first.
+class StagingRing
+{
+public:
+	static const uint64_t InvalidOffset = UINT64_MAX;
+
+	explicit StagingRing(uint64_t capacity);
+
+	// Returns InvalidOffset when there is no contiguous free range large enough
+	uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+	// Tag every allocation made since the previous Retire with fenceValue
+	void Retire(uint64_t fenceValue);
+
+	// Free every retired block whose fence value is <= completedFenceValue
+	void Release(uint64_t completedFenceValue);
+
+	uint64_t GetCapacity() const;
+	uint64_t GetUsedSize() const;
+
+	// Allocations not yet retired
+	bool HasPending() const;
+	// Fence value of the oldest retired block (0 if none)
+	uint64_t GetOldestFence() const;
+
+private:
+	struct Block
+	{
+		uint64_t FenceValue;
+		uint64_t End;
+		uint64_t Size;
+	};
+
+	uint64_t mCapacity;
+	uint64_t mHead = 0;
+	uint64_t mTail = 0;
+	uint64_t mUsed = 0;
+	uint64_t mPendingSize = 0;
+
+	std::deque<Block> mRetired;
+};
+
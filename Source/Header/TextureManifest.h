@@ -0,0 +1,48 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+enum class eTextureSlot : int
+{
+	Normal,
+	Roughness,
+	AO,
+	Count
+};
+
+// Maps each diffuse texture to its companion maps (normal, roughness, AO).
+// The manifest is read once at startup. A diffuse texture missing from it is cooked on first use:
+// its companions are probed by file-name suffix, recorded, and written back by Save,
+// so the files are only probed again when the manifest is deleted.
+class TextureManifest
+{
+public:
+	TextureManifest();
+	~TextureManifest();
+
+	bool Load(const std::string& fileName);
+	bool Save(const std::string& fileName) const;
+
+	// Empty when the diffuse texture has no map in this slot
+	const std::wstring& GetCompanion(const std::wstring& diffuseFileName, eTextureSlot slot);
+
+	// True when entries were cooked since the last Load or Save
+	bool IsDirty() const;
+
+private:
+	struct Entry
+	{
+		std::wstring DiffuseFileName;
+		std::array<std::wstring, (int)eTextureSlot::Count> Companions;
+	};
+
+	static std::string MakeKey(const std::wstring& fileName);
+	static void Cook(Entry& entry);
+
+private:
+	std::unordered_map<std::string, Entry> mEntries;
+	// Keys in insertion order so Save is stable
+	std::vector<std::string> mOrder;
+
+	mutable bool mDirty;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "FrameResource.h"
+#include "StagingRing.h"
+
+class ThreadPool;
+
+// Decodes texture files on a ThreadPool and streams them to the GPU
+// through one persistently mapped upload buffer managed by a StagingRing.
+// Decoding is parallel; resource creation and copy recording happen on the
+// calling thread in Flush, in the order the textures were enqueued.
+class TextureUploader
+{
+public:
+	TextureUploader(ID3D12Device* device, ID3D12CommandQueue* queue, UINT64 stagingSize, ThreadPool* threadPool);
+	TextureUploader(const TextureUploader& rhs) = delete;
+	TextureUploader& operator=(const TextureUploader& rhs) = delete;
+	~TextureUploader();
+
+	// Start decoding tex->Filename on a worker
+	void Enqueue(Texture* tex);
+
+	// Wait for the decodes, create every enqueued Resource and submit the copies.
+	// Resources are valid on return; the copies are ordered before later work on the queue.
+	void Flush();
+
+	// Block until every submitted copy has completed on the GPU
+	void WaitIdle();
+
+	UINT64 GetUploadedBytes() const;
+	UINT GetUploadedCount() const;
+	// Number of times Flush had to wait for the GPU to free staging space
+	UINT GetStallCount() const;
+	// Throughput of the CPU mip generation for images without stored mips
+	double GetMipMegapixelsPerSecond() const;
+
+private:
+	struct UploadJob
+	{
+		Texture* Tex = nullptr;
+		HRESULT Result = E_PENDING;
+
+		D3D12_RESOURCE_DESC Desc = {};
+		std::vector<D3D12_SUBRESOURCE_DATA> Subresources;
+
+		// Backing memory for Subresources (DDS file or WIC pixels and generated mips)
+		std::unique_ptr<uint8_t[]> DdsData;
+		BYTE* ImageData = nullptr;
+		std::unique_ptr<uint8_t[]> MipData;
+
+		UINT64 MipPixels = 0;
+		double MipSeconds = 0.0;
+	};
+
+	void Decode(UploadJob* job) const;
+	void GenerateMips(UploadJob* job) const;
+
+	void Record(UploadJob* job);
+	UINT64 AllocateStaging(UINT64 size);
+	void Submit();
+	void WaitForFence(UINT64 fenceValue);
+
+private:
+	static const int NumAllocators = 3;
+
+	ID3D12Device* mDevice;
+	ID3D12CommandQueue* mCommandQueue;
+	ThreadPool* mThreadPool;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mStagingBuffer;
+	BYTE* mMappedStaging = nullptr;
+	StagingRing mRing;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mAllocators[NumAllocators];
+	UINT64 mAllocatorFence[NumAllocators] = {};
+	int mCurrAllocator = 0;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCommandList;
+	bool mHasPendingCommands = false;
+
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+	UINT64 mFenceValue = 0;
+	HANDLE mFenceEvent = nullptr;
+
+	std::vector<std::unique_ptr<UploadJob>> mJobs;
+
+	UINT64 mUploadedBytes = 0;
+	UINT mUploadedCount = 0;
+	UINT mStallCount = 0;
+	UINT64 mMipPixels = 0;
+	double mMipSeconds = 0.0;
+};
@@ -2,6 +2,9 @@
 
 #include "FrameResource.h"
 
+class TextureUploader;
+class RenderDevice;
+
 class Textures
 {
 public:
@@ -15,6 +18,9 @@ public:
 		Count
 	};
 
+	// When set, SetTexture only queues a decode and End uploads the batch
+	static void SetUploader(TextureUploader* uploader);
+
 	UINT GetSize() const;
 	int GetTextureIndex(std::string Name) const;
 
@@ -25,7 +31,7 @@ public:
 		const std::vector<std::string>& Name,
 		const std::vector<std::wstring>& szFileName);
 
-	void Begin(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, ID3D12DescriptorHeap* cbvHeap);
+	void Begin(RenderDevice* device, ID3D12DescriptorHeap* cbvHeap);
 	void End();
 
 	void BuildCBVTex2D(const int offset = 0);
@@ -34,8 +40,12 @@ public:
 	void BuildConstantBufferViews(Textures::Type texType, int offset = 0);
 
 private:
-	ID3D12Device* mDevice;
-	ID3D12GraphicsCommandList* mCommandList;
+	void LoadTexture(Texture* tex);
+
+private:
+	static TextureUploader* mUploader;
+
+	RenderDevice* mDevice;
 	ID3D12DescriptorHeap* mCbvHeap;
 	 
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
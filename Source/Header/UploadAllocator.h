@@ -0,0 +1,64 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "LinearAllocator.h"
+#include "RenderDevice.h"
+
+struct UploadAllocation
+{
+	BYTE* CPU = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GPU = 0;
+};
+
+// Per-frame transient upload memory: one persistently mapped buffer, bump allocated and reset
+// once the frame's fence has passed. Data is bound by GPU virtual address (root CBV/SRV).
+// When a frame outgrows the buffer a larger one takes over; the old one stays alive until Reset,
+// so addresses handed out earlier in the frame remain valid.
+class UploadAllocator
+{
+public:
+	UploadAllocator(RenderDevice* device, UINT64 capacity);
+	UploadAllocator(const UploadAllocator& rhs) = delete;
+	UploadAllocator& operator=(const UploadAllocator& rhs) = delete;
+
+	// Only once the GPU is done with everything allocated since the last Reset
+	void Reset();
+
+	// A size of 0 returns an empty allocation (null CPU pointer, GPU address 0)
+	UploadAllocation Allocate(UINT64 size, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	// count elements of T, 256-byte aligned so the range can back a CBV or a structured buffer
+	template<typename T>
+	UploadAllocation Allocate(UINT count)
+	{
+		return Allocate(sizeof(T) * count);
+	}
+
+	// One constant buffer, returns the address for SetGraphicsRootConstantBufferView
+	template<typename T>
+	D3D12_GPU_VIRTUAL_ADDRESS Push(const T& data)
+	{
+		UploadAllocation allocation = Allocate(d3dUtil::CalcConstantBufferByteSize(sizeof(T)));
+		memcpy(allocation.CPU, &data, sizeof(T));
+		return allocation.GPU;
+	}
+
+	UINT64 GetCapacity() const;
+	// Bytes allocated since the last Reset, in every buffer
+	UINT64 GetUsedSize() const;
+	UINT GetGrowCount() const;
+
+private:
+	void CreateBuffer(UINT64 capacity);
+
+private:
+	RenderDevice* mDevice;
+
+	UploadMemory mBuffer;
+	LinearAllocator mAllocator;
+
+	// Outgrown buffers still read by the GPU for this frame
+	std::vector<UploadMemory> mRetired;
+	UINT64 mRetiredSize = 0;
+	UINT mGrowCount = 0;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "FixedStep.h"
+
+class ThreadPool;
+
+// Steps every zone of the world each frame, each one as its own task on the thread pool.
+// The zone the player is in runs at the active rate; the others keep going at a lower
+// background rate, so a zone is never stale when the player comes back to it.
+// Run returns only when every zone is done: while it runs, each zone's state belongs to the
+// one task stepping it, and afterwards it all belongs to the calling thread again, so the
+// render upload that follows never races the simulation.
+class ZoneScheduler
+{
+public:
+	// One step of a zone: its index, the simulated time after the step and the step length
+	using StepFunction = std::function<void(uint32_t zone, float simTime, float dt)>;
+
+	struct ZoneStats
+	{
+		// ms spent stepping the zone in the last Run
+		float Time = 0.0f;
+		uint32_t Steps = 0;
+		// Runs cut short by the budget since the start
+		uint32_t OverBudget = 0;
+	};
+
+	void SetZoneCount(uint32_t count);
+	void SetRates(float activeRate, float backgroundRate);
+	// ms per zone per frame. A background zone that spends it leaves its remaining steps
+	// for the next frame. 0 is unlimited, and the only setting that keeps replays exact.
+	void SetBudget(float budget);
+
+	// threadPool may be null to step the zones on the calling thread
+	void Run(uint32_t activeZone, float deltaTime, ThreadPool* threadPool, const StepFunction& step);
+
+	uint32_t GetZoneCount() const;
+	float GetActiveRate() const;
+	float GetBackgroundRate() const;
+	float GetBudget() const;
+	// How far zone is into its next step, for interpolating what is drawn
+	float GetAlpha(uint32_t zone) const;
+	const ZoneStats& GetStats(uint32_t zone) const;
+
+private:
+	void RunZone(uint32_t zone, const StepFunction& step);
+
+private:
+	std::vector<FixedStep> mSteps;
+	std::vector<ZoneStats> mStats;
+	uint32_t mActiveZone = 0;
+	float mActiveRate = 25.0f;
+	float mBackgroundRate = 5.0f;
+	float mBudget = 0.0f;
+};
@@ -10,6 +10,8 @@
 
 #include <random>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
 #include "MathHelper.h"
 #include "UploadBuffer.h"
 #include "RenderItem.h"
@@ -21,12 +23,52 @@
 #include "Player.h"
 #include "Monster.h"
 #include "Textures.h"
+#include "TextureUploader.h"
 #include "Materials.h"
+#include "TextureManifest.h"
 #include "TextureLoader.h"
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
+#include "ZoneScheduler.h"
+#include "HitQueue.h"
+#include "CommandRecorder.h"
+#include "RenderDevice.h"
+#include "DrawList.h"
+#include "Culling.h"
+#include "CollisionWorld.h"
+#include "FlowField.h"
+#include "SkinnedBounds.h"
+#include "OcclusionCuller.h"
+#include "LightClusters.h"
+#include "RandomStreams.h"
+#include "Replay.h"
 #include "Utility.h"
 
 #include "Portfolio_Game.h"
 
+// Names of RenderLayer in the frame stats
+const wchar_t* RenderLayerName[(int)RenderLayer::Count] =
+{
+	L"opaque", L"mirrors", L"reflected", L"transparent", L"sky", L"architecture",
+	L"wall", L"character", L"monster", L"shadow", L"ui"
+};
+
+// Position of each RenderLayer in the frame, the most significant field of the draw key
+const UINT LayerDrawOrder[(int)RenderLayer::Count] =
+{
+	1,	// Opaque
+	8,	// Mirrors
+	9,	// Reflected
+	10,	// Transparent
+	3,	// Sky
+	2,	// Architecture
+	0,	// Wall
+	5,	// Character
+	6,	// Monster
+	7,	// Shadow
+	4	// UI
+};
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	PSTR cmdLine, int showCmd)
 {
@@ -38,6 +80,68 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	try
 	{
 		PortfolioGameApp theApp(hInstance);
+
+		// -record <file> and -replay <file> capture and repeat a session.
+		// -crowd <n> adds n simulated members to every zone.
+		// -simrate <hz> and -bgrate <hz> set the monster simulation rate in the player's zone
+		// and in the others (default 25 and 5), -zonebudget <ms> caps the others per frame.
+		// -respawn <s> brings dead monsters back s seconds after their slot is freed.
+		// -headless runs the frame loop without presenting, for -frames <n> frames
+		// (default 600, or the whole replay), and writes a report to -report <file>.
+		bool headless = false;
+		UINT frameCount = 0;
+		UINT crowdPopulation = 0;
+		float simulationRate = 25.0f;
+		float backgroundRate = 5.0f;
+		float zoneBudget = 0.0f;
+		float respawnDelay = 0.0f;
+		std::string reportName = "HeadlessBenchmark.txt";
+
+		std::istringstream args(cmdLine);
+		std::string option;
+		while (args >> option)
+		{
+			std::string value;
+			if (option == "-headless")
+				headless = true;
+			else if (option == "-frames")
+				args >> frameCount;
+			else if (option == "-crowd")
+				args >> crowdPopulation;
+			else if (option == "-simrate")
+				args >> simulationRate;
+			else if (option == "-bgrate")
+				args >> backgroundRate;
+			else if (option == "-zonebudget")
+				args >> zoneBudget;
+			else if (option == "-respawn")
+				args >> respawnDelay;
+			else if (option == "-report" && args >> value)
+				reportName = value;
+			else if (option == "-record" && args >> value)
+				theApp.StartRecording(value);
+			else if (option == "-replay" && args >> value)
+			{
+				if (!theApp.LoadReplay(value))
+				{
+					MessageBox(nullptr, L"The replay file could not be read.", L"Replay", MB_OK);
+					return 0;
+				}
+			}
+		}
+
+		theApp.SetCrowdPopulation(crowdPopulation);
+		theApp.SetSimulationRates(simulationRate, backgroundRate);
+		theApp.SetZoneBudget(zoneBudget);
+		theApp.SetRespawnDelay(respawnDelay);
+
+		// No window and no device, the frames are only counted
+		if (headless)
+		{
+			theApp.InitializeHeadless();
+			return theApp.RunHeadless(frameCount, reportName) ? 0 : 1;
+		}
+
 		if (!theApp.Initialize())
 			return 0;
 
@@ -58,12 +162,33 @@ PortfolioGameApp::PortfolioGameApp(HINSTANCE hInstance)
 		HitTime[i] = 0.0f;
 		DelayTime[i] = 0.0f;
 	}
+
+	// A new world every run unless a replay brings its seed
+	mRandom.Seed((uint32_t)std::chrono::system_clock::now().time_since_epoch().count());
 }
 
 PortfolioGameApp::~PortfolioGameApp()
 {
 	if (md3dDevice != nullptr)
 		FlushCommandQueue();
+
+	if (mReplay.GetMode() == Replay::eMode::Record)
+		mReplay.Save(mReplayFileName);
+}
+
+void PortfolioGameApp::StartRecording(const std::string& fileName)
+{
+	mReplayFileName = fileName;
+	mReplay.StartRecording(mRandom.GetSeed());
+}
+
+bool PortfolioGameApp::LoadReplay(const std::string& fileName)
+{
+	if (!mReplay.Load(fileName))
+		return false;
+
+	mRandom.Seed(mReplay.GetSeed());
+	return true;
 }
 
 ///
@@ -78,6 +203,63 @@ bool PortfolioGameApp::Initialize()
 	// TODO : DELETE
 	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
+	// Textures are decoded on the pool and copied through a 64MB staging ring
+	mThreadPool = std::make_unique<ThreadPool>();
+	mTextureUploader = std::make_unique<TextureUploader>(md3dDevice.Get(), mCommandQueue.Get(), 64 * 1024 * 1024, mThreadPool.get());
+	Textures::SetUploader(mTextureUploader.get());
+
+	// Buffers and the rest of the scene upload through the initialization list
+	mRenderDevice = std::make_unique<D3D12RenderDevice>(md3dDevice.Get(), mCommandList.Get());
+	BuildScene();
+
+	// Execute the initialization commands.
+	ThrowIfFailed(mCommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	// Wait until initialization is complete.
+	FlushCommandQueue();
+
+	std::wstring uploadText = L"Textures uploaded: " + std::to_wstring(mTextureUploader->GetUploadedCount()) +
+		L" (" + std::to_wstring(mTextureUploader->GetUploadedBytes() / 1024) + L" KB, " +
+		std::to_wstring(mTextureUploader->GetStallCount()) + L" staging stalls, " +
+		std::to_wstring(mThreadPool->GetThreadCount()) + L" decode threads, mips " +
+		std::to_wstring(mTextureUploader->GetMipMegapixelsPerSecond()) + L" MP/s)\n";
+	OutputDebugString(uploadText.c_str());
+
+#if defined(DEBUG) | defined(_DEBUG)
+	// Draw key generation and sort on their own, outside the frame
+	for (UINT drawCount : { 1024u, 16384u })
+	{
+		float keyTime = 0.0f;
+		float sortTime = 0.0f;
+		DrawList::Benchmark(drawCount, 100, keyTime, sortTime);
+
+		std::wstring benchText = L"DrawList " + std::to_wstring(drawCount) + L" draws: key " +
+			std::to_wstring(keyTime) + L" ms, sort " + std::to_wstring(sortTime) + L" ms\n";
+		OutputDebugString(benchText.c_str());
+	}
+#endif
+
+	return true;
+}
+
+// The scene on a NullRenderDevice, sized like the default window. Nothing is created on a GPU,
+// so Update and DrawHeadless run without D3DApp::Initialize.
+void PortfolioGameApp::InitializeHeadless()
+{
+	mHeadless = true;
+	mThreadPool = std::make_unique<ThreadPool>();
+	mRenderDevice = std::make_unique<NullRenderDevice>();
+	BuildScene();
+
+	mScreenViewport = { 0.0f, 0.0f, (float)mClientWidth, (float)mClientHeight, 0.0f, 1.0f };
+	mScissorRect = { 0, 0, mClientWidth, mClientHeight };
+	UpdateProjection();
+}
+
+void PortfolioGameApp::BuildScene()
+{
 	LoadTextures();
 	BuildShapeGeometry();
 	BuildMaterials();
@@ -89,19 +271,37 @@ bool PortfolioGameApp::Initialize()
 
 	BuildDescriptorHeaps();
 	BuildTextureBufferViews();
-	BuildConstantBufferViews();
 
 	BuildPSOs();
+	BuildDrawList();
+}
 
-	// Execute the initialization commands.
-	ThrowIfFailed(mCommandList->Close());
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+void PortfolioGameApp::SetCrowdPopulation(UINT population)
+{
+	mCrowdPopulation = population;
+}
 
-	// Wait until initialization is complete.
-	FlushCommandQueue();
+void PortfolioGameApp::SetSimulationRates(float activeRate, float backgroundRate)
+{
+	mZoneScheduler.SetRates(activeRate, backgroundRate);
+}
 
-	return true;
+void PortfolioGameApp::SetZoneBudget(float budget)
+{
+	mZoneScheduler.SetBudget(budget);
+}
+
+void PortfolioGameApp::SetRespawnDelay(float seconds)
+{
+	mRespawnDelay = seconds;
+}
+
+uint64_t PortfolioGameApp::GetMonsterAllocations() const
+{
+	uint64_t allocations = mMonsterAllocations;
+	for (auto e : mZoneAllocations)
+		allocations += e;
+	return allocations;
 }
 
 void PortfolioGameApp::OnResize()
@@ -109,17 +309,30 @@ void PortfolioGameApp::OnResize()
 	D3DApp::OnResize();
 
 	// The window resized, so update the aspect ratio and recompute the projection matrix.
+	UpdateProjection();
+}
+
+void PortfolioGameApp::UpdateProjection()
+{
 	//XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	mPlayer.mCamera.SetProj(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+	mLightClusters.SetProjection(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 }
 
-void PortfolioGameApp::Update(const GameTimer& gt)
+void PortfolioGameApp::Update(const GameTimer& clock)
 {
+	// A replay swaps in the recorded input and frame times
+	PollInput();
+	const GameTimer& gt = mReplay.BeginFrame(clock, mFrameInput);
+	if (mReplay.IsFinished())
+		PostQuitMessage(0);
+
 	OnKeyboardInput(gt);
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
+	mCurrFrameResource->ResetUploadBytes();
 
 	// Has the GPU finished processing the commands of the current frame resource?
 	// If not, wait until the GPU has completed commands up to this fence point.
@@ -131,34 +344,33 @@ void PortfolioGameApp::Update(const GameTimer& gt)
 		CloseHandle(eventHandle);
 	}
 
+	// The GPU is done with this frame's transient allocations
+	mCurrFrameResource->Allocator->Reset();
+
 	UpdateObjectCBs(gt);
 	UpdateCharacterCBs(gt);
+	CullRenderItems(gt);
+	UpdateInstanceBuffer(gt);
+	UpdateLights(gt);
 	UpdateMainPassCB(gt);
 	UpdateObjectShadows(gt);
-	UpdateMaterialCB(gt);
+	UpdateMaterialBuffer(gt);
 }
 
 void PortfolioGameApp::Draw(const GameTimer& gt)
 {
+	auto recordStart = std::chrono::high_resolution_clock::now();
+	mDrawStats = DrawStats();
+	mDrawStats.UploadBytes = mCurrFrameResource->GetUploadBytes();
+
 	auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
 
 	// Reuse the memory associated with command recording.
 	// We can only reset when the associated command lists have finished execution on the GPU.
 	ThrowIfFailed(cmdListAlloc->Reset());
 
-	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
-	// Reusing the command list reuses memory.
-	if (mIsWireframe)
-	{
-		ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque_wireframe"].Get()));
-	}
-	else
-	{
-		ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
-	}
-
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
+	// The main list only prepares the back buffer, the draws are recorded by the workers
+	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));
 
 	// Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -168,81 +380,53 @@ void PortfolioGameApp::Draw(const GameTimer& gt)
 	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
 	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-	// Specify the buffers we are going to render to.
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
-
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mCbvHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-	mCommandList->SetGraphicsRootDescriptorTable(0, mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-
-	int passCbvIndex = mPassCbvOffset + mCurrFrameResourceIndex;
-	auto passCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-	passCbvHandle.Offset(passCbvIndex, mCbvSrvDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(5, passCbvHandle);
-	// Object
-	DrawRenderItems(mCommandList.Get(), mRitems[(int)RenderLayer::Opaque]);
-	DrawRenderItems(mCommandList.Get(), mRitems[(int)RenderLayer::Wall]);
-	DrawRenderItems(mCommandList.Get(), mRitems[(int)RenderLayer::Architecture]);
-
-	// SkyTex
-	CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-	//skyTexDescriptor.Offset(mTexDiffuseOffset, mCbvSrvDescriptorSize);
-	skyTexDescriptor.Offset(mTexSkyCubeOffset, mCbvSrvDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(2, skyTexDescriptor);
+	ThrowIfFailed(mCommandList->Close());
 
-	// Sky 
-	mCommandList->SetPipelineState(mPSOs["sky"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitems[(int)RenderLayer::Sky]);
+	CollectDraws();
 
-	
-	//// Sky
-	//mCommandList->SetPipelineState(mPSOs["sky"].Get());
-	//DrawRenderItems(mCommandList.Get(), mRitems[(int)RenderLayer::Sky]);
-
-	// UI
-	mCommandList->SetPipelineState(mPSOs["UI"].Get());
-	DrawRenderItems(mCommandList.Get(), mPlayer.mUI.GetRenderItem(eUIList::Rect));
-	DrawRenderItems(mCommandList.Get(), mPlayer.mUI.GetRenderItem(eUIList::I_Punch));
-	DrawRenderItems(mCommandList.Get(), mPlayer.mUI.GetRenderItem(eUIList::I_Kick));
-	DrawRenderItems(mCommandList.Get(), mPlayer.mUI.GetRenderItem(eUIList::I_Kick2));
-	mCommandList->SetPipelineState(mPSOs["MonsterUI"].Get());
-	DrawRenderItems(mCommandList.Get(), mMonster->mMonsterUI.GetRenderItem(eUIList::Rect));
+	UINT listCount, drawsPerList;
+	SplitDrawList(listCount, drawsPerList);
+	auto& workerLists = mCurrFrameResource->WorkerCmdLists;
+	mFrameBindings.resize(listCount);
+	D3D12_CPU_DESCRIPTOR_HANDLE renderTarget = CurrentBackBufferView();
+	D3D12_CPU_DESCRIPTOR_HANDLE depthStencil = DepthStencilView();
 
-	// Character
-	if (!mFbxWireframe)
-	{
-		mCommandList->SetPipelineState(mPSOs["Player"].Get());
-	}
-	else
+	mThreadPool->ParallelFor(listCount, [&](UINT i)
 	{
-		mCommandList->SetPipelineState(mPSOs["Player_wireframe"].Get());
-	}
-	DrawRenderItems(mCommandList.Get(), mPlayer.GetRenderItem(RenderLayer::Character));
+		auto& alloc = mCurrFrameResource->WorkerCmdListAllocs[i];
+		auto& cmdList = workerLists[i];
 
-	// Monster
-	mCommandList->SetPipelineState(mPSOs["Monster"].Get());
-	DrawRenderItems(mCommandList.Get(), mMonster->GetRenderItem(RenderLayer::Monster));
+		ThrowIfFailed(alloc->Reset());
+		ThrowIfFailed(cmdList->Reset(alloc.Get(), nullptr));
 
-	// Shadow
-	mCommandList->OMSetStencilRef(0);
-	mCommandList->SetPipelineState(mPSOs["Player_shadow"].Get());
-	DrawRenderItems(mCommandList.Get(), mPlayer.GetRenderItem(RenderLayer::Shadow));
+		D3D12CommandRecorder recorder(cmdList.Get());
+		mFrameBindings[i] = SetFrameState(recorder, renderTarget, depthStencil);
+		mDrawList.Execute(recorder, i * drawsPerList, drawsPerList);
 
-	mCommandList->SetPipelineState(mPSOs["Monster_shadow"].Get());
-	DrawRenderItems(mCommandList.Get(), mMonster->GetRenderItem(RenderLayer::Shadow));
+		// The last list hands the back buffer to present
+		if (i == listCount - 1)
+		{
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+				D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+		}
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+		ThrowIfFailed(cmdList->Close());
+	});
 
-	// Done recording commands.
-	ThrowIfFailed(mCommandList->Close());
+	for (UINT i = 0; i < listCount; ++i)
+		mDrawStats.RootBindings += mFrameBindings[i];
+	mDrawStats.RootBindings += mDrawList.GetRootBindings();
+	mDrawStats.CommandLists = listCount + 1;
 
-	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	std::chrono::duration<float, std::milli> recordTime = std::chrono::high_resolution_clock::now() - recordStart;
+	mDrawStats.RecordTime = recordTime.count();
+
+	// Submit the prologue and the worker lists in order, in one call
+	mSubmitLists.clear();
+	mSubmitLists.push_back(mCommandList.Get());
+	for (UINT i = 0; i < listCount; ++i)
+		mSubmitLists.push_back(workerLists[i].Get());
+	mCommandQueue->ExecuteCommandLists((UINT)mSubmitLists.size(), mSubmitLists.data());
 
 	// Swap the back and front buffers
 	ThrowIfFailed(mSwapChain->Present(0, 0));
@@ -257,6 +441,233 @@ void PortfolioGameApp::Draw(const GameTimer& gt)
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
 }
 
+void PortfolioGameApp::UpdateFrameStatsText()
+{
+	std::wstring layerDraws;
+	for (int i = 0; i < (int)RenderLayer::Count; ++i)
+	{
+		if (mDrawStats.LayerDrawCalls[i] > 0)
+			layerDraws += L" " + std::wstring(RenderLayerName[i]) + L" " + std::to_wstring(mDrawStats.LayerDrawCalls[i]);
+	}
+
+	std::wstring zoneText;
+	for (UINT i = 0; i < mZoneScheduler.GetZoneCount(); ++i)
+	{
+		auto& stats = mZoneScheduler.GetStats(i);
+		zoneText += L" " + std::to_wstring(stats.Time) + L"/" + std::to_wstring(stats.Steps);
+	}
+
+	mFrameStatsText =
+		L"   record ms: " + std::to_wstring(mDrawStats.RecordTime) +
+		L"   draws: " + std::to_wstring(mDrawStats.DrawCalls) + L" (" + layerDraws + L" )" +
+		L"   instances: " + std::to_wstring(mDrawStats.Instances) +
+		L"   visible: " + std::to_wstring(mCullStats.Visible) + L"/" + std::to_wstring(mCullStats.Total) +
+		L"   cull ms: " + std::to_wstring(mCullStats.CullTime) +
+		L"   occluded: " + std::to_wstring(mCullStats.Occluded) +
+		L"   occlusion ms: " + std::to_wstring(mCullStats.OcclusionTime) +
+		L"   lights: " + std::to_wstring(mFrameLights.size()) +
+		L"   light bin ms: " + std::to_wstring(mLightClusters.GetBuildTime()) +
+		L"   crowd: " + std::to_wstring(mMonster->GetCrowd().GetAliveCount()) + L"/" + std::to_wstring(mMonster->GetCrowd().GetCount()) +
+		L"   crowd ms: " + std::to_wstring(mMonster->GetCrowd().GetUpdateTime()) +
+		L"   monster allocs: " + std::to_wstring(GetMonsterAllocations()) +
+		L"   hits: " + std::to_wstring(mHitCount) +
+		L"   flow ms: " + std::to_wstring(mFlowField.GetStepTime()) + L" (" + std::to_wstring(mFlowField.GetRebuildCount()) + L" rebuilds of " +
+		std::to_wstring(mFlowField.GetRebuildTime()) + L")" +
+		L"   contacts: " + std::to_wstring(mPlayerContacts.size()) + L" (" + std::to_wstring(mCollision.GetTestCount()) + L" tests)" +
+		L"   zones ms:" + zoneText +
+		L"   root binds: " + std::to_wstring(mDrawStats.RootBindings) +
+		L"   lists: " + std::to_wstring(mDrawStats.CommandLists) +
+		L"   state changes: " + std::to_wstring(mDrawList.GetStateChanges()) +
+		L"   commands: " + std::to_wstring(mDrawList.GetCommandCount()) +
+		L"   key/sort ms: " + std::to_wstring(mDrawList.GetKeyTime()) + L"/" + std::to_wstring(mDrawList.GetSortTime()) +
+		L"   upload KB: " + std::to_wstring(mDrawStats.UploadBytes / 1024);
+}
+
+// The whole draw side of a frame, recorded into null recorders. Nothing reaches the GPU.
+void PortfolioGameApp::DrawHeadless(CommandCounts& counts)
+{
+	mDrawStats = DrawStats();
+	mDrawStats.UploadBytes = mCurrFrameResource->GetUploadBytes();
+
+	CollectDraws();
+
+	UINT listCount, drawsPerList;
+	SplitDrawList(listCount, drawsPerList);
+
+	// There is no back buffer to render to
+	D3D12_CPU_DESCRIPTOR_HANDLE noTarget = {};
+
+	mNullRecorders.resize(listCount);
+	mFrameBindings.resize(listCount);
+	mThreadPool->ParallelFor(listCount, [&](UINT i)
+	{
+		mNullRecorders[i].Reset();
+		mFrameBindings[i] = SetFrameState(mNullRecorders[i], noTarget, noTarget);
+		mDrawList.Execute(mNullRecorders[i], i * drawsPerList, drawsPerList);
+	});
+
+	counts = CommandCounts();
+	for (UINT i = 0; i < listCount; ++i)
+		counts += mNullRecorders[i].GetCounts();
+
+	for (UINT i = 0; i < listCount; ++i)
+		mDrawStats.RootBindings += mFrameBindings[i];
+	mDrawStats.RootBindings += mDrawList.GetRootBindings();
+	mDrawStats.CommandLists = listCount;
+}
+
+// Runs Update and DrawHeadless for frameCount frames and writes the averages to fileName.
+// A replay runs at full speed and stops with its last frame.
+bool PortfolioGameApp::RunHeadless(UINT frameCount, const std::string& fileName)
+{
+	if (frameCount == 0)
+		frameCount = mReplay.GetMode() == Replay::eMode::Play ? (UINT)mReplay.GetFrameCount() : 600;
+
+	double updateTime = 0.0;
+	double drawTime = 0.0;
+	double crowdTime = 0.0;
+	double flowTime = 0.0;
+	std::vector<double> zoneTimes(mZoneScheduler.GetZoneCount(), 0.0);
+	UINT64 uploadBytes = 0;
+	CommandCounts totalCounts;
+
+	double flowMaxTime = 0.0;
+	uint32_t firstFlowRebuild = mFlowField.GetRebuildCount();
+	// Counted once the first frames have sized every buffer: the whole frame on every thread,
+	// and the monster update on its own
+	const UINT warmupFrames = 60;
+	uint64_t frameAllocations = 0;
+	uint64_t warmupAllocations = GetMonsterAllocations();
+
+	mTimer.Reset();
+	UINT frame = 0;
+	for (; frame < frameCount && !mReplay.IsFinished(); ++frame)
+	{
+		uint64_t allocations = AllocationCounter::GetTotalCount();
+		mTimer.Tick();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		Update(mTimer);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		updateTime += elapsed.count();
+		crowdTime += mMonster->GetCrowd().GetUpdateTime();
+		if (frame + 1 == warmupFrames)
+			warmupAllocations = GetMonsterAllocations();
+		flowTime += mFlowField.GetStepTime();
+		flowMaxTime = (std::max)(flowMaxTime, (double)mFlowField.GetStepTime());
+		for (UINT i = 0; i < mZoneScheduler.GetZoneCount(); ++i)
+			zoneTimes[i] += mZoneScheduler.GetStats(i).Time;
+
+		CommandCounts counts;
+		start = std::chrono::high_resolution_clock::now();
+		DrawHeadless(counts);
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+		drawTime += elapsed.count();
+
+		totalCounts += counts;
+		uploadBytes += mDrawStats.UploadBytes;
+		if (frame >= warmupFrames)
+			frameAllocations += AllocationCounter::GetTotalCount() - allocations;
+	}
+
+	if (frame == 0)
+		return true;
+	frameCount = frame;
+
+	// Where the player ended up tells two runs of one replay apart
+	XMFLOAT3 playerPosition;
+	XMStoreFloat3(&playerPosition, mPlayer.GetCharacterInfo().mMovement.GetPlayerPosition());
+
+	std::ofstream fileOut(fileName);
+	fileOut << std::setprecision(9);
+	fileOut << "Seed " << mRandom.GetSeed() << "\n";
+	fileOut << "Frames " << frameCount << "\n";
+	fileOut << "UpdateMs " << updateTime / frameCount << "\n";
+	fileOut << "DrawMs " << drawTime / frameCount << "\n";
+	fileOut << "SimRate " << mZoneScheduler.GetActiveRate() << " " << mZoneScheduler.GetBackgroundRate() << "\n";
+	fileOut << "ZoneBudgetMs " << mZoneScheduler.GetBudget() << "\n";
+	for (UINT i = 0; i < mZoneScheduler.GetZoneCount(); ++i)
+		fileOut << "Zone" << i << "Ms " << zoneTimes[i] / frameCount << " OverBudget " << mZoneScheduler.GetStats(i).OverBudget << "\n";
+	fileOut << "Crowd " << mCrowdPopulation << "\n";
+	fileOut << "CrowdMs " << crowdTime / frameCount << "\n";
+	UINT respawns = 0;
+	for (auto& e : mMonstersByZone)
+		respawns += e->GetRespawnCount();
+	fileOut << "MonsterRespawns " << respawns << "\n";
+	fileOut << "MonsterAllocs " << GetMonsterAllocations() - warmupAllocations << "\n";
+	if (AllocationCounter::IsCounting())
+		fileOut << "FrameAllocs " << frameAllocations << "\n";
+	else
+		fileOut << "FrameAllocs not counted, build with ALLOCATION_COUNTER\n";
+	fileOut << "FlowRebuilds " << mFlowField.GetRebuildCount() - firstFlowRebuild << "\n";
+	fileOut << "FlowMs " << flowTime / frameCount << " Max " << flowMaxTime << "\n";
+	fileOut << "Commands " << totalCounts.GetCommandCount() / frameCount << "\n";
+	fileOut << "Draws " << totalCounts.Draws / frameCount << "\n";
+	fileOut << "PipelineStates " << totalCounts.PipelineStates / frameCount << "\n";
+	fileOut << "RootConstants " << totalCounts.RootConstants / frameCount << "\n";
+	fileOut << "RootBuffers " << totalCounts.RootBuffers / frameCount << "\n";
+	fileOut << "DescriptorTables " << totalCounts.DescriptorTables / frameCount << "\n";
+	fileOut << "Instances " << totalCounts.Instances / frameCount << "\n";
+	fileOut << "UploadBytes " << uploadBytes / frameCount << "\n";
+	const DescriptorCounts& descriptors = mRenderDevice->GetDescriptorCounts();
+	fileOut << "DescriptorHeaps " << descriptors.Heaps << " Descriptors " << descriptors.Descriptors << "\n";
+	fileOut << "SrvWrites " << descriptors.TextureViews + descriptors.CubeViews << " Texture2D " << descriptors.TextureViews <<
+		" Cube " << descriptors.CubeViews << " OutOfRange " << descriptors.OutOfRange << "\n";
+	fileOut << "PlayerPosition " << playerPosition.x << " " << playerPosition.y << " " << playerPosition.z << "\n";
+
+	// A steady frame must not touch the heap
+	return frameAllocations == 0;
+}
+
+// Fills mDrawList with the frame's draws, sorted
+void PortfolioGameApp::CollectDraws()
+{
+	mDrawList.Clear();
+
+	// Object
+	AddRenderItems(mRitems[(int)RenderLayer::Wall], RenderLayer::Wall, mIsWireframe ? ePSO::OpaqueWireframe : ePSO::Opaque);
+
+	// Ground and props, one draw per batch
+	ePSO instancedPSO = mIsWireframe ? ePSO::OpaqueInstancedWireframe : ePSO::OpaqueInstanced;
+	AddInstanceBatches(mBatches[(int)RenderLayer::Opaque], RenderLayer::Opaque, instancedPSO);
+	AddInstanceBatches(mBatches[(int)RenderLayer::Architecture], RenderLayer::Architecture, instancedPSO);
+
+	// Sky
+	AddRenderItems(mRitems[(int)RenderLayer::Sky], RenderLayer::Sky, ePSO::Sky);
+
+	// UI
+	AddRenderItems(mPlayer.mUI.GetRenderItem(eUIList::Rect), RenderLayer::UI, ePSO::UI);
+	AddRenderItems(mPlayer.mUI.GetRenderItem(eUIList::I_Punch), RenderLayer::UI, ePSO::UI);
+	AddRenderItems(mPlayer.mUI.GetRenderItem(eUIList::I_Kick), RenderLayer::UI, ePSO::UI);
+	AddRenderItems(mPlayer.mUI.GetRenderItem(eUIList::I_Kick2), RenderLayer::UI, ePSO::UI);
+	AddRenderItems(mMonster->mMonsterUI.GetRenderItem(eUIList::Rect), RenderLayer::UI, ePSO::MonsterUI);
+
+	// Character
+	AddRenderItems(mPlayer.GetRenderItem(RenderLayer::Character), RenderLayer::Character, mFbxWireframe ? ePSO::PlayerWireframe : ePSO::Player);
+
+	// Monster, one draw per submesh for the whole zone
+	auto monsterPalette = mMonster->GetPaletteAddress();
+	AddInstanceBatches(mMonster->GetInstanceBatches(RenderLayer::Monster), RenderLayer::Monster, ePSO::Monster, monsterPalette);
+
+	// Shadow
+	AddRenderItems(mPlayer.GetRenderItem(RenderLayer::Shadow), RenderLayer::Shadow, ePSO::PlayerShadow);
+	AddInstanceBatches(mMonster->GetInstanceBatches(RenderLayer::Shadow), RenderLayer::Shadow, ePSO::MonsterShadow, monsterPalette);
+
+	// Sort by state and record only what changes between draws
+	mDrawList.Sort();
+}
+
+// Split the sorted draws into contiguous ranges, one list each. Every list repeats the frame state,
+// so small frames use fewer lists than there are workers.
+void PortfolioGameApp::SplitDrawList(UINT& listCount, UINT& drawsPerList) const
+{
+	const UINT minDrawsPerList = 64;
+	UINT drawCount = mDrawList.GetDrawCount();
+	listCount = (std::min)((UINT)mCurrFrameResource->WorkerCmdLists.size(), (drawCount + minDrawsPerList - 1) / minDrawsPerList);
+	listCount = (std::max)(listCount, 1u);
+	drawsPerList = (drawCount + listCount - 1) / listCount;
+}
+
 
 void PortfolioGameApp::OnMouseDown(WPARAM btnState, int x, int y)
 {
@@ -276,73 +687,65 @@ void PortfolioGameApp::OnMouseMove(WPARAM btnState, int x, int y)
 	float dx = XMConvertToRadians(0.25f*static_cast<float>(x - mLastMousePos.x));
 	float dy = XMConvertToRadians(0.25f*static_cast<float>(y - mLastMousePos.y));
 
+	// Applied by the next Update, so replays see the same turns
 	if ((btnState & MK_LBUTTON) != 0)
 	{
-		mPlayer.mCamera.AddPitch(dy);
-
 		// Rotate Camera only
-		mPlayer.mCamera.AddYaw(dx);
+		mPendingInput.CameraPitch += dy;
+		mPendingInput.CameraYaw += dx;
 	}
 	else if ((btnState & MK_RBUTTON) != 0)
 	{
-		mPlayer.mCamera.AddPitch(dy);
-
 		// Rotate Camera with Player
-		mPlayer.mCamera.AddYaw(dx);
-		if(!mCameraDetach)
-			mPlayer.UpdatePlayerPosition(ePlayerMoveList::AddYaw, dx);
+		mPendingInput.CameraPitch += dy;
+		mPendingInput.CameraYaw += dx;
+		mPendingInput.PlayerYaw += dx;
 	}
 
 	mLastMousePos.x = x;
 	mLastMousePos.y = y;
+}
 
-	mPlayer.UpdateTransformationMatrix();
+void PortfolioGameApp::PollInput()
+{
+	static const int keyCodes[(int)eInputKey::Count] = { '7', '8', '9', '0', 'W', 'S', '1', '2', '3', 'A', 'D', VK_LSHIFT };
+
+	mFrameInput = mPendingInput;
+	mPendingInput = FrameInput();
+
+	// The keyboard of whoever is at the machine is not the benchmark's input
+	if (mHeadless)
+		return;
+
+	for (int i = 0; i < (int)eInputKey::Count; ++i)
+		mFrameInput.SetDown((eInputKey)i, (GetAsyncKeyState(keyCodes[i]) & 0x8000) != 0);
 }
 
 void PortfolioGameApp::OnKeyboardInput(const GameTimer& gt)
 {
 	const float dt = gt.DeltaTime();
-	bool isForward = true;
-	bool isBackward = true;
 
-	// Architecture
-	// Collision Chk
-	XMVECTOR playerLook = mPlayer.GetCharacterInfo().mMovement.GetPlayerLook();
-	XMVECTOR playerPos = mPlayer.GetCharacterInfo().mMovement.GetPlayerPosition();
-	auto playerBoundForward = mPlayer.GetCharacterInfo().mBoundingBox;
-	auto playerBoundBackward = playerBoundForward;
-
-	playerBoundForward.Center.x += 3.0f * playerLook.m128_f32[0];
-	playerBoundForward.Center.y += 3.0f * playerLook.m128_f32[1];
-	playerBoundForward.Center.z += 3.0f * playerLook.m128_f32[2];
-
-	playerBoundBackward.Center.x -= 3.0f * playerLook.m128_f32[0];
-	playerBoundBackward.Center.y -= 3.0f * playerLook.m128_f32[1];
-	playerBoundBackward.Center.z -= 3.0f * playerLook.m128_f32[2];
-
-	checkCollision(
-		mRitems[(int)RenderLayer::Architecture],
-		playerBoundForward,
-		playerBoundBackward,
-		isForward,
-		isBackward,
-		dt);
-	checkCollision(
-		mRitems[(int)RenderLayer::Wall],
-		playerBoundForward,
-		playerBoundBackward,
-		isForward,
-		isBackward,
-		dt);
+	// Mouse look
+	mPlayer.mCamera.AddPitch(mFrameInput.CameraPitch);
+	mPlayer.mCamera.AddYaw(mFrameInput.CameraYaw);
+	if (mFrameInput.PlayerYaw != 0.0f && !mCameraDetach)
+		mPlayer.UpdatePlayerPosition(ePlayerMoveList::AddYaw, mFrameInput.PlayerYaw);
+
+	// The walls may have moved since the last frame
+	mWallBoxes.clear();
+	for (auto& e : mRitems[(int)RenderLayer::Wall])
+		mWallBoxes.push_back(ToCullBox(e->Bounds));
+	mCollision.SetDynamicBoxes(mWallBoxes.data(), (uint32_t)mWallBoxes.size());
+	mPlayerContacts.clear();
 
 	// Input
-	if (GetAsyncKeyState('7') & 0x8000)
+	if (mFrameInput.IsDown(eInputKey::Wireframe))
 		mIsWireframe = true;
-	else if (GetAsyncKeyState('8') & 0x8000)
+	else if (mFrameInput.IsDown(eInputKey::FbxWireframe))
 		mFbxWireframe = true;
-	else if (GetAsyncKeyState('9') & 0x8000)
+	else if (mFrameInput.IsDown(eInputKey::DetachCamera))
 		mCameraDetach = true;
-	else if (GetAsyncKeyState('0') & 0x8000)
+	else if (mFrameInput.IsDown(eInputKey::AttachCamera))
 		mCameraDetach = false;
 	else
 	{
@@ -350,27 +753,19 @@ void PortfolioGameApp::OnKeyboardInput(const GameTimer& gt)
 		mFbxWireframe = false;
 	}
 
-	if (GetAsyncKeyState('W') & 0x8000)
+	if (mFrameInput.IsDown(eInputKey::Forward))
 	{
 		if (!mCameraDetach)
 		{
-			if (GetAsyncKeyState(VK_LSHIFT))
+			if (mFrameInput.IsDown(eInputKey::Run))
 			{
 				mPlayer.SetClipName("run");
-
-				if (isForward)
-					mPlayer.UpdatePlayerPosition(ePlayerMoveList::Walk, 18.0f * dt);
-
-				isForward = true;
+				MovePlayer(18.0f * dt);
 			}
 			else
 			{
 				mPlayer.SetClipName("playerWalking");
-
-				if (isForward)
-					mPlayer.UpdatePlayerPosition(ePlayerMoveList::Walk, 7.0f * dt);
-
-				isForward = true;
+				MovePlayer(7.0f * dt);
 			}
 
 			if (mPlayer.GetCurrentClip() == eClipList::Walking)
@@ -384,15 +779,12 @@ void PortfolioGameApp::OnKeyboardInput(const GameTimer& gt)
 			mPlayer.mCamera.Walk(20.0f * dt);
 		}
 	}
-	else if (GetAsyncKeyState('S') & 0x8000) 
+	else if (mFrameInput.IsDown(eInputKey::Backward)) 
 	{
 		if (!mCameraDetach)
 		{
 			mPlayer.SetClipName("WalkingBackward");
-
-			if(isBackward)
-				mPlayer.UpdatePlayerPosition(ePlayerMoveList::Walk, -5.0f * dt);
-			isBackward = true;
+			MovePlayer(-5.0f * dt);
 
 			if (mPlayer.GetCurrentClip() == eClipList::Walking)
 			{
@@ -405,33 +797,33 @@ void PortfolioGameApp::OnKeyboardInput(const GameTimer& gt)
 			mPlayer.mCamera.Walk(-20.0f * dt);
 		}
 	}
-	else if(GetAsyncKeyState('1') & 0x8000)
+	else if(mFrameInput.IsDown(eInputKey::Punch))
 	{
 		// Kick Delay, 5 seconds
 		if (gt.TotalTime() - HitTime[(int)eUIList::I_Punch] > 3.0f)
 		{
 			mPlayer.SetClipTime(0.0f);
-			mPlayer.Attack(mMonster, "Hook");
+			mPlayer.Attack(mHits, mZoneIndex, "Hook");
 			HitTime[(int)eUIList::I_Punch] = gt.TotalTime();
 		}
 	}
-	else if (GetAsyncKeyState('2') & 0x8000)
+	else if (mFrameInput.IsDown(eInputKey::Kick))
 	{
 		// Hook Delay, 3 seconds
 		if (gt.TotalTime() - HitTime[(int)eUIList::I_Kick] > 5.0f)
 		{
 			mPlayer.SetClipTime(0.0f);
-			mPlayer.Attack(mMonster, "Kick"); 
+			mPlayer.Attack(mHits, mZoneIndex, "Kick");
 			HitTime[(int)eUIList::I_Kick] = gt.TotalTime();
 		}
 	}
-	else if (GetAsyncKeyState('3') & 0x8000)
+	else if (mFrameInput.IsDown(eInputKey::Kick2))
 	{
 		// Hook Delay, 3 seconds
 		if (gt.TotalTime() - HitTime[(int)eUIList::I_Kick2] > 10.0f)
 		{
 			mPlayer.SetClipTime(0.0f);
-			mPlayer.Attack(mMonster, "Kick2");
+			mPlayer.Attack(mHits, mZoneIndex, "Kick2");
 			HitTime[(int)eUIList::I_Kick2] = gt.TotalTime();
 		}
 	}
@@ -441,14 +833,14 @@ void PortfolioGameApp::OnKeyboardInput(const GameTimer& gt)
 			mPlayer.SetClipName("Idle");
 	}
 
-	if (GetAsyncKeyState('A') & 0x8000)
+	if (mFrameInput.IsDown(eInputKey::TurnLeft))
 	{
 		if (!mCameraDetach)
 			mPlayer.UpdatePlayerPosition(ePlayerMoveList::AddYaw, -1.0f * dt);
 		else
 			mPlayer.mCamera.WalkSideway(-10.0f * dt);
 	}
-	else if (GetAsyncKeyState('D') & 0x8000)
+	else if (mFrameInput.IsDown(eInputKey::TurnRight))
 	{
 		if (!mCameraDetach)
 			mPlayer.UpdatePlayerPosition(ePlayerMoveList::AddYaw, 1.0f * dt);
@@ -471,35 +863,18 @@ void PortfolioGameApp::OnKeyboardInput(const GameTimer& gt)
 	}
 }
 
-void PortfolioGameApp::checkCollision(
-	const std::vector<RenderItem*>& rItems,
-	const BoundingBox &playerBoundForward,
-	const BoundingBox &playerBoundBackward,
-	bool &isForward, 
-	bool &isBackward,
-	const float &dt)
+void PortfolioGameApp::MovePlayer(float distance)
 {
-	for (auto&e : rItems)
-	{
-		if (isForward && playerBoundForward.Contains(e->Bounds) == ContainmentType::INTERSECTS)
-		{
-			mPlayer.SetClipName("WalkingBackward");
-
-			if (isBackward)
-				mPlayer.UpdatePlayerPosition(ePlayerMoveList::Walk, -7.0f * dt);
-
-			isForward = false;
-		}
-		if (isBackward && playerBoundBackward.Contains(e->Bounds) == ContainmentType::INTERSECTS)
-		{
-			mPlayer.SetClipName("playerWalking");
+	// The box around the player where it stands now
+	BoundingBox playerBounds;
+	mPlayer.GetBoundingBox().Transform(playerBounds, mPlayer.GetWorldTransformMatrix());
 
-			if (isForward)
-				mPlayer.UpdatePlayerPosition(ePlayerMoveList::Walk, 7.0f * dt);
+	XMFLOAT3 delta;
+	XMStoreFloat3(&delta, distance * mPlayer.GetCharacterInfo().mMovement.GetPlayerLook());
 
-			isBackward = false;
-		}
-	}
+	XMFLOAT3 allowed;
+	mCollision.Move(ToCullBox(playerBounds), &delta.x, &allowed.x, mPlayerContacts);
+	mPlayer.TranslatePlayer(XMLoadFloat3(&allowed));
 }
 
 void PortfolioGameApp::UpdateObjectCBs(const GameTimer& gt)
@@ -528,6 +903,201 @@ void PortfolioGameApp::UpdateObjectCBs(const GameTimer& gt)
 	}
 }
 
+// Sets up both culling stages for this frame's camera: the frustum, and the occluder depth
+void PortfolioGameApp::RenderOccluders()
+{
+	auto occlusionStart = std::chrono::high_resolution_clock::now();
+
+	mPlayer.mCamera.UpdateViewMatrix();
+	mFrustum = mPlayer.mCamera.GetFrustum();
+
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(mPlayer.mCamera.GetView(), mPlayer.mCamera.GetProj()));
+	mOcclusion.Render(&viewProj.m[0][0]);
+
+	std::chrono::duration<float, std::milli> occlusionTime = std::chrono::high_resolution_clock::now() - occlusionStart;
+	mCullStats.OcclusionTime = occlusionTime.count();
+}
+
+// Tests the static items through the BVH, and walls and player items one by one,
+// then drops what the occluders hide. Monsters cull their own instances in Monster::UpdateCharacterCBs.
+void PortfolioGameApp::CullRenderItems(const GameTimer& gt)
+{
+	auto cullStart = std::chrono::high_resolution_clock::now();
+
+	for (auto& e : mStaticCullItems)
+		e->Visible = false;
+
+	mVisibleStatic.clear();
+	mStaticBVH.Cull(mFrustum, mVisibleStatic);
+
+	UINT occluded = 0;
+	size_t visibleCount = 0;
+	for (auto i : mVisibleStatic)
+	{
+		if (!mOcclusion.IsVisible(mStaticBoxes[i]))
+		{
+			++occluded;
+			continue;
+		}
+
+		mStaticCullItems[i]->Visible = true;
+		mVisibleStatic[visibleCount++] = i;
+	}
+	mVisibleStatic.resize(visibleCount);
+
+	// Walls move when a zone is cleared, the player every frame
+	mDynamicCullItems.clear();
+	mDynamicBoxes.clear();
+	for (auto& e : mRitems[(int)RenderLayer::Wall])
+	{
+		mDynamicCullItems.push_back(e);
+		mDynamicBoxes.push_back(ToCullBox(e->Bounds));
+	}
+
+	CullBox playerBox = ToCullBox(mPlayer.GetCharacterInfo().mBoundingBox);
+	for (auto& e : mPlayer.GetRenderItem(RenderLayer::Character))
+	{
+		mDynamicCullItems.push_back(e);
+		mDynamicBoxes.push_back(playerBox);
+	}
+	CullBox shadowBox = ToCullBox(mPlayer.GetShadowBounds());
+	for (auto& e : mPlayer.GetRenderItem(RenderLayer::Shadow))
+	{
+		mDynamicCullItems.push_back(e);
+		mDynamicBoxes.push_back(shadowBox);
+	}
+
+	mDynamicVisible.resize(mDynamicBoxes.size());
+	CullBoxes(mFrustum, mDynamicBoxes.data(), (uint32_t)mDynamicBoxes.size(), mDynamicVisible.data());
+	occluded += mOcclusion.TestBoxes(mDynamicBoxes.data(), (uint32_t)mDynamicBoxes.size(), mDynamicVisible.data());
+
+	UINT dynamicVisible = 0;
+	for (size_t i = 0; i < mDynamicCullItems.size(); ++i)
+	{
+		mDynamicCullItems[i]->Visible = mDynamicVisible[i] != 0;
+		dynamicVisible += mDynamicVisible[i];
+	}
+
+	std::chrono::duration<float, std::milli> cullTime = std::chrono::high_resolution_clock::now() - cullStart;
+	mCullStats.CullTime = cullTime.count();
+	mCullStats.Total = (UINT)(mStaticCullItems.size() + mDynamicCullItems.size()) + 2 * mMonster->GetNumberOfMonster();
+	mCullStats.Visible = (UINT)mVisibleStatic.size() + dynamicVisible + mMonster->GetVisibleInstanceCount();
+	mCullStats.Occluded = occluded + mMonster->GetOccludedInstanceCount();
+}
+
+// Packs the visible instances of the static batches into this frame's upload memory
+void PortfolioGameApp::UpdateInstanceBuffer(const GameTimer& gt)
+{
+	UINT visibleCount = (UINT)mVisibleStatic.size();
+
+	UploadAllocation instances;
+	if (visibleCount > 0)
+		instances = mCurrFrameResource->Allocator->Allocate<InstanceData>(visibleCount);
+	InstanceData* curInstances = reinterpret_cast<InstanceData*>(instances.CPU);
+
+	UINT instanceBase = 0;
+	for (auto& batches : mBatches)
+	{
+		for (auto& b : batches)
+		{
+			b.InstanceAddress = instances.GPU;
+			b.InstanceBase = instanceBase;
+			b.InstanceCount = 0;
+
+			for (auto& e : b.Instances)
+			{
+				if (!e->Visible)
+					continue;
+
+				InstanceData instanceData;
+				XMStoreFloat4x4(&instanceData.World, XMMatrixTranspose(XMLoadFloat4x4(&e->World)));
+				XMStoreFloat4x4(&instanceData.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&e->TexTransform)));
+				instanceData.MaterialIndex = (UINT)e->Mat;
+
+				curInstances[instanceBase + b.InstanceCount++] = instanceData;
+			}
+
+			instanceBase += b.InstanceCount;
+		}
+	}
+}
+
+// Torches and hit flashes, binned into the view clusters and uploaded for the pixel shaders
+void PortfolioGameApp::UpdateLights(const GameTimer& gt)
+{
+	const float flashLifetime = 0.3f;
+
+	for (auto& e : mHitFlashes)
+		e.Age += gt.DeltaTime();
+	mHitFlashes.erase(std::remove_if(mHitFlashes.begin(), mHitFlashes.end(),
+		[flashLifetime](const HitFlash& e) { return e.Age >= flashLifetime; }), mHitFlashes.end());
+
+	mHitPositions.clear();
+	for (auto& e : mMonstersByZone)
+		e->TakeHitPositions(mHitPositions);
+	for (auto& e : mHitPositions)
+	{
+		if (mHitFlashes.size() < MaxHitFlashes)
+			mHitFlashes.push_back({ { e.x, e.y + 5.0f, e.z }, 0.0f });
+	}
+
+	mFrameLights.clear();
+	for (size_t i = 0; i < mTorchLights.size(); ++i)
+	{
+		Light light = mTorchLights[i];
+		float flicker = 0.85f + 0.15f * sinf(gt.TotalTime() * 11.0f + (float)i * 1.7f);
+		light.Strength = { light.Strength.x * flicker, light.Strength.y * flicker, light.Strength.z * flicker };
+		mFrameLights.push_back(light);
+	}
+	for (auto& e : mHitFlashes)
+	{
+		float fade = 1.0f - e.Age / flashLifetime;
+
+		Light light;
+		light.Strength = { 3.0f * fade, 2.4f * fade, 1.6f * fade };
+		light.FalloffStart = 1.0f;
+		light.FalloffEnd = 20.0f;
+		light.Position = e.Position;
+		light.SpotPower = 0.0f;
+		mFrameLights.push_back(light);
+	}
+
+	XMMATRIX view = mPlayer.mCamera.GetView();
+	mFrameLightBounds.resize(mFrameLights.size());
+	for (size_t i = 0; i < mFrameLights.size(); ++i)
+	{
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&mFrameLights[i].Position), view));
+		mFrameLightBounds[i] = { { center.x, center.y, center.z }, mFrameLights[i].FalloffEnd };
+	}
+
+	mLightClusters.Build(mFrameLightBounds.data(), (uint32_t)mFrameLightBounds.size(), mThreadPool.get());
+
+	auto& ranges = mLightClusters.GetRanges();
+	auto& indices = mLightClusters.GetIndices();
+
+	auto lights = mCurrFrameResource->Allocator->Allocate<Light>((std::max)((UINT)mFrameLights.size(), 1u));
+	auto clusters = mCurrFrameResource->Allocator->Allocate<LightClusters::Range>((UINT)ranges.size());
+	auto lightIndices = mCurrFrameResource->Allocator->Allocate<UINT>((std::max)((UINT)indices.size(), 1u));
+	if (!mFrameLights.empty())
+		memcpy(lights.CPU, mFrameLights.data(), mFrameLights.size() * sizeof(Light));
+	memcpy(clusters.CPU, ranges.data(), ranges.size() * sizeof(LightClusters::Range));
+	if (!indices.empty())
+		memcpy(lightIndices.CPU, indices.data(), indices.size() * sizeof(UINT));
+
+	mLightBufferAddress = lights.GPU;
+	mLightClusterAddress = clusters.GPU;
+	mLightIndexAddress = lightIndices.GPU;
+
+	mMainPassCB.ClusterDimX = LightClusters::DimX;
+	mMainPassCB.ClusterDimY = LightClusters::DimY;
+	mMainPassCB.ClusterDimZ = LightClusters::DimZ;
+	mMainPassCB.ClusterLightCount = (UINT)mFrameLights.size();
+	mMainPassCB.ClusterSliceScale = mLightClusters.GetSliceScale();
+	mMainPassCB.ClusterSliceBias = mLightClusters.GetSliceBias();
+}
+
 void PortfolioGameApp::UpdateMainPassCB(const GameTimer& gt)
 {
 	XMMATRIX view = mPlayer.mCamera.GetView();
@@ -563,14 +1133,13 @@ void PortfolioGameApp::UpdateMainPassCB(const GameTimer& gt)
 	mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
 	mMainPassCB.Lights[2].Strength = { 0.15f, 0.15f, 0.15f };
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
+	mPassCBAddress = mCurrFrameResource->Allocator->Push(mMainPassCB);
 }
 
-void PortfolioGameApp::UpdateMaterialCB(const GameTimer & gt)
+void PortfolioGameApp::UpdateMaterialBuffer(const GameTimer & gt)
 {
-	auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
-	mMaterials.UpdateMaterialCB(currMaterialCB);
+	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
+	mMaterials.UpdateMaterialBuffer(currMaterialBuffer);
 }
 
 void PortfolioGameApp::UpdateCharacterCBs(const GameTimer & gt)
@@ -619,26 +1188,26 @@ void PortfolioGameApp::UpdateCharacterCBs(const GameTimer & gt)
 	// when all monsters die, the next room(third room) opens
 	// and Block room4
 	auto& e = mRitems[(int)RenderLayer::Wall].front();
-	if (e->Mat->Name == "stone0" && mZoneIndex == 0 && mMonster->isAllDie())
+	if (e->Mat == mWallMat[0] && mZoneIndex == 0 && mMonster->isAllDie())
 	{
 		XMMATRIX M = XMMatrixRotationY(XM_PIDIV2);
-		mAllRitems[e->ObjCBIndex]->Mat = mMaterials.Get("ice0");
+		mAllRitems[e->ObjCBIndex]->Mat = mWallMat[1];
 		e->Bounds.Transform(e->Bounds, M);
 		XMStoreFloat4x4(&e->World, XMLoadFloat4x4(&e->World) * M);
 		e->NumFramesDirty = gNumFrameResources;
 	}
-	else if (e->Mat->Name == "ice0" && mZoneIndex == 1 && mMonster->isAllDie())
+	else if (e->Mat == mWallMat[1] && mZoneIndex == 1 && mMonster->isAllDie())
 	{
 		XMMATRIX M = XMMatrixRotationY(XM_PIDIV2);
-		mAllRitems[e->ObjCBIndex]->Mat = mMaterials.Get("Transparency");
+		mAllRitems[e->ObjCBIndex]->Mat = mWallMat[2];
 		e->Bounds.Transform(e->Bounds, M);
 		XMStoreFloat4x4(&e->World, XMLoadFloat4x4(&e->World) * M);
 		e->NumFramesDirty = gNumFrameResources;
 	}
-	else if (e->Mat->Name == "Transparency" && mZoneIndex == 2 && mMonster->isAllDie())
+	else if (e->Mat == mWallMat[2] && mZoneIndex == 2 && mMonster->isAllDie())
 	{
 		XMMATRIX M = XMMatrixTranslation(0.0f, 0.0f, -500.0f);
-		mAllRitems[e->ObjCBIndex]->Mat = mMaterials.Get("tundra0");
+		mAllRitems[e->ObjCBIndex]->Mat = mWallMat[3];
 		e->Bounds.Transform(e->Bounds, M);
 		XMStoreFloat4x4(&e->World, XMLoadFloat4x4(&e->World) * M);
 		e->NumFramesDirty = gNumFrameResources;
@@ -665,14 +1234,62 @@ void PortfolioGameApp::UpdateCharacterCBs(const GameTimer & gt)
 		}
 	}
 
-	static float lastTime = gt.TotalTime();
-	if (gt.TotalTime() - lastTime > 0.04f)
+	// Every zone advances in fixed steps on the workers, the player's at the full rate.
+	// They see a copy of the player and queue their strikes until all are done.
+	ZoneTarget target;
+	XMStoreFloat3(&target.Position, PlayerPos);
+	XMStoreFloat3(&target.Look, mPlayer.GetCharacterInfo().mMovement.GetPlayerLook());
+	target.Health = mPlayer.GetCharacterInfo().mHealth;
+	// Rebuilt only when the player changed cell, a slice per frame while the zones read the
+	// previous field. A full rebuild of the 250 x 250 grid takes about 8 frames.
+	const uint32_t flowCellsPerFrame = 16384;
+	mFlowField.SetGoal(target.Position.x, target.Position.z);
+	mFlowField.Step(flowCellsPerFrame);
+	target.Field = &mFlowField;
+	target.Hits = &mHits;
+
+	// A zone steps on one thread at a time, so its thread's count is its own
+	mZoneScheduler.Run(mZoneIndex, gt.DeltaTime(), mThreadPool.get(), [this, &target](uint32_t zone, float simTime, float dt)
+	{
+		uint64_t allocations = AllocationCounter::GetThreadCount();
+		mMonstersByZone[zone]->UpdateMonsterPosition(target, simTime, dt);
+		// The drawn zone is posed per frame in UpdateCharacterCBs
+		if (zone != mZoneIndex)
+			mMonstersByZone[zone]->UpdatePosedBounds();
+		mMonstersByZone[zone]->UpdateCrowd(target, dt);
+		mZoneAllocations[zone] += AllocationCounter::GetThreadCount() - allocations;
+	});
+
+	uint64_t allocations = AllocationCounter::GetThreadCount();
+	ResolveHits();
+
+	// Drawn between its last two steps
+	mMonster->SetInterpolation(mZoneScheduler.GetAlpha(mZoneIndex));
+	// Culling follows this frame's camera
+	RenderOccluders();
+
+	mMonster->UpdateCharacterCBs(mCurrFrameResource, mMainLight, mFrustum, mOcclusion, gt);
+	mMonsterAllocations += AllocationCounter::GetThreadCount() - allocations;
+	mPlayer.UpdateCharacterCBs(mCurrFrameResource, mMainLight, DelayTime, gt);
+}
+
+void PortfolioGameApp::ResolveHits()
+{
+	// One pass in a fixed order, whichever thread queued each hit
+	mHits.Sort();
+	mHitCount = mHits.GetCount();
+	for (UINT i = 0; i < mHitCount; ++i)
 	{
-		mMonster->UpdateMonsterPosition(mPlayer, gt);
-		lastTime = gt.TotalTime();
+		const HitEvent& e = mHits[i];
+		XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(e.Position));
+		XMVECTOR look = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(e.Look));
+
+		if (e.Source == eHitSource::Player)
+			mMonstersByZone[e.Zone]->Damage(e.Damage, position, look);
+		else
+			mPlayer.Damage(e.Damage, position, look);
 	}
-	mMonster->UpdateCharacterCBs(mCurrFrameResource, mMainLight, gt);
-	mPlayer.UpdateCharacterCBs(mCurrFrameResource, mMainLight, DelayTime, gt);
+	mHits.Clear();
 }
 
 void PortfolioGameApp::UpdateObjectShadows(const GameTimer& gt)
@@ -688,137 +1305,64 @@ void PortfolioGameApp::BuildDescriptorHeaps()
 	UINT texCount = mTexDiffuse.GetSize();
 	UINT texNormalCount = mTexDiffuse.GetSize();
 	UINT texSkyCount = mTexSkyCube.GetSize();
-	UINT objCount = (UINT)mAllRitems.size();
-	UINT passCount = 1;
-	UINT matCount = mMaterials.GetSize();
-	UINT chaCount = mPlayer.GetAllRitemsSize();
-	UINT monsterCount = mMonster->GetAllRitemsSize();
-	UINT uiCount = mPlayer.mUI.GetSize();
-	UINT monsterUICount = mMonster->GetUISize();
-	// Need a CBV descriptor for each object for each frame resource,
-	// +1 for the perPass CBV for each frame resource.
-	// +matCount for the Materials for each frame resources.
-	UINT numDescriptors = texCount + texNormalCount + texSkyCount + (objCount + passCount + matCount + chaCount + monsterCount + monsterUICount + uiCount) * gNumFrameResources;
-
-
-	// Save an offset to the start of the pass CBVs.  These are the last 3 descriptors.
-	
+	// Constant data is bound through root descriptors,
+	// so the heap only holds texture SRVs.
+	UINT numDescriptors = texCount + texNormalCount + texSkyCount;
+
 	mTexNormalOffset = texCount;
 	mTexSkyCubeOffset = texCount + texNormalCount;
-	mObjCbvOffset = mTexSkyCubeOffset + texSkyCount;
-	mMatCbvOffset = objCount * gNumFrameResources + mObjCbvOffset;
-	mPassCbvOffset = matCount * gNumFrameResources + mMatCbvOffset;
-	mChaCbvOffset = passCount * gNumFrameResources + mPassCbvOffset;
-	mMonsterCbvOffset = chaCount * gNumFrameResources + mChaCbvOffset;
-	mUICbvOffset = monsterCount * gNumFrameResources + mMonsterCbvOffset;
-	mMonsterUICbvOffset = uiCount * gNumFrameResources + mUICbvOffset;
-
-	// mPassCbvOffset + (passSize)
-	// passSize = 1 * gNumFrameResources
-	D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc;
-	cbvHeapDesc.NumDescriptors = numDescriptors;
-	cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	cbvHeapDesc.NodeMask = 0;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&cbvHeapDesc,
-		IID_PPV_ARGS(&mCbvHeap)));
+	mMaterials.SetNormalSrvHeapOffset(mTexNormalOffset);
+
+	mCbvHeap = mRenderDevice->CreateDescriptorHeap(numDescriptors);
 }
 
 void PortfolioGameApp::BuildTextureBufferViews()
 {
-	mTexDiffuse.Begin(md3dDevice.Get(), mCommandList.Get(), mCbvHeap.Get());
+	mTexDiffuse.Begin(mRenderDevice.get(), mCbvHeap.Get());
 	mTexDiffuse.BuildConstantBufferViews(Textures::Type::TWO_DIMENTION);
 	mTexDiffuse.End();
 
-	mTexNormal.Begin(md3dDevice.Get(), mCommandList.Get(), mCbvHeap.Get());
+	mTexNormal.Begin(mRenderDevice.get(), mCbvHeap.Get());
 	mTexNormal.BuildConstantBufferViews(Textures::Type::TWO_DIMENTION, mTexNormalOffset);
 	mTexNormal.End();
 
-	mTexSkyCube.Begin(md3dDevice.Get(), mCommandList.Get(), mCbvHeap.Get());
+	mTexSkyCube.Begin(mRenderDevice.get(), mCbvHeap.Get());
 	mTexSkyCube.BuildConstantBufferViews(Textures::Type::CUBE, mTexSkyCubeOffset);
 	mTexSkyCube.End();
 }
 
-void PortfolioGameApp::BuildConstantBufferViews(int cbvOffset, UINT itemSize, UINT cbSize, eUploadBufferIndex e)
-{
-	UINT CBByteSize = d3dUtil::CalcConstantBufferByteSize(cbSize);
-
-	for (int frameIndex = 0; frameIndex < gNumFrameResources; ++frameIndex)
-	{
-		auto cbResource = FrameResource::GetResourceByIndex(mFrameResources[frameIndex].get(), e);
-
-		for (UINT i = 0; i < itemSize; ++i)
-		{
-			D3D12_GPU_VIRTUAL_ADDRESS cbAddress = cbResource->GetGPUVirtualAddress();
-
-			// Offset to the ith object constant buffer in the buffer.
-			cbAddress += i * CBByteSize;
-
-			// Offset to the object cbv in the descriptor heap.
-			int heapIndex = cbvOffset + frameIndex * itemSize + i;
-			auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-			handle.Offset(heapIndex, mCbvSrvDescriptorSize);
-
-			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-			cbvDesc.BufferLocation = cbAddress;
-			cbvDesc.SizeInBytes = CBByteSize;
-
-			md3dDevice->CreateConstantBufferView(&cbvDesc, handle);
-		}
-	}
-}
-
-void PortfolioGameApp::BuildConstantBufferViews()
-{
-	// Object 
-	BuildConstantBufferViews(mObjCbvOffset, mAllRitems.size(), sizeof(ObjectConstants), eUploadBufferIndex::ObjectCB);
-
-	// Material 
-	BuildConstantBufferViews(mMatCbvOffset, mMaterials.GetSize(), sizeof(MaterialConstants), eUploadBufferIndex::MaterialCB);
-
-	// Pass - 4
-	// Last three descriptors are the pass CBVs for each frame resource.
-	BuildConstantBufferViews(mPassCbvOffset, 1, sizeof(PassConstants), eUploadBufferIndex::PassCB);
-
-	// Character
-	BuildConstantBufferViews(mChaCbvOffset, mPlayer.GetAllRitemsSize(), sizeof(CharacterConstants), eUploadBufferIndex::PlayerCB);
-	BuildConstantBufferViews(mMonsterCbvOffset, mMonster->GetAllRitemsSize(), sizeof(CharacterConstants), eUploadBufferIndex::MonsterCB);
-
-	// UI
-	BuildConstantBufferViews(mUICbvOffset, mPlayer.mUI.GetSize(), sizeof(UIConstants), eUploadBufferIndex::UICB);
-	BuildConstantBufferViews(mMonsterUICbvOffset, mMonster->mMonsterUI.GetSize(), sizeof(UIConstants), eUploadBufferIndex::MonsterUICB);
-}
-
 void PortfolioGameApp::BuildRootSignature()
 {
-	const int texTableNumber = 3;
-	const int cbvTableNumber = 7;
-	const int tableNumber = texTableNumber + cbvTableNumber;
-
-	CD3DX12_DESCRIPTOR_RANGE texTable[texTableNumber];
-	CD3DX12_DESCRIPTOR_RANGE cbvTable[cbvTableNumber];
+	// Bindless texture range: diffuse and normal maps, indexed through MaterialData
+	CD3DX12_DESCRIPTOR_RANGE texTable;
+	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 1);
 
-	for (int i = 0; i < texTableNumber; ++i)
-		texTable[i].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, i);
-	for (int i = 0; i < cbvTableNumber; ++i)
-		cbvTable[i].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, i);
+	CD3DX12_DESCRIPTOR_RANGE cubeTable;
+	cubeTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
-	
 	// Root parameter can be a table, root descriptor or root constants.
-	// Objects, Materials, Passes
-	CD3DX12_ROOT_PARAMETER slotRootParameter[tableNumber];
-
-	// Create root CBVs.
-	for (int i = 0; i < texTableNumber; ++i)
-		slotRootParameter[i].InitAsDescriptorTable(1, &texTable[i], D3D12_SHADER_VISIBILITY_PIXEL);
-	for (int i = texTableNumber; i < tableNumber; ++i)
-		slotRootParameter[i].InitAsDescriptorTable(1, &cbvTable[i - texTableNumber]);
-
+	CD3DX12_ROOT_PARAMETER slotRootParameter[(int)eRootParameter::Count];
+
+	// Per draw only the object and material index change
+	slotRootParameter[(int)eRootParameter::DrawConstants].InitAsConstants(sizeof(DrawConstants) / 4, 0);
+	slotRootParameter[(int)eRootParameter::TextureTable].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[(int)eRootParameter::CubeMapTable].InitAsDescriptorTable(1, &cubeTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[(int)eRootParameter::MaterialBuffer].InitAsShaderResourceView(1);
+	slotRootParameter[(int)eRootParameter::ObjectBuffer].InitAsShaderResourceView(2);
+	slotRootParameter[(int)eRootParameter::UIBuffer].InitAsShaderResourceView(3);
+	slotRootParameter[(int)eRootParameter::MonsterUIBuffer].InitAsShaderResourceView(4);
+	slotRootParameter[(int)eRootParameter::PassCB].InitAsConstantBufferView(1);
+	slotRootParameter[(int)eRootParameter::SkinnedCB].InitAsConstantBufferView(2);
+	slotRootParameter[(int)eRootParameter::BonePalette].InitAsShaderResourceView(5);
+	slotRootParameter[(int)eRootParameter::InstanceBuffer].InitAsShaderResourceView(6);
+	slotRootParameter[(int)eRootParameter::LightBuffer].InitAsShaderResourceView(7, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[(int)eRootParameter::LightClusterBuffer].InitAsShaderResourceView(8, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[(int)eRootParameter::LightIndexBuffer].InitAsShaderResourceView(9, 0, D3D12_SHADER_VISIBILITY_PIXEL);
 
 	auto staticSamplers = GetStaticSamplers();
 
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(tableNumber, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc((UINT)eRootParameter::Count, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -834,26 +1378,26 @@ void PortfolioGameApp::BuildRootSignature()
 	}
 	ThrowIfFailed(hr);
 
-	ThrowIfFailed(md3dDevice->CreateRootSignature(
-		0,
-		serializedRootSig->GetBufferPointer(),
-		serializedRootSig->GetBufferSize(),
-		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+	mRootSignature = mRenderDevice->CreateRootSignature(serializedRootSig.Get());
 
 }
 
 void PortfolioGameApp::BuildFrameResources()
 {
+	// Pass constants, skinned constants, palettes and visible instances; grows on demand
+	const UINT64 frameUploadCapacity = 256 * 1024;
+
+	// One recording list per pool thread plus the calling thread, ParallelFor uses both
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(
-			md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(),
+			mRenderDevice.get(),
+			(UINT)mAllRitems.size(),
 			mMaterials.GetSize(),
-			mPlayer.GetAllRitemsSize(),
-			mMonster->GetAllRitemsSize(),
 			mPlayer.mUI.GetSize(),
-			mMonster->GetUISize()));
+			mMonster->GetUISize(),
+			frameUploadCapacity,
+			mThreadPool->GetThreadCount() + 1));
 	}
 }
 
@@ -864,6 +1408,11 @@ void PortfolioGameApp::BuildShadersAndInputLayout()
 		"SKINNED", "1",
 		NULL, NULL
 	};
+	const D3D_SHADER_MACRO instancedDefines[] =
+	{
+		"INSTANCED", "1",
+		NULL, NULL
+	};
 	const D3D_SHADER_MACRO playerUIDefines[] =
 	{
 		"PLAYER", "1",
@@ -876,6 +1425,7 @@ void PortfolioGameApp::BuildShadersAndInputLayout()
 	};
 
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"..\\Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
+	mShaders["instancedVS"] = d3dUtil::CompileShader(L"..\\Shaders\\Default.hlsl", instancedDefines, "VS", "vs_5_1");
 	mShaders["skinnedVS"] = d3dUtil::CompileShader(L"..\\Shaders\\Default.hlsl", skinnedDefines, "VS", "vs_5_1");
 	mShaders["monsterVS"] = d3dUtil::CompileShader(L"..\\Shaders\\Monster.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["uiVS"] = d3dUtil::CompileShader(L"..\\Shaders\\UI.hlsl", playerUIDefines, "VS", "vs_5_1");
@@ -950,7 +1500,16 @@ void PortfolioGameApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	mPSOs["opaque"] = mRenderDevice->CreatePipelineState(opaquePsoDesc);
+
+	// PSO for instance batches
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC instancedPsoDesc = opaquePsoDesc;
+	instancedPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["instancedVS"]->GetBufferPointer()),
+		mShaders["instancedVS"]->GetBufferSize()
+	};
+	mPSOs["opaque_instanced"] = mRenderDevice->CreatePipelineState(instancedPsoDesc);
 
 	// PSO for Player 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC PlayerPsoDesc = opaquePsoDesc;
@@ -965,7 +1524,7 @@ void PortfolioGameApp::BuildPSOs()
 		reinterpret_cast<BYTE*>(mShaders["skinnedPS"]->GetBufferPointer()),
 		mShaders["skinnedPS"]->GetBufferSize()
 	};
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&PlayerPsoDesc, IID_PPV_ARGS(&mPSOs["Player"])));
+	mPSOs["Player"] = mRenderDevice->CreatePipelineState(PlayerPsoDesc);
 
 	// PSO for Monster
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC MonsterPsoDesc = PlayerPsoDesc;
@@ -981,7 +1540,7 @@ void PortfolioGameApp::BuildPSOs()
 		mShaders["monsterPS"]->GetBufferSize()
 	};
 	
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&MonsterPsoDesc, IID_PPV_ARGS(&mPSOs["Monster"])));
+	mPSOs["Monster"] = mRenderDevice->CreatePipelineState(MonsterPsoDesc);
 
 
 	// PSO for ui
@@ -997,7 +1556,7 @@ void PortfolioGameApp::BuildPSOs()
 		reinterpret_cast<BYTE*>(mShaders["uiPS"]->GetBufferPointer()),
 		mShaders["uiPS"]->GetBufferSize()
 	};
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&UIPsoDesc, IID_PPV_ARGS(&mPSOs["UI"])));
+	mPSOs["UI"] = mRenderDevice->CreatePipelineState(UIPsoDesc);
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC MonsterUIPsoDesc = UIPsoDesc;
 	MonsterUIPsoDesc.VS =
@@ -1010,19 +1569,23 @@ void PortfolioGameApp::BuildPSOs()
 		reinterpret_cast<BYTE*>(mShaders["uiPS"]->GetBufferPointer()),
 		mShaders["uiPS"]->GetBufferSize()
 	};
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&MonsterUIPsoDesc, IID_PPV_ARGS(&mPSOs["MonsterUI"])));
+	mPSOs["MonsterUI"] = mRenderDevice->CreatePipelineState(MonsterUIPsoDesc);
 
 
 	// PSO for skinned wireframe objects.
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC PlayerWireframePsoDesc = PlayerPsoDesc;
 	PlayerWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
 	
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&PlayerWireframePsoDesc, IID_PPV_ARGS(&mPSOs["Player_wireframe"])));
+	mPSOs["Player_wireframe"] = mRenderDevice->CreatePipelineState(PlayerWireframePsoDesc);
 
 	// PSO for opaque wireframe objects.
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueWireframePsoDesc = opaquePsoDesc;
 	opaqueWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueWireframePsoDesc, IID_PPV_ARGS(&mPSOs["opaque_wireframe"])));
+	mPSOs["opaque_wireframe"] = mRenderDevice->CreatePipelineState(opaqueWireframePsoDesc);
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC instancedWireframePsoDesc = instancedPsoDesc;
+	instancedWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+	mPSOs["opaque_instanced_wireframe"] = mRenderDevice->CreatePipelineState(instancedWireframePsoDesc);
 
 
 	// PSO for sky.
@@ -1043,7 +1606,7 @@ void PortfolioGameApp::BuildPSOs()
 		reinterpret_cast<BYTE*>(mShaders["skyPS"]->GetBufferPointer()),
 		mShaders["skyPS"]->GetBufferSize()
 	};
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&skyPsoDesc, IID_PPV_ARGS(&mPSOs["sky"])));
+	mPSOs["sky"] = mRenderDevice->CreatePipelineState(skyPsoDesc);
 
 
 
@@ -1083,7 +1646,7 @@ void PortfolioGameApp::BuildPSOs()
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC shadowPsoDesc = opaquePsoDesc;
 	shadowPsoDesc.DepthStencilState = shadowDSS;
 	shadowPsoDesc.BlendState.RenderTarget[0] = shadowBlendDesc;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&shadowPsoDesc, IID_PPV_ARGS(&mPSOs["shadow"])));
+	mPSOs["shadow"] = mRenderDevice->CreatePipelineState(shadowPsoDesc);
 
 
 	// Skinned Shadow
@@ -1101,7 +1664,7 @@ void PortfolioGameApp::BuildPSOs()
 	};
 	PlayerShadowPsoDesc.DepthStencilState = shadowDSS;
 	PlayerShadowPsoDesc.BlendState.RenderTarget[0] = shadowBlendDesc;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&PlayerShadowPsoDesc, IID_PPV_ARGS(&mPSOs["Player_shadow"])));
+	mPSOs["Player_shadow"] = mRenderDevice->CreatePipelineState(PlayerShadowPsoDesc);
 	
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC MonsterShadowPsoDesc = PlayerShadowPsoDesc;
 	MonsterShadowPsoDesc.VS =
@@ -1110,10 +1673,33 @@ void PortfolioGameApp::BuildPSOs()
 		mShaders["monsterVS"]->GetBufferSize()
 	};
 	
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&MonsterShadowPsoDesc, IID_PPV_ARGS(&mPSOs["Monster_shadow"])));
+	mPSOs["Monster_shadow"] = mRenderDevice->CreatePipelineState(MonsterShadowPsoDesc);
 }
 
 
+void PortfolioGameApp::BuildDrawList()
+{
+	// In ePSO order
+	mDrawList.SetPipelineStates({
+		mPSOs["opaque"].Get(),
+		mPSOs["opaque_wireframe"].Get(),
+		mPSOs["opaque_instanced"].Get(),
+		mPSOs["opaque_instanced_wireframe"].Get(),
+		mPSOs["sky"].Get(),
+		mPSOs["UI"].Get(),
+		mPSOs["MonsterUI"].Get(),
+		mPSOs["Player"].Get(),
+		mPSOs["Player_wireframe"].Get(),
+		mPSOs["Monster"].Get(),
+		mPSOs["Player_shadow"].Get(),
+		mPSOs["Monster_shadow"].Get() });
+	mDrawList.SetRootParameters(
+		(UINT)eRootParameter::DrawConstants,
+		(UINT)eRootParameter::SkinnedCB,
+		(UINT)eRootParameter::BonePalette,
+		(UINT)eRootParameter::InstanceBuffer);
+}
+
 ///
 void PortfolioGameApp::BuildShapeGeometry()
 {
@@ -1152,26 +1738,31 @@ void PortfolioGameApp::BuildShapeGeometry()
 	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
 	boxSubmesh.StartIndexLocation = boxIndexOffset;
 	boxSubmesh.BaseVertexLocation = boxVertexOffset;
+	BoundingBox::CreateFromPoints(boxSubmesh.Bounds, box.Vertices.size(), &box.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
 
 	SubmeshGeometry gridSubmesh;
 	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
 	gridSubmesh.StartIndexLocation = gridIndexOffset;
 	gridSubmesh.BaseVertexLocation = gridVertexOffset;
+	BoundingBox::CreateFromPoints(gridSubmesh.Bounds, grid.Vertices.size(), &grid.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
 
 	SubmeshGeometry hpBarSubmesh;
 	hpBarSubmesh.IndexCount = (UINT)hpBar.Indices32.size();
 	hpBarSubmesh.StartIndexLocation = hpBarIndexOffset;
 	hpBarSubmesh.BaseVertexLocation = hpBarVertexOffset;
+	BoundingBox::CreateFromPoints(hpBarSubmesh.Bounds, hpBar.Vertices.size(), &hpBar.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
 
 	SubmeshGeometry sphereSubmesh;
 	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
 	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
 	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
+	BoundingBox::CreateFromPoints(sphereSubmesh.Bounds, sphere.Vertices.size(), &sphere.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
 
 	SubmeshGeometry cylinderSubmesh;
 	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
 	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
 	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
+	BoundingBox::CreateFromPoints(cylinderSubmesh.Bounds, cylinder.Vertices.size(), &cylinder.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
 
 	//
 	// Extract the vertex elements we are interested in and pack the
@@ -1242,11 +1833,9 @@ void PortfolioGameApp::BuildShapeGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	geo->VertexBufferGPU = mRenderDevice->CreateDefaultBuffer(vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->IndexBufferGPU = mRenderDevice->CreateDefaultBuffer(indices.data(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -1270,8 +1859,7 @@ void PortfolioGameApp::BuildShapeGeometry()
 		outUIVertices, outUIIndices, 
 		10.0f, 10.0f, 10, 10);
 	mPlayer.mUI.BuildGeometry(
-		md3dDevice.Get(),
-		mCommandList.Get(),
+		mRenderDevice.get(),
 		outUIVertices,
 		outUIIndices,
 		"SkillUI"
@@ -1282,7 +1870,7 @@ void PortfolioGameApp::BuildFbxGeometry()
 {
 	FBXGenerator fbxGen;
 
-	fbxGen.Begin(md3dDevice.Get(), mCommandList.Get(), mCbvHeap.Get());
+	fbxGen.Begin(mRenderDevice.get(), mCbvHeap.Get(), &mTextureManifest);
 
 	fbxGen.LoadFBXPlayer(mPlayer, mTexDiffuse, mTexNormal, mMaterials);
 	fbxGen.LoadFBXMonster(mMonster, mMonstersByZone, mTexDiffuse, mTexNormal, mMaterials);
@@ -1291,15 +1879,21 @@ void PortfolioGameApp::BuildFbxGeometry()
 	mMonster = mMonstersByZone[1].get();
 
 	//LoadFBXArchitecture();
-	fbxGen.LoadFBXArchitecture(mGeometries, mTexDiffuse, mTexNormal, mMaterials);
+	fbxGen.LoadFBXArchitecture(mGeometries, mOccluders, mTexDiffuse, mTexNormal, mMaterials);
 
 	fbxGen.End();
+
+	// Every texture has been resolved, keep what was cooked for the next run
+	if (mTextureManifest.IsDirty())
+		mTextureManifest.Save(TextureManifestFileName);
 }
 
 
 void PortfolioGameApp::LoadTextures()
 {
-	mTexDiffuse.Begin(md3dDevice.Get(), mCommandList.Get(), mCbvHeap.Get());
+	mTextureManifest.Load(TextureManifestFileName);
+
+	mTexDiffuse.Begin(mRenderDevice.get(), mCbvHeap.Get());
 
 	std::vector<std::string> texNames;
 	std::vector<std::wstring> texPaths;
@@ -1347,18 +1941,12 @@ void PortfolioGameApp::LoadTextures()
 
 	mTexDiffuse.End();
 
-	mTexNormal.Begin(md3dDevice.Get(), mCommandList.Get(), mCbvHeap.Get());
+	mTexNormal.Begin(mRenderDevice.get(), mCbvHeap.Get());
 
 	for (int i = 0; i < texPaths.size(); ++i)
 	{
-		std::wstring TextureNormalFileName;
-		TextureNormalFileName = texPaths[i].substr(0, texPaths[i].size() - 4);
-		TextureNormalFileName.append(L"_normal.jpg");
-
-		struct stat buffer;
-		std::string fileCheck;
-		fileCheck.assign(TextureNormalFileName.begin(), TextureNormalFileName.end());
-		if (stat(fileCheck.c_str(), &buffer) == 0)
+		const std::wstring& TextureNormalFileName = mTextureManifest.GetCompanion(texPaths[i], eTextureSlot::Normal);
+		if (!TextureNormalFileName.empty())
 		{
 			mTexNormal.SetTexture(
 				texNames[i],
@@ -1369,7 +1957,7 @@ void PortfolioGameApp::LoadTextures()
 	mTexNormal.End();
 
 	// Cube Map
-	mTexSkyCube.Begin(md3dDevice.Get(), mCommandList.Get(), mCbvHeap.Get());
+	mTexSkyCube.Begin(mRenderDevice.get(), mCbvHeap.Get());
 
 	mTexSkyCube.SetTexture("skyCubeMap", L"../Resource/Textures/snowcube1024.dds");
 	
@@ -1378,8 +1966,6 @@ void PortfolioGameApp::LoadTextures()
 
 void PortfolioGameApp::BuildMaterials()
 {
-	int MatIndex = mMaterials.GetSize();
-
 	std::vector<std::string> matName;
 	std::vector<XMFLOAT4> diffuses;
 	std::vector<XMFLOAT3> fresnels;
@@ -1494,21 +2080,41 @@ void PortfolioGameApp::BuildMaterials()
 
 	mMaterials.SetMaterial(
 		matName, diffuses, fresnels, roughnesses,
-		MatIndex, texIndices, texNormalIndices);
+		texIndices, texNormalIndices);
 
 	// CUBE MAP
 	mMaterials.SetMaterial(
 		"sky", XMFLOAT4(0.0f, 0.0f, 0.0f, 0.5f), XMFLOAT3(0.001f, 0.001f, 0.001f), 0.0f,
-		mMaterials.GetSize(), mTexSkyCubeOffset);
-	
+		mTexSkyCubeOffset);
+
+	// Wall material progression by zone
+	mWallMat[0] = mMaterials.Get("stone0");
+	mWallMat[1] = mMaterials.Get("ice0");
+	mWallMat[2] = mMaterials.Get("Transparency");
+	mWallMat[3] = mMaterials.Get("tundra0");
 }
 
 void PortfolioGameApp::BuildRenderItems()
 {
 	UINT objCBIndex = -1;
 
+	mSceneEngine = mRandom.Create(RandomStreams::Scene);
 	BuildLandscapeRitems(objCBIndex);
 
+	// Merge the static layers into instance batches
+	BuildInstanceBatches(RenderLayer::Opaque);
+	BuildInstanceBatches(RenderLayer::Architecture);
+	BuildStaticBVH();
+	BuildCollisionWorld();
+	BuildOccluders();
+	BuildLights();
+
+	std::wstring text = L"Instance batches: " + std::to_wstring(mStaticCullItems.size()) + L" static items in " +
+		std::to_wstring(mBatches[(int)RenderLayer::Opaque].size() + mBatches[(int)RenderLayer::Architecture].size()) + L" draws, " +
+		std::to_wstring(mStaticBVH.GetNodeCount()) + L" BVH nodes, " +
+		std::to_wstring(mOcclusion.GetTriangleCount()) + L" occluder triangles\n";
+	::OutputDebugString(text.c_str());
+
 	auto skyRitem = std::make_unique<RenderItem>();
 	XMStoreFloat4x4(&skyRitem->World, XMMatrixScaling(5000.0f, 5000.0f, 5000.0f));
 	skyRitem->TexTransform = MathHelper::Identity4x4();
@@ -1539,9 +2145,21 @@ void PortfolioGameApp::BuildRenderItems()
 		else if (i == 2)
 			monsterName = "NameMaw";
 
+		mMonstersByZone[i]->SetRandomStreams(mRandom, i);
+		mMonstersByZone[i]->SetCrowdPopulation(mCrowdPopulation);
+		mMonstersByZone[i]->SetRespawnDelay(mRespawnDelay);
 		mMonstersByZone[i]->BuildRenderItem(mMaterials, "monsterMat" + i);
 		mMonstersByZone[i]->mMonsterUI.BuildRenderItem(mGeometries, mMaterials, monsterName, mMonstersByZone[i]->GetNumberOfMonster());
 	}
+	mZoneScheduler.SetZoneCount((uint32_t)mMonstersByZone.size());
+
+	// Worst case per frame: every monster strikes in each of the steps a zone may take,
+	// plus the one attack the player's input starts
+	UINT monsterCount = 0;
+	for (auto& e : mMonstersByZone)
+		monsterCount += e->GetNumberOfMonster();
+	mHits.SetCapacity(monsterCount * FixedStep::MaxSteps + 1);
+	mZoneAllocations.assign(mMonstersByZone.size(), 0);
 }
 
 void PortfolioGameApp::BuildLandscapeRitems(UINT& objCBIndex)
@@ -1559,7 +2177,6 @@ void PortfolioGameApp::BuildLandscapeRitems(UINT& objCBIndex)
 		subRitem->IndexCount = subRitem->Geo->DrawArgs["grid"].IndexCount;
 		subRitem->StartIndexLocation = subRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 		subRitem->BaseVertexLocation = subRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
-		subRitem->Geo->DrawArgs["grid"].Bounds.Transform(subRitem->Bounds, XMLoadFloat4x4(&subRitem->World));
 
 		z *= -1.0f;
 		if (i > 1)
@@ -1576,6 +2193,7 @@ void PortfolioGameApp::BuildLandscapeRitems(UINT& objCBIndex)
 			if(i == 0)
 				subRitem->Mat = mMaterials.Get("ice0");
 		}
+		subRitem->Geo->DrawArgs["grid"].Bounds.Transform(subRitem->Bounds, XMLoadFloat4x4(&subRitem->World));
 		mRitems[(int)RenderLayer::Opaque].push_back(subRitem.get());
 		mAllRitems.push_back(std::move(subRitem));
 	}
@@ -1699,10 +2317,8 @@ void PortfolioGameApp::BuildLandscapeRitems(UINT& objCBIndex)
 
 	for (int i = 0; i < 10; ++i)
 	{
-		auto seed = std::chrono::system_clock::now().time_since_epoch().count();
-		std::mt19937 engine{ (unsigned int)seed };
 		std::uniform_int_distribution <> dis{ 15, 25 };
-		int x{ dis(engine) };
+		int x{ dis(mSceneEngine) };
 		treeX -= static_cast<float>(x);
 
 		XMMATRIX treeWorld = treeWorldSR * XMMatrixTranslation(treeX, 0.0f, -210.0f - static_cast<float>(x));
@@ -1861,10 +2477,8 @@ void PortfolioGameApp::BuildLandscapeRitems(UINT& objCBIndex)
 
 	for (int i = 0; i < 20; ++i)
 	{
-		auto seed = std::chrono::system_clock::now().time_since_epoch().count();
-		std::mt19937 engine{ (unsigned int)seed };
 		std::uniform_int_distribution <> dis{ 15, 25 };
-		int x{ dis(engine) };
+		int x{ dis(mSceneEngine) };
 		treeX += static_cast<float>(x);
 
 		XMMATRIX treeWorld = treeWorldSR * XMMatrixTranslation(treeX, 0.0f, 300.0f - static_cast<float>(x));
@@ -1961,83 +2575,249 @@ void PortfolioGameApp::BuildSubRitems(
 	subRitem->StartIndexLocation = subRitem->Geo->DrawArgs[subRitemName].StartIndexLocation;
 	subRitem->BaseVertexLocation = subRitem->Geo->DrawArgs[subRitemName].BaseVertexLocation;
 	subRitem->Geo->DrawArgs[subRitemName].Bounds.Transform(subRitem->Bounds, XMLoadFloat4x4(&subRitem->World));
+
+	auto occluder = mOccluders.find(subRitemName);
+	if (geoName == "Architecture" && occluder != mOccluders.end() && !occluder->second.empty())
+		subRitem->Occluder = &occluder->second;
 	mRitems[(int)subRtype].push_back(subRitem.get());
 	mAllRitems.push_back(std::move(subRitem));
 }
 
-
-///
-void PortfolioGameApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+// Groups the items of a layer by submesh and material
+void PortfolioGameApp::BuildInstanceBatches(RenderLayer layer)
 {
-	// For each render item...
-	for (size_t i = 0; i < ritems.size(); ++i)
-	{
-		auto ri = ritems[i];
-
-		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+	auto& batches = mBatches[(int)layer];
 
-		const int texOffset = 3;
-		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
-
-		cmdList->SetGraphicsRootDescriptorTable(0, tex);
+	for (auto& ri : mRitems[(int)layer])
+	{
+		auto it = std::find_if(batches.begin(), batches.end(), [ri](const InstanceBatch& b)
+		{
+			return b.Geo == ri->Geo && b.Mat == ri->Mat && b.PrimitiveType == ri->PrimitiveType &&
+				b.IndexCount == ri->IndexCount &&
+				b.StartIndexLocation == ri->StartIndexLocation &&
+				b.BaseVertexLocation == ri->BaseVertexLocation;
+		});
 
-		if (ri->Mat->NormalSrvHeapIndex >= 0)
+		if (it == batches.end())
 		{
-			UINT normalOffset = mTexNormalOffset + ri->Mat->NormalSrvHeapIndex;
-			CD3DX12_GPU_DESCRIPTOR_HANDLE normal(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-			normal.Offset(normalOffset, mCbvSrvDescriptorSize);
-			cmdList->SetGraphicsRootDescriptorTable(1, normal);
+			InstanceBatch batch;
+			batch.Mat = ri->Mat;
+			batch.Geo = ri->Geo;
+			batch.PrimitiveType = ri->PrimitiveType;
+			batch.IndexCount = ri->IndexCount;
+			batch.StartIndexLocation = ri->StartIndexLocation;
+			batch.BaseVertexLocation = ri->BaseVertexLocation;
+			batches.push_back(batch);
+			it = batches.end() - 1;
 		}
+		it->Instances.push_back(ri);
+	}
+
+	for (auto& b : batches)
+		b.InstanceCount = (UINT)b.Instances.size();
+}
 
-		if (ri->ObjCBIndex >= 0)
+// The batched items never move, their world bounds go in a BVH once
+void PortfolioGameApp::BuildStaticBVH()
+{
+	for (auto layer : { RenderLayer::Opaque, RenderLayer::Architecture })
+	{
+		for (auto& e : mRitems[(int)layer])
 		{
-			UINT cbvIndex = mObjCbvOffset + mCurrFrameResourceIndex * (UINT)mAllRitems.size() + ri->ObjCBIndex;
-			auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-			cbvHandle.Offset(cbvIndex, mCbvSrvDescriptorSize);
-			cmdList->SetGraphicsRootDescriptorTable(texOffset, cbvHandle);
+			mStaticCullItems.push_back(e);
+			mStaticBoxes.push_back(ToCullBox(e->Bounds));
 		}
+	}
+
+	mStaticBVH.Build(mStaticBoxes.data(), (uint32_t)mStaticBoxes.size());
+}
+
+// The architecture never moves, its occluder boxes go to world space once
+void PortfolioGameApp::BuildCollisionWorld()
+{
+	// Architecture bounds come from the submesh bounds placed by their items
+	std::vector<CullBox> boxes;
+	for (auto& e : mRitems[(int)RenderLayer::Architecture])
+		boxes.push_back(ToCullBox(e->Bounds));
 
-		UINT matCbvIndex = mMatCbvOffset + mCurrFrameResourceIndex * mMaterials.GetSize() + ri->Mat->MatCBIndex;
-		auto matCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		matCbvHandle.Offset(matCbvIndex, mCbvSrvDescriptorSize);
+	mCollision.Build(boxes.data(), (uint32_t)boxes.size());
 
-		UINT skinnedIndex = mChaCbvOffset + mCurrFrameResourceIndex * mPlayer.GetAllRitemsSize() + ri->PlayerCBIndex;
-		auto skinCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		skinCbvHandle.Offset(skinnedIndex, mCbvSrvDescriptorSize);
+	// Monsters path around the same boxes, 4 units per cell over the whole ground
+	mFlowField.Build(boxes.data(), (uint32_t)boxes.size(), -500.0f, -500.0f, 500.0f, 500.0f, 4.0f, 2.0f);
+}
 
-		UINT monsterIndex = mMonsterCbvOffset + mCurrFrameResourceIndex * mMonster->GetAllRitemsSize() + ri->MonsterCBIndex;
-		auto monsterCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		monsterCbvHandle.Offset(monsterIndex, mCbvSrvDescriptorSize);
+void PortfolioGameApp::BuildOccluders()
+{
+	mOcclusion.ClearOccluders();
+	for (auto& e : mRitems[(int)RenderLayer::Architecture])
+	{
+		if (e->Occluder == nullptr)
+			continue;
 
-		UINT uiIndex = mUICbvOffset + mCurrFrameResourceIndex * mPlayer.mUI.GetSize() + ri->ObjCBIndex;
-		auto uiCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		uiCbvHandle.Offset(uiIndex, mCbvSrvDescriptorSize);
+		for (auto& box : *e->Occluder)
+			mOcclusion.AddOccluder(box, &e->World.m[0][0]);
+	}
+}
 
-		UINT monsterUIIndex = mMonsterUICbvOffset + mCurrFrameResourceIndex * mMonster->mMonsterUI.GetSize() + ri->ObjCBIndex;
-		auto monsterUICbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		monsterUICbvHandle.Offset(monsterUIIndex, mCbvSrvDescriptorSize);
+// A torch at each corner of the houses
+void PortfolioGameApp::BuildLights()
+{
+	auto& house = mGeometries["Architecture"]->DrawArgs["house"];
 
-		
-		cmdList->SetGraphicsRootDescriptorTable(texOffset + 1, matCbvHandle);
-		cmdList->SetGraphicsRootDescriptorTable(texOffset + 5, uiCbvHandle);
-		cmdList->SetGraphicsRootDescriptorTable(texOffset + 6, monsterUICbvHandle);
+	mTorchLights.clear();
+	for (auto& e : mRitems[(int)RenderLayer::Architecture])
+	{
+		if (e->Geo != mGeometries["Architecture"].get() || e->StartIndexLocation != house.StartIndexLocation)
+			continue;
 
-		if (ri->PlayerCBIndex >= 0)
+		const BoundingBox& bounds = e->Bounds;
+		for (int corner = 0; corner < 4; ++corner)
 		{
-			cmdList->SetGraphicsRootDescriptorTable(texOffset + 3, skinCbvHandle);
+			Light light;
+			light.Strength = { 1.5f, 0.9f, 0.4f };
+			light.FalloffStart = 5.0f;
+			light.FalloffEnd = 40.0f;
+			light.Position = {
+				bounds.Center.x + (corner & 1 ? 1.0f : -1.0f) * (bounds.Extents.x + 2.0f),
+				bounds.Center.y - bounds.Extents.y + 10.0f,
+				bounds.Center.z + (corner & 2 ? 1.0f : -1.0f) * (bounds.Extents.z + 2.0f) };
+			light.SpotPower = 0.0f;
+			mTorchLights.push_back(light);
 		}
-		else if (ri->MonsterCBIndex >= 0)
+	}
+
+	// The most lights a frame can have, so UpdateLights never grows a buffer
+	size_t maxLights = mTorchLights.size() + MaxHitFlashes;
+	mHitFlashes.reserve(MaxHitFlashes);
+	mFrameLights.reserve(maxLights);
+	mFrameLightBounds.reserve(maxLights);
+	mLightClusters.Reserve((uint32_t)maxLights);
+}
+
+///
+void PortfolioGameApp::AddRenderItems(const std::vector<RenderItem*>& ritems, RenderLayer layer, ePSO pso)
+{
+	XMMATRIX view = mPlayer.mCamera.GetView();
+
+	// For each render item...
+	for (size_t i = 0; i < ritems.size(); ++i)
+	{
+		auto ri = ritems[i];
+		if (!ri->Visible)
+			continue;
+
+		DrawCommand command;
+		command.Layer = LayerDrawOrder[(int)layer];
+		command.PSO = (UINT)pso;
+		command.Geo = ri->Geo;
+		command.VertexBuffer = ri->Geo->VertexBufferView();
+		command.IndexBuffer = ri->Geo->IndexBufferView();
+		command.Mat = ri->Mat;
+		command.Depth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&ri->Bounds.Center), view)) / mMainPassCB.FarZ;
+		command.KeepOrder = layer == RenderLayer::UI;
+		command.PrimitiveType = ri->PrimitiveType;
+		command.IndexCount = ri->IndexCount;
+		command.StartIndexLocation = ri->StartIndexLocation;
+		command.BaseVertexLocation = ri->BaseVertexLocation;
+
+		// ObjIndex addresses the object, UI or monster UI buffer depending on the PSO
+		command.Constants.ObjIndex = (UINT)ri->ObjCBIndex;
+		command.Constants.MatIndex = (UINT)ri->Mat;
+
+		if (ri->PlayerCBIndex >= 0)
 		{
-			cmdList->SetGraphicsRootDescriptorTable(texOffset + 4, monsterCbvHandle);
+			command.SkinnedCB = mPlayer.GetSkinnedCBAddress(ri->PlayerCBIndex);
+			command.Palette = mPlayer.GetPaletteAddress();
 		}
 
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		mDrawList.Add(command);
+		mDrawStats.DrawCalls++;
+		mDrawStats.LayerDrawCalls[(int)layer]++;
+		mDrawStats.Instances++;
+	}
+}
+
+void PortfolioGameApp::AddInstanceBatches(
+	const std::vector<InstanceBatch>& batches,
+	RenderLayer layer,
+	ePSO pso,
+	D3D12_GPU_VIRTUAL_ADDRESS palette)
+{
+	for (auto& b : batches)
+	{
+		// Every instance was culled
+		if (b.InstanceCount == 0)
+			continue;
+
+		DrawCommand command;
+		command.Layer = LayerDrawOrder[(int)layer];
+		command.PSO = (UINT)pso;
+		command.Geo = b.Geo;
+		command.VertexBuffer = b.Geo->VertexBufferView();
+		command.IndexBuffer = b.Geo->IndexBufferView();
+		command.Mat = b.Mat;
+		command.PrimitiveType = b.PrimitiveType;
+		command.IndexCount = b.IndexCount;
+		command.StartIndexLocation = b.StartIndexLocation;
+		command.BaseVertexLocation = b.BaseVertexLocation;
+		command.InstanceCount = b.InstanceCount;
+
+		// ObjIndex is the first instance, each instance carries its own material
+		command.Constants.ObjIndex = b.InstanceBase;
+		command.Constants.MatIndex = (UINT)b.Mat;
+		command.Instances = b.InstanceAddress;
+		command.Palette = palette;
+
+		mDrawList.Add(command);
+		mDrawStats.DrawCalls++;
+		mDrawStats.LayerDrawCalls[(int)layer]++;
+		mDrawStats.Instances += b.InstanceCount;
 	}
 }
 
+// Everything a worker list needs before its first draw; command lists inherit no state.
+// Returns the number of root parameters bound, for the draw stats.
+UINT PortfolioGameApp::SetFrameState(CommandRecorder& recorder,
+	D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil)
+{
+	recorder.SetViewport(mScreenViewport, mScissorRect);
+
+	// Specify the buffers we are going to render to.
+	recorder.SetRenderTarget(renderTarget, depthStencil);
+	recorder.SetDescriptorHeap(mCbvHeap.Get());
+	recorder.SetRootSignature(mRootSignature.Get());
+
+	UINT bindings = 0;
+	auto bindTable = [&](eRootParameter parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+	{
+		recorder.SetRootDescriptorTable((UINT)parameter, baseDescriptor);
+		++bindings;
+	};
+	auto bindBuffer = [&](eRootParameter parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+	{
+		recorder.SetRootShaderResource((UINT)parameter, address);
+		++bindings;
+	};
+
+	// Per-frame bindings; draws only change root constants from here on
+	bindTable(eRootParameter::TextureTable, mRenderDevice->GetGPUDescriptor(mCbvHeap.Get(), 0));
+	bindBuffer(eRootParameter::MaterialBuffer, mCurrFrameResource->MaterialBuffer->GetGPUAddress());
+	bindBuffer(eRootParameter::ObjectBuffer, mCurrFrameResource->ObjectCB->GetGPUAddress());
+	bindBuffer(eRootParameter::UIBuffer, mCurrFrameResource->UICB->GetGPUAddress());
+	bindBuffer(eRootParameter::MonsterUIBuffer, mCurrFrameResource->MonsterUICB->GetGPUAddress());
+	recorder.SetRootConstantBuffer((UINT)eRootParameter::PassCB, mPassCBAddress);
+	++bindings;
+	bindBuffer(eRootParameter::LightBuffer, mLightBufferAddress);
+	bindBuffer(eRootParameter::LightClusterBuffer, mLightClusterAddress);
+	bindBuffer(eRootParameter::LightIndexBuffer, mLightIndexAddress);
+
+	// Sky cube map and the shadow stencil reference are per frame as well
+	bindTable(eRootParameter::CubeMapTable, mRenderDevice->GetGPUDescriptor(mCbvHeap.Get(), mTexSkyCubeOffset));
+	recorder.SetStencilRef(0);
+
+	return bindings;
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> PortfolioGameApp::GetStaticSamplers()
 {
 	const CD3DX12_STATIC_SAMPLER_DESC pointWrap(
@@ -7,6 +7,76 @@ using namespace DirectX;
 using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
+const std::string TextureManifestFileName = "../Resource/Textures/TextureManifest.txt";
+
+enum class eRootParameter : int
+{
+	DrawConstants,
+	TextureTable,
+	CubeMapTable,
+	MaterialBuffer,
+	ObjectBuffer,
+	UIBuffer,
+	MonsterUIBuffer,
+	PassCB,
+	SkinnedCB,
+	BonePalette,
+	InstanceBuffer,
+	LightBuffer,
+	LightClusterBuffer,
+	LightIndexBuffer,
+	Count
+};
+
+// Pipeline states of the DrawList, the PSO field of the draw key
+enum class ePSO : int
+{
+	Opaque,
+	OpaqueWireframe,
+	OpaqueInstanced,
+	OpaqueInstancedWireframe,
+	Sky,
+	UI,
+	MonsterUI,
+	Player,
+	PlayerWireframe,
+	Monster,
+	PlayerShadow,
+	MonsterShadow,
+	Count
+};
+
+// CPU cost of recording one frame
+struct DrawStats
+{
+	float RecordTime = 0.0f;
+	UINT DrawCalls = 0;
+	UINT LayerDrawCalls[(int)RenderLayer::Count] = {};
+	UINT Instances = 0;
+	UINT RootBindings = 0;
+	UINT CommandLists = 0;
+	UINT64 UploadBytes = 0;
+};
+
+// Items and monster instances tested against the camera frustum, then the occluders
+struct CullStats
+{
+	float CullTime = 0.0f;
+	float OcclusionTime = 0.0f;
+	UINT Total = 0;
+	UINT Visible = 0;
+	UINT Occluded = 0;
+};
+
+// Short point light where a hit landed
+struct HitFlash
+{
+	DirectX::XMFLOAT3 Position;
+	float Age = 0.0f;
+};
+
+// Flashes alive at once, hits past it get none rather than growing the list mid-frame
+const size_t MaxHitFlashes = 64;
 
 class Textures;
 class Materials;
@@ -22,35 +92,66 @@ public:
 	~PortfolioGameApp();
 
 	virtual bool Initialize()override;
+	// Instead of Initialize, for RunHeadless: builds the scene without a window or a device
+	void InitializeHeadless();
+
+	// Before Initialize. The recording is written when the app closes.
+	void StartRecording(const std::string& fileName);
+	bool LoadReplay(const std::string& fileName);
+	// Crowd members per zone, simulated alongside the monsters
+	void SetCrowdPopulation(UINT population);
+	// Monster simulation steps per second in the player's zone and in the others,
+	// independent of the frame rate
+	void SetSimulationRates(float activeRate, float backgroundRate);
+	// ms a background zone may take per frame, 0 for no limit
+	void SetZoneBudget(float budget);
+	// Seconds before a dead monster's slot spawns again, 0 to keep the dead down
+	void SetRespawnDelay(float seconds);
+
+	// Benchmark without a GPU: simulates and generates frameCount frames without submitting them.
+	// Runs after InitializeHeadless, or after Initialize to count the same frames with a device.
+	// False when a frame after the warm-up allocated, in builds that count allocations.
+	bool RunHeadless(UINT frameCount, const std::string& fileName);
 
 private:
 	virtual void OnResize()override;
+	void UpdateProjection();
 	virtual void Update(const GameTimer& gt)override;
 	virtual void Draw(const GameTimer& gt)override;
+	void DrawHeadless(CommandCounts& counts);
+	void CollectDraws();
+	void SplitDrawList(UINT& listCount, UINT& drawsPerList) const;
 
 	virtual void OnMouseDown(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
+	// The statistics of the last drawn frame, built only when the caption shows them
+	virtual void UpdateFrameStatsText()override;
+	// Keys down now and the mouse look since the last frame, all up when headless
+	void PollInput();
 	void OnKeyboardInput(const GameTimer& gt);
-	void checkCollision(
-		const std::vector<RenderItem*>& rItems,
-		const BoundingBox &playerBoundForward,
-		const BoundingBox &playerBoundBackward,
-		bool &isForward,
-		bool &isBackward,
-		const float &dt);
+	// Walks the player along its look, sliding along the level where it collides
+	void MovePlayer(float distance);
 
 	void UpdateObjectCBs(const GameTimer& gt);
+	void RenderOccluders();
+	void UpdateLights(const GameTimer& gt);
+	void CullRenderItems(const GameTimer& gt);
+	void UpdateInstanceBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
-	void UpdateMaterialCB(const GameTimer& gt);
+	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateCharacterCBs(const GameTimer & gt);
+	// Deals the hits the player and the zones queued this tick
+	void ResolveHits();
 	void UpdateObjectShadows(const GameTimer & gt);
+	// Since startup, on every thread
+	uint64_t GetMonsterAllocations() const;
 
+	// Everything Initialize and InitializeHeadless share, created through mRenderDevice
+	void BuildScene();
 	void LoadTextures();
 	void BuildDescriptorHeaps();
 	void BuildTextureBufferViews();
-	void BuildConstantBufferViews(int mCbvOffset, UINT ItemSize, UINT ConstantsSize, eUploadBufferIndex e);
-	void BuildConstantBufferViews();
 	void BuildRootSignature();
 	void BuildShadersAndInputLayout();
 	void BuildShapeGeometry();
@@ -63,6 +164,7 @@ private:
 
 	void BuildMaterials();
 	void BuildPSOs();
+	void BuildDrawList();
 	void BuildFrameResources();
 	void BuildRenderItems();
 	void BuildLandscapeRitems(UINT& objCBIndex);
@@ -74,7 +176,19 @@ private:
 		UINT &objCBIndex,
 		FXMMATRIX& worldTransform,
 		CXMMATRIX& texTransform);
-	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void BuildInstanceBatches(RenderLayer layer);
+	void BuildStaticBVH();
+	void BuildCollisionWorld();
+	void BuildOccluders();
+	void BuildLights();
+	void AddRenderItems(const std::vector<RenderItem*>& ritems, RenderLayer layer, ePSO pso);
+	void AddInstanceBatches(
+		const std::vector<InstanceBatch>& batches,
+		RenderLayer layer,
+		ePSO pso,
+		D3D12_GPU_VIRTUAL_ADDRESS palette = 0);
+	UINT SetFrameState(CommandRecorder& recorder,
+		D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil);
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
 private:
@@ -96,6 +210,7 @@ private:
 	
 	// Pass
 	PassConstants mMainPassCB;
+	D3D12_GPU_VIRTUAL_ADDRESS mPassCBAddress = 0;
 
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
@@ -103,6 +218,42 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitems[(int)RenderLayer::Count];
 
+	// Static layers merged by geometry and material
+	std::vector<InstanceBatch> mBatches[(int)RenderLayer::Count];
+
+	// The batched items in a BVH, everything else is tested flat every frame
+	Frustum mFrustum;
+	CullBVH mStaticBVH;
+	std::vector<RenderItem*> mStaticCullItems;
+	std::vector<CullBox> mStaticBoxes;
+	std::vector<uint32_t> mVisibleStatic;
+	std::vector<RenderItem*> mDynamicCullItems;
+	std::vector<CullBox> mDynamicBoxes;
+	std::vector<uint8_t> mDynamicVisible;
+	CullStats mCullStats;
+
+	// Architecture boxes for player movement; the walls move between rounds and are refreshed every frame
+	CollisionWorld mCollision;
+	std::vector<CullBox> mWallBoxes;
+	std::vector<SweepHit> mPlayerContacts;
+	// Paths toward the player around the architecture, shared by every zone
+	FlowField mFlowField;
+
+	// Boxes cooked from the architecture meshes by submesh name, rasterized on the CPU every frame
+	std::unordered_map<std::string, std::vector<CullBox>> mOccluders;
+	OcclusionCuller mOcclusion;
+
+	// Point and spot lights, binned into view clusters every frame. SpotPower 0 marks a point light.
+	LightClusters mLightClusters;
+	std::vector<Light> mTorchLights;
+	std::vector<HitFlash> mHitFlashes;
+	std::vector<DirectX::XMFLOAT3> mHitPositions;
+	std::vector<Light> mFrameLights;
+	std::vector<LightBounds> mFrameLightBounds;
+	D3D12_GPU_VIRTUAL_ADDRESS mLightBufferAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mLightClusterAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mLightIndexAddress = 0;
+
 	// Skill Icon time
 	float HitTime[(int)eUIList::Count];
 	float DelayTime[(int)eUIList::Count];
@@ -111,16 +262,28 @@ private:
 	//UINT mTexDiffuseOffset = 0;
 	UINT mTexNormalOffset = 0;
 	UINT mTexSkyCubeOffset = 0;
-	UINT mObjCbvOffset = 0;
-	UINT mPassCbvOffset = 0;
-	UINT mMatCbvOffset = 0;
-	UINT mChaCbvOffset = 0;
-	UINT mMonsterCbvOffset = 0;
-	UINT mUICbvOffset = 0;
-	UINT mMonsterUICbvOffset = 0;
 
 	UINT mCbvSrvDescriptorSize = 0;
 
+	DrawList mDrawList;
+	DrawStats mDrawStats;
+	std::vector<ID3D12CommandList*> mSubmitLists;
+	// One per worker list in headless frames
+	std::vector<NullCommandRecorder> mNullRecorders;
+	// Root bindings each worker list made for the frame state
+	std::vector<UINT> mFrameBindings;
+
+	// Input of the current frame, and the mouse look gathered for the next one
+	FrameInput mFrameInput;
+	FrameInput mPendingInput;
+	// No window and no keyboard: frames see neutral input unless a replay supplies it
+	bool mHeadless = false;
+	Replay mReplay;
+	std::string mReplayFileName;
+
+	RandomStreams mRandom;
+	std::mt19937 mSceneEngine;
+
 	bool mIsWireframe = false;
 	bool mFbxWireframe = false;
 	bool mCameraDetach = false; // True - Camera Move with player
@@ -132,10 +295,26 @@ private:
 	Player mPlayer;
 	Monster* mMonster;
 	std::vector<std::unique_ptr<Monster>> mMonstersByZone;
-	UINT mZoneIndex;
+	// Starts with mMonster in zone 1
+	UINT mZoneIndex = 1;
+	UINT mCrowdPopulation = 0;
+	float mRespawnDelay = 0.0f;
+	ZoneScheduler mZoneScheduler;
+	HitQueue mHits;
+	UINT mHitCount = 0;
+	// Heap allocations made by the monster update: per zone on the workers, and on the main thread
+	std::vector<uint64_t> mZoneAllocations;
+	uint64_t mMonsterAllocations = 0;
+
+	std::unique_ptr<ThreadPool> mThreadPool;
+	std::unique_ptr<TextureUploader> mTextureUploader;
+	// D3D12RenderDevice, or NullRenderDevice in headless runs
+	std::unique_ptr<RenderDevice> mRenderDevice;
 
 	Textures mTexDiffuse;
 	Textures mTexNormal;
 	Textures mTexSkyCube;
 	Materials mMaterials;
+	TextureManifest mTextureManifest;
+	MaterialHandle mWallMat[4];
 };
\ No newline at end of file
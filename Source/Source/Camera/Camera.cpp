@@ -92,6 +92,13 @@ XMMATRIX Camera::GetView() const
 {
 	return XMLoadFloat4x4(&mView);
 }
+Frustum Camera::GetFrustum() const
+{
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, GetView() * GetProj());
+	return Frustum::FromViewProj(&viewProj.m[0][0]);
+}
+
 XMMATRIX Camera::GetProj() const
 {
 	return XMLoadFloat4x4(&mProj);
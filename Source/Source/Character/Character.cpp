@@ -12,8 +12,7 @@ Character::~Character()
 }
 
 void Character::BuildGeometry(
-	ID3D12Device * device,
-	ID3D12GraphicsCommandList* cmdList,
+	RenderDevice* device,
 	const std::vector<CharacterVertex>& inVertices,
 	const std::vector<std::uint32_t>& inIndices,
 	const SkinnedData& inSkinInfo,
@@ -41,8 +40,8 @@ void Character::BuildGeometry(
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), inIndices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList, inVertices.data(), vbByteSize, geo->VertexBufferUploader);
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList, inIndices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->VertexBufferGPU = device->CreateDefaultBuffer(inVertices.data(), vbByteSize, geo->VertexBufferUploader);
+	geo->IndexBufferGPU = device->CreateDefaultBuffer(inIndices.data(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(CharacterVertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -92,6 +91,13 @@ void Character::BuildGeometry(
 	box.Center.y = 3.0f;
 
 	mInitBoundsBox = box;
+	mSkinnedBounds.Build(inVertices.data(), vCount, (std::min)(inSkinInfo.BoneCount(), gBonePaletteSize));
 
 	mGeometry = std::move(geo);
 }
+
+void Character::UpdateSkinnedBounds(const std::vector<XMFLOAT4X4>& palette, FXMMATRIX world, BoundingBox& bounds) const
+{
+	if (palette.empty() || !mSkinnedBounds.Compute(palette.data(), world, bounds))
+		mInitBoundsBox.Transform(bounds, world);
+}
@@ -1,8 +1,11 @@
 
+#include <cmath>
 #include <random>
-#include <chrono>
 #include "GameTimer.h"
 #include "Monster.h"
+#include "OcclusionCuller.h"
+#include "FlowField.h"
+#include "HitQueue.h"
 
 using namespace DirectX;
 Monster::Monster()
@@ -27,6 +30,18 @@ Monster::Monster()
 
 		mMonsterInfo.push_back(M);
 	}
+	mPrevTransforms.resize(numOfCharacter);
+
+	// Everything a monster needs during play is sized here, spawns and deaths only reuse it
+	mStates.assign(numOfCharacter, eMonsterState::Alive);
+	mSpawnPoints.resize(numOfCharacter);
+	mFreeSlots.resize(numOfCharacter);
+	mFreeTimes.resize(numOfCharacter);
+	mDeadSlots.reserve(numOfCharacter);
+	mUIWorlds.resize(numOfCharacter);
+	mUIEyeLeft.resize(numOfCharacter);
+	mHitPositions.reserve(4 * numOfCharacter);
+	mQueryIds.reserve(numOfCharacter);
 }
 Monster::~Monster()
 {
@@ -44,14 +59,29 @@ CharacterInfo & Monster::GetCharacterInfo(int cIndex)
 
 DirectX::XMMATRIX Monster::GetWorldTransformMatrix(int i) const
 {
-	auto T = mMonsterInfo[i].mMovement.GetWorldTransformInfo();
-	XMMATRIX P = XMMatrixTranslation(T.Position.x, T.Position.y, T.Position.z);
-	XMMATRIX R = XMLoadFloat4x4(&T.Rotation);
-	XMMATRIX S = XMMatrixScaling(T.Scale.x, T.Scale.y, T.Scale.z);
+	XMVECTOR scale, rotation, position;
+	GetDrawnTransform(i, scale, rotation, position);
+
+	XMMATRIX P = XMMatrixTranslationFromVector(position);
+	XMMATRIX R = XMMatrixRotationQuaternion(rotation);
+	XMMATRIX S = XMMatrixScalingFromVector(scale);
 
 	return S * R * P;
 }
 
+void Monster::GetDrawnTransform(UINT cIndex, XMVECTOR& scale, XMVECTOR& rotation, XMVECTOR& position) const
+{
+	// Between the last two simulation steps
+	auto T = mMonsterInfo[cIndex].mMovement.GetWorldTransformInfo();
+	auto& prevT = mPrevTransforms[cIndex];
+	position = XMVectorLerp(XMLoadFloat3(&prevT.Position), XMLoadFloat3(&T.Position), mInterpolation);
+	rotation = XMQuaternionSlerp(
+		XMQuaternionRotationMatrix(XMLoadFloat4x4(&prevT.Rotation)),
+		XMQuaternionRotationMatrix(XMLoadFloat4x4(&T.Rotation)),
+		mInterpolation);
+	scale = XMLoadFloat3(&T.Scale);
+}
+
 UINT Monster::GetNumberOfMonster() const
 {
 	return numOfCharacter;
@@ -67,9 +97,25 @@ UINT Monster::GetUISize() const
 	return ret;
 }
 
-UINT Monster::GetAllRitemsSize() const
+UINT Monster::GetVisibleInstanceCount() const
+{
+	return mVisibleInstanceCount;
+}
+
+UINT Monster::GetOccludedInstanceCount() const
+{
+	return mOccludedInstanceCount;
+}
+
+void Monster::TakeHitPositions(std::vector<XMFLOAT3>& outPositions)
 {
-	return (UINT)mAllRitems.size();
+	outPositions.insert(outPositions.end(), mHitPositions.begin(), mHitPositions.end());
+	mHitPositions.clear();
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS Monster::GetPaletteAddress() const
+{
+	return mPaletteAddress;
 }
 
 const std::vector<RenderItem*> Monster::GetRenderItem(RenderLayer Type) const
@@ -77,6 +123,11 @@ const std::vector<RenderItem*> Monster::GetRenderItem(RenderLayer Type) const
 	return mRitems[(int)Type];
 }
 
+const std::vector<InstanceBatch>& Monster::GetInstanceBatches(RenderLayer Type) const
+{
+	return mBatches[(int)Type];
+}
+
 
 bool Monster::isClipEnd(std::string clipName, int i)
 {
@@ -94,29 +145,39 @@ bool Monster::isAllDie()
 
 void Monster::Damage(int damage, XMVECTOR Position, XMVECTOR Look)
 {
-	// Player Attack Range // Radius - 5.0f
+	// Player Attack Range // Radius - 5.0f, against the posed bounds
 	XMVECTOR HitTargetv = XMVectorAdd(Position, Look * 5.0f);
+	BoundingSphere hitSphere;
+	XMStoreFloat3(&hitSphere.Center, HitTargetv);
+	hitSphere.Radius = 5.0f;
+	mGrid.QueryRadius(XMVectorGetX(HitTargetv), XMVectorGetZ(HitTargetv), 5.0f + mHitReach, mQueryIds);
 
 	// Damage
-	for (UINT cIndex = 0; cIndex < numOfCharacter; ++cIndex)
+	for (UINT cIndex : mQueryIds)
 	{
 		XMVECTOR MonsterPos = mMonsterInfo[cIndex].mMovement.GetPlayerPosition();
 
 		if (mMonsterInfo[cIndex].isDeath) continue;
 
-		if (MathHelper::getDistance(HitTargetv, MonsterPos) < 5.0f)
+		if (mMonsterInfo[cIndex].mBoundingBox.Intersects(hitSphere))
 		{
 			if (mMonsterInfo[cIndex].mHealth >= 0)
 				mSkinnedModelInst[cIndex]->TimePos = 0.0f;
 
 			SetClipName("HitReaction", cIndex);
 			mMonsterInfo[cIndex].mHealth -= damage;
+
+			XMFLOAT3 hitPosition;
+			XMStoreFloat3(&hitPosition, MonsterPos);
+			mHitPositions.push_back(hitPosition);
 		}
 		if (mMonsterInfo[cIndex].mHealth < 0)
 			mMonsterInfo[cIndex].mHealth = 0;
 
 		mMonsterUI.SetDamageScale(cIndex, static_cast<float>(mMonsterInfo[cIndex].mHealth) / static_cast<float>(mMonsterInfo[cIndex].mFullHealth));
 	}
+
+	mCrowd.Damage(XMVectorGetX(HitTargetv), XMVectorGetZ(HitTargetv), 5.0f, static_cast<float>(damage));
 }
 
 
@@ -133,6 +194,38 @@ void Monster::SetClipName(const std::string& inClipName, int cIndex)
 	}
 }
 
+void Monster::SetRandomStreams(const RandomStreams& streams, UINT zone)
+{
+	mZone = zone;
+	mSpawnEngine = streams.Create(RandomStreams::MonsterSpawn, zone);
+	mAIEngine = streams.Create(RandomStreams::MonsterAI, zone);
+}
+
+void Monster::SetCrowdPopulation(UINT population)
+{
+	mCrowdPopulation = population;
+}
+
+void Monster::SetRespawnDelay(float seconds)
+{
+	mRespawnDelay = seconds;
+}
+
+eMonsterState Monster::GetState(UINT cIndex) const
+{
+	return mStates[cIndex];
+}
+
+UINT Monster::GetFreeCount() const
+{
+	return mFreeCount;
+}
+
+UINT Monster::GetRespawnCount() const
+{
+	return mRespawnCount;
+}
+
 void Monster::SetMaterialName(const std::string & inMaterialName)
 {
 	MaterialName = inMaterialName;
@@ -145,8 +238,7 @@ void Monster::SetMonsterIndex(int inMonsterIndex)
 
 
 void Monster::BuildGeometry(
-	ID3D12Device * device,
-	ID3D12GraphicsCommandList* cmdList,
+	RenderDevice* device,
 	const std::vector<CharacterVertex>& inVertices,
 	const std::vector<std::uint32_t>& inIndices,
 	const SkinnedData& inSkinInfo,
@@ -166,7 +258,7 @@ void Monster::BuildGeometry(
 	}
 
 	Character::BuildGeometry(
-		device, cmdList,
+		device,
 		inVertices, inIndices,
 		mSkinnedInfo, geoName);
 	
@@ -175,7 +267,6 @@ void Monster::BuildRenderItem(
 	Materials& mMaterials,
 	std::string matrialPrefix)
 {
-	int chaIndex = 0;
 	auto boneName = mSkinnedInfo.GetBoneName();
 	int BoneCount = boneName.size();
 
@@ -217,14 +308,12 @@ void Monster::BuildRenderItem(
 		CharacterInfo cInfo;
 
 		// Monster - Random Position
-		auto seed = std::chrono::system_clock::now().time_since_epoch().count();
-		std::mt19937 engine{ (unsigned int)seed };
 		std::uniform_int_distribution <> disX{ 0, xRange }; // monster Area
 		std::uniform_int_distribution <> disz{ 0, zRange }; // monster Area
 
 		//Generate a random integer
-		int x{ disX(engine) };
-		int z{ disz(engine) };
+		int x{ disX(mSpawnEngine) };
+		int z{ disz(mSpawnEngine) };
 
 		XMVECTOR monsterPos = XMVectorSet(static_cast<float>(x + xOffset), 0.0f, static_cast<float>(z + zOffset), 0.0f);
 
@@ -237,316 +326,551 @@ void Monster::BuildRenderItem(
 		}
 
 		cInfo.mMovement.SetPlayerPosition(monsterPos);
-
-		// Character Mesh
-		for (int submeshIndex = 0; submeshIndex < BoneCount - 1; ++submeshIndex)
-		{
-			std::string SubmeshName = boneName[submeshIndex];
-
-			auto MonsterRitem = std::make_unique<RenderItem>();
-			XMStoreFloat4x4(&MonsterRitem->World, XMMatrixScaling(4.0f + BossScale, 4.0f + BossScale, 4.0f + BossScale));
-			MonsterRitem->TexTransform = MathHelper::Identity4x4();
-			MonsterRitem->Mat = mMaterials.Get(MaterialName);
-			MonsterRitem->Geo = GetMeshGeometry();
-			MonsterRitem->NumFramesDirty = gNumFrameResources;
-			MonsterRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-			MonsterRitem->StartIndexLocation = MonsterRitem->Geo->DrawArgs[SubmeshName].StartIndexLocation;
-			MonsterRitem->BaseVertexLocation = MonsterRitem->Geo->DrawArgs[SubmeshName].BaseVertexLocation;
-			MonsterRitem->IndexCount = MonsterRitem->Geo->DrawArgs[SubmeshName].IndexCount;
-			MonsterRitem->SkinnedModelInst = mSkinnedModelInst[cIndex].get();
-			MonsterRitem->MonsterCBIndex = chaIndex++;
-
-			auto shadowedObjectRitem = std::make_unique<RenderItem>();
-			*shadowedObjectRitem = *MonsterRitem;
-			shadowedObjectRitem->Mat = mMaterials.Get("shadow0");
-			shadowedObjectRitem->NumFramesDirty = gNumFrameResources;
-			shadowedObjectRitem->SkinnedModelInst = mSkinnedModelInst[cIndex].get();
-			shadowedObjectRitem->MonsterCBIndex = chaIndex++;
-
-			mRitems[(int)RenderLayer::Monster].push_back(MonsterRitem.get());
-			mAllRitems.push_back(std::move(MonsterRitem));
-			mRitems[(int)RenderLayer::Shadow].push_back(shadowedObjectRitem.get());
-			mAllRitems.push_back(std::move(shadowedObjectRitem));
-		}
+		XMStoreFloat3(&mSpawnPoints[cIndex], monsterPos);
+
+		// Per monster instance, the submeshes are shared
+		auto MonsterRitem = std::make_unique<RenderItem>();
+		XMStoreFloat4x4(&MonsterRitem->World, XMMatrixScaling(4.0f + BossScale, 4.0f + BossScale, 4.0f + BossScale));
+		MonsterRitem->TexTransform = MathHelper::Identity4x4();
+		MonsterRitem->Mat = mMaterials.Get(MaterialName);
+		MonsterRitem->Geo = GetMeshGeometry();
+		MonsterRitem->NumFramesDirty = gNumFrameResources;
+		MonsterRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		MonsterRitem->SkinnedModelInst = mSkinnedModelInst[cIndex].get();
+
+		auto shadowedObjectRitem = std::make_unique<RenderItem>();
+		*shadowedObjectRitem = *MonsterRitem;
+		shadowedObjectRitem->Mat = mMaterials.Get("shadow0");
+		shadowedObjectRitem->NumFramesDirty = gNumFrameResources;
+		shadowedObjectRitem->SkinnedModelInst = mSkinnedModelInst[cIndex].get();
+
+		mRitems[(int)RenderLayer::Monster].push_back(MonsterRitem.get());
+		mAllRitems.push_back(std::move(MonsterRitem));
+		mRitems[(int)RenderLayer::Shadow].push_back(shadowedObjectRitem.get());
+		mAllRitems.push_back(std::move(shadowedObjectRitem));
 
 		mMonsterInfo[cIndex] = cInfo;
+		mPrevTransforms[cIndex] = cInfo.mMovement.GetWorldTransformInfo();
+		UpdateGrid(cIndex);
+	}
+
+	mShadowMaterial = (UINT)mMaterials.Get("shadow0");
+	mSlotEntities.resize(numOfCharacter);
+	for (UINT cIndex = 0; cIndex < numOfCharacter; ++cIndex)
+		CreateEntity(cIndex, 0.0f);
+
+	// Character Mesh : one instanced draw per submesh for the whole zone
+	for (int submeshIndex = 0; submeshIndex < BoneCount - 1; ++submeshIndex)
+	{
+		const SubmeshGeometry& submesh = GetMeshGeometry()->DrawArgs[boneName[submeshIndex]];
+
+		InstanceBatch batch;
+		batch.Mat = mMaterials.Get(MaterialName);
+		batch.Geo = GetMeshGeometry();
+		batch.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		batch.IndexCount = submesh.IndexCount;
+		batch.StartIndexLocation = submesh.StartIndexLocation;
+		batch.BaseVertexLocation = submesh.BaseVertexLocation;
+		batch.InstanceCount = numOfCharacter;
+		mBatches[(int)RenderLayer::Monster].push_back(batch);
+
+		batch.Mat = mMaterials.Get("shadow0");
+		mBatches[(int)RenderLayer::Shadow].push_back(batch);
 	}
 
 	// Boss
 	mMonsterInfo[0].mHealth = 200;
 	mMonsterInfo[0].mFullHealth = 200;
+
+	// After the monsters, so their spawn positions do not depend on the crowd
+	if (mCrowdPopulation > 0)
+	{
+		mCrowd.Spawn(mCrowdPopulation,
+			static_cast<float>(xOffset), static_cast<float>(zOffset),
+			static_cast<float>(xOffset + xRange), static_cast<float>(zOffset + zRange),
+			100.0f, mSpawnEngine);
+	}
 }
 
 
 void Monster::UpdateCharacterCBs(
 	FrameResource * mCurrFrameResource,
 	const Light & mMainLight,
+	const Frustum & frustum,
+	const OcclusionCuller & occlusion,
 	const GameTimer & gt)
 {
-	auto curMonsterCB = mCurrFrameResource->MonsterCB.get();
+	auto allocator = mCurrFrameResource->Allocator.get();
 	static float time = 0.0f;
 
+	// Bodies then shadows of the live monsters, culled and packed at the end
+	UINT liveCount = mEntities.GetEntityCount();
+	mInstanceData.resize(2 * liveCount);
+	mCullBoxes.resize(2 * liveCount);
+	mCullVisible.resize(2 * liveCount);
 
 	// Animation per 0.01s
 	//if (gt.TotalTime() - time > 0.01f)
 	//{
-	for (UINT k = 0; k < numOfCharacter; ++k)
+	UploadAllocation palettes = allocator->Allocate<XMFLOAT4X4>(numOfCharacter * gBonePaletteSize);
+	XMFLOAT4X4* curPalettes = reinterpret_cast<XMFLOAT4X4*>(palettes.CPU);
+	mPaletteAddress = palettes.GPU;
+	mHitReach = 0.0f;
+	mEntities.Each<TransformComponent, BoundsComponent, RenderComponent>(
+		[&](uint32_t count, const Entity*, TransformComponent* transforms, BoundsComponent* bounds, RenderComponent* renders)
 	{
-		mSkinnedModelInst[k]->UpdateSkinnedAnimation(mMonsterInfo[k].mClipName, gt.DeltaTime());
-		GetBoundingBox().Transform(mMonsterInfo[k].mBoundingBox, GetWorldTransformMatrix(k));
-	}
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			UINT k = renders[i].InstanceIndex;
+
+			// The clock moves in simulation steps, drawn between the last two like the transforms
+			float timePos = (std::max)(mSkinnedModelInst[k]->TimePos - (1.0f - mInterpolation) * mStepTime, 0.0f);
+			PoseMonster(k, timePos);
+			UpdateEntity(k, transforms[i], bounds[i]);
+
+			// One palette per monster, shared by its submeshes and shadows
+			auto& finalTransforms = mSkinnedModelInst[k]->FinalTransforms;
+			memcpy(curPalettes + k * gBonePaletteSize, finalTransforms.data(),
+				sizeof(XMFLOAT4X4) * (std::min)((UINT)finalTransforms.size(), gBonePaletteSize));
+
+			// Health bars keep their slot's constant buffer; the boss's sit wider apart.
+			// A free slot's bars were collapsed when it was released.
+			mMonsterInfo[k].mMovement.UpdateTransformationMatrix();
+			mUIWorlds[k] = XMLoadFloat4x4(&mRitems[(int)RenderLayer::Monster][k]->World) * GetWorldTransformMatrix(k);
+			mUIEyeLeft[k] = -mMonsterInfo[k].mMovement.GetPlayerRight() * (k == 0 ? 1.75f : 1.0f);
+		}
+	});
 	time = gt.TotalTime();
 	//}
 
-	// Character Offset : mAllsize  / numOfcharacter
-	int monsterFullIndex = 0;
-	int preMonsterIndex = -1;
-	int monsterOffset = mRitems[(int)RenderLayer::Monster].size() / numOfCharacter;
-
-	std::vector<XMMATRIX> vWorld;
-	std::vector<XMVECTOR> vEyeLeft;
-
-	// Monster
-	for (auto& e : mRitems[(int)RenderLayer::Monster])
+	// Instances straight from the entity chunks: body n and its shadow at liveCount + n
+	UpdateCharacterShadows(mMainLight);
+	XMMATRIX shadowTransform = XMLoadFloat4x4(&mShadowTransform);
+	XMFLOAT4X4 texTransform = MathHelper::Identity4x4();
+	UINT n = 0;
+	mEntities.Each<TransformComponent, BoundsComponent, RenderComponent>(
+		[&](uint32_t count, const Entity*, TransformComponent* transforms, BoundsComponent* bounds, RenderComponent* renders)
 	{
-		int monsterIndex = monsterFullIndex / monsterOffset;
-
-		XMMATRIX world = XMLoadFloat4x4(&e->World) * GetWorldTransformMatrix(monsterIndex);
-		XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
-
-		if (preMonsterIndex != monsterIndex)
+		for (uint32_t i = 0; i < count; ++i, ++n)
 		{
-			preMonsterIndex = monsterIndex;
-
-			mMonsterInfo[monsterIndex].mMovement.UpdateTransformationMatrix();
-			vWorld.push_back(world);
-			vEyeLeft.push_back(-mMonsterInfo[monsterIndex].mMovement.GetPlayerRight());
+			const TransformComponent& t = transforms[i];
+			const RenderComponent& r = renders[i];
+			XMMATRIX world = XMMatrixScaling(t.Scale, t.Scale, t.Scale) *
+				XMMatrixRotationQuaternion(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(t.Rotation))) *
+				XMMatrixTranslation(t.Position[0], t.Position[1], t.Position[2]);
+			XMMATRIX shadowWorld = world * shadowTransform;
+
+			InstanceData& body = mInstanceData[n];
+			XMStoreFloat4x4(&body.World, XMMatrixTranspose(world));
+			body.TexTransform = texTransform;
+			body.MaterialIndex = r.MaterialIndex;
+			body.PaletteOffset = r.PaletteOffset;
+			memcpy(&mCullBoxes[n], &bounds[i], sizeof(CullBox));
+
+			InstanceData& shadow = mInstanceData[liveCount + n];
+			shadow = body;
+			XMStoreFloat4x4(&shadow.World, XMMatrixTranspose(shadowWorld));
+			shadow.MaterialIndex = mShadowMaterial;
+
+			// The posed bones flattened onto the ground
+			BoundingBox shadowBox;
+			UpdateSkinnedBounds(mSkinnedModelInst[r.InstanceIndex]->FinalTransforms, shadowWorld, shadowBox);
+			mCullBoxes[liveCount + n] = ToCullBox(shadowBox);
 		}
+	});
 
-		CharacterConstants monsterConstants;
-
-		std::copy(
-			std::begin(mSkinnedModelInst[monsterIndex]->FinalTransforms),
-			std::end(mSkinnedModelInst[monsterIndex]->FinalTransforms),
-			&monsterConstants.BoneTransforms[0]);
-
-		XMStoreFloat4x4(&monsterConstants.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&monsterConstants.TexTransform, XMMatrixTranspose(texTransform));
-
-		curMonsterCB->CopyData(e->MonsterCBIndex, monsterConstants);
+	// Upload only the visible instances; the batches draw that many
+	CullBoxes(frustum, mCullBoxes.data(), 2 * liveCount, mCullVisible.data());
+	mOccludedInstanceCount = occlusion.TestBoxes(mCullBoxes.data(), 2 * liveCount, mCullVisible.data());
 
-		++monsterFullIndex;
+	UINT visibleBodies = 0;
+	UINT visibleShadows = 0;
+	for (UINT i = 0; i < liveCount; ++i)
+	{
+		visibleBodies += mCullVisible[i];
+		visibleShadows += mCullVisible[liveCount + i];
 	}
+	mVisibleInstanceCount = visibleBodies + visibleShadows;
 
-	// Shadow
-	UpdateCharacterShadows(mMainLight);
-	monsterFullIndex = 0;
-	for (auto& e : mRitems[(int)RenderLayer::Shadow])
+	D3D12_GPU_VIRTUAL_ADDRESS instanceAddress = 0;
+	if (mVisibleInstanceCount > 0)
 	{
-		int monsterIndex = monsterFullIndex / monsterOffset;
-
-		CharacterConstants monsterConstants;
-
-		std::copy(
-			std::begin(mSkinnedModelInst[monsterIndex]->FinalTransforms),
-			std::end(mSkinnedModelInst[monsterIndex]->FinalTransforms),
-			&monsterConstants.BoneTransforms[0]);
-
-		// TODO : player constroller
-		XMMATRIX world = XMLoadFloat4x4(&e->World);
-		XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+		UploadAllocation instances = allocator->Allocate<InstanceData>(mVisibleInstanceCount);
+		InstanceData* curInstances = reinterpret_cast<InstanceData*>(instances.CPU);
+		instanceAddress = instances.GPU;
 
-		XMStoreFloat4x4(&monsterConstants.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&monsterConstants.TexTransform, XMMatrixTranspose(texTransform));
-
-		curMonsterCB->CopyData(e->MonsterCBIndex, monsterConstants);
+		UINT visibleIndex = 0;
+		for (UINT i = 0; i < 2 * liveCount; ++i)
+		{
+			if (mCullVisible[i])
+				curInstances[visibleIndex++] = mInstanceData[i];
+		}
+	}
 
-		++monsterFullIndex;
+	for (auto& b : mBatches[(int)RenderLayer::Monster])
+	{
+		b.InstanceAddress = instanceAddress;
+		b.InstanceBase = 0;
+		b.InstanceCount = visibleBodies;
+	}
+	for (auto& b : mBatches[(int)RenderLayer::Shadow])
+	{
+		b.InstanceAddress = instanceAddress;
+		b.InstanceBase = visibleBodies;
+		b.InstanceCount = visibleShadows;
 	}
 
 	//UI
 	auto curUICB = mCurrFrameResource->MonsterUICB.get();
-	vEyeLeft[0] *= 1.75f;
-
-	mMonsterUI.UpdateUICBs(curUICB, vWorld, vEyeLeft, mTransformDirty);
+	mMonsterUI.UpdateUICBs(curUICB, mUIWorlds, mUIEyeLeft, mTransformDirty);
 }
 
 void Monster::UpdateCharacterShadows(const Light& mMainLight)
 {
-	int i = 0;
-	int monsterOffset = mRitems[(int)RenderLayer::Shadow].size() / numOfCharacter;
-
-	for (auto& e : mRitems[(int)RenderLayer::Shadow])
-	{
-		int monsterIndex = i / monsterOffset;
-
-		// Load the object world
-		auto& o = mRitems[(int)RenderLayer::Monster][i];
-		XMMATRIX shadowWorld = XMLoadFloat4x4(&o->World) * GetWorldTransformMatrix(monsterIndex);
+	// Same for every monster; the instance upload applies it after each world
+	XMVECTOR shadowPlane = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	XMVECTOR toMainLight = -XMLoadFloat3(&mMainLight.Direction);
+	XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
+	XMMATRIX shadowOffsetY = XMMatrixTranslation(0.0f, 0.001f, 0.0f);
+	XMStoreFloat4x4(&mShadowTransform, S * shadowOffsetY);
+}
 
-		XMVECTOR shadowPlane = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-		XMVECTOR toMainLight = -XMLoadFloat3(&mMainLight.Direction);
-		XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
-		XMMATRIX shadowOffsetY = XMMatrixTranslation(0.0f, 0.001f, 0.0f);
-		XMStoreFloat4x4(&e->World, shadowWorld * S * shadowOffsetY);
-		e->NumFramesDirty = gNumFrameResources;
+void Monster::PoseMonster(UINT cIndex, float timePos)
+{
+	mSkinnedModelInst[cIndex]->UpdatePose(mMonsterInfo[cIndex].mClipName, timePos);
+
+	// Posed bounds for culling and hits, through the same world as the body
+	XMMATRIX world = XMLoadFloat4x4(&mRitems[(int)RenderLayer::Monster][cIndex]->World) * GetWorldTransformMatrix(cIndex);
+	UpdateSkinnedBounds(mSkinnedModelInst[cIndex]->FinalTransforms, world, mMonsterInfo[cIndex].mBoundingBox);
+
+	// How far a box reaches from its monster on the ground, for the hit query
+	XMFLOAT3 position;
+	XMStoreFloat3(&position, mMonsterInfo[cIndex].mMovement.GetPlayerPosition());
+	const BoundingBox& bounds = mMonsterInfo[cIndex].mBoundingBox;
+	float reachX = std::fabs(bounds.Center.x - position.x) + bounds.Extents.x;
+	float reachZ = std::fabs(bounds.Center.z - position.z) + bounds.Extents.z;
+	mHitReach = (std::max)(mHitReach, std::sqrt(reachX * reachX + reachZ * reachZ));
+}
 
-		++i;
-	}
+void Monster::UpdatePosedBounds()
+{
+	// Nothing is drawn between steps here, so the latest step is the pose
+	mInterpolation = 1.0f;
+	mHitReach = 0.0f;
+	mEntities.Each<RenderComponent>([this](uint32_t count, const Entity*, RenderComponent* renders)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			PoseMonster(renders[i].InstanceIndex, mSkinnedModelInst[renders[i].InstanceIndex]->TimePos);
+	});
 }
 
-void Monster::UpdateMonsterPosition(Character& Player, const GameTimer & gt)
+void Monster::UpdateMonsterPosition(const ZoneTarget& target, float simTime, float dt)
 {
 	// p.. - player
 	// m.. - monster
 	XMVECTOR E = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-	XMVECTOR pPosition = Player.GetCharacterInfo().mMovement.GetPlayerPosition();
-	static std::vector<std::pair<float, bool>> HitTime(numOfCharacter, std::make_pair(gt.TotalTime(), false));
+	XMVECTOR pPosition = XMLoadFloat3(&target.Position);
+
+	// The monsters built with the zone start their attack clocks on its first step
+	if (!mAttackClockStarted)
+	{
+		mEntities.Each<AttackComponent>([simTime](uint32_t count, const Entity*, AttackComponent* attacks)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+				attacks[i].StartTime = simTime;
+		});
+		mAttackClockStarted = true;
+	}
 
-	auto seed = std::chrono::system_clock::now().time_since_epoch().count();
-	std::mt19937 engine{ (unsigned int)seed };
 	std::uniform_int_distribution <> disX{ 0, 2 }; // monster Area
-	int attackIndex{ disX(engine) };
+	int attackIndex{ disX(mAIEngine) };
 
-	for (UINT cIndex = 0; cIndex < numOfCharacter; ++cIndex)
+	// The steering constants below are per 0.04 s
+	float tick = dt / 0.04f;
+
+	// Animation runs on simulation time, so attacks land and the dead are released
+	// on the same schedule whether the zone is drawn or not. The grid update is cheap
+	// when nobody changed cell.
+	mStepTime = dt;
+	mEntities.Each<RenderComponent>([this, dt](uint32_t count, const Entity*, RenderComponent* renders)
 	{
-		// Monster Die
-		if (!mMonsterInfo[cIndex].isDeath && mMonsterInfo[cIndex].mHealth <= 0)
+		for (uint32_t i = 0; i < count; ++i)
 		{
-			SetClipName("Death", cIndex);
-			HitTime[cIndex].first = gt.TotalTime();
-			mMonsterInfo[cIndex].isDeath = true;
-			mAliveMonster--;
+			UINT cIndex = renders[i].InstanceIndex;
+			mPrevTransforms[cIndex] = mMonsterInfo[cIndex].mMovement.GetWorldTransformInfo();
+			mSkinnedModelInst[cIndex]->AdvanceTime(mMonsterInfo[cIndex].mClipName, dt);
+			UpdateGrid(cIndex);
 		}
-		if (mMonsterInfo[cIndex].mClipName == "Death")
+	});
+
+	mDeadSlots.clear();
+	mEntities.Each<RenderComponent, AttackComponent>(
+		[&](uint32_t count, const Entity*, RenderComponent* renders, AttackComponent* attacks)
+	{
+		for (uint32_t i = 0; i < count; ++i)
 		{
-			if (gt.TotalTime() - HitTime[cIndex].first > 7.0f)
+			UINT cIndex = renders[i].InstanceIndex;
+			AttackComponent& attack = attacks[i];
+
+			// Monster Die
+			if (!mMonsterInfo[cIndex].isDeath && mMonsterInfo[cIndex].mHealth <= 0)
 			{
-				// If spawn
-				mMonsterInfo[cIndex].mMovement.SetPlayerPosition(XMVectorZero());
+				SetClipName("Death", cIndex);
+				attack.StartTime = simTime;
+				mMonsterInfo[cIndex].isDeath = true;
+				mStates[cIndex] = eMonsterState::Dying;
+				mAliveMonster--;
 			}
+			// Destroying the entity would move the chunk under the walk, so the release waits
+			if (mStates[cIndex] == eMonsterState::Dying && simTime - attack.StartTime > 7.0f)
+				mDeadSlots.push_back(cIndex);
+			if (mStates[cIndex] != eMonsterState::Alive)
+				continue;
 
-			continue;
-		}
+			auto& M = mMonsterInfo[cIndex];
+			XMVECTOR mUp = M.mMovement.GetPlayerUp();
+			XMVECTOR mLook = M.mMovement.GetPlayerLook();
+			XMVECTOR mPosition = M.mMovement.GetPlayerPosition();
+			XMMATRIX mRotation = M.mMovement.GetPlayerRotation();
 
-		auto& M = mMonsterInfo[cIndex];
-		XMVECTOR mUp = M.mMovement.GetPlayerUp();
-		XMVECTOR mLook = M.mMovement.GetPlayerLook();
-		XMVECTOR mPosition = M.mMovement.GetPlayerPosition();
-		XMMATRIX mRotation = M.mMovement.GetPlayerRotation();
+			XMMATRIX R = XMMatrixIdentity();
+			XMVECTOR D = XMVector3Normalize(XMVectorSubtract(pPosition, mPosition));
 
-		XMMATRIX R = XMMatrixIdentity();
-		XMVECTOR D = XMVector3Normalize(XMVectorSubtract(pPosition, mPosition));
-		float theta = XMVector3AngleBetweenNormals(mLook, D).m128_f32[0];
+			// Around the walls the field knows the way, within attack range head straight in
+			float flowX, flowZ;
+			if (target.Field && MathHelper::getDistance(pPosition, mPosition) > 12.0f &&
+				target.Field->GetDirection(XMVectorGetX(mPosition), XMVectorGetZ(mPosition), flowX, flowZ))
+				D = XMVectorSet(flowX, 0.0f, flowZ, 0.0f);
 
-		// left right check ; Left - minus / Right - plus
-		float res = XMVector3Dot(XMVector3Cross(D, mLook), mUp).m128_f32[0];
+			float theta = XMVector3AngleBetweenNormals(mLook, D).m128_f32[0];
 
-		if (theta > XM_PI / 36.0f)
-		{
-			if (res > 0)
-				R = R * XMMatrixRotationY(0.03f * -theta);
-			else
-				R = R * XMMatrixRotationY(0.03f * theta);
-		}
+			// left right check ; Left - minus / Right - plus
+			float res = XMVector3Dot(XMVector3Cross(D, mLook), mUp).m128_f32[0];
 
-		float curDeltaTime = gt.TotalTime() - HitTime[cIndex].first;
-		float curClipTime = mSkinnedModelInst[cIndex]->TimePos;
-		if (curDeltaTime < 5.0f) // Attack Time
-		{
-			// After half the full time of the clip
-			if (mMonsterInfo[cIndex].mAttackTime < curClipTime && HitTime[cIndex].second)
+			if (theta > XM_PI / 36.0f)
 			{
-				HitTime[cIndex].second = false;
-
-				if (cIndex == 0)	// boss monster
-					Player.Damage(mBossDamage, mPosition, mLook);
+				if (res > 0)
+					R = R * XMMatrixRotationY(0.03f * tick * -theta);
 				else
-					Player.Damage(mDamage, mPosition, mLook);
+					R = R * XMMatrixRotationY(0.03f * tick * theta);
 			}
-		}
 
-		float distance = MathHelper::getDistance(pPosition, mPosition);
+			float curDeltaTime = simTime - attack.StartTime;
+			float curClipTime = mSkinnedModelInst[cIndex]->TimePos;
+			if (curDeltaTime < 5.0f) // Attack Time
+			{
+				// After half the full time of the clip
+				if (mMonsterInfo[cIndex].mAttackTime < curClipTime && attack.Pending)
+				{
+					attack.Pending = 0;
+
+					HitEvent hit = {};
+					hit.Source = eHitSource::Monster;
+					hit.Zone = mZone;
+					hit.Attacker = cIndex;
+					hit.Target = HitQueue::NoTarget;
+					// A slot strikes at most once per step, so its key is already unique
+					hit.Sequence = 0;
+					hit.Time = simTime;
+					hit.Damage = cIndex == 0 ? mBossDamage : mDamage;	// boss monster
+					XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(hit.Position), mPosition);
+					XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(hit.Look), mLook);
+					target.Hits->Push(hit);
+				}
+			}
 
-		// Collision - player
-		if (distance < 8.0f)
-		{
-			// Move Back
-			mPosition = XMVectorSubtract(mPosition, mLook);
-			M.mMovement.SetPlayerPosition(mPosition);
-		}
+			float distance = MathHelper::getDistance(pPosition, mPosition);
 
-		// Attack
-		if (distance < 12.0f)
-		{
-			float pHealth = static_cast<float>(Player.GetCharacterInfo().mHealth);
+			// Collision - player
+			if (distance < 8.0f)
+			{
+				// Move Back
+				mPosition = XMVectorSubtract(mPosition, tick * mLook);
+				M.mMovement.SetPlayerPosition(mPosition);
+				UpdateGrid(cIndex);
+			}
 
-			if (curDeltaTime > 5.0f && pHealth > 0) // Hit per 5 seconds
+			// Attack
+			if (distance < 12.0f)
 			{
-				HitTime[cIndex].first = gt.TotalTime();
-				if (attackIndex % 2 == 0)
+				float pHealth = static_cast<float>(target.Health);
+
+				if (curDeltaTime > 5.0f && pHealth > 0) // Hit per 5 seconds
 				{
-					SetClipName("MAttack1", cIndex);
-					mMonsterInfo[cIndex].mAttackTime = mAttackTimes[0];
+					attack.StartTime = simTime;
+					if (attackIndex % 2 == 0)
+					{
+						SetClipName("MAttack1", cIndex);
+						mMonsterInfo[cIndex].mAttackTime = mAttackTimes[0];
+					}
+					else
+					{
+						SetClipName("MAttack2", cIndex);
+						mMonsterInfo[cIndex].mAttackTime = mAttackTimes[1];
+					}
+					mSkinnedModelInst[cIndex]->TimePos = 0.0f;
+
+					attack.Pending = 1;
 				}
-				else
+				else if (pHealth <= 0)
 				{
-					SetClipName("MAttack2", cIndex);
-					mMonsterInfo[cIndex].mAttackTime = mAttackTimes[1];
+					SetClipName("Idle", cIndex);
+				}
+			}
+			else if (distance < 100.0f) // Move Monster
+			{
+				// Monster Collision Check, against the monsters ahead within reach
+				mGrid.QueryCone(XMVectorGetX(mPosition), XMVectorGetZ(mPosition), XMVectorGetX(mLook), XMVectorGetZ(mLook),
+					5.5f, XM_PIDIV2, mQueryIds);
+				for (UINT j : mQueryIds)
+				{
+					// Me
+					if (cIndex == j) continue;
+
+					// Other Monster nth
+					XMVECTOR MnthPos = mMonsterInfo[j].mMovement.GetPlayerPosition();
+					XMVECTOR MnthDirection = XMVectorSubtract(MnthPos, mPosition);
+
+					// Monster nth`s Position is NOT Front
+					if (XMVector3Dot(mLook, MnthDirection).m128_f32[0] < 0)
+						continue;
+
+					if (MathHelper::getDistance(MnthPos, mPosition) < 5.0f)
+					{
+						XMVECTOR Md = XMVectorSubtract(MnthPos, mPosition);
+						mPosition = XMVectorSubtract(mPosition, 0.01f * tick * Md);
+
+						// Rotate opposite direction
+						if (res > 0)
+							R = R * XMMatrixRotationY(0.1f * tick * theta);
+						else
+							R = R * XMMatrixRotationY(0.1f * tick * -theta);
+					}
 				}
-				mSkinnedModelInst[cIndex]->TimePos = 0.0f;
 
-				HitTime[cIndex].second = true;
+				// Move to player
+				mPosition = XMVectorAdd(mPosition, 0.15f * tick * mLook);
+
+				SetClipName("Walking", cIndex);
+				mTransformDirty = true;
 			}
-			else if (pHealth <= 0)
+			else
 			{
 				SetClipName("Idle", cIndex);
 			}
+
+			M.mMovement.SetPlayerLook(XMVector3TransformNormal(mLook, R));
+			M.mMovement.SetPlayerRotation(mRotation * R);
+			M.mMovement.SetPlayerPosition(mPosition);
+			UpdateGrid(cIndex);
 		}
-		else if (distance < 100.0f) // Move Monster
-		{
-			// Monster Collision Check
-			for (UINT j = 0; j < numOfCharacter; ++j)
-			{
-				// Me
-				if (cIndex == j) continue;
+	});
 
-				// Other Monster nth
-				XMVECTOR MnthPos = mMonsterInfo[j].mMovement.GetPlayerPosition();
-				XMVECTOR MnthDirection = XMVectorSubtract(MnthPos, mPosition);
+	for (UINT cIndex : mDeadSlots)
+		Release(cIndex);
 
-				// Monster nth`s Position is NOT Front
-				if (XMVector3Dot(mLook, MnthDirection).m128_f32[0] < 0)
-					continue;
+	// Freed in death order, so the oldest is always at the head
+	while (mRespawnDelay > 0.0f && mFreeCount > 0 &&
+		simTime - mFreeTimes[mFreeHead] > 7.0f + mRespawnDelay)
+	{
+		UINT cIndex = mFreeSlots[mFreeHead];
+		mFreeHead = (mFreeHead + 1) % numOfCharacter;
+		--mFreeCount;
+		Respawn(cIndex, simTime);
+	}
+}
 
-				if (MathHelper::getDistance(MnthPos, mPosition) < 5.0f)
-				{
-					XMVECTOR Md = XMVectorSubtract(MnthPos, mPosition);
-					mPosition = XMVectorSubtract(mPosition, 0.01f * Md);
+void Monster::UpdateCrowd(const ZoneTarget& target, float dt)
+{
+	if (mCrowd.GetCount() == 0)
+		return;
 
-					// Rotate opposite direction
-					if (res > 0)
-						R = R * XMMatrixRotationY(0.1f * theta);
-					else
-						R = R * XMMatrixRotationY(0.1f * -theta);
-				}
-			}
+	// Strikes are counted but spare the player, so a large crowd does not end the game
+	mCrowd.Update(target.Position.x, target.Position.z, dt, target.Field);
+}
 
-			// Move to player
-			mPosition = XMVectorAdd(mPosition, 0.15f * mLook);
+void Monster::SetInterpolation(float alpha)
+{
+	mInterpolation = alpha;
+}
 
-			SetClipName("Walking", cIndex);
-			mTransformDirty = true;
-		}
-		else
-		{
-			SetClipName("Idle", cIndex);
-		}
+const SpatialGrid& Monster::GetGrid() const
+{
+	return mGrid;
+}
 
-		M.mMovement.SetPlayerLook(XMVector3TransformNormal(mLook, R));
-		M.mMovement.SetPlayerRotation(mRotation * R);
-		M.mMovement.SetPlayerPosition(mPosition);
-	}
+const Crowd& Monster::GetCrowd() const
+{
+	return mCrowd;
+}
+
+void Monster::UpdateGrid(UINT cIndex)
+{
+	XMVECTOR position = mMonsterInfo[cIndex].mMovement.GetPlayerPosition();
+	mGrid.Move(cIndex, XMVectorGetX(position), XMVectorGetZ(position));
+}
+
+void Monster::Release(UINT cIndex)
+{
+	mStates[cIndex] = eMonsterState::Free;
+	UINT freeIndex = (mFreeHead + mFreeCount) % numOfCharacter;
+	mFreeSlots[freeIndex] = cIndex;
+	mFreeTimes[freeIndex] = mEntities.Get<AttackComponent>(mSlotEntities[cIndex])->StartTime;
+	++mFreeCount;
+
+	// Out of the queries for damage and avoidance, out of the instance upload, and its
+	// health bars collapse to nothing
+	mGrid.Remove(cIndex);
+	mEntities.Destroy(mSlotEntities[cIndex]);
+	mUIWorlds[cIndex] = XMMatrixScaling(0.0f, 0.0f, 0.0f);
+	mTransformDirty = true;
+}
+
+void Monster::CreateEntity(UINT cIndex, float startTime)
+{
+	Entity entity = mEntities.Create<TransformComponent, BoundsComponent, RenderComponent, AttackComponent>();
+	mSlotEntities[cIndex] = entity;
+
+	RenderComponent* render = mEntities.Get<RenderComponent>(entity);
+	render->InstanceIndex = cIndex;
+	render->MaterialIndex = (UINT)mRitems[(int)RenderLayer::Monster][cIndex]->Mat;
+	render->PaletteOffset = cIndex * gBonePaletteSize;
+	mEntities.Get<AttackComponent>(entity)->StartTime = startTime;
+}
+
+void Monster::UpdateEntity(UINT cIndex, TransformComponent& transform, BoundsComponent& bounds)
+{
+	XMVECTOR scale, rotation, position;
+	GetDrawnTransform(cIndex, scale, rotation, position);
+
+	// The render item's world is the monster's uniform size
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(transform.Position), position);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(transform.Rotation), rotation);
+	transform.Scale = mRitems[(int)RenderLayer::Monster][cIndex]->World._11 * XMVectorGetX(scale);
+
+	const BoundingBox& box = mMonsterInfo[cIndex].mBoundingBox;
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(bounds.Center), XMLoadFloat3(&box.Center));
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(bounds.Extents), XMLoadFloat3(&box.Extents));
+}
+
+void Monster::Respawn(UINT cIndex, float simTime)
+{
+	auto& M = mMonsterInfo[cIndex];
+	M.mHealth = M.mFullHealth;
+	M.isDeath = false;
+	// Past SetClipName, which holds on to Death
+	M.mClipName = "Idle";
+	M.mMovement.SetPlayerPosition(XMLoadFloat3(&mSpawnPoints[cIndex]));
+	mSkinnedModelInst[cIndex]->TimePos = 0.0f;
+	mPrevTransforms[cIndex] = M.mMovement.GetWorldTransformInfo();
+	mMonsterUI.SetDamageScale(cIndex, 1.0f);
+
+	mStates[cIndex] = eMonsterState::Alive;
+	++mAliveMonster;
+	CreateEntity(cIndex, simTime);
+	++mRespawnCount;
+	UpdateGrid(cIndex);
+	mTransformDirty = true;
 }
 
 /*std::wstring text = L"dot: " + std::to_wstring(gt.TotalTime()) + L"\n";
@@ -1,5 +1,6 @@
 #include "GameTimer.h"
 #include "Player.h"
+#include "HitQueue.h"
 
 using namespace DirectX;
 
@@ -31,10 +32,12 @@ CharacterInfo & Player::GetCharacterInfo(int cIndex)
 
 void Player::Damage(int damage, XMVECTOR Position, XMVECTOR Look)
 {
-	XMVECTOR mP = Position;
-	XMVECTOR P = mPlayerInfo.mMovement.GetPlayerPosition();
+	// Within reach of the attacker, against the posed bounds
+	BoundingSphere reach;
+	XMStoreFloat3(&reach.Center, Position);
+	reach.Radius = 15.0f;
 
-	if (MathHelper::getDistance(mP, P) > 15.0f)
+	if (!mPlayerInfo.mBoundingBox.Intersects(reach))
 		return;
 
 	if (mPlayerInfo.mHealth >= 0)
@@ -52,7 +55,7 @@ void Player::Damage(int damage, XMVECTOR Position, XMVECTOR Look)
 	mUI.SetDamageScale(static_cast<float>(mPlayerInfo.mHealth) / static_cast<float>(mFullHealth));
 }
 
-void Player::Attack(Character * inMonster, std::string clipName)
+void Player::Attack(HitQueue& hits, UINT zone, const std::string& clipName)
 {
 	SetClipName(clipName);
 	SetClipTime(0.0f);
@@ -64,10 +67,16 @@ void Player::Attack(Character * inMonster, std::string clipName)
 	else if (clipName == "Kick2")
 		mDamage = 30;
 
-	inMonster->Damage(
-		mDamage,
-		mPlayerInfo.mMovement.GetPlayerPosition(),
-		mPlayerInfo.mMovement.GetPlayerLook());
+	HitEvent hit = {};
+	hit.Source = eHitSource::Player;
+	hit.Zone = zone;
+	hit.Attacker = 0;
+	hit.Target = HitQueue::NoTarget;
+	hit.Sequence = mAttackSequence++;
+	hit.Damage = mDamage;
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(hit.Position), mPlayerInfo.mMovement.GetPlayerPosition());
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(hit.Look), mPlayerInfo.mMovement.GetPlayerLook());
+	hits.Push(hit);
 }
 
 bool Player::isClipEnd()
@@ -94,6 +103,11 @@ XMMATRIX Player::GetWorldTransformMatrix() const
 	return  S * R * P;
 }
 
+const BoundingBox& Player::GetShadowBounds() const
+{
+	return mShadowBounds;
+}
+
 UINT Player::GetAllRitemsSize() const
 {
 	return (UINT)mAllRitems.size();
@@ -104,6 +118,16 @@ const std::vector<RenderItem*> Player::GetRenderItem(RenderLayer Type) const
 	return mRitems[(int)Type];
 }
 
+D3D12_GPU_VIRTUAL_ADDRESS Player::GetSkinnedCBAddress(int playerCBIndex) const
+{
+	return mSkinnedCBAddress + playerCBIndex * d3dUtil::CalcConstantBufferByteSize(sizeof(CharacterConstants));
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS Player::GetPaletteAddress() const
+{
+	return mPaletteAddress;
+}
+
 
 void Player::SetClipName(const std::string& inClipName)
 {
@@ -120,8 +144,7 @@ void Player::SetClipTime(float time)
 
 
 void Player::BuildGeometry(
-	ID3D12Device * device,
-	ID3D12GraphicsCommandList* cmdList,
+	RenderDevice* device,
 	const std::vector<CharacterVertex>& inVertices,
 	const std::vector<std::uint32_t>& inIndices,
 	const SkinnedData& inSkinInfo,
@@ -135,7 +158,7 @@ void Player::BuildGeometry(
 	mSkinnedModelInst->TimePos = 0.0f;
 
 	Character::BuildGeometry(
-		device, cmdList,
+		device,
 		inVertices, inIndices,
 		mSkinnedInfo, geoName);
 }
@@ -194,47 +217,55 @@ void Player::UpdateCharacterCBs(
 	}
 	mSkinnedModelInst->UpdateSkinnedAnimation(mPlayerInfo.mClipName, gt.DeltaTime());
 
-	auto currPlayerCB = mCurrFrameResource->PlayerCB.get();
+	auto allocator = mCurrFrameResource->Allocator.get();
+
+	// One palette for every submesh and shadow of the player
+	auto& finalTransforms = mSkinnedModelInst->FinalTransforms;
+	UploadAllocation palette = allocator->Allocate<XMFLOAT4X4>(gBonePaletteSize);
+	memcpy(palette.CPU, finalTransforms.data(),
+		sizeof(XMFLOAT4X4) * (std::min)((UINT)finalTransforms.size(), gBonePaletteSize));
+	mPaletteAddress = palette.GPU;
+
+	// Skinned constants of every item in one block, addressed by PlayerCBIndex
+	UINT skinnedCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(CharacterConstants));
+	UploadAllocation skinnedCB = allocator->Allocate(GetAllRitemsSize() * skinnedCBByteSize);
+	mSkinnedCBAddress = skinnedCB.GPU;
 	for (auto& e : mRitems[(int)RenderLayer::Character])
 	{
-
 		CharacterConstants skinnedConstants;
 
-		std::copy(
-			std::begin(mSkinnedModelInst->FinalTransforms),
-			std::end(mSkinnedModelInst->FinalTransforms),
-			&skinnedConstants.BoneTransforms[0]);
-
 		XMMATRIX world = XMLoadFloat4x4(&e->World) * GetWorldTransformMatrix();
 		XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
 
 		XMStoreFloat4x4(&skinnedConstants.World, XMMatrixTranspose(world));
 		XMStoreFloat4x4(&skinnedConstants.TexTransform, XMMatrixTranspose(texTransform));
+		skinnedConstants.PaletteOffset = 0;
 
-		currPlayerCB->CopyData(e->PlayerCBIndex, skinnedConstants);
+		memcpy(skinnedCB.CPU + e->PlayerCBIndex * skinnedCBByteSize, &skinnedConstants, sizeof(CharacterConstants));
 	}
 
-	//mInitBoundsBox.Transform(mPlayerInfo.mBoundingBox, GetWorldTransformMatrix());
-	GetBoundingBox().Transform(mPlayerInfo.mBoundingBox, GetWorldTransformMatrix());
+	// Posed bounds for culling and hits; the submeshes share one world
+	if (!mRitems[(int)RenderLayer::Character].empty())
+	{
+		XMMATRIX world = XMLoadFloat4x4(&mRitems[(int)RenderLayer::Character][0]->World) * GetWorldTransformMatrix();
+		UpdateSkinnedBounds(finalTransforms, world, mPlayerInfo.mBoundingBox);
+	}
 
 	UpdateCharacterShadows(mMainLight);
+	if (!mRitems[(int)RenderLayer::Shadow].empty())
+		UpdateSkinnedBounds(finalTransforms, XMLoadFloat4x4(&mRitems[(int)RenderLayer::Shadow][0]->World), mShadowBounds);
 	for (auto& e : mRitems[(int)RenderLayer::Shadow])
 	{
-
 		CharacterConstants skinnedConstants;
 
-		std::copy(
-			std::begin(mSkinnedModelInst->FinalTransforms),
-			std::end(mSkinnedModelInst->FinalTransforms),
-			&skinnedConstants.BoneTransforms[0]);
-
 		XMMATRIX world = XMLoadFloat4x4(&e->World);
 		XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
 
 		XMStoreFloat4x4(&skinnedConstants.World, XMMatrixTranspose(world));
 		XMStoreFloat4x4(&skinnedConstants.TexTransform, XMMatrixTranspose(texTransform));
+		skinnedConstants.PaletteOffset = 0;
 
-		currPlayerCB->CopyData(e->PlayerCBIndex, skinnedConstants);
+		memcpy(skinnedCB.CPU + e->PlayerCBIndex * skinnedCBByteSize, &skinnedConstants, sizeof(CharacterConstants));
 	}
 
 	mCamera.UpdateViewMatrix();
@@ -305,6 +336,19 @@ void Player::UpdatePlayerPosition(ePlayerMoveList moveName, float velocity)
 	mTransformDirty = true;
 }
 
+void Player::TranslatePlayer(FXMVECTOR offset)
+{
+	mPlayerInfo.mMovement.SetPlayerPosition(XMVectorAdd(mPlayerInfo.mMovement.GetPlayerPosition(), offset));
+
+	mCamera.UpdatePosition(
+		mPlayerInfo.mMovement.GetPlayerPosition(),
+		mPlayerInfo.mMovement.GetPlayerLook(),
+		mPlayerInfo.mMovement.GetPlayerUp(),
+		mPlayerInfo.mMovement.GetPlayerRight());
+
+	mTransformDirty = true;
+}
+
 void Player::UpdateTransformationMatrix()
 {
 	mPlayerInfo.mMovement.UpdateTransformationMatrix();
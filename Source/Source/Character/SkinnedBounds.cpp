@@ -0,0 +1,218 @@
+#include "SkinnedBounds.h"
+#include "FrameResource.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Influences below this weight do not grow a bone's box. The shader derives the fourth
+	// weight as one minus the others, which leaves rounding noise on unused slots.
+	const float MinWeight = 1e-4f;
+
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+void SkinnedBounds::Build(const CharacterVertex* vertices, uint32_t count, uint32_t boneCount)
+{
+	std::vector<XMFLOAT3> mins(boneCount, XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+	std::vector<XMFLOAT3> maxs(boneCount, XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const CharacterVertex& v = vertices[i];
+		float weights[4] = { v.BoneWeights.x, v.BoneWeights.y, v.BoneWeights.z,
+			1.0f - v.BoneWeights.x - v.BoneWeights.y - v.BoneWeights.z };
+
+		for (int k = 0; k < 4; ++k)
+		{
+			uint32_t bone = v.BoneIndices[k];
+			if (weights[k] < MinWeight || bone >= boneCount)
+				continue;
+
+			XMStoreFloat3(&mins[bone], XMVectorMin(XMLoadFloat3(&mins[bone]), XMLoadFloat3(&v.Pos)));
+			XMStoreFloat3(&maxs[bone], XMVectorMax(XMLoadFloat3(&maxs[bone]), XMLoadFloat3(&v.Pos)));
+		}
+	}
+
+	mBoxes.clear();
+	for (uint32_t bone = 0; bone < boneCount; ++bone)
+	{
+		if (mins[bone].x > maxs[bone].x)
+			continue;
+
+		XMVECTOR lo = XMLoadFloat3(&mins[bone]);
+		XMVECTOR hi = XMLoadFloat3(&maxs[bone]);
+
+		BoneBox box;
+		XMStoreFloat4(&box.Center, XMVectorSetW(0.5f * (lo + hi), 1.0f));
+		XMStoreFloat4(&box.Extents, XMVectorSetW(0.5f * (hi - lo), 0.0f));
+		box.Bone = bone;
+		mBoxes.push_back(box);
+	}
+}
+
+bool SkinnedBounds::Compute(const XMFLOAT4X4* palette, FXMMATRIX world, BoundingBox& bounds) const
+{
+	if (mBoxes.empty())
+		return false;
+
+	XMVECTOR lo = XMVectorReplicate(FLT_MAX);
+	XMVECTOR hi = XMVectorReplicate(-FLT_MAX);
+	for (const BoneBox& box : mBoxes)
+	{
+		XMMATRIX M = XMMatrixMultiply(XMMatrixTranspose(XMLoadFloat4x4(&palette[box.Bone])), world);
+
+		// The box about its moved center, grown by the absolute axes
+		XMVECTOR center = XMVector3Transform(XMLoadFloat4(&box.Center), M);
+		XMVECTOR extents = XMLoadFloat4(&box.Extents);
+		XMVECTOR radius = XMVectorAbs(M.r[0]) * XMVectorSplatX(extents);
+		radius = XMVectorMultiplyAdd(XMVectorAbs(M.r[1]), XMVectorSplatY(extents), radius);
+		radius = XMVectorMultiplyAdd(XMVectorAbs(M.r[2]), XMVectorSplatZ(extents), radius);
+
+		lo = XMVectorMin(lo, center - radius);
+		hi = XMVectorMax(hi, center + radius);
+	}
+
+	XMStoreFloat3(&bounds.Center, 0.5f * (lo + hi));
+	XMStoreFloat3(&bounds.Extents, 0.5f * (hi - lo));
+	return true;
+}
+
+uint32_t SkinnedBounds::GetBoneCount() const
+{
+	return (uint32_t)mBoxes.size();
+}
+
+void SkinnedBounds::Benchmark(uint32_t instanceCount, uint32_t vertexCount, BenchmarkResult& result)
+{
+	const uint32_t boneCount = 64;
+	std::mt19937 engine{ 1234u };
+	std::uniform_real_distribution<float> dis{ -1.0f, 1.0f };
+	std::uniform_real_distribution<float> disUnit{ 0.0f, 1.0f };
+
+	// Bone joints through a body two units tall
+	std::vector<XMFLOAT3> joints(boneCount);
+	for (auto& j : joints)
+		j = XMFLOAT3(0.5f * dis(engine), 1.0f + dis(engine), 0.25f * dis(engine));
+
+	// Each vertex on its nearest joint, blended with the second nearest
+	std::vector<CharacterVertex> vertices(vertexCount);
+	for (auto& v : vertices)
+	{
+		v = CharacterVertex();
+		v.Pos = XMFLOAT3(0.5f * dis(engine), 1.0f + dis(engine), 0.25f * dis(engine));
+
+		uint32_t nearest[2] = { 0, 0 };
+		float distance[2] = { FLT_MAX, FLT_MAX };
+		for (uint32_t b = 0; b < boneCount; ++b)
+		{
+			float d = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&v.Pos) - XMLoadFloat3(&joints[b])));
+			if (d < distance[0])
+			{
+				nearest[1] = nearest[0]; distance[1] = distance[0];
+				nearest[0] = b; distance[0] = d;
+			}
+			else if (d < distance[1])
+			{
+				nearest[1] = b; distance[1] = d;
+			}
+		}
+
+		float w = 0.5f + 0.5f * disUnit(engine);
+		v.BoneWeights = XMFLOAT3(w, 1.0f - w, 0.0f);
+		v.BoneIndices[0] = (BYTE)nearest[0];
+		v.BoneIndices[1] = (BYTE)nearest[1];
+	}
+
+	SkinnedBounds bounds;
+	bounds.Build(vertices.data(), vertexCount, boneCount);
+
+	// Every bone turned about its joint and nudged, every instance scaled and turned like a monster
+	std::vector<XMFLOAT4X4> palettes(instanceCount * boneCount);
+	std::vector<XMFLOAT4X4> worlds(instanceCount);
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		for (uint32_t b = 0; b < boneCount; ++b)
+		{
+			XMVECTOR joint = XMLoadFloat3(&joints[b]);
+			XMVECTOR axis = XMVector3Normalize(XMVectorSet(dis(engine), dis(engine), dis(engine), 0.0f) + XMVectorSet(0.0f, 0.0f, 0.01f, 0.0f));
+			XMMATRIX bone = XMMatrixTranslationFromVector(-joint) * XMMatrixRotationAxis(axis, 0.8f * dis(engine)) *
+				XMMatrixTranslationFromVector(joint + 0.2f * XMVectorSet(dis(engine), dis(engine), dis(engine), 0.0f));
+			XMStoreFloat4x4(&palettes[i * boneCount + b], XMMatrixTranspose(bone));
+		}
+
+		float scale = 4.0f + 3.0f * disUnit(engine);
+		XMStoreFloat4x4(&worlds[i], XMMatrixScaling(scale, scale, scale) * XMMatrixRotationY(XM_PI * dis(engine)) *
+			XMMatrixTranslation(500.0f * dis(engine), 0.0f, 500.0f * dis(engine)));
+	}
+
+	// Exact boxes, skinning every vertex the way the shader does
+	std::vector<BoundingBox> exact(instanceCount);
+	std::vector<XMFLOAT4X4> bones(boneCount);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		for (uint32_t b = 0; b < boneCount; ++b)
+			XMStoreFloat4x4(&bones[b], XMMatrixTranspose(XMLoadFloat4x4(&palettes[i * boneCount + b])));
+
+		XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+		XMVECTOR lo = XMVectorReplicate(FLT_MAX);
+		XMVECTOR hi = XMVectorReplicate(-FLT_MAX);
+		for (const auto& v : vertices)
+		{
+			float weights[4] = { v.BoneWeights.x, v.BoneWeights.y, v.BoneWeights.z,
+				1.0f - v.BoneWeights.x - v.BoneWeights.y - v.BoneWeights.z };
+
+			XMVECTOR pos = XMLoadFloat3(&v.Pos);
+			XMVECTOR skinned = XMVectorZero();
+			for (int k = 0; k < 4; ++k)
+			{
+				if (weights[k] != 0.0f)
+					skinned += weights[k] * XMVector3Transform(pos, XMLoadFloat4x4(&bones[v.BoneIndices[k]]));
+			}
+
+			skinned = XMVector3Transform(skinned, world);
+			lo = XMVectorMin(lo, skinned);
+			hi = XMVectorMax(hi, skinned);
+		}
+
+		XMStoreFloat3(&exact[i].Center, 0.5f * (lo + hi));
+		XMStoreFloat3(&exact[i].Extents, 0.5f * (hi - lo));
+	}
+	float vertexTime = ElapsedMs(start);
+
+	std::vector<BoundingBox> skinned(instanceCount);
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < instanceCount; ++i)
+		bounds.Compute(&palettes[i * boneCount], XMLoadFloat4x4(&worlds[i]), skinned[i]);
+	float boneTime = ElapsedMs(start);
+
+	result.VertexTime = 1000.0f * vertexTime / (std::max)(instanceCount, 1u);
+	result.BoneTime = 1000.0f * boneTime / (std::max)(instanceCount, 1u);
+	result.Escapes = 0;
+	result.Slack = 0.0f;
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		XMVECTOR exactCenter = XMLoadFloat3(&exact[i].Center);
+		XMVECTOR exactExtents = XMLoadFloat3(&exact[i].Extents);
+		XMVECTOR center = XMLoadFloat3(&skinned[i].Center);
+		XMVECTOR extents = XMLoadFloat3(&skinned[i].Extents) + XMVectorReplicate(1e-3f);
+
+		if (!XMVector3LessOrEqual(exactCenter + exactExtents, center + extents) ||
+			!XMVector3GreaterOrEqual(exactCenter - exactExtents, center - extents))
+			++result.Escapes;
+
+		const XMFLOAT3& e = exact[i].Extents;
+		const XMFLOAT3& s = skinned[i].Extents;
+		result.Slack += (s.x * s.y * s.z) / (std::max)(e.x * e.y * e.z, FLT_MIN);
+	}
+	result.Slack /= (std::max)(instanceCount, 1u);
+}
@@ -202,10 +202,23 @@ void SkinnedData::clear()
 //}
 
 void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos, std::vector<XMFLOAT4X4>& finalTransforms)const
+{
+	std::vector<XMFLOAT4X4> toParentTransforms;
+	std::vector<XMFLOAT4X4> toRootTransforms;
+	GetFinalTransforms(clipName, timePos, finalTransforms, toParentTransforms, toRootTransforms);
+}
+
+void SkinnedData::GetFinalTransforms(
+	const std::string& clipName,
+	float timePos,
+	std::vector<XMFLOAT4X4>& finalTransforms,
+	std::vector<XMFLOAT4X4>& toParentTransforms,
+	std::vector<XMFLOAT4X4>& toRootTransforms)const
 {
 	UINT numBones = (UINT)mBoneOffsets.size();
 
-	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
+	// Grows once, then reused. Bones the clip does not animate stay zero.
+	toParentTransforms.assign(numBones, XMFLOAT4X4());
 
 	// Interpolate all the bones of this clip at the given time instance.
 	auto clip = mAnimations.find(clipName);
@@ -214,7 +227,7 @@ void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,
 	//
 	// Traverse the hierarchy and transform all the bones to the root space.
 	//
-	std::vector<XMFLOAT4X4> toRootTransforms(numBones);
+	toRootTransforms.resize(numBones);
 
 	// The root bone has index 0.  The root bone has no parent, so its toRootTransform
 	// is just its local bone transform.
@@ -0,0 +1,197 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+#ifdef ALLOCATION_COUNTER
+namespace
+{
+	// Plain data only, operator new runs before and during static initialization
+	thread_local uint64_t gThreadCount = 0;
+	std::atomic<uint64_t> gTotalCount{ 0 };
+
+	void* Allocate(std::size_t size)
+	{
+		++gThreadCount;
+		gTotalCount.fetch_add(1, std::memory_order_relaxed);
+		return std::malloc(size ? size : 1);
+	}
+
+#ifdef __cpp_aligned_new
+	// Over-aligned types (alignas above the default new alignment) come through here in C++17
+	void* AllocateAligned(std::size_t size, std::align_val_t alignment)
+	{
+		++gThreadCount;
+		gTotalCount.fetch_add(1, std::memory_order_relaxed);
+		std::size_t align = static_cast<std::size_t>(alignment);
+		if (!size)
+			size = 1;
+#ifdef _MSC_VER
+		return _aligned_malloc(size, align);
+#else
+		void* p = nullptr;
+		return posix_memalign(&p, align < sizeof(void*) ? sizeof(void*) : align, size) == 0 ? p : nullptr;
+#endif
+	}
+
+	void FreeAligned(void* p)
+	{
+#ifdef _MSC_VER
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+#endif
+}
+
+uint64_t AllocationCounter::GetThreadCount()
+{
+	return gThreadCount;
+}
+
+uint64_t AllocationCounter::GetTotalCount()
+{
+	return gTotalCount.load(std::memory_order_relaxed);
+}
+
+bool AllocationCounter::IsCounting()
+{
+	return true;
+}
+
+void* operator new(std::size_t size)
+{
+	void* p = Allocate(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](std::size_t size)
+{
+	void* p = Allocate(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	void* p = AllocateAligned(size, alignment);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	void* p = AllocateAligned(size, alignment);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(p);
+}
+#endif
+
+#else
+
+uint64_t AllocationCounter::GetThreadCount()
+{
+	return 0;
+}
+
+uint64_t AllocationCounter::GetTotalCount()
+{
+	return 0;
+}
+
+bool AllocationCounter::IsCounting()
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,368 @@
+#include "CollisionWorld.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	// Distance kept from a surface after a contact, so the next sweep does not start inside it
+	const float Skin = 0.01f;
+	const uint32_t MaxSlides = 3;
+
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	float Length(const float v[3])
+	{
+		return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	}
+}
+
+const uint32_t CollisionWorld::LeafSize;
+
+void CollisionWorld::Build(const CullBox* boxes, uint32_t count)
+{
+	mStatic.assign(boxes, boxes + count);
+	mItems.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		mItems[i] = i;
+
+	mNodes.clear();
+	if (count > 0)
+	{
+		mNodes.reserve(2 * count / LeafSize + 1);
+		mNodes.emplace_back();
+		BuildNode(0, 0, count);
+	}
+}
+
+void CollisionWorld::BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count)
+{
+	Node node;
+	float centerMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float centerMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int a = 0; a < 3; ++a)
+	{
+		node.Min[a] = FLT_MAX;
+		node.Max[a] = -FLT_MAX;
+	}
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const CullBox& b = mStatic[mItems[i]];
+		for (int a = 0; a < 3; ++a)
+		{
+			node.Min[a] = (std::min)(node.Min[a], b.Center[a] - b.Extents[a]);
+			node.Max[a] = (std::max)(node.Max[a], b.Center[a] + b.Extents[a]);
+			centerMin[a] = (std::min)(centerMin[a], b.Center[a]);
+			centerMax[a] = (std::max)(centerMax[a], b.Center[a]);
+		}
+	}
+	node.Left = 0;
+	node.First = first;
+	node.Count = count;
+
+	if (count <= LeafSize)
+	{
+		mNodes[nodeIndex] = node;
+		return;
+	}
+
+	// Median split along the widest spread of centers
+	int axis = 0;
+	for (int a = 1; a < 3; ++a)
+	{
+		if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis])
+			axis = a;
+	}
+
+	uint32_t half = count / 2;
+	std::nth_element(mItems.begin() + first, mItems.begin() + first + half, mItems.begin() + first + count,
+		[this, axis](uint32_t l, uint32_t r) { return mStatic[l].Center[axis] < mStatic[r].Center[axis]; });
+
+	node.Left = (uint32_t)mNodes.size();
+	node.Count = 0;
+	mNodes[nodeIndex] = node;
+	mNodes.emplace_back();
+	mNodes.emplace_back();
+
+	BuildNode(node.Left, first, half);
+	BuildNode(node.Left + 1, first + half, count - half);
+}
+
+void CollisionWorld::SetDynamicBoxes(const CullBox* boxes, uint32_t count)
+{
+	mDynamic.assign(boxes, boxes + count);
+}
+
+void CollisionWorld::TestBox(const CullBox& target, uint32_t item, const CullBox& box, const float delta[3], SweepHit& hit, bool& found) const
+{
+	++mTestCount;
+
+	// The moving center against the target grown by the moving box
+	float tEnter = -FLT_MAX;
+	float tExit = FLT_MAX;
+	int enterAxis = -1;
+	float enterSign = 0.0f;
+
+	for (int a = 0; a < 3; ++a)
+	{
+		float extent = target.Extents[a] + box.Extents[a];
+		float low = target.Center[a] - extent - box.Center[a];
+		float high = target.Center[a] + extent - box.Center[a];
+
+		if (std::fabs(delta[a]) < 1e-8f)
+		{
+			if (low >= 0.0f || high <= 0.0f)
+				return;
+			continue;
+		}
+
+		float t0 = low / delta[a];
+		float t1 = high / delta[a];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		if (t0 > tEnter)
+		{
+			tEnter = t0;
+			enterAxis = a;
+			enterSign = delta[a] > 0.0f ? -1.0f : 1.0f;
+		}
+		tExit = (std::min)(tExit, t1);
+		if (tEnter >= tExit)
+			return;
+	}
+
+	if (tExit <= 0.0f || tEnter > 1.0f)
+		return;
+
+	float normal[3] = { 0.0f, 0.0f, 0.0f };
+	if (tEnter >= 0.0f && enterAxis >= 0)
+	{
+		normal[enterAxis] = enterSign;
+	}
+	else
+	{
+		// Already overlapping: push out along the shallowest axis, and only block motion deeper in
+		int axis = 0;
+		float depth = FLT_MAX;
+		for (int a = 0; a < 3; ++a)
+		{
+			float offset = box.Center[a] - target.Center[a];
+			float d = target.Extents[a] + box.Extents[a] - std::fabs(offset);
+			if (d < depth)
+			{
+				depth = d;
+				axis = a;
+			}
+		}
+		normal[axis] = box.Center[axis] >= target.Center[axis] ? 1.0f : -1.0f;
+		if (delta[axis] * normal[axis] >= 0.0f)
+			return;
+		tEnter = 0.0f;
+	}
+
+	// Earliest contact, ties to the lower index so results do not depend on traversal order
+	if (!found || tEnter < hit.Time || (tEnter == hit.Time && item < hit.Item))
+	{
+		hit.Time = tEnter;
+		hit.Normal[0] = normal[0];
+		hit.Normal[1] = normal[1];
+		hit.Normal[2] = normal[2];
+		hit.Item = item;
+		found = true;
+	}
+}
+
+bool CollisionWorld::Sweep(const CullBox& box, const float delta[3], SweepHit& hit) const
+{
+	mTestCount = 0;
+	bool found = false;
+
+	// Bounds of the whole path
+	float pathMin[3], pathMax[3];
+	for (int a = 0; a < 3; ++a)
+	{
+		pathMin[a] = box.Center[a] - box.Extents[a] + (std::min)(delta[a], 0.0f);
+		pathMax[a] = box.Center[a] + box.Extents[a] + (std::max)(delta[a], 0.0f);
+	}
+
+	if (!mNodes.empty())
+	{
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = mNodes[stack[--stackSize]];
+
+			bool overlaps = true;
+			for (int a = 0; a < 3; ++a)
+				overlaps = overlaps && node.Min[a] <= pathMax[a] && node.Max[a] >= pathMin[a];
+			if (!overlaps)
+				continue;
+
+			if (node.Count > 0)
+			{
+				for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+					TestBox(mStatic[mItems[i]], mItems[i], box, delta, hit, found);
+			}
+			else
+			{
+				stack[stackSize++] = node.Left;
+				stack[stackSize++] = node.Left + 1;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)mDynamic.size(); ++i)
+		TestBox(mDynamic[i], (uint32_t)mStatic.size() + i, box, delta, hit, found);
+
+	return found;
+}
+
+bool CollisionWorld::SweepBruteForce(const CullBox& box, const float delta[3], SweepHit& hit) const
+{
+	mTestCount = 0;
+	bool found = false;
+	for (uint32_t i = 0; i < (uint32_t)mStatic.size(); ++i)
+		TestBox(mStatic[i], i, box, delta, hit, found);
+	for (uint32_t i = 0; i < (uint32_t)mDynamic.size(); ++i)
+		TestBox(mDynamic[i], (uint32_t)mStatic.size() + i, box, delta, hit, found);
+	return found;
+}
+
+void CollisionWorld::Move(const CullBox& box, const float delta[3], float outDelta[3], std::vector<SweepHit>& contacts) const
+{
+	CullBox current = box;
+	float remaining[3] = { delta[0], delta[1], delta[2] };
+	outDelta[0] = outDelta[1] = outDelta[2] = 0.0f;
+	uint32_t testCount = 0;
+
+	for (uint32_t slide = 0; slide < MaxSlides; ++slide)
+	{
+		float length = Length(remaining);
+		if (length < 1e-6f)
+			break;
+
+		SweepHit hit;
+		bool blocked = Sweep(current, remaining, hit);
+		testCount += mTestCount;
+
+		// Up to the contact, less the skin
+		float t = blocked ? (std::max)(hit.Time - Skin / length, 0.0f) : 1.0f;
+		for (int a = 0; a < 3; ++a)
+		{
+			outDelta[a] += remaining[a] * t;
+			current.Center[a] += remaining[a] * t;
+		}
+		if (!blocked)
+			break;
+
+		contacts.push_back(hit);
+
+		// Slide the rest along the face
+		float dot = 0.0f;
+		for (int a = 0; a < 3; ++a)
+		{
+			remaining[a] *= 1.0f - t;
+			dot += remaining[a] * hit.Normal[a];
+		}
+		for (int a = 0; a < 3; ++a)
+			remaining[a] -= dot * hit.Normal[a];
+	}
+
+	mTestCount = testCount;
+}
+
+uint32_t CollisionWorld::GetStaticCount() const
+{
+	return (uint32_t)mStatic.size();
+}
+
+uint32_t CollisionWorld::GetNodeCount() const
+{
+	return (uint32_t)mNodes.size();
+}
+
+uint32_t CollisionWorld::GetTestCount() const
+{
+	return mTestCount;
+}
+
+void CollisionWorld::Benchmark(uint32_t propCount, uint32_t moveCount, BenchmarkResult& result)
+{
+	result = BenchmarkResult();
+
+	// About one prop per 400 square units whatever the count
+	float side = std::sqrt((float)propCount * 400.0f);
+	std::mt19937 engine{ 1234u };
+	std::uniform_real_distribution<float> disPos{ 0.0f, side };
+	std::uniform_real_distribution<float> disExtent{ 1.0f, 6.0f };
+	std::uniform_real_distribution<float> disStep{ -1.0f, 1.0f };
+
+	std::vector<CullBox> boxes(propCount);
+	for (auto& b : boxes)
+	{
+		b.Center[0] = disPos(engine);
+		b.Center[1] = 5.0f;
+		b.Center[2] = disPos(engine);
+		b.Extents[0] = disExtent(engine);
+		b.Extents[1] = 5.0f;
+		b.Extents[2] = disExtent(engine);
+	}
+
+	CollisionWorld world;
+	world.Build(boxes.data(), propCount);
+
+	std::vector<CullBox> probes(moveCount);
+	std::vector<float> deltas(3 * moveCount);
+	for (uint32_t i = 0; i < moveCount; ++i)
+	{
+		CullBox& p = probes[i];
+		p.Center[0] = disPos(engine);
+		p.Center[1] = 5.0f;
+		p.Center[2] = disPos(engine);
+		p.Extents[0] = p.Extents[2] = 1.5f;
+		p.Extents[1] = 4.0f;
+		deltas[3 * i] = disStep(engine);
+		deltas[3 * i + 1] = 0.0f;
+		deltas[3 * i + 2] = disStep(engine);
+	}
+
+	std::vector<SweepHit> contacts;
+	std::vector<float> treeDeltas(3 * moveCount);
+	uint64_t tests = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < moveCount; ++i)
+	{
+		contacts.clear();
+		world.Move(probes[i], &deltas[3 * i], &treeDeltas[3 * i], contacts);
+		tests += world.GetTestCount();
+	}
+	result.TreeTime = ElapsedMs(start) * 1e6f / (std::max)(moveCount, 1u);
+	result.TestsPerMove = (float)tests / (std::max)(moveCount, 1u);
+
+	// The same first sweep against every box
+	for (uint32_t i = 0; i < moveCount; ++i)
+	{
+		SweepHit treeHit, bruteHit;
+		bool treeFound = world.Sweep(probes[i], &deltas[3 * i], treeHit);
+		bool bruteFound = world.SweepBruteForce(probes[i], &deltas[3 * i], bruteHit);
+		if (treeFound != bruteFound || (treeFound && (treeHit.Item != bruteHit.Item || treeHit.Time != bruteHit.Time)))
+			result.Mismatches++;
+	}
+
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < moveCount; ++i)
+	{
+		SweepHit hit;
+		world.SweepBruteForce(probes[i], &deltas[3 * i], hit);
+	}
+	result.BruteForceTime = ElapsedMs(start) * 1e6f / (std::max)(moveCount, 1u);
+}
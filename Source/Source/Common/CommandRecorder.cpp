@@ -0,0 +1,190 @@
+#include "CommandRecorder.h"
+
+// The command list comes with the Windows SDK, the counting recorder builds anywhere
+#ifdef _WIN32
+
+D3D12CommandRecorder::D3D12CommandRecorder(ID3D12GraphicsCommandList* cmdList)
+	: mCmdList(cmdList)
+{
+}
+
+void D3D12CommandRecorder::SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)
+{
+	mCmdList->RSSetViewports(1, &viewport);
+	mCmdList->RSSetScissorRects(1, &scissorRect);
+}
+
+void D3D12CommandRecorder::SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil)
+{
+	mCmdList->OMSetRenderTargets(1, &renderTarget, true, &depthStencil);
+}
+
+void D3D12CommandRecorder::SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+	ID3D12DescriptorHeap* descriptorHeaps[] = { heap };
+	mCmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+}
+
+void D3D12CommandRecorder::SetRootSignature(ID3D12RootSignature* rootSignature)
+{
+	mCmdList->SetGraphicsRootSignature(rootSignature);
+}
+
+void D3D12CommandRecorder::SetStencilRef(UINT stencilRef)
+{
+	mCmdList->OMSetStencilRef(stencilRef);
+}
+
+void D3D12CommandRecorder::SetPipelineState(ID3D12PipelineState* pipelineState)
+{
+	mCmdList->SetPipelineState(pipelineState);
+}
+
+void D3D12CommandRecorder::SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	mCmdList->IASetVertexBuffers(0, 1, &view);
+}
+
+void D3D12CommandRecorder::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	mCmdList->IASetIndexBuffer(&view);
+}
+
+void D3D12CommandRecorder::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY primitiveTopology)
+{
+	mCmdList->IASetPrimitiveTopology(primitiveTopology);
+}
+
+void D3D12CommandRecorder::SetRootConstants(UINT parameter, UINT count, const void* data)
+{
+	mCmdList->SetGraphicsRoot32BitConstants(parameter, count, data, 0);
+}
+
+void D3D12CommandRecorder::SetRootConstantBuffer(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	mCmdList->SetGraphicsRootConstantBufferView(parameter, address);
+}
+
+void D3D12CommandRecorder::SetRootShaderResource(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	mCmdList->SetGraphicsRootShaderResourceView(parameter, address);
+}
+
+void D3D12CommandRecorder::SetRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+	mCmdList->SetGraphicsRootDescriptorTable(parameter, baseDescriptor);
+}
+
+void D3D12CommandRecorder::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation)
+{
+	mCmdList->DrawIndexedInstanced(indexCount, instanceCount, startIndexLocation, baseVertexLocation, 0);
+}
+
+#endif
+
+UINT CommandCounts::GetCommandCount() const
+{
+	return FrameState + PipelineStates + BufferViews + Topologies + RootConstants + RootBuffers + DescriptorTables + Draws;
+}
+
+CommandCounts& CommandCounts::operator+=(const CommandCounts& rhs)
+{
+	FrameState += rhs.FrameState;
+	PipelineStates += rhs.PipelineStates;
+	BufferViews += rhs.BufferViews;
+	Topologies += rhs.Topologies;
+	RootConstants += rhs.RootConstants;
+	RootBuffers += rhs.RootBuffers;
+	DescriptorTables += rhs.DescriptorTables;
+	Draws += rhs.Draws;
+	Indices += rhs.Indices;
+	Instances += rhs.Instances;
+	RootBytes += rhs.RootBytes;
+	return *this;
+}
+
+void NullCommandRecorder::Reset()
+{
+	mCounts = CommandCounts();
+}
+
+const CommandCounts& NullCommandRecorder::GetCounts() const
+{
+	return mCounts;
+}
+
+void NullCommandRecorder::SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)
+{
+	mCounts.FrameState += 2;
+}
+
+void NullCommandRecorder::SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, D3D12_CPU_DESCRIPTOR_HANDLE depthStencil)
+{
+	mCounts.FrameState++;
+}
+
+void NullCommandRecorder::SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+	mCounts.FrameState++;
+}
+
+void NullCommandRecorder::SetRootSignature(ID3D12RootSignature* rootSignature)
+{
+	mCounts.FrameState++;
+}
+
+void NullCommandRecorder::SetStencilRef(UINT stencilRef)
+{
+	mCounts.FrameState++;
+}
+
+void NullCommandRecorder::SetPipelineState(ID3D12PipelineState* pipelineState)
+{
+	mCounts.PipelineStates++;
+}
+
+void NullCommandRecorder::SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	mCounts.BufferViews++;
+}
+
+void NullCommandRecorder::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	mCounts.BufferViews++;
+}
+
+void NullCommandRecorder::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY primitiveTopology)
+{
+	mCounts.Topologies++;
+}
+
+void NullCommandRecorder::SetRootConstants(UINT parameter, UINT count, const void* data)
+{
+	mCounts.RootConstants++;
+	mCounts.RootBytes += count * 4;
+}
+
+void NullCommandRecorder::SetRootConstantBuffer(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	mCounts.RootBuffers++;
+	mCounts.RootBytes += sizeof(address);
+}
+
+void NullCommandRecorder::SetRootShaderResource(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	mCounts.RootBuffers++;
+	mCounts.RootBytes += sizeof(address);
+}
+
+void NullCommandRecorder::SetRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+	mCounts.DescriptorTables++;
+	mCounts.RootBytes += sizeof(baseDescriptor.ptr);
+}
+
+void NullCommandRecorder::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation)
+{
+	mCounts.Draws++;
+	mCounts.Indices += indexCount;
+	mCounts.Instances += instanceCount;
+}
@@ -0,0 +1,338 @@
+#include "Crowd.h"
+#include "FlowField.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <emmintrin.h>
+
+namespace
+{
+	// The zone monsters' behaviour, per second
+	const float AggroRadius = 100.0f;
+	const float AttackRadius = 12.0f;
+	const float StopRadius = 8.0f;
+	const float WalkSpeed = 3.75f;
+	const float TurnRate = 0.75f;
+	const float AttackInterval = 5.0f;
+	const float RespawnTime = 7.0f;
+	const float SeparationRadius = 5.0f;
+	const float SeparationRate = 0.25f;
+
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	__m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	uint32_t LaneCount(__m128 mask)
+	{
+		int bits = _mm_movemask_ps(mask);
+		return (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+	}
+}
+
+void Crowd::Spawn(uint32_t count, float minX, float minZ, float maxX, float maxZ, float health, std::mt19937& engine)
+{
+	Clear();
+
+	std::uniform_real_distribution<float> disX{ minX, maxX };
+	std::uniform_real_distribution<float> disZ{ minZ, maxZ };
+
+	// Padding lanes stay dead and never respawn
+	uint32_t padded = (count + 3) & ~3u;
+	mCount = count;
+	mFullHealth = health;
+	mPosX.assign(padded, 0.0f);
+	mPosZ.assign(padded, 0.0f);
+	mHeadingX.assign(padded, 0.0f);
+	mHeadingZ.assign(padded, 1.0f);
+	mFlowX.assign(padded, 0.0f);
+	mFlowZ.assign(padded, 0.0f);
+	mSpawnX.assign(padded, 0.0f);
+	mSpawnZ.assign(padded, 0.0f);
+	mHealth.assign(padded, 0.0f);
+	mTimer.assign(padded, FLT_MAX);
+	mClip.assign(padded, (uint32_t)eCrowdClip::Death);
+	// A query finds at most every member
+	mQueryIds.reserve(count);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		mSpawnX[i] = mPosX[i] = disX(engine);
+		mSpawnZ[i] = mPosZ[i] = disZ(engine);
+		mHealth[i] = health;
+		mTimer[i] = 0.0f;
+		mClip[i] = (uint32_t)eCrowdClip::Idle;
+		mGrid.Insert(i, mPosX[i], mPosZ[i]);
+	}
+}
+
+void Crowd::Clear()
+{
+	mCount = 0;
+	mPosX.clear();
+	mPosZ.clear();
+	mHeadingX.clear();
+	mHeadingZ.clear();
+	mFlowX.clear();
+	mFlowZ.clear();
+	mSpawnX.clear();
+	mSpawnZ.clear();
+	mHealth.clear();
+	mTimer.clear();
+	mClip.clear();
+	mGrid.Clear();
+}
+
+uint32_t Crowd::Update(float targetX, float targetZ, float dt, const FlowField* field)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mAttacks = 0;
+	if (field)
+		ReadFlow(*field, targetX, targetZ);
+	else
+	{
+		std::fill(mFlowX.begin(), mFlowX.end(), 0.0f);
+		std::fill(mFlowZ.begin(), mFlowZ.end(), 0.0f);
+	}
+	UpdateLanes(targetX, targetZ, dt);
+
+	for (uint32_t i = 0; i < mCount; ++i)
+		mGrid.Move(i, mPosX[i], mPosZ[i]);
+	Separate(dt);
+
+	mUpdateTime = ElapsedMs(start);
+	return mAttacks;
+}
+
+void Crowd::ReadFlow(const FlowField& field, float targetX, float targetZ)
+{
+	// One cell lookup per member; within attack range they close in directly
+	for (uint32_t i = 0; i < mCount; ++i)
+	{
+		float dx = targetX - mPosX[i];
+		float dz = targetZ - mPosZ[i];
+		mFlowX[i] = mFlowZ[i] = 0.0f;
+		if (dx * dx + dz * dz > AttackRadius * AttackRadius)
+			field.GetDirection(mPosX[i], mPosZ[i], mFlowX[i], mFlowZ[i]);
+	}
+}
+
+void Crowd::UpdateLanes(float targetX, float targetZ, float dt)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 epsilon = _mm_set1_ps(1e-6f);
+	const __m128 delta = _mm_set1_ps(dt);
+	const __m128 turn = _mm_set1_ps((std::min)(TurnRate * dt, 1.0f));
+	const __m128 step = _mm_set1_ps(WalkSpeed * dt);
+	const __m128 tx = _mm_set1_ps(targetX);
+	const __m128 tz = _mm_set1_ps(targetZ);
+	const __m128 fullHealth = _mm_set1_ps(mFullHealth);
+	const __m128i deathClip = _mm_set1_epi32((int)eCrowdClip::Death);
+
+	for (size_t i = 0; i < mPosX.size(); i += 4)
+	{
+		__m128 px = _mm_loadu_ps(&mPosX[i]);
+		__m128 pz = _mm_loadu_ps(&mPosZ[i]);
+		__m128 hx = _mm_loadu_ps(&mHeadingX[i]);
+		__m128 hz = _mm_loadu_ps(&mHeadingZ[i]);
+		__m128 health = _mm_loadu_ps(&mHealth[i]);
+		__m128 timer = _mm_sub_ps(_mm_loadu_ps(&mTimer[i]), delta);
+		__m128i clip = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mClip[i]));
+
+		// Death starts the respawn countdown, which brings the member back at its spawn point
+		__m128 wasDead = _mm_castsi128_ps(_mm_cmpeq_epi32(clip, deathClip));
+		__m128 dead = _mm_cmple_ps(health, zero);
+		timer = Select(_mm_andnot_ps(wasDead, dead), _mm_set1_ps(RespawnTime), timer);
+
+		__m128 respawn = _mm_and_ps(_mm_and_ps(wasDead, dead), _mm_cmple_ps(timer, zero));
+		health = Select(respawn, fullHealth, health);
+		px = Select(respawn, _mm_loadu_ps(&mSpawnX[i]), px);
+		pz = Select(respawn, _mm_loadu_ps(&mSpawnZ[i]), pz);
+		timer = Select(respawn, zero, timer);
+		__m128 alive = _mm_cmpgt_ps(health, zero);
+
+		// Direction and distance to the target
+		__m128 dx = _mm_sub_ps(tx, px);
+		__m128 dz = _mm_sub_ps(tz, pz);
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)));
+		__m128 invDistance = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(distance, epsilon));
+		dx = _mm_mul_ps(dx, invDistance);
+		dz = _mm_mul_ps(dz, invDistance);
+
+		// The flow field's heading where it has one
+		__m128 fx = _mm_loadu_ps(&mFlowX[i]);
+		__m128 fz = _mm_loadu_ps(&mFlowZ[i]);
+		__m128 hasFlow = _mm_cmpneq_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fz, fz)), zero);
+		dx = Select(hasFlow, fx, dx);
+		dz = Select(hasFlow, fz, dz);
+
+		// Turn part of the way toward it, keeping the heading when the blend cancels out
+		__m128 nx = _mm_add_ps(hx, _mm_mul_ps(turn, _mm_sub_ps(dx, hx)));
+		__m128 nz = _mm_add_ps(hz, _mm_mul_ps(turn, _mm_sub_ps(dz, hz)));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(nz, nz)));
+		__m128 turned = _mm_and_ps(alive, _mm_cmpgt_ps(length, epsilon));
+		length = _mm_max_ps(length, epsilon);
+		hx = Select(turned, _mm_div_ps(nx, length), hx);
+		hz = Select(turned, _mm_div_ps(nz, length), hz);
+
+		__m128 inAttack = _mm_cmplt_ps(distance, _mm_set1_ps(AttackRadius));
+		__m128 inStop = _mm_cmplt_ps(distance, _mm_set1_ps(StopRadius));
+		__m128 inAggro = _mm_cmplt_ps(distance, _mm_set1_ps(AggroRadius));
+
+		// Strike on the cooldown
+		__m128 strike = _mm_and_ps(_mm_and_ps(alive, inAttack), _mm_cmple_ps(timer, zero));
+		mAttacks += LaneCount(strike);
+		timer = Select(strike, _mm_set1_ps(AttackInterval), timer);
+		timer = Select(alive, _mm_max_ps(timer, zero), timer);
+
+		// Back off when too close, walk while chasing
+		__m128 walk = _mm_andnot_ps(inAttack, inAggro);
+		__m128 move = Select(inStop, _mm_sub_ps(zero, step), _mm_and_ps(walk, step));
+		move = _mm_and_ps(alive, move);
+		px = _mm_add_ps(px, _mm_mul_ps(hx, move));
+		pz = _mm_add_ps(pz, _mm_mul_ps(hz, move));
+
+		__m128 clipValue = _mm_and_ps(walk, _mm_set1_ps((float)eCrowdClip::Walking));
+		clipValue = Select(inAttack, _mm_set1_ps((float)eCrowdClip::Attack), clipValue);
+		clipValue = Select(alive, clipValue, _mm_set1_ps((float)eCrowdClip::Death));
+
+		_mm_storeu_ps(&mPosX[i], px);
+		_mm_storeu_ps(&mPosZ[i], pz);
+		_mm_storeu_ps(&mHeadingX[i], hx);
+		_mm_storeu_ps(&mHeadingZ[i], hz);
+		_mm_storeu_ps(&mHealth[i], health);
+		_mm_storeu_ps(&mTimer[i], timer);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&mClip[i]), _mm_cvttps_epi32(clipValue));
+	}
+}
+
+void Crowd::Separate(float dt)
+{
+	const uint32_t deathClip = (uint32_t)eCrowdClip::Death;
+	const float rate = SeparationRate * dt;
+
+	for (uint32_t i = 0; i < mCount; ++i)
+	{
+		if (mClip[i] == deathClip)
+			continue;
+
+		// Step away from every living neighbour within reach
+		mGrid.QueryRadius(mPosX[i], mPosZ[i], SeparationRadius, mQueryIds);
+		float pushX = 0.0f;
+		float pushZ = 0.0f;
+		for (uint32_t j : mQueryIds)
+		{
+			if (j == i || mClip[j] == deathClip)
+				continue;
+
+			pushX += mPosX[i] - mPosX[j];
+			pushZ += mPosZ[i] - mPosZ[j];
+		}
+
+		if (pushX != 0.0f || pushZ != 0.0f)
+		{
+			mPosX[i] += rate * pushX;
+			mPosZ[i] += rate * pushZ;
+			mGrid.Move(i, mPosX[i], mPosZ[i]);
+		}
+	}
+}
+
+uint32_t Crowd::Damage(float x, float z, float radius, float damage)
+{
+	uint32_t hits = 0;
+
+	mGrid.QueryRadius(x, z, radius, mQueryIds);
+	for (uint32_t i : mQueryIds)
+	{
+		if (mHealth[i] <= 0.0f)
+			continue;
+
+		mHealth[i] = (std::max)(mHealth[i] - damage, 0.0f);
+		++hits;
+	}
+	return hits;
+}
+
+uint32_t Crowd::GetCount() const
+{
+	return mCount;
+}
+
+uint32_t Crowd::GetAliveCount() const
+{
+	uint32_t alive = 0;
+	for (uint32_t i = 0; i < mCount; ++i)
+		alive += mClip[i] != (uint32_t)eCrowdClip::Death;
+	return alive;
+}
+
+float Crowd::GetPositionX(uint32_t i) const
+{
+	return mPosX[i];
+}
+
+float Crowd::GetPositionZ(uint32_t i) const
+{
+	return mPosZ[i];
+}
+
+float Crowd::GetHeadingX(uint32_t i) const
+{
+	return mHeadingX[i];
+}
+
+float Crowd::GetHeadingZ(uint32_t i) const
+{
+	return mHeadingZ[i];
+}
+
+float Crowd::GetHealth(uint32_t i) const
+{
+	return mHealth[i];
+}
+
+eCrowdClip Crowd::GetClip(uint32_t i) const
+{
+	return (eCrowdClip)mClip[i];
+}
+
+const SpatialGrid& Crowd::GetGrid() const
+{
+	return mGrid;
+}
+
+float Crowd::GetUpdateTime() const
+{
+	return mUpdateTime;
+}
+
+float Crowd::Benchmark(uint32_t count, uint32_t frames)
+{
+	// Same density at every size, the target in the middle
+	float side = std::sqrt((float)count * 25.0f);
+	std::mt19937 engine{ 1234u };
+
+	Crowd crowd;
+	crowd.Spawn(count, -side * 0.5f, -side * 0.5f, side * 0.5f, side * 0.5f, 100.0f, engine);
+
+	float totalTime = 0.0f;
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		crowd.Update(0.0f, 0.0f, 1.0f / 60.0f);
+		totalTime += crowd.GetUpdateTime();
+
+		// Keep some members dying and respawning
+		if (frame % 30 == 0)
+			crowd.Damage(0.0f, 0.0f, 20.0f, 50.0f);
+	}
+	return totalTime / (std::max)(frames, 1u);
+}
@@ -0,0 +1,362 @@
+#include "Culling.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CULLING_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	enum : int
+	{
+		Outside = 0,
+		Intersecting = 1,
+		Inside = 2
+	};
+
+	// Classify four boxes given in SoA form. Returns bit masks of the lanes outside and fully inside.
+	void ClassifyBoxes4Scalar(const Frustum& frustum,
+		const float* cx, const float* cy, const float* cz,
+		const float* ex, const float* ey, const float* ez,
+		int& outsideMask, int& insideMask)
+	{
+		outsideMask = 0;
+		insideMask = 0;
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			bool out = false;
+			bool cross = false;
+			for (int i = 0; i < 6; ++i)
+			{
+				const float* p = frustum.Planes[i];
+				// Summed in the order of the SSE path so both round the same
+				float distance = (p[0] * cx[lane] + p[1] * cy[lane]) + (p[2] * cz[lane] + p[3]);
+				float radius = (std::fabs(p[0]) * ex[lane] + std::fabs(p[1]) * ey[lane]) + std::fabs(p[2]) * ez[lane];
+				out |= distance + radius < 0.0f;
+				cross |= distance - radius < 0.0f;
+			}
+			outsideMask |= (out ? 1 : 0) << lane;
+			insideMask |= (cross ? 0 : 1) << lane;
+		}
+	}
+
+	void ClassifyBoxes4(const Frustum& frustum,
+		const float* cx, const float* cy, const float* cz,
+		const float* ex, const float* ey, const float* ez,
+		int& outsideMask, int& insideMask)
+	{
+#ifdef CULLING_SSE
+		__m128 centerX = _mm_loadu_ps(cx);
+		__m128 centerY = _mm_loadu_ps(cy);
+		__m128 centerZ = _mm_loadu_ps(cz);
+		__m128 extentX = _mm_loadu_ps(ex);
+		__m128 extentY = _mm_loadu_ps(ey);
+		__m128 extentZ = _mm_loadu_ps(ez);
+		__m128 zero = _mm_setzero_ps();
+
+		__m128 outside = zero;
+		__m128 crossing = zero;
+		for (int i = 0; i < 6; ++i)
+		{
+			const float* p = frustum.Planes[i];
+
+			// Signed distance of the center and the box radius projected on the plane normal
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0]), centerX), _mm_mul_ps(_mm_set1_ps(p[1]), centerY)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[2]), centerZ), _mm_set1_ps(p[3])));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(p[0])), extentX), _mm_mul_ps(_mm_set1_ps(std::fabs(p[1])), extentY)),
+				_mm_mul_ps(_mm_set1_ps(std::fabs(p[2])), extentZ));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			crossing = _mm_or_ps(crossing, _mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+		}
+
+		outsideMask = _mm_movemask_ps(outside);
+		insideMask = ~_mm_movemask_ps(crossing) & 0xf;
+#else
+		ClassifyBoxes4Scalar(frustum, cx, cy, cz, ex, ey, ez, outsideMask, insideMask);
+#endif
+	}
+
+	typedef void (*ClassifyFunction)(const Frustum&,
+		const float*, const float*, const float*,
+		const float*, const float*, const float*,
+		int&, int&);
+
+	void CullBoxesWith(ClassifyFunction classify, const Frustum& frustum, const CullBox* boxes, uint32_t count, uint8_t* visible)
+	{
+		for (uint32_t first = 0; first < count; first += 4)
+		{
+			uint32_t lanes = (std::min)(count - first, 4u);
+
+			// Gather to SoA, unused lanes repeat the last box
+			float c[3][4], e[3][4];
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				const CullBox& box = boxes[first + (std::min)(lane, lanes - 1)];
+				for (int k = 0; k < 3; ++k)
+				{
+					c[k][lane] = box.Center[k];
+					e[k][lane] = box.Extents[k];
+				}
+			}
+
+			int outsideMask = 0;
+			int insideMask = 0;
+			classify(frustum, c[0], c[1], c[2], e[0], e[1], e[2], outsideMask, insideMask);
+
+			for (uint32_t lane = 0; lane < lanes; ++lane)
+				visible[first + lane] = (outsideMask >> lane) & 1 ? 0 : 1;
+		}
+	}
+}
+
+Frustum Frustum::FromViewProj(const float m[16])
+{
+	// Column j of the matrix is m[j], m[4 + j], m[8 + j], m[12 + j]
+	auto column = [m](int j, float* out)
+	{
+		for (int i = 0; i < 4; ++i)
+			out[i] = m[i * 4 + j];
+	};
+
+	float c0[4], c1[4], c2[4], c3[4];
+	column(0, c0);
+	column(1, c1);
+	column(2, c2);
+	column(3, c3);
+
+	Frustum frustum;
+	for (int i = 0; i < 4; ++i)
+	{
+		frustum.Planes[0][i] = c3[i] + c0[i];
+		frustum.Planes[1][i] = c3[i] - c0[i];
+		frustum.Planes[2][i] = c3[i] + c1[i];
+		frustum.Planes[3][i] = c3[i] - c1[i];
+		frustum.Planes[4][i] = c2[i];
+		frustum.Planes[5][i] = c3[i] - c2[i];
+	}
+
+	for (auto& p : frustum.Planes)
+	{
+		float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		if (length > 0.0f)
+		{
+			for (int i = 0; i < 4; ++i)
+				p[i] /= length;
+		}
+	}
+
+	return frustum;
+}
+
+void CullBoxes(const Frustum& frustum, const CullBox* boxes, uint32_t count, uint8_t* visible)
+{
+	CullBoxesWith(ClassifyBoxes4, frustum, boxes, count, visible);
+}
+
+void CullBoxesScalar(const Frustum& frustum, const CullBox* boxes, uint32_t count, uint8_t* visible)
+{
+	CullBoxesWith(ClassifyBoxes4Scalar, frustum, boxes, count, visible);
+}
+
+void CullBVH::Build(const CullBox* boxes, uint32_t count)
+{
+	mNodes.clear();
+	mBoxes.assign(boxes, boxes + count);
+	mItems.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		mItems[i] = i;
+
+	if (count > 0)
+		BuildNode(0, count);
+
+	// SoA copies in tree order; the padding lets a leaf at the end load four lanes
+	uint32_t padded = count + 3;
+	for (int k = 0; k < 3; ++k)
+	{
+		mItemCenters[k].assign(padded, 0.0f);
+		mItemExtents[k].assign(padded, 0.0f);
+	}
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const CullBox& box = mBoxes[mItems[i]];
+		for (int k = 0; k < 3; ++k)
+		{
+			mItemCenters[k][i] = box.Center[k];
+			mItemExtents[k][i] = box.Extents[k];
+		}
+	}
+}
+
+// Splits [first, first + count) in up to four groups by two median cuts on the longest centroid axis
+uint32_t CullBVH::BuildNode(uint32_t first, uint32_t count)
+{
+	uint32_t nodeIndex = (uint32_t)mNodes.size();
+	mNodes.emplace_back();
+	for (uint32_t slot = 0; slot < 4; ++slot)
+	{
+		mNodes[nodeIndex].Count[slot] = 0;
+		mNodes[nodeIndex].Child[slot] = Leaf;
+	}
+
+	auto split = [this](uint32_t begin, uint32_t n)
+	{
+		float minC[3] = { INFINITY, INFINITY, INFINITY };
+		float maxC[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (uint32_t i = begin; i < begin + n; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				minC[k] = (std::min)(minC[k], mBoxes[mItems[i]].Center[k]);
+				maxC[k] = (std::max)(maxC[k], mBoxes[mItems[i]].Center[k]);
+			}
+		}
+
+		int axis = 0;
+		for (int k = 1; k < 3; ++k)
+		{
+			if (maxC[k] - minC[k] > maxC[axis] - minC[axis])
+				axis = k;
+		}
+
+		uint32_t half = n / 2;
+		std::nth_element(mItems.begin() + begin, mItems.begin() + begin + half, mItems.begin() + begin + n,
+			[this, axis](uint32_t a, uint32_t b) { return mBoxes[a].Center[axis] < mBoxes[b].Center[axis]; });
+		return half;
+	};
+
+	uint32_t ranges[4][2];
+	uint32_t rangeCount = 0;
+	if (count <= LeafSize)
+	{
+		ranges[rangeCount][0] = first;
+		ranges[rangeCount++][1] = count;
+	}
+	else
+	{
+		uint32_t half = split(first, count);
+		uint32_t halves[2][2] = { { first, half }, { first + half, count - half } };
+		for (auto& h : halves)
+		{
+			if (h[1] <= LeafSize)
+			{
+				ranges[rangeCount][0] = h[0];
+				ranges[rangeCount++][1] = h[1];
+				continue;
+			}
+
+			uint32_t quarter = split(h[0], h[1]);
+			ranges[rangeCount][0] = h[0];
+			ranges[rangeCount++][1] = quarter;
+			ranges[rangeCount][0] = h[0] + quarter;
+			ranges[rangeCount++][1] = h[1] - quarter;
+		}
+	}
+
+	for (uint32_t slot = 0; slot < rangeCount; ++slot)
+	{
+		// mNodes may grow inside BuildRange, so the node is looked up again each time
+		Node node = mNodes[nodeIndex];
+		BuildRange(ranges[slot][0], ranges[slot][1], node, slot);
+		mNodes[nodeIndex] = node;
+	}
+
+	return nodeIndex;
+}
+
+void CullBVH::BuildRange(uint32_t first, uint32_t count, Node& node, uint32_t slot)
+{
+	int32_t child = count > LeafSize ? (int32_t)BuildNode(first, count) : Leaf;
+
+	float minP[3] = { INFINITY, INFINITY, INFINITY };
+	float maxP[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const CullBox& box = mBoxes[mItems[i]];
+		for (int k = 0; k < 3; ++k)
+		{
+			minP[k] = (std::min)(minP[k], box.Center[k] - box.Extents[k]);
+			maxP[k] = (std::max)(maxP[k], box.Center[k] + box.Extents[k]);
+		}
+	}
+
+	node.CenterX[slot] = 0.5f * (minP[0] + maxP[0]);
+	node.CenterY[slot] = 0.5f * (minP[1] + maxP[1]);
+	node.CenterZ[slot] = 0.5f * (minP[2] + maxP[2]);
+	node.ExtentX[slot] = 0.5f * (maxP[0] - minP[0]);
+	node.ExtentY[slot] = 0.5f * (maxP[1] - minP[1]);
+	node.ExtentZ[slot] = 0.5f * (maxP[2] - minP[2]);
+	node.Child[slot] = child;
+	node.First[slot] = first;
+	node.Count[slot] = count;
+}
+
+void CullBVH::Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	if (mNodes.empty())
+		return;
+
+	uint32_t stack[64];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = mNodes[stack[--stackSize]];
+
+		int outsideMask = 0;
+		int insideMask = 0;
+		ClassifyBoxes4(frustum, node.CenterX, node.CenterY, node.CenterZ,
+			node.ExtentX, node.ExtentY, node.ExtentZ, outsideMask, insideMask);
+
+		for (uint32_t slot = 0; slot < 4; ++slot)
+		{
+			if (node.Count[slot] == 0 || (outsideMask >> slot) & 1)
+				continue;
+
+			if ((insideMask >> slot) & 1)
+			{
+				visible.insert(visible.end(), mItems.begin() + node.First[slot],
+					mItems.begin() + node.First[slot] + node.Count[slot]);
+			}
+			else if (node.Child[slot] == Leaf)
+			{
+				TestLeaf(frustum, node.First[slot], node.Count[slot], visible);
+			}
+			else
+			{
+				stack[stackSize++] = (uint32_t)node.Child[slot];
+			}
+		}
+	}
+}
+
+void CullBVH::TestLeaf(const Frustum& frustum, uint32_t first, uint32_t count, std::vector<uint32_t>& visible) const
+{
+	int outsideMask = 0;
+	int insideMask = 0;
+	ClassifyBoxes4(frustum,
+		&mItemCenters[0][first], &mItemCenters[1][first], &mItemCenters[2][first],
+		&mItemExtents[0][first], &mItemExtents[1][first], &mItemExtents[2][first],
+		outsideMask, insideMask);
+
+	for (uint32_t lane = 0; lane < count; ++lane)
+	{
+		if (!((outsideMask >> lane) & 1))
+			visible.push_back(mItems[first + lane]);
+	}
+}
+
+uint32_t CullBVH::GetItemCount() const
+{
+	return (uint32_t)mBoxes.size();
+}
+
+uint32_t CullBVH::GetNodeCount() const
+{
+	return (uint32_t)mNodes.size();
+}
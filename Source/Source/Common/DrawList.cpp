@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <random>
+#include <stdexcept>
+#include "DrawList.h"
+
+namespace
+{
+	// Key layout, most significant first. The low 16 bits are left zero.
+	const UINT LayerBits = 4;
+	const UINT PSOBits = 6;
+	const UINT GeometryBits = 10;
+	const UINT MaterialBits = 12;
+	const UINT DepthBits = 16;
+
+	const UINT DepthShift = 16;
+	const UINT MaterialShift = DepthShift + DepthBits;
+	const UINT GeometryShift = MaterialShift + MaterialBits;
+	const UINT PSOShift = GeometryShift + GeometryBits;
+	const UINT LayerShift = PSOShift + PSOBits;
+
+	UINT64 Field(UINT64 value, UINT bits, UINT shift)
+	{
+		return (value & ((1ull << bits) - 1)) << shift;
+	}
+
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+DrawList::DrawList()
+{
+}
+
+DrawList::~DrawList()
+{
+}
+
+void DrawList::SetPipelineStates(const std::vector<ID3D12PipelineState*>& pipelineStates)
+{
+	if (pipelineStates.size() > (1ull << PSOBits))
+		throw std::runtime_error("Too many pipeline states for the draw key");
+
+	mPipelineStates = pipelineStates;
+}
+
+void DrawList::SetRootParameters(UINT drawConstants, UINT skinnedCB, UINT palette, UINT instances)
+{
+	mDrawConstantsParameter = drawConstants;
+	mSkinnedCBParameter = skinnedCB;
+	mPaletteParameter = palette;
+	mInstancesParameter = instances;
+}
+
+void DrawList::Clear()
+{
+	mCommands.clear();
+}
+
+void DrawList::Add(const DrawCommand& command)
+{
+	mCommands.push_back(command);
+}
+
+void DrawList::Sort()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	BuildKeys();
+	mKeyTime = ElapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	RadixSort();
+	mSortTime = ElapsedMs(start);
+
+	mStateChanges = 0;
+	mRootBindings = 0;
+}
+
+void DrawList::Execute(CommandRecorder& recorder)
+{
+	Execute(recorder, 0, (UINT)mOrder.size());
+}
+
+void DrawList::Execute(CommandRecorder& recorder, UINT first, UINT count)
+{
+	UINT stateChanges = 0;
+	UINT rootBindings = 0;
+
+	UINT pso = UINT_MAX;
+	const void* geo = nullptr;
+	D3D12_PRIMITIVE_TOPOLOGY primitiveType = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	DrawConstants constants = { UINT_MAX, UINT_MAX };
+	D3D12_GPU_VIRTUAL_ADDRESS instances = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS skinnedCB = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS palette = 0;
+
+	UINT last = (std::min)(first + count, (UINT)mOrder.size());
+	for (UINT i = first; i < last; ++i)
+	{
+		const DrawCommand& c = mCommands[mOrder[i]];
+
+		if (c.PSO != pso)
+		{
+			recorder.SetPipelineState(mPipelineStates[c.PSO]);
+			pso = c.PSO;
+			stateChanges++;
+		}
+
+		if (c.Geo != geo)
+		{
+			recorder.SetVertexBuffer(c.VertexBuffer);
+			recorder.SetIndexBuffer(c.IndexBuffer);
+			geo = c.Geo;
+			stateChanges += 2;
+		}
+
+		if (c.PrimitiveType != primitiveType)
+		{
+			recorder.SetPrimitiveTopology(c.PrimitiveType);
+			primitiveType = c.PrimitiveType;
+			stateChanges++;
+		}
+
+		if (c.Constants.ObjIndex != constants.ObjIndex || c.Constants.MatIndex != constants.MatIndex)
+		{
+			recorder.SetRootConstants(mDrawConstantsParameter, sizeof(DrawConstants) / 4, &c.Constants);
+			constants = c.Constants;
+			rootBindings++;
+		}
+
+		if (c.Instances != 0 && c.Instances != instances)
+		{
+			recorder.SetRootShaderResource(mInstancesParameter, c.Instances);
+			instances = c.Instances;
+			rootBindings++;
+		}
+
+		if (c.SkinnedCB != 0 && c.SkinnedCB != skinnedCB)
+		{
+			recorder.SetRootConstantBuffer(mSkinnedCBParameter, c.SkinnedCB);
+			skinnedCB = c.SkinnedCB;
+			rootBindings++;
+		}
+
+		if (c.Palette != 0 && c.Palette != palette)
+		{
+			recorder.SetRootShaderResource(mPaletteParameter, c.Palette);
+			palette = c.Palette;
+			rootBindings++;
+		}
+
+		recorder.DrawIndexedInstanced(c.IndexCount, c.InstanceCount, c.StartIndexLocation, c.BaseVertexLocation);
+	}
+
+	mStateChanges += stateChanges + rootBindings;
+	mRootBindings += rootBindings;
+}
+
+UINT DrawList::GetDrawCount() const
+{
+	return (UINT)mCommands.size();
+}
+
+UINT DrawList::GetStateChanges() const
+{
+	return mStateChanges;
+}
+
+UINT DrawList::GetRootBindings() const
+{
+	return mRootBindings;
+}
+
+UINT DrawList::GetCommandCount() const
+{
+	return mStateChanges + (UINT)mCommands.size();
+}
+
+float DrawList::GetKeyTime() const
+{
+	return mKeyTime;
+}
+
+float DrawList::GetSortTime() const
+{
+	return mSortTime;
+}
+
+void DrawList::Benchmark(UINT drawCount, UINT iterations, float& keyTime, float& sortTime)
+{
+	// Fake geometries, only their addresses are used for the ids
+	std::vector<int> geometries(64);
+
+	std::mt19937 engine{ 1234u };
+	std::uniform_int_distribution<> disLayer{ 0, 7 };
+	std::uniform_int_distribution<> disPSO{ 0, 11 };
+	std::uniform_int_distribution<> disGeo{ 0, (int)geometries.size() - 1 };
+	std::uniform_int_distribution<> disMat{ 0, 63 };
+	std::uniform_real_distribution<float> disDepth{ 0.0f, 1.0f };
+
+	DrawList drawList;
+	for (UINT i = 0; i < drawCount; ++i)
+	{
+		DrawCommand command;
+		command.Layer = disLayer(engine);
+		command.PSO = disPSO(engine);
+		command.Geo = &geometries[disGeo(engine)];
+		command.Mat = disMat(engine);
+		command.Depth = disDepth(engine);
+		drawList.Add(command);
+	}
+
+	keyTime = 0.0f;
+	sortTime = 0.0f;
+	for (UINT i = 0; i < iterations; ++i)
+	{
+		drawList.Sort();
+		keyTime += drawList.GetKeyTime();
+		sortTime += drawList.GetSortTime();
+	}
+
+	if (iterations > 0)
+	{
+		keyTime /= iterations;
+		sortTime /= iterations;
+	}
+}
+
+void DrawList::BuildKeys()
+{
+	UINT count = (UINT)mCommands.size();
+	mKeys.resize(count);
+
+	for (UINT i = 0; i < count; ++i)
+	{
+		const DrawCommand& c = mCommands[i];
+
+		float depth = c.Depth < 0.0f ? 0.0f : (c.Depth > 1.0f ? 1.0f : c.Depth);
+		UINT64 quantizedDepth = (UINT64)(depth * (float)((1 << DepthBits) - 1));
+
+		mKeys[i] =
+			Field(c.Layer, LayerBits, LayerShift) |
+			Field(c.PSO, PSOBits, PSOShift);
+
+		if (!c.KeepOrder)
+		{
+			mKeys[i] |=
+				Field(GetGeometryId(c.Geo), GeometryBits, GeometryShift) |
+				Field((UINT64)c.Mat, MaterialBits, MaterialShift) |
+				Field(quantizedDepth, DepthBits, DepthShift);
+		}
+	}
+}
+
+// LSD radix sort on 8-bit digits. Stable, and digits that are equal in every key are skipped.
+void DrawList::RadixSort()
+{
+	UINT count = (UINT)mKeys.size();
+	mOrder.resize(count);
+	for (UINT i = 0; i < count; ++i)
+		mOrder[i] = i;
+
+	mTempKeys.resize(count);
+	mTempOrder.resize(count);
+
+	for (UINT shift = 0; shift < 64; shift += 8)
+	{
+		UINT histogram[256] = {};
+		for (UINT i = 0; i < count; ++i)
+			histogram[(mKeys[i] >> shift) & 0xff]++;
+
+		if (count == 0 || histogram[(mKeys[0] >> shift) & 0xff] == count)
+			continue;
+
+		UINT offset = 0;
+		for (UINT d = 0; d < 256; ++d)
+		{
+			UINT n = histogram[d];
+			histogram[d] = offset;
+			offset += n;
+		}
+
+		for (UINT i = 0; i < count; ++i)
+		{
+			UINT dst = histogram[(mKeys[i] >> shift) & 0xff]++;
+			mTempKeys[dst] = mKeys[i];
+			mTempOrder[dst] = mOrder[i];
+		}
+
+		mKeys.swap(mTempKeys);
+		mOrder.swap(mTempOrder);
+	}
+}
+
+UINT DrawList::GetGeometryId(const void* geo)
+{
+	auto it = mGeometryIds.find(geo);
+	if (it != mGeometryIds.end())
+		return it->second;
+
+	UINT id = (UINT)mGeometryIds.size();
+	if (id >= (1u << GeometryBits))
+		throw std::runtime_error("Too many geometries for the draw key");
+
+	mGeometryIds.emplace(geo, id);
+	return id;
+}
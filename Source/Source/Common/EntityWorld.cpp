@@ -0,0 +1,434 @@
+#include "EntityWorld.h"
+#include "CharacterComponents.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <random>
+#include <string>
+
+namespace
+{
+	const uint32_t ColumnAlign = 16;
+
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	uint32_t AlignUp(uint32_t value, uint32_t align)
+	{
+		return (value + align - 1) & ~(align - 1);
+	}
+}
+
+const uint32_t EntityWorld::ChunkBytes;
+const uint32_t EntityWorld::MaxComponents;
+
+std::vector<EntityWorld::ComponentInfo>& EntityWorld::Components()
+{
+	static std::vector<ComponentInfo> components;
+	return components;
+}
+
+uint32_t EntityWorld::RegisterComponent(uint32_t size, uint32_t align)
+{
+	auto& components = Components();
+	if (components.size() >= MaxComponents || align > ColumnAlign)
+		throw std::runtime_error("EntityWorld: too many component types, or one aligned over 16");
+
+	components.push_back({ size, align });
+	return (uint32_t)components.size() - 1;
+}
+
+uint32_t EntityWorld::FindArchetype(ComponentMask mask)
+{
+	auto it = mArchetypeIndex.find(mask);
+	if (it != mArchetypeIndex.end())
+		return it->second;
+
+	const auto& components = Components();
+	uint32_t rowBytes = sizeof(Entity);
+	for (uint32_t id = 0; id < MaxComponents; ++id)
+	{
+		if (mask & (1u << id))
+			rowBytes += components[id].Size;
+	}
+
+	// As many rows as fit once every array is aligned
+	Archetype archetype;
+	archetype.Mask = mask;
+	std::fill(std::begin(archetype.Offsets), std::end(archetype.Offsets), 0u);
+	for (uint32_t capacity = ChunkBytes / rowBytes; capacity > 0; --capacity)
+	{
+		uint32_t offset = AlignUp(capacity * (uint32_t)sizeof(Entity), ColumnAlign);
+		for (uint32_t id = 0; id < MaxComponents; ++id)
+		{
+			if (!(mask & (1u << id)))
+				continue;
+			archetype.Offsets[id] = offset;
+			offset = AlignUp(offset + capacity * components[id].Size, ColumnAlign);
+		}
+
+		if (offset <= ChunkBytes)
+		{
+			archetype.Capacity = capacity;
+			break;
+		}
+	}
+	if (archetype.Capacity == 0)
+		throw std::runtime_error("EntityWorld: components do not fit in a chunk");
+
+	mArchetypes.push_back(std::move(archetype));
+	mArchetypeIndex[mask] = (uint32_t)mArchetypes.size() - 1;
+	return (uint32_t)mArchetypes.size() - 1;
+}
+
+Entity EntityWorld::Allocate()
+{
+	Entity e;
+	if (!mFreeIndices.empty())
+	{
+		e.Index = mFreeIndices.back();
+		mFreeIndices.pop_back();
+	}
+	else
+	{
+		e.Index = (uint32_t)mRecords.size();
+		mRecords.push_back({ 0, 0, 0, 0, false });
+	}
+
+	Record& record = mRecords[e.Index];
+	record.Alive = true;
+	e.Generation = record.Generation;
+	++mEntityCount;
+	return e;
+}
+
+void EntityWorld::Insert(Entity e, uint32_t archetypeIndex)
+{
+	Archetype& archetype = mArchetypes[archetypeIndex];
+	if (archetype.Chunks.empty() || archetype.Chunks.back().Count == archetype.Capacity)
+	{
+		Chunk chunk;
+		if (archetype.Spare)
+			chunk.Data = std::move(archetype.Spare);
+		else
+			chunk.Data.reset(new uint8_t[ChunkBytes]);
+		archetype.Chunks.push_back(std::move(chunk));
+	}
+
+	Chunk& chunk = archetype.Chunks.back();
+	uint32_t row = chunk.Count++;
+	reinterpret_cast<Entity*>(chunk.Data.get())[row] = e;
+
+	const auto& components = Components();
+	for (uint32_t id = 0; id < MaxComponents; ++id)
+	{
+		if (archetype.Mask & (1u << id))
+			std::memset(chunk.Data.get() + archetype.Offsets[id] + row * components[id].Size, 0, components[id].Size);
+	}
+
+	Record& record = mRecords[e.Index];
+	record.Archetype = archetypeIndex;
+	record.Chunk = (uint32_t)archetype.Chunks.size() - 1;
+	record.Row = row;
+}
+
+void EntityWorld::Erase(const Record& record)
+{
+	Archetype& archetype = mArchetypes[record.Archetype];
+	Chunk& last = archetype.Chunks.back();
+	uint32_t lastChunk = (uint32_t)archetype.Chunks.size() - 1;
+	uint32_t lastRow = last.Count - 1;
+
+	if (record.Chunk != lastChunk || record.Row != lastRow)
+	{
+		Chunk& hole = archetype.Chunks[record.Chunk];
+		Entity moved = reinterpret_cast<Entity*>(last.Data.get())[lastRow];
+		reinterpret_cast<Entity*>(hole.Data.get())[record.Row] = moved;
+
+		const auto& components = Components();
+		for (uint32_t id = 0; id < MaxComponents; ++id)
+		{
+			if (!(archetype.Mask & (1u << id)))
+				continue;
+			uint32_t size = components[id].Size;
+			std::memcpy(hole.Data.get() + archetype.Offsets[id] + record.Row * size,
+				last.Data.get() + archetype.Offsets[id] + lastRow * size, size);
+		}
+
+		mRecords[moved.Index].Chunk = record.Chunk;
+		mRecords[moved.Index].Row = record.Row;
+	}
+
+	if (--last.Count == 0)
+	{
+		if (!archetype.Spare)
+			archetype.Spare = std::move(last.Data);
+		archetype.Chunks.pop_back();
+	}
+}
+
+void EntityWorld::Move(Entity e, ComponentMask mask)
+{
+	Record from = mRecords[e.Index];
+	uint32_t to = FindArchetype(mask);
+	Insert(e, to);
+
+	// Carry over the components both archetypes have
+	const auto& components = Components();
+	const Record& record = mRecords[e.Index];
+	ComponentMask shared = mArchetypes[from.Archetype].Mask & mask;
+	for (uint32_t id = 0; id < MaxComponents; ++id)
+	{
+		if (!(shared & (1u << id)))
+			continue;
+		uint32_t size = components[id].Size;
+		std::memcpy(Column(record, id) + record.Row * size, Column(from, id) + from.Row * size, size);
+	}
+
+	Erase(from);
+}
+
+uint8_t* EntityWorld::Column(const Record& record, uint32_t id)
+{
+	const Archetype& archetype = mArchetypes[record.Archetype];
+	return archetype.Chunks[record.Chunk].Data.get() + archetype.Offsets[id];
+}
+
+void EntityWorld::Destroy(Entity e)
+{
+	if (!IsAlive(e))
+		return;
+
+	Record& record = mRecords[e.Index];
+	Erase(record);
+	record.Alive = false;
+	++record.Generation;
+	mFreeIndices.push_back(e.Index);
+	--mEntityCount;
+}
+
+bool EntityWorld::IsAlive(Entity e) const
+{
+	return e.Index < mRecords.size() && mRecords[e.Index].Alive && mRecords[e.Index].Generation == e.Generation;
+}
+
+uint32_t EntityWorld::GetEntityCount() const
+{
+	return mEntityCount;
+}
+
+uint32_t EntityWorld::GetArchetypeCount() const
+{
+	return (uint32_t)mArchetypes.size();
+}
+
+uint32_t EntityWorld::GetChunkCount() const
+{
+	uint32_t count = 0;
+	for (auto& e : mArchetypes)
+		count += (uint32_t)e.Chunks.size();
+	return count;
+}
+
+namespace
+{
+	struct BenchInstance
+	{
+		float World[16];
+		uint32_t MaterialIndex;
+		uint32_t PaletteOffset;
+	};
+
+	// The game's layout: gameplay data in one object, drawing in render items it points at
+	struct ClassRenderItem
+	{
+		float World[16];
+		float TexTransform[16];
+		RenderComponent Render;
+		bool Visible;
+	};
+
+	struct ClassCharacter
+	{
+		std::string ClipName;
+		float Bounds[6];
+		TransformComponent Transform;
+		MovementComponent Movement;
+		HealthComponent Health;
+		AnimationComponent Animation;
+		bool isDeath;
+		std::unique_ptr<ClassRenderItem> Body;
+		std::unique_ptr<ClassRenderItem> HealthBar;
+	};
+
+	// Both layouts run the same steps, so their results match bit for bit
+	void StepMovement(TransformComponent& t, const MovementComponent& m, const float turn[4], float dt)
+	{
+		t.Position[0] += m.Look[0] * m.Speed * dt;
+		t.Position[2] += m.Look[2] * m.Speed * dt;
+
+		// Rotation * turn about y
+		float x = t.Rotation[0], y = t.Rotation[1], z = t.Rotation[2], w = t.Rotation[3];
+		t.Rotation[0] = w * turn[0] + x * turn[3] + y * turn[2] - z * turn[1];
+		t.Rotation[1] = w * turn[1] - x * turn[2] + y * turn[3] + z * turn[0];
+		t.Rotation[2] = w * turn[2] + x * turn[1] - y * turn[0] + z * turn[3];
+		t.Rotation[3] = w * turn[3] - x * turn[0] - y * turn[1] - z * turn[2];
+	}
+
+	void TurnLook(MovementComponent& m, float c, float s)
+	{
+		float x = m.Look[0];
+		float z = m.Look[2];
+		m.Look[0] = x * c + z * s;
+		m.Look[2] = z * c - x * s;
+	}
+
+	void StepAnimation(AnimationComponent& a, float dt)
+	{
+		a.TimePos += dt;
+		if (a.TimePos >= a.ClipLength)
+			a.TimePos -= a.ClipLength;
+	}
+
+	void WriteInstance(const TransformComponent& t, const RenderComponent& r, BenchInstance& out)
+	{
+		float x = t.Rotation[0], y = t.Rotation[1], z = t.Rotation[2], w = t.Rotation[3];
+		float s = t.Scale;
+		float* m = out.World;
+		m[0] = s * (1.0f - 2.0f * (y * y + z * z)); m[1] = s * 2.0f * (x * y + w * z); m[2] = s * 2.0f * (x * z - w * y); m[3] = 0.0f;
+		m[4] = s * 2.0f * (x * y - w * z); m[5] = s * (1.0f - 2.0f * (x * x + z * z)); m[6] = s * 2.0f * (y * z + w * x); m[7] = 0.0f;
+		m[8] = s * 2.0f * (x * z + w * y); m[9] = s * 2.0f * (y * z - w * x); m[10] = s * (1.0f - 2.0f * (x * x + y * y)); m[11] = 0.0f;
+		m[12] = t.Position[0]; m[13] = t.Position[1]; m[14] = t.Position[2]; m[15] = 1.0f;
+		out.MaterialIndex = r.MaterialIndex;
+		out.PaletteOffset = r.PaletteOffset;
+	}
+
+	float StepHealth(HealthComponent& h)
+	{
+		h.Health = h.Health > 0 ? h.Health - 1 : h.FullHealth;
+		return (float)h.Health / (float)h.FullHealth;
+	}
+}
+
+void EntityWorld::Benchmark(uint32_t characterCount, uint32_t frames, BenchmarkResult& result)
+{
+	std::mt19937 engine{ 1234u };
+	std::uniform_real_distribution<float> disPos{ -500.0f, 500.0f };
+	std::uniform_real_distribution<float> disAngle{ -3.14159265f, 3.14159265f };
+	std::uniform_int_distribution<int> disHealth{ 1, 100 };
+	std::uniform_int_distribution<uint32_t> disGap{ 1, 32 };
+
+	const float dt = 1.0f / 60.0f;
+	const float turnAngle = 0.5f * dt;
+	const float turn[4] = { 0.0f, std::sin(turnAngle * 0.5f), 0.0f, std::cos(turnAngle * 0.5f) };
+	const float turnCos = std::cos(turnAngle);
+	const float turnSin = std::sin(turnAngle);
+
+	std::vector<TransformComponent> transforms(characterCount);
+	std::vector<MovementComponent> movements(characterCount);
+	std::vector<HealthComponent> healths(characterCount);
+	std::vector<AnimationComponent> animations(characterCount);
+	for (uint32_t i = 0; i < characterCount; ++i)
+	{
+		float yaw = disAngle(engine);
+		transforms[i] = { { disPos(engine), 0.0f, disPos(engine) }, { 0.0f, std::sin(yaw * 0.5f), 0.0f, std::cos(yaw * 0.5f) }, 1.0f };
+		movements[i] = { { std::sin(yaw), 0.0f, std::cos(yaw) }, 3.75f, 0.5f };
+		healths[i] = { disHealth(engine), 100 };
+		animations[i] = { i % 4, 0.0f, 1.0f + 0.25f * (i % 4) };
+	}
+
+	// Objects allocated among other allocations, as they are after a few rounds
+	std::vector<std::unique_ptr<ClassCharacter>> characters(characterCount);
+	std::vector<std::unique_ptr<uint8_t[]>> clutter;
+	for (uint32_t i = 0; i < characterCount; ++i)
+	{
+		auto character = std::make_unique<ClassCharacter>();
+		clutter.emplace_back(new uint8_t[disGap(engine) * 16]);
+		character->Body = std::make_unique<ClassRenderItem>();
+		clutter.emplace_back(new uint8_t[disGap(engine) * 16]);
+		character->HealthBar = std::make_unique<ClassRenderItem>();
+
+		character->ClipName = "Idle";
+		character->Transform = transforms[i];
+		character->Movement = movements[i];
+		character->Health = healths[i];
+		character->Animation = animations[i];
+		character->isDeath = false;
+		character->Body->Render = { i, i % 8, i * 96 };
+		characters[i] = std::move(character);
+	}
+	std::shuffle(characters.begin(), characters.end(), engine);
+
+	EntityWorld world;
+	for (uint32_t i = 0; i < characterCount; ++i)
+	{
+		Entity e = world.Create<TransformComponent, MovementComponent, HealthComponent, AnimationComponent, RenderComponent>();
+		*world.Get<TransformComponent>(e) = transforms[i];
+		*world.Get<MovementComponent>(e) = movements[i];
+		*world.Get<HealthComponent>(e) = healths[i];
+		*world.Get<AnimationComponent>(e) = animations[i];
+		*world.Get<RenderComponent>(e) = { i, i % 8, i * 96 };
+	}
+
+	std::vector<BenchInstance> classInstances(characterCount);
+	std::vector<BenchInstance> entityInstances(characterCount);
+	std::vector<float> classBars(characterCount);
+	std::vector<float> entityBars(characterCount);
+
+	// AI, animation, instance upload and health bars, one object at a time
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		for (auto& c : characters)
+		{
+			TurnLook(c->Movement, turnCos, turnSin);
+			StepMovement(c->Transform, c->Movement, turn, dt);
+			StepAnimation(c->Animation, dt);
+			WriteInstance(c->Transform, c->Body->Render, classInstances[c->Body->Render.InstanceIndex]);
+			c->HealthBar->World[0] = StepHealth(c->Health);
+			classBars[c->Body->Render.InstanceIndex] = c->HealthBar->World[0];
+		}
+	}
+	result.ClassTime = ElapsedMs(start) / (std::max)(frames, 1u);
+
+	// The same work as systems, each over the arrays it reads
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		world.Each<TransformComponent, MovementComponent>([&](uint32_t count, const Entity*, TransformComponent* t, MovementComponent* m)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				TurnLook(m[i], turnCos, turnSin);
+				StepMovement(t[i], m[i], turn, dt);
+			}
+		});
+		world.Each<AnimationComponent>([&](uint32_t count, const Entity*, AnimationComponent* a)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+				StepAnimation(a[i], dt);
+		});
+		world.Each<TransformComponent, RenderComponent>([&](uint32_t count, const Entity*, TransformComponent* t, RenderComponent* r)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+				WriteInstance(t[i], r[i], entityInstances[r[i].InstanceIndex]);
+		});
+		world.Each<HealthComponent, RenderComponent>([&](uint32_t count, const Entity*, HealthComponent* h, RenderComponent* r)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+				entityBars[r[i].InstanceIndex] = StepHealth(h[i]);
+		});
+	}
+	result.EntityTime = ElapsedMs(start) / (std::max)(frames, 1u);
+
+	result.Mismatches = 0;
+	for (uint32_t i = 0; i < characterCount; ++i)
+	{
+		if (std::memcmp(&classInstances[i], &entityInstances[i], sizeof(BenchInstance)) != 0 || classBars[i] != entityBars[i])
+			++result.Mismatches;
+	}
+}
@@ -1,9 +1,11 @@
 #include "Textures.h"
 #include "Materials.h"
+#include "TextureManifest.h"
 #include "Player.h"
 #include "Monster.h"
 #include "FbxLoader.h"
 #include "FBXGenerator.h"
+#include "Occluder.h"
 
 FBXGenerator::FBXGenerator()
 	:mInBeginEndPair(false)
@@ -15,14 +17,14 @@ FBXGenerator::~FBXGenerator()
 {
 }
 
-void FBXGenerator::Begin(ID3D12Device * device, ID3D12GraphicsCommandList * cmdList, ID3D12DescriptorHeap* cbvHeap)
+void FBXGenerator::Begin(RenderDevice * device, ID3D12DescriptorHeap* cbvHeap, TextureManifest* textureManifest)
 {
 	if (mInBeginEndPair)
 		throw std::exception("Cannot nest Begin calls on a FBX Generator");
 
 	mDevice = device;
-	mCommandList = cmdList;
 	mCbvHeap = cbvHeap;
+	mTextureManifest = textureManifest;
 
 	mInBeginEndPair = true;
 }
@@ -33,8 +35,8 @@ void FBXGenerator::End()
 		throw std::exception("Begin must be called before End");
 
 	mDevice = nullptr;
-	mCommandList = nullptr;
 	mCbvHeap = nullptr;
+	mTextureManifest = nullptr;
 
 	mInBeginEndPair = false;
 }
@@ -45,11 +47,10 @@ void FBXGenerator::BuildFBXTexture(
 	Textures& mTexDiffuse, Textures& mTexturesNormal, Materials& mMaterials)
 {
 	// Begin
-	mTexDiffuse.Begin(mDevice, mCommandList, mCbvHeap);
-	mTexturesNormal.Begin(mDevice, mCommandList, mCbvHeap);
+	mTexDiffuse.Begin(mDevice, mCbvHeap);
+	mTexturesNormal.Begin(mDevice, mCbvHeap);
 
 	// Load Texture and Material
-	int MatIndex = mMaterials.GetSize();
 	for (int i = 0; i < outMaterial.size(); ++i)
 	{
 		std::string TextureName;
@@ -66,13 +67,8 @@ void FBXGenerator::BuildFBXTexture(
 				TextureFileName);
 
 			// Normal Map
-			std::wstring TextureNormalFileName;
-			TextureNormalFileName = TextureFileName.substr(0, TextureFileName.size() - 4);
-			TextureNormalFileName.append(L"_normal.jpg");
-			struct stat buffer;
-			std::string fileCheck;
-			fileCheck.assign(TextureNormalFileName.begin(), TextureNormalFileName.end());
-			if (stat(fileCheck.c_str(), &buffer) == 0)
+			const std::wstring& TextureNormalFileName = mTextureManifest->GetCompanion(TextureFileName, eTextureSlot::Normal);
+			if (!TextureNormalFileName.empty())
 			{
 				mTexturesNormal.SetTexture(
 					TextureName,
@@ -89,7 +85,6 @@ void FBXGenerator::BuildFBXTexture(
 			outMaterial[i].DiffuseAlbedo,
 			outMaterial[i].FresnelR0,
 			outMaterial[i].Roughness,
-			MatIndex++,
 			mTexDiffuse.GetTextureIndex(TextureName),
 			mTexturesNormal.GetTextureIndex(TextureName));
 	}
@@ -119,7 +114,7 @@ void FBXGenerator::LoadFBXPlayer(Player& mPlayer, Textures& mTexDiffuse, Texture
 	fbx.LoadFBX(outSkinnedInfo, "Death", FileName);
 	fbx.LoadFBX(outSkinnedInfo, "WalkingBackward", FileName);
 
-	mPlayer.BuildGeometry(mDevice, mCommandList, outSkinnedVertices, outIndices, outSkinnedInfo, "playerGeo");
+	mPlayer.BuildGeometry(mDevice, outSkinnedVertices, outIndices, outSkinnedInfo, "playerGeo");
 
 	BuildFBXTexture(outMaterial, "playerTex", "playerMat", mTexDiffuse, mTexturesNormal, mMaterials);
 }
@@ -166,7 +161,6 @@ void FBXGenerator::LoadFBXSubMonster(
 	std::unique_ptr<Monster> tempMonster = std::make_unique<Monster>();
 	tempMonster->BuildGeometry(
 		mDevice,
-		mCommandList,
 		outSkinnedVertices,
 		outIndices,
 		outSkinnedInfo,
@@ -186,6 +180,7 @@ void FBXGenerator::LoadFBXSubMonster(
 
 void FBXGenerator::LoadFBXArchitecture(
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& mGeometries, 
+	std::unordered_map<std::string, std::vector<CullBox>>& mOccluders,
 	Textures& mTexDiffuse, Textures& mTexturesNormal, Materials& mMaterials)
 {
 	// Architecture FBX
@@ -204,6 +199,7 @@ void FBXGenerator::LoadFBXArchitecture(
 	archVertex.push_back(outVertices);
 	archIndex.push_back(outIndices);
 	archName.push_back("house");
+	LoadOccluder(FileName, outVertices, outIndices, mOccluders["house"]);
 
 	outVertices.clear();
 	outIndices.clear();
@@ -214,6 +210,7 @@ void FBXGenerator::LoadFBXArchitecture(
 	archVertex.push_back(outVertices);
 	archIndex.push_back(outIndices);
 	archName.push_back("RockCluster");
+	LoadOccluder(FileName, outVertices, outIndices, mOccluders["RockCluster"]);
 
 	outVertices.clear();
 	outIndices.clear();
@@ -224,6 +221,7 @@ void FBXGenerator::LoadFBXArchitecture(
 	archVertex.push_back(outVertices);
 	archIndex.push_back(outIndices);
 	archName.push_back("Canyon0");
+	LoadOccluder(FileName, outVertices, outIndices, mOccluders["Canyon0"]);
 
 	outVertices.clear();
 	outIndices.clear();
@@ -234,6 +232,7 @@ void FBXGenerator::LoadFBXArchitecture(
 	archVertex.push_back(outVertices);
 	archIndex.push_back(outIndices);
 	archName.push_back("Canyon1");
+	LoadOccluder(FileName, outVertices, outIndices, mOccluders["Canyon1"]);
 
 	outVertices.clear();
 	outIndices.clear();
@@ -244,6 +243,7 @@ void FBXGenerator::LoadFBXArchitecture(
 	archVertex.push_back(outVertices);
 	archIndex.push_back(outIndices);
 	archName.push_back("Canyon2");
+	LoadOccluder(FileName, outVertices, outIndices, mOccluders["Canyon2"]);
 
 	outVertices.clear();
 	outIndices.clear();
@@ -254,6 +254,7 @@ void FBXGenerator::LoadFBXArchitecture(
 	archVertex.push_back(outVertices);
 	archIndex.push_back(outIndices);
 	archName.push_back("Rock0");
+	LoadOccluder(FileName, outVertices, outIndices, mOccluders["Rock0"]);
 
 	outVertices.clear();
 	outIndices.clear();
@@ -264,6 +265,7 @@ void FBXGenerator::LoadFBXArchitecture(
 	archVertex.push_back(outVertices);
 	archIndex.push_back(outIndices);
 	archName.push_back("Tree");
+	LoadOccluder(FileName, outVertices, outIndices, mOccluders["Tree"]);
 
 	outVertices.clear();
 	outIndices.clear();
@@ -274,6 +276,7 @@ void FBXGenerator::LoadFBXArchitecture(
 	archVertex.push_back(outVertices);
 	archIndex.push_back(outIndices);
 	archName.push_back("Leaf");
+	LoadOccluder(FileName, outVertices, outIndices, mOccluders["Leaf"]);
 
 	BuildArcheGeometry(archVertex, archIndex, archName, mGeometries);
 	BuildFBXTexture(outMaterial, "archiTex", "archiMat", mTexDiffuse, mTexturesNormal,  mMaterials);
@@ -283,6 +286,23 @@ void FBXGenerator::LoadFBXArchitecture(
 	outMaterial.clear();
 }
 
+// Cooked from the render mesh once and cached next to it
+void FBXGenerator::LoadOccluder(
+	const std::string& fileName,
+	const std::vector<Vertex>& vertices,
+	const std::vector<std::uint32_t>& indices,
+	std::vector<CullBox>& outBoxes)
+{
+	std::string occluderFileName = fileName + ".occluder";
+	if (Occluder::Load(occluderFileName, outBoxes) || vertices.empty())
+		return;
+
+	// The architecture is modeled Z up and left open underneath, where it stands on the ground
+	Occluder::Cook(&vertices[0].Pos, sizeof(Vertex), (uint32_t)vertices.size(),
+		indices.data(), (uint32_t)indices.size(), outBoxes, Occluder::SideNegZ);
+	Occluder::Save(occluderFileName, outBoxes);
+}
+
 void FBXGenerator::BuildArcheGeometry(
 	const std::vector<std::vector<Vertex>>& outVertices,
 	const std::vector<std::vector<std::uint32_t>>& outIndices,
@@ -344,11 +364,9 @@ void FBXGenerator::BuildArcheGeometry(
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(mDevice,
-		mCommandList, vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	geo->VertexBufferGPU = mDevice->CreateDefaultBuffer(vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(mDevice,
-		mCommandList, indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->IndexBufferGPU = mDevice->CreateDefaultBuffer(indices.data(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -0,0 +1,57 @@
+#include "FixedStep.h"
+#include <algorithm>
+
+const unsigned int FixedStep::MaxSteps;
+
+FixedStep::FixedStep(float rate)
+{
+	SetRate(rate);
+}
+
+void FixedStep::SetRate(float rate)
+{
+	mRate = (std::max)(rate, 1.0f);
+	mStep = 1.0f / mRate;
+}
+
+float FixedStep::GetRate() const
+{
+	return mRate;
+}
+
+float FixedStep::GetStep() const
+{
+	return mStep;
+}
+
+void FixedStep::Accumulate(float deltaTime)
+{
+	mAccumulator = (std::min)(mAccumulator + (std::max)(deltaTime, 0.0f), mStep * MaxSteps);
+	mStepCount = 0;
+}
+
+bool FixedStep::Step()
+{
+	if (mAccumulator < mStep)
+		return false;
+
+	mAccumulator -= mStep;
+	mTime += mStep;
+	++mStepCount;
+	return true;
+}
+
+float FixedStep::GetTime() const
+{
+	return (float)mTime;
+}
+
+float FixedStep::GetAlpha() const
+{
+	return (std::min)(mAccumulator / mStep, 1.0f);
+}
+
+unsigned int FixedStep::GetStepCount() const
+{
+	return mStepCount;
+}
@@ -0,0 +1,352 @@
+#include "FlowField.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	// Neighbours: four straight, then four diagonal
+	const int OffsetX[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+	const int OffsetZ[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+	const uint32_t StepCost[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+	const float Diagonal = 0.70710678f;
+	const float DirectionX[8] = { 1.0f, -1.0f, 0.0f, 0.0f, Diagonal, -Diagonal, Diagonal, -Diagonal };
+	const float DirectionZ[8] = { 0.0f, 0.0f, 1.0f, -1.0f, Diagonal, Diagonal, -Diagonal, -Diagonal };
+	const uint32_t BucketCount = 15;
+
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+const uint32_t FlowField::None;
+const uint32_t FlowField::Unreachable;
+
+void FlowField::Build(const CullBox* boxes, uint32_t count,
+	float minX, float minZ, float maxX, float maxZ,
+	float cellSize, float agentRadius)
+{
+	mMinX = minX;
+	mMinZ = minZ;
+	mCellSize = cellSize;
+	mInvCellSize = 1.0f / cellSize;
+	mWidth = (uint32_t)std::ceil((maxX - minX) * mInvCellSize);
+	mHeight = (uint32_t)std::ceil((maxZ - minZ) * mInvCellSize);
+
+	uint32_t cellCount = mWidth * mHeight;
+	mBlocked.assign(cellCount, 0);
+	mCost.assign(cellCount, Unreachable);
+	mDirection.assign(cellCount, (uint8_t)None);
+	mBuildCost.assign(cellCount, Unreachable);
+	mBuildDirection.assign(cellCount, (uint8_t)None);
+	mBuckets.assign(BucketCount, std::vector<uint32_t>());
+	mGoal = UINT32_MAX;
+	mRequestedGoal = UINT32_MAX;
+	mBuildState = eBuild::Idle;
+	mBuildTime = 0.0f;
+	mRebuildCount = 0;
+
+	// Every cell whose center lies in a footprint grown by the radius
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const CullBox& b = boxes[i];
+
+		// Lying on the ground, walked over
+		if (b.Center[1] + b.Extents[1] < 1.0f)
+			continue;
+
+		float x0 = b.Center[0] - b.Extents[0] - agentRadius;
+		float x1 = b.Center[0] + b.Extents[0] + agentRadius;
+		float z0 = b.Center[2] - b.Extents[2] - agentRadius;
+		float z1 = b.Center[2] + b.Extents[2] + agentRadius;
+
+		int cx0 = (std::max)((int)std::ceil((x0 - mMinX) * mInvCellSize - 0.5f), 0);
+		int cx1 = (std::min)((int)std::floor((x1 - mMinX) * mInvCellSize - 0.5f), (int)mWidth - 1);
+		int cz0 = (std::max)((int)std::ceil((z0 - mMinZ) * mInvCellSize - 0.5f), 0);
+		int cz1 = (std::min)((int)std::floor((z1 - mMinZ) * mInvCellSize - 0.5f), (int)mHeight - 1);
+
+		for (int z = cz0; z <= cz1; ++z)
+		{
+			for (int x = cx0; x <= cx1; ++x)
+				mBlocked[z * mWidth + x] = 1;
+		}
+	}
+
+	mBlockedCount = 0;
+	for (uint8_t e : mBlocked)
+		mBlockedCount += e;
+}
+
+bool FlowField::CellOf(float x, float z, uint32_t& cellX, uint32_t& cellZ) const
+{
+	float fx = std::floor((x - mMinX) * mInvCellSize);
+	float fz = std::floor((z - mMinZ) * mInvCellSize);
+	if (fx < 0.0f || fz < 0.0f || fx >= (float)mWidth || fz >= (float)mHeight)
+		return false;
+
+	cellX = (uint32_t)fx;
+	cellZ = (uint32_t)fz;
+	return true;
+}
+
+bool FlowField::SetGoal(float x, float z)
+{
+	uint32_t cellX, cellZ;
+	if (!CellOf(x, z, cellX, cellZ))
+		return false;
+
+	uint32_t goal = cellZ * mWidth + cellX;
+	if (goal == mRequestedGoal)
+		return false;
+
+	mRequestedGoal = goal;
+	return true;
+}
+
+bool FlowField::Step(uint32_t cellBudget)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	cellBudget = (std::max)(cellBudget, 1u);
+
+	if (mBuildState == eBuild::Idle && mRequestedGoal != UINT32_MAX && mRequestedGoal != mGoal)
+		BeginRebuild(mRequestedGoal);
+
+	bool swapped = mBuildState != eBuild::Idle && ContinueRebuild(cellBudget);
+
+	mStepTime = ElapsedMs(start);
+	mBuildTime += mStepTime;
+	if (swapped)
+	{
+		mRebuildTime = mBuildTime;
+		mBuildTime = 0.0f;
+		++mRebuildCount;
+	}
+	else if (mBuildState == eBuild::Idle)
+		mBuildTime = 0.0f;
+	return swapped;
+}
+
+void FlowField::BeginRebuild(uint32_t goal)
+{
+	std::fill(mBuildCost.begin(), mBuildCost.end(), Unreachable);
+	std::fill(mBuildDirection.begin(), mBuildDirection.end(), (uint8_t)None);
+	for (auto& bucket : mBuckets)
+		bucket.clear();
+
+	// The goal is seeded even when blocked, so a player against a wall still draws everyone in
+	mBuildGoal = goal;
+	mBuildCost[goal] = 0;
+	mBuckets[0].push_back(goal);
+	mPending = 1;
+	mSearchCost = 0;
+	mBucketIndex = 0;
+	mDirectionCell = 0;
+	mBuildState = eBuild::Search;
+}
+
+bool FlowField::ContinueRebuild(uint32_t cellBudget)
+{
+	uint32_t work = 0;
+
+	if (mBuildState == eBuild::Search)
+	{
+		for (; mPending > 0; ++mSearchCost)
+		{
+			auto& bucket = mBuckets[mSearchCost % BucketCount];
+
+			// Settling a cell only pushes into later buckets, so this one does not grow
+			for (; mBucketIndex < bucket.size(); ++mBucketIndex)
+			{
+				if (work == cellBudget)
+					return false;
+				++work;
+
+				uint32_t cell = bucket[mBucketIndex];
+				--mPending;
+				if (mBuildCost[cell] != mSearchCost)
+					continue;
+
+				int x = (int)(cell % mWidth);
+				int z = (int)(cell / mWidth);
+				for (int n = 0; n < 8; ++n)
+				{
+					int nx = x + OffsetX[n];
+					int nz = z + OffsetZ[n];
+					if (nx < 0 || nz < 0 || nx >= (int)mWidth || nz >= (int)mHeight)
+						continue;
+
+					uint32_t next = nz * mWidth + nx;
+					if (mBlocked[next])
+						continue;
+					// No corner cutting past a blocked cell
+					if (n >= 4 && (mBlocked[z * mWidth + nx] || mBlocked[nz * mWidth + x]))
+						continue;
+
+					uint32_t nextCost = mSearchCost + StepCost[n];
+					if (nextCost < mBuildCost[next])
+					{
+						mBuildCost[next] = nextCost;
+						mBuckets[nextCost % BucketCount].push_back(next);
+						++mPending;
+					}
+				}
+			}
+			bucket.clear();
+			mBucketIndex = 0;
+		}
+		mBuildState = eBuild::Directions;
+	}
+
+	// Each reached cell points at its cheapest neighbour
+	uint32_t cellCount = mWidth * mHeight;
+	for (; mDirectionCell < cellCount; ++mDirectionCell)
+	{
+		if (work == cellBudget)
+			return false;
+		++work;
+
+		uint32_t cell = mDirectionCell;
+		if (cell == mBuildGoal || mBuildCost[cell] == Unreachable)
+			continue;
+
+		int x = (int)(cell % mWidth);
+		int z = (int)(cell / mWidth);
+		uint32_t best = mBuildCost[cell];
+		for (int n = 0; n < 8; ++n)
+		{
+			int nx = x + OffsetX[n];
+			int nz = z + OffsetZ[n];
+			if (nx < 0 || nz < 0 || nx >= (int)mWidth || nz >= (int)mHeight)
+				continue;
+			if (n >= 4 && (mBlocked[z * mWidth + nx] || mBlocked[nz * mWidth + x]))
+				continue;
+
+			uint32_t nextCost = mBuildCost[nz * mWidth + nx];
+			if (nextCost < best)
+			{
+				best = nextCost;
+				mBuildDirection[cell] = (uint8_t)n;
+			}
+		}
+	}
+
+	// Agents read the new field from here on
+	mCost.swap(mBuildCost);
+	mDirection.swap(mBuildDirection);
+	mGoal = mBuildGoal;
+	mBuildState = eBuild::Idle;
+	return true;
+}
+
+bool FlowField::GetDirection(float x, float z, float& dirX, float& dirZ) const
+{
+	uint32_t cellX, cellZ;
+	if (!CellOf(x, z, cellX, cellZ))
+		return false;
+
+	uint8_t n = mDirection[cellZ * mWidth + cellX];
+	if (n == None)
+		return false;
+
+	dirX = DirectionX[n];
+	dirZ = DirectionZ[n];
+	return true;
+}
+
+float FlowField::GetDistance(float x, float z) const
+{
+	uint32_t cellX, cellZ;
+	if (!CellOf(x, z, cellX, cellZ))
+		return -1.0f;
+
+	uint32_t cost = mCost[cellZ * mWidth + cellX];
+	if (cost == Unreachable)
+		return -1.0f;
+	return (float)cost * 0.1f * mCellSize;
+}
+
+uint32_t FlowField::GetWidth() const
+{
+	return mWidth;
+}
+
+uint32_t FlowField::GetHeight() const
+{
+	return mHeight;
+}
+
+uint32_t FlowField::GetBlockedCount() const
+{
+	return mBlockedCount;
+}
+
+float FlowField::GetRebuildTime() const
+{
+	return mRebuildTime;
+}
+
+float FlowField::GetStepTime() const
+{
+	return mStepTime;
+}
+
+uint32_t FlowField::GetRebuildCount() const
+{
+	return mRebuildCount;
+}
+
+void FlowField::Benchmark(uint32_t side, uint32_t rebuilds, uint32_t cellBudget, BenchmarkResult& result)
+{
+	result = BenchmarkResult();
+
+	// One box per 64 cells, as cluttered as the level
+	std::mt19937 engine{ 1234u };
+	std::uniform_real_distribution<float> disPos{ 0.0f, (float)side };
+	std::uniform_real_distribution<float> disExtent{ 0.5f, 3.0f };
+
+	std::vector<CullBox> boxes(side * side / 64);
+	for (auto& b : boxes)
+	{
+		b.Center[0] = disPos(engine);
+		b.Center[1] = 5.0f;
+		b.Center[2] = disPos(engine);
+		b.Extents[0] = disExtent(engine);
+		b.Extents[1] = 5.0f;
+		b.Extents[2] = disExtent(engine);
+	}
+
+	FlowField whole, sliced;
+	whole.Build(boxes.data(), (uint32_t)boxes.size(), 0.0f, 0.0f, (float)side, (float)side, 1.0f, 0.5f);
+	sliced.Build(boxes.data(), (uint32_t)boxes.size(), 0.0f, 0.0f, (float)side, (float)side, 1.0f, 0.5f);
+
+	uint32_t steps = 0;
+	uint32_t done = 0;
+	for (uint32_t i = 0; i < rebuilds; ++i)
+	{
+		float x = disPos(engine);
+		float z = disPos(engine);
+		if (!whole.SetGoal(x, z) || !sliced.SetGoal(x, z))
+			continue;
+
+		whole.Step();
+		result.RebuildTime += whole.GetRebuildTime();
+
+		bool swapped = false;
+		while (!swapped)
+		{
+			swapped = sliced.Step(cellBudget);
+			result.MaxStepTime = (std::max)(result.MaxStepTime, sliced.GetStepTime());
+			++steps;
+		}
+		++done;
+
+		for (size_t cell = 0; cell < whole.mDirection.size(); ++cell)
+			result.Mismatches += whole.mDirection[cell] != sliced.mDirection[cell];
+	}
+
+	result.RebuildTime /= (std::max)(done, 1u);
+	result.StepsPerRebuild = (float)steps / (std::max)(done, 1u);
+}
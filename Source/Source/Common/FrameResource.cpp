@@ -1,21 +1,41 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device * device, UINT passCount, UINT objectCount, UINT materialCount, UINT PlayerCount, UINT MonsterCount, UINT UICount, UINT MonsterUICount)
+FrameResource::FrameResource(RenderDevice* device, UINT objectCount, UINT materialCount, UINT UICount, UINT MonsterUICount, UINT64 UploadCapacity, UINT WorkerCount)
 {
-	ThrowIfFailed(device->CreateCommandAllocator(
-		D3D12_COMMAND_LIST_TYPE_DIRECT,
-		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
+	CmdListAlloc = device->CreateCommandAllocator();
 
-	PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-	MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
-	ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
-	PlayerCB = std::make_unique<UploadBuffer<CharacterConstants>>(device, PlayerCount, true);
-	MonsterCB = std::make_unique<UploadBuffer<CharacterConstants>>(device, MonsterCount, true);
-	UICB = std::make_unique<UploadBuffer<UIConstants>>(device, UICount, true);
-	MonsterUICB = std::make_unique<UploadBuffer<UIConstants>>(device, MonsterUICount, true);
+	// Draw resets each list before recording
+	WorkerCmdListAllocs.resize(WorkerCount);
+	WorkerCmdLists.resize(WorkerCount);
+	for (UINT i = 0; i < WorkerCount; ++i)
+	{
+		WorkerCmdListAllocs[i] = device->CreateCommandAllocator();
+		WorkerCmdLists[i] = device->CreateCommandList(WorkerCmdListAllocs[i].Get());
+	}
+
+	MaterialBuffer = std::make_unique<UploadBuffer<MaterialData>>(device, materialCount, false);
+	ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, false);
+	UICB = std::make_unique<UploadBuffer<UIConstants>>(device, UICount, false);
+	MonsterUICB = std::make_unique<UploadBuffer<UIConstants>>(device, MonsterUICount, false);
+	Allocator = std::make_unique<UploadAllocator>(device, UploadCapacity);
 }
 
 FrameResource::~FrameResource()
 {
 
+}
+
+UINT64 FrameResource::GetUploadBytes() const
+{
+	return MaterialBuffer->GetBytesWritten() + ObjectCB->GetBytesWritten() +
+		UICB->GetBytesWritten() + MonsterUICB->GetBytesWritten() +
+		Allocator->GetUsedSize();
+}
+
+void FrameResource::ResetUploadBytes()
+{
+	MaterialBuffer->ResetBytesWritten();
+	ObjectCB->ResetBytesWritten();
+	UICB->ResetBytesWritten();
+	MonsterUICB->ResetBytesWritten();
 }
\ No newline at end of file
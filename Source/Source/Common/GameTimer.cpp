@@ -6,7 +6,7 @@
 #include "GameTimer.h"
 
 GameTimer::GameTimer()
-: mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0), 
+: mSecondsPerCount(0.0), mDeltaTime(-1.0), mDeltaCounts(0), mBaseTime(0), 
   mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
 {
 	__int64 countsPerSec;
@@ -61,6 +61,30 @@ float GameTimer::DeltaTime()const
 	return (float)mDeltaTime;
 }
 
+__int64 GameTimer::DeltaCounts()const
+{
+	return mDeltaCounts;
+}
+
+__int64 GameTimer::TotalCounts()const
+{
+	if( mStopped )
+	{
+		return (mStopTime - mPausedTime)-mBaseTime;
+	}
+	return (mCurrTime-mPausedTime)-mBaseTime;
+}
+
+__int64 GameTimer::CountsPerSecond()const
+{
+	return (__int64)(1.0 / mSecondsPerCount + 0.5);
+}
+
+void GameTimer::SetCountsPerSecond(__int64 countsPerSec)
+{
+	mSecondsPerCount = 1.0 / (double)countsPerSec;
+}
+
 void GameTimer::Reset()
 {
 	__int64 currTime;
@@ -123,6 +147,7 @@ void GameTimer::Tick()
 	if( mStopped )
 	{
 		mDeltaTime = 0.0;
+		mDeltaCounts = 0;
 		return;
 	}
 
@@ -132,6 +157,7 @@ void GameTimer::Tick()
 
 	// Time difference between this frame and the previous.
 	mDeltaTime = (mCurrTime - mPrevTime)*mSecondsPerCount;
+	mDeltaCounts = mCurrTime - mPrevTime;
 
 	// Prepare for next frame.
 	mPrevTime = mCurrTime;
@@ -142,6 +168,18 @@ void GameTimer::Tick()
 	if(mDeltaTime < 0.0)
 	{
 		mDeltaTime = 0.0;
+		mDeltaCounts = 0;
 	}
 }
 
+// Tick to recorded counts instead of the clock, so TotalTime and DeltaTime
+// come out exactly as they did in the recorded run, pauses included.
+void GameTimer::Advance(__int64 deltaCounts, __int64 totalCounts)
+{
+	mCurrTime = (mBaseTime + mPausedTime) + totalCounts;
+	mDeltaTime = deltaCounts*mSecondsPerCount;
+	mDeltaCounts = deltaCounts;
+	mPrevTime = mCurrTime;
+	mStopped = false;
+}
+
@@ -0,0 +1,900 @@
+#include "HeadlessScene.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	// The game's root signature (eRootParameter) and the pipeline states its frame uses
+	enum class eRoot : UINT
+	{
+		DrawConstants,
+		TextureTable,
+		CubeMapTable,
+		MaterialBuffer,
+		ObjectBuffer,
+		UIBuffer,
+		MonsterUIBuffer,
+		PassCB,
+		SkinnedCB,
+		BonePalette,
+		InstanceBuffer,
+		LightBuffer,
+		LightClusterBuffer,
+		LightIndexBuffer
+	};
+
+	enum class ePSO : UINT
+	{
+		OpaqueInstanced,
+		Sky,
+		UI,
+		MonsterUI,
+		Player,
+		Monster,
+		PlayerShadow,
+		MonsterShadow,
+		Count
+	};
+
+	// LayerDrawOrder of the layers drawn
+	const UINT OpaqueLayer = 1;
+	const UINT ArchitectureLayer = 2;
+	const UINT SkyLayer = 3;
+	const UINT UILayer = 4;
+	const UINT CharacterLayer = 5;
+	const UINT MonsterLayer = 6;
+	const UINT ShadowLayer = 7;
+
+	// The mesh table built by BuildLevel
+	const UINT GroundMesh = 0;
+	const UINT PropMeshes = 1;
+	const UINT PropMeshCount = 6;
+	const UINT HouseMesh = PropMeshes + PropMeshCount;
+	const UINT SkyMesh = HouseMesh + 1;
+	const UINT QuadMesh = SkyMesh + 1;
+	const UINT PlayerMesh = QuadMesh + 1;
+	const UINT MonsterMesh = PlayerMesh + 1;
+	const UINT MeshCount = MonsterMesh + 1;
+	const UINT CharacterSubmeshes = 4;
+	const UINT MaterialCount = 32;
+
+	const float GroundHalf = 500.0f;
+	const float GroundTile = 50.0f;
+	// The default window
+	const float FovY = 0.25f * 3.14159265f;
+	const float Aspect = 800.0f / 600.0f;
+	const float NearZ = 1.0f;
+	const float FarZ = 1000.0f;
+	const D3D12_VIEWPORT Viewport = { 0.0f, 0.0f, 800.0f, 600.0f, 0.0f, 1.0f };
+	const D3D12_RECT ScissorRect = { 0, 0, 800, 600 };
+
+	// The per-draw descriptor tables before the bindless materials: diffuse, normal, object,
+	// material, UI, monster UI and skinned
+	const UINT DrawTableCount = 7;
+
+	const float PlayerSpeed = 20.0f;
+	const float PlayerTurnRate = 0.3f;
+	const float AttackInterval = 0.5f;
+	const float AttackReach = 6.0f;
+	const float AttackRadius = 8.0f;
+	const int AttackDamage = 40;
+	const float FlashLifetime = 0.3f;
+	// Flashes alive at once; more are dropped rather than growing the list mid-frame
+	const size_t MaxHitFlashes = 64;
+	const uint32_t FlowCellsPerFrame = 16384;
+	const UINT MinDrawsPerList = 64;
+
+	// Fake GPU addresses: meshes in one range, the frame's upload memory in another
+	const D3D12_GPU_VIRTUAL_ADDRESS MeshAddress = 0x100000000ull;
+	const D3D12_GPU_VIRTUAL_ADDRESS UploadAddress = 0x200000000ull;
+	const uint64_t UploadAlignment = 256;
+
+	// Same layouts as InstanceData, Light and the bone palette
+	struct Instance
+	{
+		float World[16];
+		float TexTransform[16];
+		UINT MaterialIndex;
+		UINT PaletteOffset;
+		UINT Pad[2];
+	};
+
+	struct Light
+	{
+		float Strength[3];
+		float FalloffStart;
+		float Direction[3];
+		float FalloffEnd;
+		float Position[3];
+		float SpotPower;
+	};
+
+	const UINT BonePaletteSize = 96;
+	const uint64_t PaletteBytes = BonePaletteSize * 16 * sizeof(float);
+	// PassConstants rounded up to its constant buffer size
+	const uint64_t PassBytes = 512;
+
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	void Identity(float m[16])
+	{
+		std::fill(m, m + 16, 0.0f);
+		m[0] = m[5] = m[10] = m[15] = 1.0f;
+	}
+
+	// Scale to the box and move to its center, row-major for row vectors
+	void BoxWorld(const CullBox& b, float m[16])
+	{
+		Identity(m);
+		m[0] = b.Extents[0];
+		m[5] = b.Extents[1];
+		m[10] = b.Extents[2];
+		m[12] = b.Center[0];
+		m[13] = b.Center[1];
+		m[14] = b.Center[2];
+	}
+
+	void Multiply(const float a[16], const float b[16], float out[16])
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				out[r * 4 + c] = a[r * 4] * b[c] + a[r * 4 + 1] * b[4 + c] + a[r * 4 + 2] * b[8 + c] + a[r * 4 + 3] * b[12 + c];
+			}
+		}
+	}
+
+	// XMMatrixLookAtLH with a +y up
+	void LookAt(const float eye[3], const float at[3], float m[16])
+	{
+		float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+		float zLength = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (float& e : z)
+			e /= zLength;
+
+		// x = up x z, y = z x x
+		float x[3] = { z[2], 0.0f, -z[0] };
+		float xLength = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= xLength;
+		x[2] /= xLength;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+		const float* axes[3] = { x, y, z };
+		for (int i = 0; i < 3; ++i)
+		{
+			m[i] = axes[i][0];
+			m[4 + i] = axes[i][1];
+			m[8 + i] = axes[i][2];
+			m[12 + i] = -(axes[i][0] * eye[0] + axes[i][1] * eye[1] + axes[i][2] * eye[2]);
+		}
+		m[3] = m[7] = m[11] = 0.0f;
+		m[15] = 1.0f;
+	}
+
+	// XMMatrixPerspectiveFovLH
+	void Perspective(float m[16])
+	{
+		float yScale = 1.0f / std::tan(0.5f * FovY);
+		float range = FarZ / (FarZ - NearZ);
+		std::fill(m, m + 16, 0.0f);
+		m[0] = yScale / Aspect;
+		m[5] = yScale;
+		m[10] = range;
+		m[11] = 1.0f;
+		m[14] = -NearZ * range;
+	}
+
+	void TransformPoint(const float p[3], const float m[16], float out[3])
+	{
+		for (int c = 0; c < 3; ++c)
+			out[c] = p[0] * m[c] + p[1] * m[4 + c] + p[2] * m[8 + c] + m[12 + c];
+	}
+}
+
+HeadlessScene::HeadlessScene(ThreadPool* threadPool)
+	: mThreadPool(threadPool)
+{
+}
+
+void HeadlessScene::Build(const HeadlessSettings& settings)
+{
+	mSettings = settings;
+	mTime = 0.0f;
+	mNextAttack = 0.0f;
+	mHitSequence = 0;
+	mPlayerYaw = 0.0f;
+	mPlayerDamage = 0.0f;
+	mHitFlashes.clear();
+	mHitFlashes.reserve(MaxHitFlashes);
+
+	std::mt19937 engine{ settings.Seed };
+	BuildLevel(engine);
+
+	// One crowd per band of the ground along x
+	uint32_t zoneCount = (std::max)(settings.ZoneCount, 1u);
+	float zoneWidth = 2.0f * GroundHalf / zoneCount;
+	mCrowds.clear();
+	mCrowds.resize(zoneCount);
+	for (uint32_t i = 0; i < zoneCount; ++i)
+	{
+		float minX = -GroundHalf + i * zoneWidth;
+		mCrowds[i].Spawn(settings.Population, minX + 10.0f, -GroundHalf + 10.0f, minX + zoneWidth - 10.0f, GroundHalf - 10.0f, 100.0f, engine);
+	}
+	mZoneScheduler.SetZoneCount(zoneCount);
+	mZoneScheduler.SetRates(settings.ActiveRate, settings.BackgroundRate);
+	mZoneScheduler.SetBudget(0.0f);
+
+	// A strike per zone per step, and the player's swing
+	mHits.SetCapacity(zoneCount * FixedStep::MaxSteps + 1);
+
+	mPlayerBox = { { 0.0f, 4.0f, 0.0f }, { 1.5f, 4.0f, 1.5f } };
+
+	mLightClusters.SetProjection(FovY, Aspect, NearZ, FarZ);
+	mLightClusters.Reserve((uint32_t)(mTorches.size() / 3 + MaxHitFlashes));
+	mLightBounds.reserve(mTorches.size() / 3 + MaxHitFlashes);
+
+	// One pose per clip, copied into the palette of every member playing it
+	mClipPalettes.resize((size_t)eCrowdClip::Count * BonePaletteSize * 16);
+	for (UINT clip = 0; clip < (UINT)eCrowdClip::Count; ++clip)
+	{
+		for (UINT bone = 0; bone < BonePaletteSize; ++bone)
+		{
+			float* m = &mClipPalettes[(clip * BonePaletteSize + bone) * 16];
+			Identity(m);
+			m[13] = 0.01f * clip * bone;
+		}
+	}
+
+	// Upload memory for the worst frame: every item and member visible, every light in every cluster
+	uint64_t lightCount = mTorches.size() / 3 + MaxHitFlashes;
+	uint64_t uploadSize =
+		PassBytes +
+		(mStaticBoxes.size() + 1) * sizeof(Instance) +
+		(settings.Population + 1) * (sizeof(Instance) + PaletteBytes) +
+		lightCount * sizeof(Light) +
+		LightClusters::ClusterCount * (sizeof(LightClusters::Range) + lightCount * sizeof(uint32_t)) +
+		8 * UploadAlignment;
+	mUploadMemory.assign((size_t)uploadSize, 0);
+	mUploadAllocator.Reset(uploadSize);
+
+	std::vector<ID3D12PipelineState*> pipelineStates((size_t)ePSO::Count, nullptr);
+	mDrawList.SetPipelineStates(pipelineStates);
+	mDrawList.SetRootParameters((UINT)eRoot::DrawConstants, (UINT)eRoot::SkinnedCB, (UINT)eRoot::BonePalette, (UINT)eRoot::InstanceBuffer);
+
+	// Everything a frame fills sized for the most it can hold, so frames never allocate:
+	// every item visible, every member of a zone, a recorder per thread
+	mVisibleStatic.reserve(mStaticBoxes.size());
+	mCrowdBoxes.reserve(settings.Population);
+	mCrowdVisible.reserve(settings.Population);
+	mPlayerContacts.reserve(8);
+	UINT maxLists = (mThreadPool != nullptr ? mThreadPool->GetThreadCount() : 0) + 1;
+	mRecorders.reserve(maxLists);
+
+	// The draw list learns every mesh and grows for every draw of a frame with all of them on screen
+	for (auto& b : mBatches)
+		b.InstanceCount = 1;
+	mCrowdInstances = 1;
+	CollectDraws();
+	for (auto& b : mBatches)
+		b.InstanceCount = 0;
+	mCrowdInstances = 0;
+	mDrawList.Clear();
+}
+
+// Ground tiles, scattered props and houses. The houses block movement and paths, hide what is
+// behind them and carry a torch at each corner.
+void HeadlessScene::BuildLevel(std::mt19937& engine)
+{
+	mMeshes.resize(MeshCount);
+	D3D12_GPU_VIRTUAL_ADDRESS address = MeshAddress;
+	for (UINT i = 0; i < MeshCount; ++i)
+	{
+		Mesh& m = mMeshes[i];
+		m.IndexCount = i == GroundMesh || i == QuadMesh ? 6 : 36 * (i + 1);
+		m.VertexBuffer = { address, m.IndexCount * 32, 32 };
+		address += 0x10000;
+		m.IndexBuffer = { address, m.IndexCount * 2, DXGI_FORMAT_R16_UINT };
+		address += 0x10000;
+	}
+
+	mStaticBoxes.clear();
+	mBatches.clear();
+	auto addBatch = [this](UINT mesh, MaterialHandle mat, UINT layer)
+	{
+		Batch b;
+		b.Geo = &mMeshes[mesh];
+		b.Mat = mat;
+		b.Layer = layer;
+		b.InstanceBase = 0;
+		b.InstanceCount = 0;
+		b.Instances = 0;
+		mBatches.push_back(b);
+		return (uint32_t)mBatches.size() - 1;
+	};
+	auto addItem = [this](uint32_t batch, const CullBox& box)
+	{
+		mBatches[batch].Items.push_back((uint32_t)mStaticBoxes.size());
+		mStaticBoxes.push_back(box);
+	};
+
+	uint32_t groundBatch = addBatch(GroundMesh, 0, OpaqueLayer);
+	for (float z = -GroundHalf; z < GroundHalf; z += GroundTile)
+	{
+		for (float x = -GroundHalf; x < GroundHalf; x += GroundTile)
+			addItem(groundBatch, { { x + 0.5f * GroundTile, -0.1f, z + 0.5f * GroundTile }, { 0.5f * GroundTile, 0.1f, 0.5f * GroundTile } });
+	}
+
+	// Two materials per prop mesh
+	std::uniform_real_distribution<float> disPos{ -GroundHalf + 5.0f, GroundHalf - 5.0f };
+	std::uniform_real_distribution<float> disPropExtent{ 1.0f, 4.0f };
+	std::uniform_int_distribution<uint32_t> disKind{ 0, 2 * PropMeshCount - 1 };
+	uint32_t firstPropBatch = (uint32_t)mBatches.size();
+	for (UINT i = 0; i < 2 * PropMeshCount; ++i)
+		addBatch(PropMeshes + i / 2, 1 + i, OpaqueLayer);
+	for (uint32_t i = 0; i < mSettings.PropCount; ++i)
+	{
+		float extent = disPropExtent(engine);
+		addItem(firstPropBatch + disKind(engine), { { disPos(engine), extent, disPos(engine) }, { extent, extent, extent } });
+	}
+
+	// Houses leave the player's start clear
+	std::uniform_real_distribution<float> disHouseExtent{ 10.0f, 25.0f };
+	uint32_t houseBatches[2] = { addBatch(HouseMesh, 20, ArchitectureLayer), addBatch(HouseMesh, 21, ArchitectureLayer) };
+	std::vector<CullBox> houses;
+	while (houses.size() < mSettings.HouseCount)
+	{
+		CullBox b = { { disPos(engine), 15.0f, disPos(engine) }, { disHouseExtent(engine), 15.0f, disHouseExtent(engine) } };
+		if (std::fabs(b.Center[0]) < b.Extents[0] + 20.0f && std::fabs(b.Center[2]) < b.Extents[2] + 20.0f)
+			continue;
+		houses.push_back(b);
+		addItem(houseBatches[houses.size() % 2], b);
+	}
+
+	mStaticBVH.Build(mStaticBoxes.data(), (uint32_t)mStaticBoxes.size());
+	mStaticVisible.assign(mStaticBoxes.size(), 0);
+
+	mCollision.Build(houses.data(), (uint32_t)houses.size());
+	mFlowField.Build(houses.data(), (uint32_t)houses.size(), -GroundHalf, -GroundHalf, GroundHalf, GroundHalf, 4.0f, 2.0f);
+
+	float identity[16];
+	Identity(identity);
+	mOcclusion.ClearOccluders();
+	mTorches.clear();
+	for (const auto& b : houses)
+	{
+		mOcclusion.AddOccluder(b, identity);
+		for (int corner = 0; corner < 4; ++corner)
+		{
+			mTorches.push_back(b.Center[0] + (corner & 1 ? 1.0f : -1.0f) * (b.Extents[0] + 2.0f));
+			mTorches.push_back(b.Center[1] - b.Extents[1] + 10.0f);
+			mTorches.push_back(b.Center[2] + (corner & 2 ? 1.0f : -1.0f) * (b.Extents[2] + 2.0f));
+		}
+	}
+}
+
+void HeadlessScene::Frame(float dt, HeadlessFrameStats& stats)
+{
+	stats = HeadlessFrameStats();
+	auto start = std::chrono::high_resolution_clock::now();
+	mTime += dt;
+	mUploadAllocator.Reset();
+
+	MovePlayer(dt);
+	StepZones(dt, stats);
+	stats.Hits = ResolveHits();
+	UpdateCamera();
+	CullItems(stats);
+	UploadInstances();
+	UpdateLights(dt, stats);
+	stats.UpdateTime = ElapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	CollectDraws();
+	auto recordStart = std::chrono::high_resolution_clock::now();
+	RecordDraws(stats);
+	stats.RecordTime = ElapsedMs(recordStart);
+	stats.DrawTime = ElapsedMs(start);
+	stats.UploadBytes = mUploadAllocator.GetUsedSize();
+}
+
+// Walks ahead and turns slowly, more sharply when a house is in the way or the ground ends,
+// and swings at whatever is in front of it on a fixed interval
+void HeadlessScene::MovePlayer(float dt)
+{
+	float dirX = std::sin(mPlayerYaw);
+	float dirZ = std::cos(mPlayerYaw);
+	float delta[3] = { dirX * PlayerSpeed * dt, 0.0f, dirZ * PlayerSpeed * dt };
+	float allowed[3];
+	mPlayerContacts.clear();
+	mCollision.Move(mPlayerBox, delta, allowed, mPlayerContacts);
+	for (int i = 0; i < 3; ++i)
+		mPlayerBox.Center[i] += allowed[i];
+
+	float x = mPlayerBox.Center[0];
+	float z = mPlayerBox.Center[2];
+	if (std::fabs(x) > GroundHalf - 50.0f || std::fabs(z) > GroundHalf - 50.0f)
+		mPlayerYaw = std::atan2(-x, -z);
+	else
+		mPlayerYaw += (mPlayerContacts.empty() ? PlayerTurnRate : 3.0f) * dt;
+
+	uint32_t zoneCount = (uint32_t)mCrowds.size();
+	mActiveZone = (std::min)((uint32_t)((x + GroundHalf) / (2.0f * GroundHalf) * zoneCount), zoneCount - 1);
+
+	if (mTime >= mNextAttack)
+	{
+		mNextAttack = mTime + AttackInterval;
+
+		HitEvent e = {};
+		e.Source = eHitSource::Player;
+		e.Zone = mActiveZone;
+		e.Attacker = 0;
+		e.Target = HitQueue::NoTarget;
+		e.Sequence = mHitSequence++;
+		e.Time = mTime;
+		e.Damage = AttackDamage;
+		e.Position[0] = x + dirX * AttackReach;
+		e.Position[1] = 0.0f;
+		e.Position[2] = z + dirZ * AttackReach;
+		e.Look[0] = dirX;
+		e.Look[2] = dirZ;
+		mHits.Push(e);
+	}
+}
+
+// Every zone on the workers at its own rate, along the field toward the player.
+// Members that strike queue one hit for their zone's step.
+void HeadlessScene::StepZones(float dt, HeadlessFrameStats& stats)
+{
+	mFlowField.SetGoal(mPlayerBox.Center[0], mPlayerBox.Center[2]);
+	mFlowField.Step(FlowCellsPerFrame);
+	stats.FlowTime = mFlowField.GetStepTime();
+
+	mZoneScheduler.Run(mActiveZone, dt, mThreadPool, [this](uint32_t zone, float simTime, float stepTime)
+	{
+		uint32_t strikes = mCrowds[zone].Update(mPlayerBox.Center[0], mPlayerBox.Center[2], stepTime, &mFlowField);
+		if (strikes == 0)
+			return;
+
+		HitEvent e = {};
+		e.Source = eHitSource::Monster;
+		e.Zone = zone;
+		e.Target = 0;
+		e.Time = simTime;
+		e.Damage = (int)strikes;
+		for (int i = 0; i < 3; ++i)
+			e.Position[i] = mPlayerBox.Center[i];
+		mHits.Push(e);
+	});
+
+	for (auto& e : mCrowds)
+		stats.CrowdTime += e.GetUpdateTime();
+}
+
+uint32_t HeadlessScene::ResolveHits()
+{
+	mHits.Sort();
+	uint32_t count = mHits.GetCount();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const HitEvent& e = mHits[i];
+		if (e.Source == eHitSource::Player)
+		{
+			if (mCrowds[e.Zone].Damage(e.Position[0], e.Position[2], AttackRadius, (float)e.Damage) > 0 && mHitFlashes.size() < MaxHitFlashes)
+				mHitFlashes.push_back({ { e.Position[0], e.Position[1] + 5.0f, e.Position[2] }, 0.0f });
+		}
+		else
+		{
+			mPlayerDamage += (float)e.Damage;
+		}
+	}
+	mHits.Clear();
+	return count;
+}
+
+// Behind and above the player, looking past it
+void HeadlessScene::UpdateCamera()
+{
+	float dirX = std::sin(mPlayerYaw);
+	float dirZ = std::cos(mPlayerYaw);
+	const float* p = mPlayerBox.Center;
+	float eye[3] = { p[0] - 30.0f * dirX, p[1] + 20.0f, p[2] - 30.0f * dirZ };
+	float at[3] = { p[0] + 20.0f * dirX, p[1] + 5.0f, p[2] + 20.0f * dirZ };
+
+	float proj[16];
+	LookAt(eye, at, mView);
+	Perspective(proj);
+	Multiply(mView, proj, mViewProj);
+	mFrustum = Frustum::FromViewProj(mViewProj);
+}
+
+// Static items through the BVH and the active zone's members one by one, then what the
+// houses hide. Only the active zone is drawn, as in the game.
+void HeadlessScene::CullItems(HeadlessFrameStats& stats)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	mOcclusion.Render(mViewProj);
+	stats.OcclusionTime = ElapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	std::fill(mStaticVisible.begin(), mStaticVisible.end(), (uint8_t)0);
+	mVisibleStatic.clear();
+	mStaticBVH.Cull(mFrustum, mVisibleStatic);
+
+	uint32_t occluded = 0;
+	for (auto i : mVisibleStatic)
+	{
+		if (mOcclusion.IsVisible(mStaticBoxes[i]))
+			mStaticVisible[i] = 1;
+		else
+			++occluded;
+	}
+
+	const Crowd& crowd = mCrowds[mActiveZone];
+	uint32_t count = crowd.GetCount();
+	mCrowdBoxes.resize(count);
+	mCrowdVisible.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		mCrowdBoxes[i] = { { crowd.GetPositionX(i), 4.0f, crowd.GetPositionZ(i) }, { 2.0f, 4.0f, 2.0f } };
+	CullBoxes(mFrustum, mCrowdBoxes.data(), count, mCrowdVisible.data());
+	occluded += mOcclusion.TestBoxes(mCrowdBoxes.data(), count, mCrowdVisible.data());
+
+	stats.CullTime = ElapsedMs(start);
+	stats.Occluded = occluded;
+	stats.Visible = (uint32_t)std::count(mStaticVisible.begin(), mStaticVisible.end(), (uint8_t)1) +
+		(uint32_t)std::count(mCrowdVisible.begin(), mCrowdVisible.end(), (uint8_t)1);
+}
+
+// The pass constants, the visible static instances batch by batch, and the visible members
+// with a bone palette each, posed by clip
+void HeadlessScene::UploadInstances()
+{
+	D3D12_GPU_VIRTUAL_ADDRESS passAddress;
+	BYTE* pass = Allocate(PassBytes, passAddress);
+	std::memcpy(pass, mView, sizeof(mView));
+	std::memcpy(pass + sizeof(mView), mViewProj, sizeof(mViewProj));
+	mPassAddress = passAddress;
+
+	UINT visibleStatic = 0;
+	for (auto i : mVisibleStatic)
+		visibleStatic += mStaticVisible[i];
+
+	D3D12_GPU_VIRTUAL_ADDRESS staticAddress;
+	Instance* instances = reinterpret_cast<Instance*>(Allocate(visibleStatic * sizeof(Instance), staticAddress));
+	UINT instanceBase = 0;
+	for (auto& b : mBatches)
+	{
+		b.Instances = staticAddress;
+		b.InstanceBase = instanceBase;
+		b.InstanceCount = 0;
+		for (auto item : b.Items)
+		{
+			if (!mStaticVisible[item])
+				continue;
+
+			Instance& e = instances[instanceBase + b.InstanceCount++];
+			BoxWorld(mStaticBoxes[item], e.World);
+			Identity(e.TexTransform);
+			e.MaterialIndex = (UINT)b.Mat;
+			e.PaletteOffset = 0;
+		}
+		instanceBase += b.InstanceCount;
+	}
+
+	const Crowd& crowd = mCrowds[mActiveZone];
+	mCrowdInstances = (UINT)std::count(mCrowdVisible.begin(), mCrowdVisible.end(), (uint8_t)1);
+	Instance* members = reinterpret_cast<Instance*>(Allocate(mCrowdInstances * sizeof(Instance), mCrowdInstanceAddress));
+	BYTE* palettes = Allocate(mCrowdInstances * PaletteBytes, mPaletteAddress);
+	UINT member = 0;
+	for (uint32_t i = 0; i < crowd.GetCount(); ++i)
+	{
+		if (!mCrowdVisible[i])
+			continue;
+
+		// Turned to its heading on the ground
+		Instance& e = members[member];
+		Identity(e.World);
+		e.World[0] = crowd.GetHeadingZ(i);
+		e.World[2] = -crowd.GetHeadingX(i);
+		e.World[8] = crowd.GetHeadingX(i);
+		e.World[10] = crowd.GetHeadingZ(i);
+		e.World[12] = crowd.GetPositionX(i);
+		e.World[14] = crowd.GetPositionZ(i);
+		Identity(e.TexTransform);
+		e.MaterialIndex = 30;
+		e.PaletteOffset = member * BonePaletteSize;
+		std::memcpy(palettes + member * PaletteBytes, &mClipPalettes[(size_t)crowd.GetClip(i) * BonePaletteSize * 16], (size_t)PaletteBytes);
+		++member;
+	}
+}
+
+// Flickering torches and hit flashes, binned into the view clusters and uploaded
+void HeadlessScene::UpdateLights(float dt, HeadlessFrameStats& stats)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (auto& e : mHitFlashes)
+		e.Age += dt;
+	mHitFlashes.erase(std::remove_if(mHitFlashes.begin(), mHitFlashes.end(),
+		[](const HitFlash& e) { return e.Age >= FlashLifetime; }), mHitFlashes.end());
+
+	UINT torchCount = (UINT)mTorches.size() / 3;
+	UINT lightCount = torchCount + (UINT)mHitFlashes.size();
+	D3D12_GPU_VIRTUAL_ADDRESS lightAddress;
+	Light* lights = reinterpret_cast<Light*>(Allocate((std::max)(lightCount, 1u) * sizeof(Light), lightAddress));
+	mLightBounds.resize(lightCount);
+	for (UINT i = 0; i < lightCount; ++i)
+	{
+		Light& light = lights[i];
+		const float* position = i < torchCount ? &mTorches[3 * i] : mHitFlashes[i - torchCount].Position;
+		float strength;
+		if (i < torchCount)
+		{
+			strength = 0.85f + 0.15f * std::sin(mTime * 11.0f + (float)i * 1.7f);
+			light.FalloffStart = 5.0f;
+			light.FalloffEnd = 40.0f;
+		}
+		else
+		{
+			strength = 3.0f * (1.0f - mHitFlashes[i - torchCount].Age / FlashLifetime);
+			light.FalloffStart = 1.0f;
+			light.FalloffEnd = 20.0f;
+		}
+		light.Strength[0] = 1.5f * strength;
+		light.Strength[1] = 0.9f * strength;
+		light.Strength[2] = 0.4f * strength;
+		light.Direction[0] = light.Direction[2] = 0.0f;
+		light.Direction[1] = -1.0f;
+		std::memcpy(light.Position, position, sizeof(light.Position));
+		light.SpotPower = 0.0f;
+
+		TransformPoint(position, mView, mLightBounds[i].Center);
+		mLightBounds[i].Radius = light.FalloffEnd;
+	}
+
+	mLightClusters.Build(mLightBounds.data(), lightCount, mThreadPool);
+
+	auto& ranges = mLightClusters.GetRanges();
+	auto& indices = mLightClusters.GetIndices();
+	mLightAddress = lightAddress;
+	mClusterAddress = Upload(ranges.data(), ranges.size() * sizeof(LightClusters::Range));
+	mLightIndexAddress = Upload(indices.data(), (std::max)(indices.size(), (size_t)1) * sizeof(uint32_t));
+
+	stats.LightTime = ElapsedMs(start);
+	stats.Lights = lightCount;
+}
+
+// The game's CollectDraws over the scene's items: instanced ground, props and houses, the sky,
+// the UI, the player's submeshes, and the members and shadows one draw per submesh
+void HeadlessScene::CollectDraws()
+{
+	mDrawList.Clear();
+
+	auto base = [](const Mesh& mesh, UINT layer, ePSO pso)
+	{
+		DrawCommand command;
+		command.Layer = layer;
+		command.PSO = (UINT)pso;
+		command.Geo = &mesh;
+		command.VertexBuffer = mesh.VertexBuffer;
+		command.IndexBuffer = mesh.IndexBuffer;
+		command.IndexCount = mesh.IndexCount;
+		return command;
+	};
+
+	for (auto& b : mBatches)
+	{
+		if (b.InstanceCount == 0)
+			continue;
+
+		DrawCommand command = base(*b.Geo, b.Layer, ePSO::OpaqueInstanced);
+		command.Mat = b.Mat;
+		command.InstanceCount = b.InstanceCount;
+		command.Constants.ObjIndex = b.InstanceBase;
+		command.Constants.MatIndex = (UINT)b.Mat;
+		command.Instances = b.Instances;
+		mDrawList.Add(command);
+	}
+
+	DrawCommand sky = base(mMeshes[SkyMesh], SkyLayer, ePSO::Sky);
+	sky.Depth = 1.0f;
+	mDrawList.Add(sky);
+
+	// Health bar, three skill icons and the monster name plate, in submission order
+	for (UINT i = 0; i < 5; ++i)
+	{
+		DrawCommand ui = base(mMeshes[QuadMesh], UILayer, i < 4 ? ePSO::UI : ePSO::MonsterUI);
+		ui.KeepOrder = true;
+		ui.Mat = 24 + i;
+		ui.Constants.ObjIndex = i;
+		ui.Constants.MatIndex = 24 + i;
+		mDrawList.Add(ui);
+	}
+
+	const Mesh& player = mMeshes[PlayerMesh];
+	const Mesh& monster = mMeshes[MonsterMesh];
+	float playerView[3];
+	TransformPoint(mPlayerBox.Center, mView, playerView);
+	for (UINT submesh = 0; submesh < CharacterSubmeshes; ++submesh)
+	{
+		UINT indexCount = player.IndexCount / CharacterSubmeshes;
+		for (ePSO pso : { ePSO::Player, ePSO::PlayerShadow })
+		{
+			DrawCommand command = base(player, pso == ePSO::Player ? CharacterLayer : ShadowLayer, pso);
+			command.Mat = 28 + submesh;
+			command.Depth = playerView[2] / FarZ;
+			command.IndexCount = indexCount;
+			command.StartIndexLocation = submesh * indexCount;
+			command.Constants.MatIndex = 28 + submesh;
+			command.SkinnedCB = mPassAddress;
+			command.Palette = mPaletteAddress;
+			mDrawList.Add(command);
+		}
+
+		if (mCrowdInstances == 0)
+			continue;
+
+		indexCount = monster.IndexCount / CharacterSubmeshes;
+		for (ePSO pso : { ePSO::Monster, ePSO::MonsterShadow })
+		{
+			DrawCommand command = base(monster, pso == ePSO::Monster ? MonsterLayer : ShadowLayer, pso);
+			command.Mat = 30;
+			command.IndexCount = indexCount;
+			command.StartIndexLocation = submesh * indexCount;
+			command.InstanceCount = mCrowdInstances;
+			command.Constants.MatIndex = 30;
+			command.Instances = mCrowdInstanceAddress;
+			command.Palette = mPaletteAddress;
+			mDrawList.Add(command);
+		}
+	}
+
+	mDrawList.Sort();
+}
+
+// Contiguous ranges of the sorted draws, one recorder each, recorded on the workers
+void HeadlessScene::RecordDraws(HeadlessFrameStats& stats)
+{
+	UINT drawCount = mDrawList.GetDrawCount();
+	UINT maxLists = (mThreadPool != nullptr ? mThreadPool->GetThreadCount() : 0) + 1;
+	UINT listCount = (std::max)((std::min)(maxLists, (drawCount + MinDrawsPerList - 1) / MinDrawsPerList), 1u);
+	UINT drawsPerList = (drawCount + listCount - 1) / listCount;
+
+	mRecorders.resize(listCount);
+	auto record = [this, drawsPerList](unsigned int i)
+	{
+		mRecorders[i].Reset();
+		mRecorders[i].SetTableBindings(mSettings.TableBindings);
+		SetFrameState(mRecorders[i]);
+		mDrawList.Execute(mRecorders[i], i * drawsPerList, drawsPerList);
+	};
+	if (mThreadPool != nullptr)
+		mThreadPool->ParallelFor(listCount, record);
+	else
+	{
+		for (UINT i = 0; i < listCount; ++i)
+			record(i);
+	}
+
+	for (UINT i = 0; i < listCount; ++i)
+		stats.Counts += mRecorders[i].GetCounts();
+	stats.RootBindings = stats.Counts.RootConstants + stats.Counts.RootBuffers + stats.Counts.DescriptorTables;
+	stats.CommandLists = listCount;
+}
+
+// The game's SetFrameState: every list binds the same frame-wide tables and buffers
+void HeadlessScene::SetFrameState(CommandRecorder& recorder) const
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE noTarget = {};
+	recorder.SetViewport(Viewport, ScissorRect);
+	recorder.SetRenderTarget(noTarget, noTarget);
+	recorder.SetDescriptorHeap(nullptr);
+	recorder.SetRootSignature(nullptr);
+
+	// Descriptors are numbered by index, as on a NullRenderDevice
+	D3D12_GPU_DESCRIPTOR_HANDLE textures = { 0 };
+	D3D12_GPU_DESCRIPTOR_HANDLE skyCube = { 2 * MaterialCount };
+	D3D12_GPU_VIRTUAL_ADDRESS frameBuffers = UploadAddress + mUploadAllocator.GetCapacity();
+
+	recorder.SetRootDescriptorTable((UINT)eRoot::TextureTable, textures);
+	recorder.SetRootShaderResource((UINT)eRoot::MaterialBuffer, frameBuffers);
+	recorder.SetRootShaderResource((UINT)eRoot::ObjectBuffer, frameBuffers + 0x10000);
+	recorder.SetRootShaderResource((UINT)eRoot::UIBuffer, frameBuffers + 0x20000);
+	recorder.SetRootShaderResource((UINT)eRoot::MonsterUIBuffer, frameBuffers + 0x30000);
+	recorder.SetRootConstantBuffer((UINT)eRoot::PassCB, mPassAddress);
+	recorder.SetRootShaderResource((UINT)eRoot::LightBuffer, mLightAddress);
+	recorder.SetRootShaderResource((UINT)eRoot::LightClusterBuffer, mClusterAddress);
+	recorder.SetRootShaderResource((UINT)eRoot::LightIndexBuffer, mLightIndexAddress);
+	recorder.SetRootDescriptorTable((UINT)eRoot::CubeMapTable, skyCube);
+	recorder.SetStencilRef(0);
+}
+
+void HeadlessScene::BindingRecorder::SetTableBindings(bool tableBindings)
+{
+	mTableBindings = tableBindings;
+	mConstants = DrawConstants();
+}
+
+void HeadlessScene::BindingRecorder::SetRootConstants(UINT parameter, UINT count, const void* data)
+{
+	if (!mTableBindings || parameter != (UINT)eRoot::DrawConstants)
+	{
+		NullCommandRecorder::SetRootConstants(parameter, count, data);
+		return;
+	}
+	std::memcpy(&mConstants, data, (std::min)((size_t)count * 4, sizeof(mConstants)));
+}
+
+void HeadlessScene::BindingRecorder::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation)
+{
+	if (mTableBindings)
+	{
+		for (UINT t = 0; t < DrawTableCount; ++t)
+		{
+			D3D12_GPU_DESCRIPTOR_HANDLE handle = { mConstants.ObjIndex * DrawTableCount + t };
+			SetRootDescriptorTable(t, handle);
+		}
+	}
+	NullCommandRecorder::DrawIndexedInstanced(indexCount, instanceCount, startIndexLocation, baseVertexLocation);
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS HeadlessScene::Upload(const void* data, uint64_t size)
+{
+	D3D12_GPU_VIRTUAL_ADDRESS address;
+	BYTE* dst = Allocate(size, address);
+	if (size > 0)
+		std::memcpy(dst, data, (size_t)size);
+	return address;
+}
+
+// Build sized the memory for the worst frame, so running out is a bug.
+// A size of 0 gets no memory and address 0, like UploadAllocator.
+BYTE* HeadlessScene::Allocate(uint64_t size, D3D12_GPU_VIRTUAL_ADDRESS& address)
+{
+	address = 0;
+	if (size == 0)
+		return nullptr;
+
+	uint64_t offset = mUploadAllocator.Allocate(size, UploadAlignment);
+	if (offset == LinearAllocator::InvalidOffset)
+		throw std::runtime_error("Headless upload memory exhausted");
+
+	address = UploadAddress + offset;
+	return mUploadMemory.data() + offset;
+}
+
+const ZoneScheduler& HeadlessScene::GetZoneScheduler() const
+{
+	return mZoneScheduler;
+}
+
+const FlowField& HeadlessScene::GetFlowField() const
+{
+	return mFlowField;
+}
+
+uint32_t HeadlessScene::GetAliveCount() const
+{
+	uint32_t alive = 0;
+	for (auto& e : mCrowds)
+		alive += e.GetAliveCount();
+	return alive;
+}
+
+void HeadlessScene::GetPlayerPosition(float position[3]) const
+{
+	std::memcpy(position, mPlayerBox.Center, 3 * sizeof(float));
+}
+
+float HeadlessScene::GetPlayerDamage() const
+{
+	return mPlayerDamage;
+}
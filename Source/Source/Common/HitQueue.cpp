@@ -0,0 +1,160 @@
+#include "HitQueue.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	// The player's hits first, then by zone, step, attacker and order within the step
+	bool HitBefore(const HitEvent& a, const HitEvent& b)
+	{
+		if (a.Source != b.Source)
+			return a.Source < b.Source;
+		if (a.Zone != b.Zone)
+			return a.Zone < b.Zone;
+		if (a.Time != b.Time)
+			return a.Time < b.Time;
+		if (a.Attacker != b.Attacker)
+			return a.Attacker < b.Attacker;
+		return a.Sequence < b.Sequence;
+	}
+}
+
+const uint32_t HitQueue::NoTarget;
+
+HitQueue::HitQueue(uint32_t capacity)
+	: mEvents(capacity)
+{
+}
+
+void HitQueue::SetCapacity(uint32_t capacity)
+{
+	mEvents.resize(capacity);
+	Clear();
+}
+
+uint32_t HitQueue::GetCapacity() const
+{
+	return (uint32_t)mEvents.size();
+}
+
+void HitQueue::Push(const HitEvent& e)
+{
+	// Past the end only counts, Sort reports it
+	uint32_t slot = mCount.fetch_add(1, std::memory_order_relaxed);
+	if (slot < mEvents.size())
+		mEvents[slot] = e;
+}
+
+void HitQueue::Sort()
+{
+	if (mCount.load(std::memory_order_relaxed) > mEvents.size())
+		throw std::runtime_error("HitQueue: more hits than the queue was sized for");
+
+	auto end = mEvents.begin() + GetCount();
+	std::sort(mEvents.begin(), end, HitBefore);
+
+	// Equal keys would leave their order to std::sort
+	if (std::adjacent_find(mEvents.begin(), end, [](const HitEvent& a, const HitEvent& b) { return !HitBefore(a, b); }) != end)
+		throw std::runtime_error("HitQueue: two hits with the same source, zone, time, attacker and sequence");
+}
+
+uint32_t HitQueue::GetCount() const
+{
+	return (std::min)(mCount.load(std::memory_order_relaxed), (uint32_t)mEvents.size());
+}
+
+const HitEvent& HitQueue::operator[](uint32_t i) const
+{
+	return mEvents[i];
+}
+
+void HitQueue::Clear()
+{
+	mCount.store(0, std::memory_order_relaxed);
+}
+
+void HitQueue::Benchmark(uint32_t combatantCount, uint32_t frames, ThreadPool* threadPool, BenchmarkResult& result)
+{
+	const uint32_t groupSize = 64;
+	const uint32_t groupCount = (combatantCount + groupSize - 1) / groupSize;
+	const int fullHealth = 100;
+
+	// Every combatant strikes one frame in eight
+	HitQueue hits(combatantCount / 8 + groupCount);
+
+	auto run = [&](ThreadPool* pool, std::vector<int>& health, float& pushTime, float& resolveTime, uint32_t& hitCount)
+	{
+		health.assign(combatantCount, fullHealth);
+		pushTime = resolveTime = 0.0f;
+		hitCount = 0;
+
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			// AI: each group reads only itself and queues what it deals out
+			auto step = [&](unsigned int group)
+			{
+				uint32_t end = (std::min)((group + 1) * groupSize, combatantCount);
+				for (uint32_t i = group * groupSize; i < end; ++i)
+				{
+					if ((frame + i) % 8 != 0 || health[i] <= 0)
+						continue;
+
+					HitEvent e = {};
+					e.Source = eHitSource::Monster;
+					e.Zone = group;
+					e.Attacker = i;
+					e.Target = (uint32_t)((i * 2654435761ull + frame) % combatantCount);
+					e.Time = (float)frame;
+					e.Damage = 1 + (int)(i % 5);
+					hits.Push(e);
+				}
+			};
+
+			auto start = std::chrono::high_resolution_clock::now();
+			if (pool)
+				pool->ParallelFor(groupCount, step);
+			else
+				for (uint32_t group = 0; group < groupCount; ++group)
+					step(group);
+			pushTime += ElapsedMs(start);
+
+			// Resolution: one thread, a fixed order
+			start = std::chrono::high_resolution_clock::now();
+			hits.Sort();
+			for (uint32_t i = 0; i < hits.GetCount(); ++i)
+			{
+				int& target = health[hits[i].Target];
+				target -= hits[i].Damage;
+				if (target <= 0)
+					target = fullHealth;
+			}
+			hitCount += hits.GetCount();
+			hits.Clear();
+			resolveTime += ElapsedMs(start);
+		}
+	};
+
+	std::vector<int> serialHealth, parallelHealth;
+	float serialPush, serialResolve, pushTime, resolveTime;
+	uint32_t serialCount, hitCount;
+	run(nullptr, serialHealth, serialPush, serialResolve, serialCount);
+	run(threadPool, parallelHealth, pushTime, resolveTime, hitCount);
+
+	result.PushTime = hitCount > 0 ? pushTime * 1e6f / hitCount : 0.0f;
+	result.ResolveTime = hitCount > 0 ? resolveTime * 1e6f / hitCount : 0.0f;
+	result.HitsPerFrame = frames > 0 ? (float)hitCount / frames : 0.0f;
+	result.Mismatches = 0;
+	for (uint32_t i = 0; i < combatantCount; ++i)
+	{
+		if (serialHealth[i] != parallelHealth[i])
+			++result.Mismatches;
+	}
+}
@@ -0,0 +1,234 @@
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	// Distance from c to [lo, hi] on one axis
+	float AxisDistance(float c, float lo, float hi)
+	{
+		return c < lo ? lo - c : (c > hi ? c - hi : 0.0f);
+	}
+}
+
+LightClusters::LightClusters()
+{
+	SetProjection(0.25f * 3.14159265f, 1.0f, 1.0f, 1000.0f);
+}
+
+void LightClusters::SetProjection(float fovY, float aspect, float nearZ, float farZ)
+{
+	mNearZ = nearZ;
+	mFarZ = farZ;
+
+	float logRatio = std::log(farZ / nearZ);
+	mSliceScale = (float)DimZ / logRatio;
+	mSliceBias = -(float)DimZ * std::log(nearZ) / logRatio;
+
+	float tanY = std::tan(0.5f * fovY);
+	float tanX = tanY * aspect;
+
+	mSliceNear.resize(DimZ);
+	mSliceFar.resize(DimZ);
+	mTileMinX.resize(DimZ * DimX);
+	mTileMaxX.resize(DimZ * DimX);
+	mTileMinY.resize(DimZ * DimY);
+	mTileMaxY.resize(DimZ * DimY);
+
+	for (uint32_t z = 0; z < DimZ; ++z)
+	{
+		float n = nearZ * std::pow(farZ / nearZ, (float)z / DimZ);
+		float f = nearZ * std::pow(farZ / nearZ, (float)(z + 1) / DimZ);
+		mSliceNear[z] = n;
+		mSliceFar[z] = f;
+
+		// The side planes of a tile spread with depth, so each bound comes from the near or the far end
+		for (uint32_t x = 0; x < DimX; ++x)
+		{
+			float left = -1.0f + 2.0f * x / DimX;
+			float right = -1.0f + 2.0f * (x + 1) / DimX;
+			mTileMinX[z * DimX + x] = left * tanX * (left < 0.0f ? f : n);
+			mTileMaxX[z * DimX + x] = right * tanX * (right < 0.0f ? n : f);
+		}
+		for (uint32_t y = 0; y < DimY; ++y)
+		{
+			float top = 1.0f - 2.0f * y / DimY;
+			float bottom = 1.0f - 2.0f * (y + 1) / DimY;
+			mTileMinY[z * DimY + y] = bottom * tanY * (bottom < 0.0f ? f : n);
+			mTileMaxY[z * DimY + y] = top * tanY * (top < 0.0f ? n : f);
+		}
+	}
+
+	mSlicePairs.resize(DimZ);
+	mRanges.resize(ClusterCount);
+}
+
+void LightClusters::Reserve(uint32_t maxLights)
+{
+	for (auto& pairs : mSlicePairs)
+		pairs.reserve((size_t)maxLights * DimX * DimY);
+	mIndices.reserve((size_t)maxLights * ClusterCount);
+}
+
+void LightClusters::Build(const LightBounds* lights, uint32_t count, ThreadPool* threadPool)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (threadPool != nullptr)
+		threadPool->ParallelFor(DimZ, [this, lights, count](unsigned int z) { BuildSlice(z, lights, count); });
+	else
+	{
+		for (uint32_t z = 0; z < DimZ; ++z)
+			BuildSlice(z, lights, count);
+	}
+
+	// Offsets in cluster order from the counts of the slices, then every pair into its cluster.
+	// Pairs are in light order, so each cluster's list is too.
+	uint32_t offset = 0;
+	for (auto& range : mRanges)
+	{
+		range.Offset = offset;
+		offset += range.Count;
+		range.Count = 0;
+	}
+	mIndices.resize(offset);
+	for (uint32_t z = 0; z < DimZ; ++z)
+	{
+		for (const TileLight& pair : mSlicePairs[z])
+		{
+			Range& range = mRanges[z * DimX * DimY + pair.Tile];
+			mIndices[range.Offset + range.Count++] = pair.Light;
+		}
+	}
+
+	mBuildTime = ElapsedMs(start);
+}
+
+const std::vector<LightClusters::Range>& LightClusters::GetRanges() const
+{
+	return mRanges;
+}
+
+const std::vector<uint32_t>& LightClusters::GetIndices() const
+{
+	return mIndices;
+}
+
+float LightClusters::GetSliceScale() const
+{
+	return mSliceScale;
+}
+
+float LightClusters::GetSliceBias() const
+{
+	return mSliceBias;
+}
+
+float LightClusters::GetBuildTime() const
+{
+	return mBuildTime;
+}
+
+float LightClusters::Benchmark(uint32_t lightCount, uint32_t iterations, ThreadPool* threadPool)
+{
+	const float fovY = 0.25f * 3.14159265f;
+	const float aspect = 16.0f / 9.0f;
+	const float tanY = std::tan(0.5f * fovY);
+
+	LightClusters clusters;
+	clusters.SetProjection(fovY, aspect, 1.0f, 1000.0f);
+
+	// Spread over the first 300 units like the torches of a zone, some partly off screen
+	std::mt19937 engine{ 1234u };
+	std::uniform_real_distribution<float> disDepth{ 1.0f, 300.0f };
+	std::uniform_real_distribution<float> disSide{ -1.2f, 1.2f };
+	std::uniform_real_distribution<float> disRadius{ 2.0f, 20.0f };
+
+	std::vector<LightBounds> lights(lightCount);
+	for (auto& l : lights)
+	{
+		float z = disDepth(engine);
+		l.Center[0] = disSide(engine) * z * tanY * aspect;
+		l.Center[1] = disSide(engine) * z * tanY;
+		l.Center[2] = z;
+		l.Radius = disRadius(engine);
+	}
+
+	float time = 0.0f;
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		clusters.Build(lights.data(), lightCount, threadPool);
+		time += clusters.GetBuildTime();
+	}
+
+	return iterations > 0 ? time / iterations : 0.0f;
+}
+
+void LightClusters::BuildSlice(uint32_t slice, const LightBounds* lights, uint32_t count)
+{
+	std::vector<TileLight>& pairs = mSlicePairs[slice];
+	pairs.clear();
+	Range* ranges = &mRanges[slice * DimX * DimY];
+	for (uint32_t tile = 0; tile < DimX * DimY; ++tile)
+		ranges[tile].Count = 0;
+
+	float sliceNear = mSliceNear[slice];
+	float sliceFar = mSliceFar[slice];
+	const float* minX = &mTileMinX[slice * DimX];
+	const float* maxX = &mTileMaxX[slice * DimX];
+	const float* minY = &mTileMinY[slice * DimY];
+	const float* maxY = &mTileMaxY[slice * DimY];
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const LightBounds& l = lights[i];
+		float cx = l.Center[0], cy = l.Center[1], cz = l.Center[2];
+		float r = l.Radius;
+
+		if (cz + r < sliceNear || cz - r > sliceFar)
+			continue;
+
+		// Candidate columns and rows from the bounding box of the sphere
+		uint32_t x0 = 0, x1 = DimX;
+		while (x0 < DimX && maxX[x0] < cx - r)
+			++x0;
+		while (x1 > x0 && minX[x1 - 1] > cx + r)
+			--x1;
+
+		uint32_t y0 = 0, y1 = DimY;
+		while (y0 < DimY && minY[y0] > cy + r)
+			++y0;
+		while (y1 > y0 && maxY[y1 - 1] < cy - r)
+			--y1;
+
+		float dz = AxisDistance(cz, sliceNear, sliceFar);
+		float r2 = r * r - dz * dz;
+		if (r2 < 0.0f)
+			continue;
+
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			float dy = AxisDistance(cy, minY[y], maxY[y]);
+			if (dy * dy > r2)
+				continue;
+
+			for (uint32_t x = x0; x < x1; ++x)
+			{
+				float dx = AxisDistance(cx, minX[x], maxX[x]);
+				if (dx * dx + dy * dy <= r2)
+				{
+					pairs.push_back({ y * DimX + x, i });
+					ranges[y * DimX + x].Count++;
+				}
+			}
+		}
+	}
+}
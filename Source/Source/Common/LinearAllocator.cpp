@@ -0,0 +1,45 @@
+#include "LinearAllocator.h"
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+LinearAllocator::LinearAllocator(uint64_t capacity)
+	: mCapacity(capacity)
+{
+}
+
+uint64_t LinearAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0)
+		return InvalidOffset;
+
+	uint64_t offset = AlignUp(mOffset, alignment);
+	if (offset > mCapacity || size > mCapacity - offset)
+		return InvalidOffset;
+
+	mOffset = offset + size;
+	return offset;
+}
+
+void LinearAllocator::Reset()
+{
+	mOffset = 0;
+}
+
+void LinearAllocator::Reset(uint64_t capacity)
+{
+	mCapacity = capacity;
+	mOffset = 0;
+}
+
+uint64_t LinearAllocator::GetCapacity() const
+{
+	return mCapacity;
+}
+
+uint64_t LinearAllocator::GetUsedSize() const
+{
+	return mOffset;
+}
@@ -0,0 +1,351 @@
+#include "Occluder.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+
+namespace
+{
+	// Cell states of the voxel grid
+	enum : uint8_t
+	{
+		Empty = 0,
+		Surface = 1,
+		Outside = 2
+	};
+
+	// Counts of marked cells over boxes in O(1), (x, y, z) of the grid map to ((z * dy + y) * dx + x)
+	class CellSums
+	{
+	public:
+		void Build(const std::vector<uint8_t>& marked, const int dims[3])
+		{
+			mDims[0] = dims[0] + 1;
+			mDims[1] = dims[1] + 1;
+			mDims[2] = dims[2] + 1;
+			mSums.assign((size_t)mDims[0] * mDims[1] * mDims[2], 0);
+
+			for (int z = 1; z < mDims[2]; ++z)
+			{
+				for (int y = 1; y < mDims[1]; ++y)
+				{
+					for (int x = 1; x < mDims[0]; ++x)
+					{
+						int cell = marked[((size_t)(z - 1) * dims[1] + (y - 1)) * dims[0] + (x - 1)];
+						At(x, y, z) = cell
+							+ At(x - 1, y, z) + At(x, y - 1, z) + At(x, y, z - 1)
+							- At(x - 1, y - 1, z) - At(x - 1, y, z - 1) - At(x, y - 1, z - 1)
+							+ At(x - 1, y - 1, z - 1);
+					}
+				}
+			}
+		}
+
+		// Marked cells in [lo, hi], both inclusive
+		int Count(const int lo[3], const int hi[3]) const
+		{
+			int x0 = lo[0], y0 = lo[1], z0 = lo[2];
+			int x1 = hi[0] + 1, y1 = hi[1] + 1, z1 = hi[2] + 1;
+			return At(x1, y1, z1)
+				- At(x0, y1, z1) - At(x1, y0, z1) - At(x1, y1, z0)
+				+ At(x0, y0, z1) + At(x0, y1, z0) + At(x1, y0, z0)
+				- At(x0, y0, z0);
+		}
+
+	private:
+		int& At(int x, int y, int z) { return mSums[((size_t)z * mDims[1] + y) * mDims[0] + x]; }
+		int At(int x, int y, int z) const { return mSums[((size_t)z * mDims[1] + y) * mDims[0] + x]; }
+
+	private:
+		int mDims[3] = {};
+		std::vector<int> mSums;
+	};
+
+	int Volume(const int lo[3], const int hi[3])
+	{
+		return (hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+	}
+}
+
+void Occluder::Cook(const void* positions, uint32_t stride, uint32_t vertexCount,
+	const uint32_t* indices, uint32_t indexCount, std::vector<CullBox>& outBoxes,
+	uint32_t closedSides, uint32_t resolution, uint32_t maxBoxes, uint32_t minCells)
+{
+	outBoxes.clear();
+	if (vertexCount == 0 || indexCount < 3 || resolution == 0)
+		return;
+
+	auto position = [positions, stride](uint32_t i)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + (size_t)i * stride);
+	};
+
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t i = 0; i < vertexCount; ++i)
+	{
+		const float* p = position(i);
+		for (int a = 0; a < 3; ++a)
+		{
+			boundsMin[a] = (std::min)(boundsMin[a], p[a]);
+			boundsMax[a] = (std::max)(boundsMax[a], p[a]);
+		}
+	}
+
+	float longest = (std::max)({ boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] });
+	if (!(longest > 0.0f))
+		return;
+
+	// One empty cell of padding on every side keeps the outside connected
+	float cellSize = longest / (float)resolution;
+	int dims[3];
+	float origin[3];
+	for (int a = 0; a < 3; ++a)
+	{
+		dims[a] = (std::max)((int)std::ceil((boundsMax[a] - boundsMin[a]) / cellSize), 1) + 2;
+		origin[a] = boundsMin[a] - cellSize;
+	}
+
+	auto index = [&dims](int x, int y, int z)
+	{
+		return ((size_t)z * dims[1] + y) * dims[0] + x;
+	};
+
+	std::vector<uint8_t> cells((size_t)dims[0] * dims[1] * dims[2], Empty);
+
+	// Surface: sample every triangle at a quarter of a cell
+	for (uint32_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		if (indices[t] >= vertexCount || indices[t + 1] >= vertexCount || indices[t + 2] >= vertexCount)
+			continue;
+
+		const float* v0 = position(indices[t]);
+		const float* v1 = position(indices[t + 1]);
+		const float* v2 = position(indices[t + 2]);
+
+		float edge = 0.0f;
+		for (int a = 0; a < 3; ++a)
+		{
+			edge = (std::max)(edge, std::fabs(v1[a] - v0[a]));
+			edge = (std::max)(edge, std::fabs(v2[a] - v0[a]));
+			edge = (std::max)(edge, std::fabs(v2[a] - v1[a]));
+		}
+		int steps = (int)std::ceil(edge / (0.25f * cellSize)) + 1;
+
+		for (int i = 0; i <= steps; ++i)
+		{
+			for (int j = 0; i + j <= steps; ++j)
+			{
+				float s = (float)i / steps;
+				float u = (float)j / steps;
+
+				int cell[3];
+				for (int a = 0; a < 3; ++a)
+				{
+					float p = v0[a] + s * (v1[a] - v0[a]) + u * (v2[a] - v0[a]);
+					cell[a] = (std::min)((std::max)((int)((p - origin[a]) / cellSize), 1), dims[a] - 2);
+				}
+				cells[index(cell[0], cell[1], cell[2])] = Surface;
+			}
+		}
+	}
+
+	// A closed side walls off its padding layer, so a mesh left open there still encloses space
+	for (int side = 0; side < 6; ++side)
+	{
+		if (!(closedSides & (1u << side)))
+			continue;
+
+		int a = side / 2;
+		int layer = side & 1 ? dims[a] - 1 : 0;
+		for (int z = 0; z < dims[2]; ++z)
+		{
+			for (int y = 0; y < dims[1]; ++y)
+			{
+				for (int x = 0; x < dims[0]; ++x)
+				{
+					int cell[3] = { x, y, z };
+					if (cell[a] == layer)
+						cells[index(x, y, z)] = Surface;
+				}
+			}
+		}
+	}
+
+	// Outside: flood fill from the open padding
+	std::vector<int> stack;
+	for (int z = 0; z < dims[2]; ++z)
+	{
+		for (int y = 0; y < dims[1]; ++y)
+		{
+			for (int x = 0; x < dims[0]; ++x)
+			{
+				bool padding = x == 0 || y == 0 || z == 0 || x == dims[0] - 1 || y == dims[1] - 1 || z == dims[2] - 1;
+				size_t i = index(x, y, z);
+				if (padding && cells[i] == Empty)
+				{
+					cells[i] = Outside;
+					stack.push_back((int)i);
+				}
+			}
+		}
+	}
+	while (!stack.empty())
+	{
+		int cell = stack.back();
+		stack.pop_back();
+
+		int x = cell % dims[0];
+		int y = (cell / dims[0]) % dims[1];
+		int z = cell / (dims[0] * dims[1]);
+
+		const int neighbors[6][3] = { { x - 1, y, z }, { x + 1, y, z }, { x, y - 1, z }, { x, y + 1, z }, { x, y, z - 1 }, { x, y, z + 1 } };
+		for (auto& n : neighbors)
+		{
+			if (n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= dims[0] || n[1] >= dims[1] || n[2] >= dims[2])
+				continue;
+
+			size_t i = index(n[0], n[1], n[2]);
+			if (cells[i] == Empty)
+			{
+				cells[i] = Outside;
+				stack.push_back((int)i);
+			}
+		}
+	}
+
+	// What is left empty is enclosed
+	std::vector<uint8_t> solid(cells.size());
+	for (size_t i = 0; i < cells.size(); ++i)
+		solid[i] = cells[i] == Empty ? 1 : 0;
+
+	CellSums solidSums;
+	solidSums.Build(solid, dims);
+
+	std::vector<uint8_t> covered(cells.size(), 0);
+	CellSums coveredSums;
+
+	for (uint32_t boxIndex = 0; boxIndex < maxBoxes; ++boxIndex)
+	{
+		coveredSums.Build(covered, dims);
+
+		int bestLo[3] = {}, bestHi[3] = {};
+		int bestScore = 0;
+
+		for (int z = 0; z < dims[2]; ++z)
+		{
+			for (int y = 0; y < dims[1]; ++y)
+			{
+				for (int x = 0; x < dims[0]; ++x)
+				{
+					size_t seed = index(x, y, z);
+					if (!solid[seed] || covered[seed])
+						continue;
+
+					// Push each face out by one layer in turn while the box stays solid
+					int lo[3] = { x, y, z };
+					int hi[3] = { x, y, z };
+					bool grown = true;
+					while (grown)
+					{
+						grown = false;
+						for (int face = 0; face < 6; ++face)
+						{
+							int a = face / 2;
+							int slabLo[3] = { lo[0], lo[1], lo[2] };
+							int slabHi[3] = { hi[0], hi[1], hi[2] };
+							if (face & 1)
+							{
+								if (hi[a] + 1 >= dims[a])
+									continue;
+								slabLo[a] = slabHi[a] = hi[a] + 1;
+							}
+							else
+							{
+								if (lo[a] == 0)
+									continue;
+								slabLo[a] = slabHi[a] = lo[a] - 1;
+							}
+
+							if (solidSums.Count(slabLo, slabHi) == Volume(slabLo, slabHi))
+							{
+								(face & 1 ? hi[a] : lo[a]) = slabLo[a];
+								grown = true;
+							}
+						}
+					}
+
+					int score = Volume(lo, hi) - coveredSums.Count(lo, hi);
+					if (score > bestScore)
+					{
+						bestScore = score;
+						std::copy(lo, lo + 3, bestLo);
+						std::copy(hi, hi + 3, bestHi);
+					}
+				}
+			}
+		}
+
+		if (bestScore < (int)minCells)
+			break;
+
+		for (int z = bestLo[2]; z <= bestHi[2]; ++z)
+		{
+			for (int y = bestLo[1]; y <= bestHi[1]; ++y)
+			{
+				for (int x = bestLo[0]; x <= bestHi[0]; ++x)
+					covered[index(x, y, z)] = 1;
+			}
+		}
+
+		CullBox box;
+		for (int a = 0; a < 3; ++a)
+		{
+			float lo = origin[a] + bestLo[a] * cellSize;
+			float hi = origin[a] + (bestHi[a] + 1) * cellSize;
+			box.Center[a] = 0.5f * (lo + hi);
+			box.Extents[a] = 0.5f * (hi - lo);
+		}
+		outBoxes.push_back(box);
+	}
+}
+
+bool Occluder::Load(const std::string& fileName, std::vector<CullBox>& outBoxes)
+{
+	std::ifstream fileIn(fileName);
+	if (!fileIn)
+		return false;
+
+	std::string ignore;
+	uint32_t boxSize = 0;
+	fileIn >> ignore >> boxSize;
+
+	outBoxes.resize(boxSize);
+	for (auto& box : outBoxes)
+	{
+		fileIn >> ignore >> box.Center[0] >> box.Center[1] >> box.Center[2];
+		fileIn >> ignore >> box.Extents[0] >> box.Extents[1] >> box.Extents[2];
+	}
+
+	if (!fileIn)
+	{
+		outBoxes.clear();
+		return false;
+	}
+	return true;
+}
+
+bool Occluder::Save(const std::string& fileName, const std::vector<CullBox>& boxes)
+{
+	std::ofstream fileOut(fileName);
+	if (!fileOut)
+		return false;
+
+	fileOut << "BoxSize " << boxes.size() << "\n";
+	for (auto& box : boxes)
+	{
+		fileOut << "Center " << box.Center[0] << " " << box.Center[1] << " " << box.Center[2] << "\n";
+		fileOut << "Extents " << box.Extents[0] << " " << box.Extents[1] << " " << box.Extents[2] << "\n";
+	}
+	return true;
+}
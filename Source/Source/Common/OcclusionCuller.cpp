@@ -0,0 +1,515 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCCLUSION_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// Corners are numbered by bits: 1 = +x, 2 = +y, 4 = +z.
+	// Clockwise seen from outside, the front face winding of the scene.
+	const int BoxIndices[36] =
+	{
+		0, 2, 3, 0, 3, 1,	// -z
+		5, 7, 6, 5, 6, 4,	// +z
+		4, 6, 2, 4, 2, 0,	// -x
+		1, 3, 7, 1, 7, 5,	// +x
+		0, 1, 5, 0, 5, 4,	// -y
+		2, 6, 7, 2, 7, 3	// +y
+	};
+
+	void BoxCorners(const CullBox& box, float corners[8][3])
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			corners[i][0] = box.Center[0] + (i & 1 ? box.Extents[0] : -box.Extents[0]);
+			corners[i][1] = box.Center[1] + (i & 2 ? box.Extents[1] : -box.Extents[1]);
+			corners[i][2] = box.Center[2] + (i & 4 ? box.Extents[2] : -box.Extents[2]);
+		}
+	}
+
+	// (x, y, z, 1) * m
+	void TransformPoint(const float m[16], const float* p, float* out)
+	{
+#ifdef OCCLUSION_SSE
+		__m128 r = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0]), _mm_loadu_ps(m)), _mm_mul_ps(_mm_set1_ps(p[1]), _mm_loadu_ps(m + 4))),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[2]), _mm_loadu_ps(m + 8)), _mm_loadu_ps(m + 12)));
+		_mm_storeu_ps(out, r);
+#else
+		for (int j = 0; j < 4; ++j)
+			out[j] = p[0] * m[j] + p[1] * m[4 + j] + p[2] * m[8 + j] + m[12 + j];
+#endif
+	}
+
+	// Clip-space point to pixels, y down, with the depth in z
+	void ToScreen(const float* clip, float width, float height, float* out)
+	{
+		float invW = 1.0f / clip[3];
+		out[0] = (clip[0] * invW * 0.5f + 0.5f) * width;
+		out[1] = (0.5f - clip[1] * invW * 0.5f) * height;
+		out[2] = clip[2] * invW;
+	}
+
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	// Left-handed perspective like XMMatrixPerspectiveFovLH, row-major
+	void PerspectiveFovLH(float fovY, float aspect, float nearZ, float farZ, float m[16])
+	{
+		float yScale = 1.0f / std::tan(fovY * 0.5f);
+		float range = farZ / (farZ - nearZ);
+		std::fill(m, m + 16, 0.0f);
+		m[0] = yScale / aspect;
+		m[5] = yScale;
+		m[10] = range;
+		m[11] = 1.0f;
+		m[14] = -range * nearZ;
+	}
+
+	// Does the segment from the origin to p pass through the box
+	bool SegmentHitsBox(const float* p, const CullBox& box)
+	{
+		float tMin = 0.0f;
+		float tMax = 1.0f;
+		for (int a = 0; a < 3; ++a)
+		{
+			float lo = box.Center[a] - box.Extents[a];
+			float hi = box.Center[a] + box.Extents[a];
+			if (std::fabs(p[a]) < 1e-6f)
+			{
+				if (0.0f < lo || 0.0f > hi)
+					return false;
+				continue;
+			}
+			float t0 = lo / p[a];
+			float t1 = hi / p[a];
+			if (t0 > t1)
+				std::swap(t0, t1);
+			tMin = (std::max)(tMin, t0);
+			tMax = (std::min)(tMax, t1);
+			if (tMin > tMax)
+				return false;
+		}
+		return true;
+	}
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+	: mWidth(width),
+	mHeight(height)
+{
+	assert(width >= 4 && (width & (width - 1)) == 0 && (height & (height - 1)) == 0);
+
+	for (;;)
+	{
+		mLevels.emplace_back((size_t)width * height, 1.0f);
+		if (width == 1 && height == 1)
+			break;
+		width = (std::max)(width / 2, 1u);
+		height = (std::max)(height / 2, 1u);
+	}
+}
+
+void OcclusionCuller::ClearOccluders()
+{
+	mTriangles.clear();
+}
+
+void OcclusionCuller::AddOccluder(const CullBox& box, const float world[16])
+{
+	float corners[8][3];
+	BoxCorners(box, corners);
+
+	float transformed[8][4];
+	for (int i = 0; i < 8; ++i)
+		TransformPoint(world, corners[i], transformed[i]);
+
+	// A mirroring world matrix turns the faces inside out
+	float det =
+		world[0] * (world[5] * world[10] - world[6] * world[9]) -
+		world[1] * (world[4] * world[10] - world[6] * world[8]) +
+		world[2] * (world[4] * world[9] - world[5] * world[8]);
+	bool flip = det < 0.0f;
+
+	for (int i = 0; i < 36; i += 3)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			int corner = BoxIndices[i + (flip ? 2 - j : j)];
+			mTriangles.insert(mTriangles.end(), transformed[corner], transformed[corner] + 3);
+		}
+	}
+}
+
+void OcclusionCuller::Render(const float viewProj[16])
+{
+	std::copy(viewProj, viewProj + 16, mViewProj);
+	std::fill(mLevels[0].begin(), mLevels[0].end(), 1.0f);
+	mRasterizedCount = 0;
+
+	float width = (float)mWidth;
+	float height = (float)mHeight;
+
+	for (size_t t = 0; t < mTriangles.size(); t += 9)
+	{
+		float clip[3][4];
+		for (int i = 0; i < 3; ++i)
+			TransformPoint(viewProj, &mTriangles[t + 3 * i], clip[i]);
+
+		// Clip against the near plane (z >= 0), which leaves at most four vertices
+		float polygon[4][4];
+		int count = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const float* a = clip[i];
+			const float* b = clip[(i + 1) % 3];
+			if (a[2] >= 0.0f)
+				std::copy(a, a + 4, polygon[count++]);
+			if ((a[2] >= 0.0f) != (b[2] >= 0.0f))
+			{
+				// From the inside vertex, so the triangle across the edge cuts it at the same point
+				const float* in = a[2] >= 0.0f ? a : b;
+				const float* out = a[2] >= 0.0f ? b : a;
+				float s = in[2] / (in[2] - out[2]);
+				for (int j = 0; j < 4; ++j)
+					polygon[count][j] = in[j] + s * (out[j] - in[j]);
+				++count;
+			}
+		}
+		if (count < 3)
+			continue;
+
+		float screen[4][3];
+		for (int i = 0; i < count; ++i)
+			ToScreen(polygon[i], width, height, screen[i]);
+
+		for (int i = 1; i + 1 < count; ++i)
+			RasterizeTriangle(screen[0], screen[i], screen[i + 1]);
+	}
+
+	BuildPyramid();
+}
+
+bool OcclusionCuller::IsVisible(const CullBox& box) const
+{
+	float corners[8][3];
+	BoxCorners(box, corners);
+
+	float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int i = 0; i < 8; ++i)
+	{
+		float clip[4];
+		TransformPoint(mViewProj, corners[i], clip);
+		if (clip[2] < 0.0f)
+			return true;
+
+		float screen[3];
+		ToScreen(clip, (float)mWidth, (float)mHeight, screen);
+		minX = (std::min)(minX, screen[0]);
+		maxX = (std::max)(maxX, screen[0]);
+		minY = (std::min)(minY, screen[1]);
+		maxY = (std::max)(maxY, screen[1]);
+		minZ = (std::min)(minZ, screen[2]);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)mWidth || minY >= (float)mHeight)
+		return true;
+
+	// One pixel wider than the box, occluder edges only cover the pixels whose centers they contain
+	int x0 = (std::max)((int)minX - 1, 0);
+	int y0 = (std::max)((int)minY - 1, 0);
+	int x1 = (std::min)((int)maxX + 1, (int)mWidth - 1);
+	int y1 = (std::min)((int)maxY + 1, (int)mHeight - 1);
+
+	// The finest level where the rectangle spans at most 4 x 4 texels
+	uint32_t level = 0;
+	while (level + 1 < mLevels.size() && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+		++level;
+
+	const std::vector<float>& depth = mLevels[level];
+	uint32_t levelWidth = (std::max)(mWidth >> level, 1u);
+	uint32_t levelHeight = (std::max)(mHeight >> level, 1u);
+
+	float maxDepth = 0.0f;
+	for (uint32_t y = (uint32_t)y0 >> level; y <= (std::min)((uint32_t)y1 >> level, levelHeight - 1); ++y)
+	{
+		for (uint32_t x = (uint32_t)x0 >> level; x <= (std::min)((uint32_t)x1 >> level, levelWidth - 1); ++x)
+			maxDepth = (std::max)(maxDepth, depth[y * levelWidth + x]);
+	}
+
+	return minZ <= maxDepth;
+}
+
+uint32_t OcclusionCuller::TestBoxes(const CullBox* boxes, uint32_t count, uint8_t* visible) const
+{
+	uint32_t occluded = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (visible[i] && !IsVisible(boxes[i]))
+		{
+			visible[i] = 0;
+			++occluded;
+		}
+	}
+	return occluded;
+}
+
+uint32_t OcclusionCuller::GetWidth() const
+{
+	return mWidth;
+}
+
+uint32_t OcclusionCuller::GetHeight() const
+{
+	return mHeight;
+}
+
+uint32_t OcclusionCuller::GetTriangleCount() const
+{
+	return (uint32_t)(mTriangles.size() / 9);
+}
+
+uint32_t OcclusionCuller::GetRasterizedCount() const
+{
+	return mRasterizedCount;
+}
+
+void OcclusionCuller::Benchmark(uint32_t boxCount, uint32_t iterations, BenchmarkResult& result)
+{
+	result = BenchmarkResult();
+
+	const float fovY = 0.25f * 3.14159265f;
+	const float aspect = 2.0f;
+	const float tanY = std::tan(fovY * 0.5f);
+
+	// The eye sits at the origin looking down +z, so the projection is the view-projection
+	float viewProj[16];
+	PerspectiveFovLH(fovY, aspect, 1.0f, 1000.0f, viewProj);
+	float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+	// Walls with gaps between them, like the zone walls and rocks of the scene
+	std::vector<CullBox> walls;
+	for (int i = -3; i <= 3; ++i)
+	{
+		float z = 40.0f + 15.0f * (float)(i & 1);
+		walls.push_back({ { (float)i * 18.0f, 0.0f, z }, { 7.0f, 10.0f + 3.0f * (float)(i & 3), 2.0f } });
+	}
+
+	OcclusionCuller culler;
+	for (auto& w : walls)
+		culler.AddOccluder(w, identity);
+
+	std::mt19937 engine{ 1234u };
+	std::uniform_real_distribution<float> disDepth{ 10.0f, 300.0f };
+	std::uniform_real_distribution<float> disSide{ -0.8f, 0.8f };
+	std::uniform_real_distribution<float> disSize{ 0.5f, 4.0f };
+
+	std::vector<CullBox> boxes(boxCount);
+	for (auto& b : boxes)
+	{
+		float z = disDepth(engine);
+		b.Center[0] = disSide(engine) * z * tanY * aspect;
+		b.Center[1] = disSide(engine) * z * tanY;
+		b.Center[2] = z;
+		b.Extents[0] = disSize(engine);
+		b.Extents[1] = disSize(engine);
+		b.Extents[2] = disSize(engine);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i)
+		culler.Render(viewProj);
+	result.RenderTime = iterations > 0 ? ElapsedMs(start) / iterations : 0.0f;
+
+	std::vector<uint8_t> visible(boxCount);
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		std::fill(visible.begin(), visible.end(), (uint8_t)1);
+		result.Occluded = culler.TestBoxes(boxes.data(), boxCount, visible.data());
+	}
+	if (iterations > 0 && boxCount > 0)
+		result.TestTime = ElapsedMs(start) * 1000000.0f / ((float)iterations * boxCount);
+
+	// Reference: a box is visible when a ray from the eye reaches any point of a 5 x 5 grid
+	// on any of its faces, pulled slightly inwards so the ray does not graze the next face
+	const int Grid = 5;
+	result.Tested = boxCount;
+	for (uint32_t i = 0; i < boxCount; ++i)
+	{
+		const CullBox& b = boxes[i];
+		bool reached = false;
+		for (int axis = 0; axis < 3 && !reached; ++axis)
+		{
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+			for (int side = -1; side <= 1 && !reached; side += 2)
+			{
+				for (int gu = 0; gu < Grid && !reached; ++gu)
+				{
+					for (int gv = 0; gv < Grid && !reached; ++gv)
+					{
+						float p[3];
+						p[axis] = b.Center[axis] + side * b.Extents[axis] * 0.999f;
+						p[u] = b.Center[u] + b.Extents[u] * 0.999f * (2.0f * gu / (Grid - 1) - 1.0f);
+						p[v] = b.Center[v] + b.Extents[v] * 0.999f * (2.0f * gv / (Grid - 1) - 1.0f);
+
+						bool blocked = false;
+						for (auto& w : walls)
+						{
+							if (SegmentHitsBox(p, w))
+							{
+								blocked = true;
+								break;
+							}
+						}
+						reached = !blocked;
+					}
+				}
+			}
+		}
+
+		if (!reached)
+			++result.ReferenceOccluded;
+		else if (!visible[i])
+			++result.FalseOccluded;
+	}
+}
+
+// Edge functions in the form a * x + b * y + c, positive inside, evaluated at pixel centers
+void OcclusionCuller::RasterizeTriangle(const float* v0, const float* v1, const float* v2)
+{
+	float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]);
+	if (!(area > 0.0f))
+		return;
+
+	float minX = (std::min)({ v0[0], v1[0], v2[0] });
+	float maxX = (std::max)({ v0[0], v1[0], v2[0] });
+	float minY = (std::min)({ v0[1], v1[1], v2[1] });
+	float maxY = (std::max)({ v0[1], v1[1], v2[1] });
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)mWidth || minY >= (float)mHeight)
+		return;
+
+	int x0 = (std::max)((int)minX, 0) & ~3;
+	int y0 = (std::max)((int)minY, 0);
+	int x1 = (std::min)((int)maxX, (int)mWidth - 1);
+	int y1 = (std::min)((int)maxY, (int)mHeight - 1);
+	++mRasterizedCount;
+
+	// An edge shared with the next triangle is walked the other way there. Taking c from the same
+	// endpoint both times makes the two edge functions exact negatives, so every pixel center is
+	// inside one of the triangles and none falls through the crack between them.
+	const float* v[3] = { v0, v1, v2 };
+	float a[3], b[3], c[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* p = v[i];
+		const float* q = v[(i + 1) % 3];
+		const float* base = p[1] < q[1] || (p[1] == q[1] && p[0] < q[0]) ? p : q;
+		a[i] = -(q[1] - p[1]);
+		b[i] = q[0] - p[0];
+		c[i] = (q[1] - p[1]) * base[0] - (q[0] - p[0]) * base[1];
+	}
+
+	// Depth is linear in screen space: z = zA * x + zB * y + zC
+	float invArea = 1.0f / area;
+	float zA = (a[1] * v0[2] + a[2] * v1[2] + a[0] * v2[2]) * invArea;
+	float zB = (b[1] * v0[2] + b[2] * v1[2] + b[0] * v2[2]) * invArea;
+	float zC = (c[1] * v0[2] + c[2] * v1[2] + c[0] * v2[2]) * invArea;
+
+	std::vector<float>& depth = mLevels[0];
+
+#ifdef OCCLUSION_SSE
+	__m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+	__m128 depthA = _mm_set1_ps(zA);
+	__m128 zero = _mm_setzero_ps();
+	__m128 laneX = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		float py = (float)y + 0.5f;
+		__m128 rowE0 = _mm_set1_ps(b[0] * py + c[0]);
+		__m128 rowE1 = _mm_set1_ps(b[1] * py + c[1]);
+		__m128 rowE2 = _mm_set1_ps(b[2] * py + c[2]);
+		__m128 z = _mm_add_ps(_mm_mul_ps(depthA, _mm_add_ps(_mm_set1_ps((float)x0), laneX)), _mm_set1_ps(zB * py + zC));
+		__m128 stepZ = _mm_mul_ps(depthA, _mm_set1_ps(4.0f));
+
+		float* row = &depth[(size_t)y * mWidth];
+		for (int x = x0; x <= x1; x += 4)
+		{
+			// Edges are evaluated afresh at every pixel rather than stepped, so a pixel gets the
+			// same value whichever triangle covers it
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneX);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), rowE0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), rowE1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), rowE2);
+
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(inside))
+			{
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+
+			z = _mm_add_ps(z, stepZ);
+		}
+	}
+#else
+	for (int y = y0; y <= y1; ++y)
+	{
+		float py = (float)y + 0.5f;
+		float* row = &depth[(size_t)y * mWidth];
+		for (int x = x0; x <= x1; ++x)
+		{
+			float px = (float)x + 0.5f;
+			if (a[0] * px + (b[0] * py + c[0]) >= 0.0f &&
+				a[1] * px + (b[1] * py + c[1]) >= 0.0f &&
+				a[2] * px + (b[2] * py + c[2]) >= 0.0f)
+			{
+				row[x] = (std::min)(row[x], zA * px + zB * py + zC);
+			}
+		}
+	}
+#endif
+}
+
+void OcclusionCuller::BuildPyramid()
+{
+	uint32_t width = mWidth;
+	uint32_t height = mHeight;
+	for (size_t level = 1; level < mLevels.size(); ++level)
+	{
+		const std::vector<float>& src = mLevels[level - 1];
+		std::vector<float>& dst = mLevels[level];
+		uint32_t dstWidth = (std::max)(width / 2, 1u);
+		uint32_t dstHeight = (std::max)(height / 2, 1u);
+
+		for (uint32_t y = 0; y < dstHeight; ++y)
+		{
+			const float* row0 = &src[(size_t)(std::min)(2 * y, height - 1) * width];
+			const float* row1 = &src[(size_t)(std::min)(2 * y + 1, height - 1) * width];
+			for (uint32_t x = 0; x < dstWidth; ++x)
+			{
+				uint32_t sx0 = (std::min)(2 * x, width - 1);
+				uint32_t sx1 = (std::min)(2 * x + 1, width - 1);
+				dst[y * dstWidth + x] = (std::max)((std::max)(row0[sx0], row0[sx1]), (std::max)(row1[sx0], row1[sx1]));
+			}
+		}
+
+		width = dstWidth;
+		height = dstHeight;
+	}
+}
@@ -0,0 +1,22 @@
+#include "RandomStreams.h"
+
+RandomStreams::RandomStreams(uint32_t seed)
+	: mSeed(seed)
+{
+}
+
+void RandomStreams::Seed(uint32_t seed)
+{
+	mSeed = seed;
+}
+
+uint32_t RandomStreams::GetSeed() const
+{
+	return mSeed;
+}
+
+std::mt19937 RandomStreams::Create(eStream stream, uint32_t index) const
+{
+	std::seed_seq seq{ mSeed, (uint32_t)stream, index };
+	return std::mt19937(seq);
+}
@@ -0,0 +1,282 @@
+#include "RenderDevice.h"
+#include "TextureLoader.h"
+
+using Microsoft::WRL::ComPtr;
+
+UploadMemory::UploadMemory(ComPtr<ID3D12Resource> resource, BYTE* mappedData)
+	: mResource(resource),
+	mMappedData(mappedData),
+	mAddress(resource->GetGPUVirtualAddress())
+{
+}
+
+UploadMemory::UploadMemory(UINT64 size)
+	: mHostData(new BYTE[(size_t)size])
+{
+	mMappedData = mHostData.get();
+	mAddress = (D3D12_GPU_VIRTUAL_ADDRESS)reinterpret_cast<uintptr_t>(mMappedData);
+}
+
+UploadMemory::UploadMemory(UploadMemory&& rhs) noexcept
+	: mResource(std::move(rhs.mResource)),
+	mHostData(std::move(rhs.mHostData)),
+	mMappedData(rhs.mMappedData),
+	mAddress(rhs.mAddress)
+{
+	rhs.mMappedData = nullptr;
+	rhs.mAddress = 0;
+}
+
+UploadMemory& UploadMemory::operator=(UploadMemory&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		Release();
+		mResource = std::move(rhs.mResource);
+		mHostData = std::move(rhs.mHostData);
+		mMappedData = rhs.mMappedData;
+		mAddress = rhs.mAddress;
+		rhs.mMappedData = nullptr;
+		rhs.mAddress = 0;
+	}
+	return *this;
+}
+
+UploadMemory::~UploadMemory()
+{
+	Release();
+}
+
+BYTE* UploadMemory::GetCPU() const
+{
+	return mMappedData;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS UploadMemory::GetGPU() const
+{
+	return mAddress;
+}
+
+void UploadMemory::Release()
+{
+	if (mResource != nullptr)
+		mResource->Unmap(0, nullptr);
+	mResource = nullptr;
+	mHostData = nullptr;
+	mMappedData = nullptr;
+	mAddress = 0;
+}
+
+void RenderDevice::CountDescriptorHeap(UINT descriptorCount)
+{
+	mDescriptorCounts.Heaps++;
+	mDescriptorCounts.Descriptors += descriptorCount;
+	mHeapSize = descriptorCount;
+}
+
+void RenderDevice::CountTextureView(D3D12_SRV_DIMENSION dimension, UINT index)
+{
+	if (dimension == D3D12_SRV_DIMENSION_TEXTURECUBE)
+		mDescriptorCounts.CubeViews++;
+	else
+		mDescriptorCounts.TextureViews++;
+
+	if (index >= mHeapSize)
+		mDescriptorCounts.OutOfRange++;
+}
+
+D3D12RenderDevice::D3D12RenderDevice(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList)
+	: mDevice(device),
+	mCommandList(cmdList),
+	mDescriptorSize(device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV))
+{
+}
+
+UploadMemory D3D12RenderDevice::CreateUploadBuffer(UINT64 size, const wchar_t* name)
+{
+	ComPtr<ID3D12Resource> buffer;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer)));
+	if (name)
+		buffer->SetName(name);
+
+	// Stays mapped until the UploadMemory is destroyed. We must not write to it
+	// while the GPU reads it, which the frame fences take care of.
+	BYTE* mappedData = nullptr;
+	ThrowIfFailed(buffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedData)));
+	return UploadMemory(buffer, mappedData);
+}
+
+ComPtr<ID3D12Resource> D3D12RenderDevice::CreateDefaultBuffer(
+	const void* initData, UINT64 byteSize, ComPtr<ID3D12Resource>& uploadBuffer)
+{
+	return d3dUtil::CreateDefaultBuffer(mDevice, mCommandList, initData, byteSize, uploadBuffer);
+}
+
+void D3D12RenderDevice::CreateTexture(Texture* tex)
+{
+	const std::wstring& fileName = tex->Filename;
+	bool isDDS = fileName.size() >= 3 && fileName.compare(fileName.size() - 3, 3, L"dds") == 0;
+
+	if (isDDS)
+	{
+		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(mDevice,
+			mCommandList, fileName.c_str(),
+			tex->Resource, tex->UploadHeap));
+	}
+	else
+	{
+		ThrowIfFailed(DirectX::CreateImageDataTextureFromFile(mDevice,
+			mCommandList, fileName.c_str(),
+			tex->Resource, tex->UploadHeap));
+	}
+}
+
+ComPtr<ID3D12DescriptorHeap> D3D12RenderDevice::CreateDescriptorHeap(UINT descriptorCount)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc;
+	heapDesc.NumDescriptors = descriptorCount;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	heapDesc.NodeMask = 0;
+
+	ComPtr<ID3D12DescriptorHeap> heap;
+	ThrowIfFailed(mDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&heap)));
+	CountDescriptorHeap(descriptorCount);
+	return heap;
+}
+
+void D3D12RenderDevice::CreateTextureView(ID3D12Resource* texture, D3D12_SRV_DIMENSION dimension, ID3D12DescriptorHeap* heap, UINT index)
+{
+	D3D12_RESOURCE_DESC texDesc = texture->GetDesc();
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = texDesc.Format;
+	srvDesc.ViewDimension = dimension;
+	if (dimension == D3D12_SRV_DIMENSION_TEXTURECUBE)
+	{
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		srvDesc.TextureCube.MipLevels = texDesc.MipLevels;
+		srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+	}
+	else
+	{
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = texDesc.MipLevels;
+		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	}
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(heap->GetCPUDescriptorHandleForHeapStart());
+	hDescriptor.Offset(index, mDescriptorSize);
+	mDevice->CreateShaderResourceView(texture, &srvDesc, hDescriptor);
+	CountTextureView(dimension, index);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE D3D12RenderDevice::GetGPUDescriptor(ID3D12DescriptorHeap* heap, UINT index) const
+{
+	CD3DX12_GPU_DESCRIPTOR_HANDLE hDescriptor(heap->GetGPUDescriptorHandleForHeapStart());
+	hDescriptor.Offset(index, mDescriptorSize);
+	return hDescriptor;
+}
+
+ComPtr<ID3D12RootSignature> D3D12RenderDevice::CreateRootSignature(ID3DBlob* serializedRootSig)
+{
+	ComPtr<ID3D12RootSignature> rootSignature;
+	ThrowIfFailed(mDevice->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(rootSignature.GetAddressOf())));
+	return rootSignature;
+}
+
+ComPtr<ID3D12PipelineState> D3D12RenderDevice::CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	ComPtr<ID3D12PipelineState> pipelineState;
+	ThrowIfFailed(mDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(pipelineState.GetAddressOf())));
+	return pipelineState;
+}
+
+ComPtr<ID3D12CommandAllocator> D3D12RenderDevice::CreateCommandAllocator()
+{
+	ComPtr<ID3D12CommandAllocator> allocator;
+	ThrowIfFailed(mDevice->CreateCommandAllocator(
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		IID_PPV_ARGS(allocator.GetAddressOf())));
+	return allocator;
+}
+
+ComPtr<ID3D12GraphicsCommandList> D3D12RenderDevice::CreateCommandList(ID3D12CommandAllocator* allocator)
+{
+	ComPtr<ID3D12GraphicsCommandList> cmdList;
+	ThrowIfFailed(mDevice->CreateCommandList(
+		0,
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		allocator,
+		nullptr,
+		IID_PPV_ARGS(cmdList.GetAddressOf())));
+
+	// The owner resets the list before recording
+	ThrowIfFailed(cmdList->Close());
+	return cmdList;
+}
+
+UploadMemory NullRenderDevice::CreateUploadBuffer(UINT64 size, const wchar_t* name)
+{
+	return UploadMemory(size);
+}
+
+ComPtr<ID3D12Resource> NullRenderDevice::CreateDefaultBuffer(
+	const void* initData, UINT64 byteSize, ComPtr<ID3D12Resource>& uploadBuffer)
+{
+	uploadBuffer = nullptr;
+	return nullptr;
+}
+
+void NullRenderDevice::CreateTexture(Texture* tex)
+{
+}
+
+ComPtr<ID3D12DescriptorHeap> NullRenderDevice::CreateDescriptorHeap(UINT descriptorCount)
+{
+	CountDescriptorHeap(descriptorCount);
+	return nullptr;
+}
+
+void NullRenderDevice::CreateTextureView(ID3D12Resource* texture, D3D12_SRV_DIMENSION dimension, ID3D12DescriptorHeap* heap, UINT index)
+{
+	CountTextureView(dimension, index);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE NullRenderDevice::GetGPUDescriptor(ID3D12DescriptorHeap* heap, UINT index) const
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE handle;
+	handle.ptr = index;
+	return handle;
+}
+
+ComPtr<ID3D12RootSignature> NullRenderDevice::CreateRootSignature(ID3DBlob* serializedRootSig)
+{
+	return nullptr;
+}
+
+ComPtr<ID3D12PipelineState> NullRenderDevice::CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	return nullptr;
+}
+
+ComPtr<ID3D12CommandAllocator> NullRenderDevice::CreateCommandAllocator()
+{
+	return nullptr;
+}
+
+ComPtr<ID3D12GraphicsCommandList> NullRenderDevice::CreateCommandList(ID3D12CommandAllocator* allocator)
+{
+	return nullptr;
+}
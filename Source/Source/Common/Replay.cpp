@@ -0,0 +1,116 @@
+#include "Replay.h"
+#include <fstream>
+#include <iomanip>
+
+bool FrameInput::IsDown(eInputKey key) const
+{
+	return (Keys & (1u << (uint32_t)key)) != 0;
+}
+
+void FrameInput::SetDown(eInputKey key, bool down)
+{
+	if (down)
+		Keys |= 1u << (uint32_t)key;
+	else
+		Keys &= ~(1u << (uint32_t)key);
+}
+
+void Replay::StartRecording(uint32_t seed)
+{
+	mMode = eMode::Record;
+	mSeed = seed;
+	mCountsPerSecond = mTimer.CountsPerSecond();
+	mFrames.clear();
+	mNextFrame = 0;
+}
+
+bool Replay::Save(const std::string& fileName) const
+{
+	std::ofstream fileOut(fileName);
+	if (!fileOut)
+		return false;
+
+	// 9 significant digits read back to the same float
+	fileOut << std::setprecision(9);
+	fileOut << "Seed " << mSeed << "\n";
+	fileOut << "CountsPerSecond " << mCountsPerSecond << "\n";
+	fileOut << "FrameSize " << mFrames.size() << "\n";
+	for (auto& e : mFrames)
+	{
+		fileOut << "Frame " << e.DeltaCounts << " " << e.TotalCounts << " " << e.Input.Keys << " "
+			<< e.Input.CameraPitch << " " << e.Input.CameraYaw << " " << e.Input.PlayerYaw << "\n";
+	}
+	return true;
+}
+
+bool Replay::Load(const std::string& fileName)
+{
+	std::ifstream fileIn(fileName);
+	if (!fileIn)
+		return false;
+
+	std::string ignore;
+	size_t frameSize = 0;
+	fileIn >> ignore >> mSeed;
+	fileIn >> ignore >> mCountsPerSecond;
+	fileIn >> ignore >> frameSize;
+
+	mFrames.resize(frameSize);
+	for (auto& e : mFrames)
+	{
+		fileIn >> ignore >> e.DeltaCounts >> e.TotalCounts >> e.Input.Keys
+			>> e.Input.CameraPitch >> e.Input.CameraYaw >> e.Input.PlayerYaw;
+	}
+
+	if (!fileIn || mCountsPerSecond <= 0)
+	{
+		mFrames.clear();
+		mMode = eMode::Off;
+		return false;
+	}
+
+	mMode = eMode::Play;
+	mNextFrame = 0;
+	mTimer.SetCountsPerSecond(mCountsPerSecond);
+	mTimer.Reset();
+	return true;
+}
+
+Replay::eMode Replay::GetMode() const
+{
+	return mMode;
+}
+
+uint32_t Replay::GetSeed() const
+{
+	return mSeed;
+}
+
+size_t Replay::GetFrameCount() const
+{
+	return mFrames.size();
+}
+
+bool Replay::IsFinished() const
+{
+	return mMode == eMode::Play && mNextFrame >= mFrames.size();
+}
+
+const GameTimer& Replay::BeginFrame(const GameTimer& clock, FrameInput& input)
+{
+	if (mMode == eMode::Record)
+	{
+		mFrames.push_back({ clock.DeltaCounts(), clock.TotalCounts(), input });
+		return clock;
+	}
+
+	if (mMode == eMode::Play && mNextFrame < mFrames.size())
+	{
+		const Frame& frame = mFrames[mNextFrame++];
+		mTimer.Advance(frame.DeltaCounts, frame.TotalCounts);
+		input = frame.Input;
+		return mTimer;
+	}
+
+	return clock;
+}
@@ -0,0 +1,361 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+const uint32_t SpatialGrid::NoId;
+
+SpatialGrid::SpatialGrid(float cellSize)
+	: mCellSize(cellSize), mInvCellSize(1.0f / cellSize)
+{
+	mBuckets.resize(64, NoId);
+	mBucketMask = 63;
+}
+
+void SpatialGrid::Clear()
+{
+	std::fill(mBuckets.begin(), mBuckets.end(), NoId);
+	std::fill(mPresent.begin(), mPresent.end(), (uint8_t)0);
+	mCount = 0;
+}
+
+void SpatialGrid::Insert(uint32_t id, float x, float z)
+{
+	if (id >= mPresent.size())
+	{
+		size_t size = (size_t)id + 1;
+		mX.resize(size);
+		mZ.resize(size);
+		mCellX.resize(size);
+		mCellZ.resize(size);
+		mNext.resize(size, NoId);
+		mPrev.resize(size, NoId);
+		mPresent.resize(size, 0);
+	}
+
+	if (mPresent[id])
+	{
+		Move(id, x, z);
+		return;
+	}
+
+	mX[id] = x;
+	mZ[id] = z;
+	mCellX[id] = CellCoord(x);
+	mCellZ[id] = CellCoord(z);
+	++mCount;
+
+	// Keep about two buckets per character so a bucket rarely holds more than one cell
+	if (mCount * 2 > mBuckets.size())
+		Grow();
+	Link(id);
+}
+
+void SpatialGrid::Move(uint32_t id, float x, float z)
+{
+	if (!Contains(id))
+	{
+		Insert(id, x, z);
+		return;
+	}
+
+	mX[id] = x;
+	mZ[id] = z;
+
+	int cellX = CellCoord(x);
+	int cellZ = CellCoord(z);
+	if (cellX == mCellX[id] && cellZ == mCellZ[id])
+		return;
+
+	Unlink(id);
+	mCellX[id] = cellX;
+	mCellZ[id] = cellZ;
+	Link(id);
+}
+
+void SpatialGrid::Remove(uint32_t id)
+{
+	if (!Contains(id))
+		return;
+
+	Unlink(id);
+	--mCount;
+}
+
+bool SpatialGrid::Contains(uint32_t id) const
+{
+	return id < mPresent.size() && mPresent[id] != 0;
+}
+
+uint32_t SpatialGrid::GetCount() const
+{
+	return mCount;
+}
+
+template<typename Visit>
+void SpatialGrid::ForEachInRadius(float x, float z, float radius, Visit visit) const
+{
+	if (mCount == 0 || radius < 0.0f)
+		return;
+
+	int minX = CellCoord(x - radius), maxX = CellCoord(x + radius);
+	int minZ = CellCoord(z - radius), maxZ = CellCoord(z + radius);
+	float radius2 = radius * radius;
+
+	for (int cz = minZ; cz <= maxZ; ++cz)
+	{
+		for (int cx = minX; cx <= maxX; ++cx)
+		{
+			// Cells sharing a bucket are told apart by the cell of each id
+			for (uint32_t id = mBuckets[Bucket(cx, cz)]; id != NoId; id = mNext[id])
+			{
+				if (mCellX[id] != cx || mCellZ[id] != cz)
+					continue;
+
+				float dx = mX[id] - x;
+				float dz = mZ[id] - z;
+				float d2 = dx * dx + dz * dz;
+				if (d2 <= radius2)
+					visit(id, d2);
+			}
+		}
+	}
+}
+
+void SpatialGrid::QueryRadius(float x, float z, float radius, std::vector<uint32_t>& outIds) const
+{
+	outIds.clear();
+	ForEachInRadius(x, z, radius, [&outIds](uint32_t id, float) { outIds.push_back(id); });
+	std::sort(outIds.begin(), outIds.end());
+}
+
+void SpatialGrid::QueryNearest(float x, float z, uint32_t k, float maxRadius, std::vector<uint32_t>& outIds) const
+{
+	outIds.clear();
+	if (k == 0 || mCount == 0)
+		return;
+
+	// Max-heap of the k best (distance, id) found so far
+	std::vector<std::pair<float, uint32_t>> best;
+	best.reserve(k + 1);
+
+	int centerX = CellCoord(x);
+	int centerZ = CellCoord(z);
+	int maxRing = (int)std::ceil(maxRadius * mInvCellSize) + 1;
+	float maxRadius2 = maxRadius * maxRadius;
+
+	for (int ring = 0; ring <= maxRing; ++ring)
+	{
+		// Every cell of this ring is at least (ring - 1) cells away
+		float ringDistance = (float)(std::max)(ring - 1, 0) * mCellSize;
+		if (ringDistance > maxRadius)
+			break;
+		if (best.size() == k && ringDistance * ringDistance > best.front().first)
+			break;
+
+		for (int cz = centerZ - ring; cz <= centerZ + ring; ++cz)
+		{
+			bool edgeRow = cz == centerZ - ring || cz == centerZ + ring;
+			int step = edgeRow ? 1 : 2 * ring;
+
+			for (int cx = centerX - ring; cx <= centerX + ring; cx += (std::max)(step, 1))
+			{
+				for (uint32_t id = mBuckets[Bucket(cx, cz)]; id != NoId; id = mNext[id])
+				{
+					if (mCellX[id] != cx || mCellZ[id] != cz)
+						continue;
+
+					float dx = mX[id] - x;
+					float dz = mZ[id] - z;
+					float d2 = dx * dx + dz * dz;
+					if (d2 > maxRadius2)
+						continue;
+
+					std::pair<float, uint32_t> candidate(d2, id);
+					if (best.size() < k)
+					{
+						best.push_back(candidate);
+						std::push_heap(best.begin(), best.end());
+					}
+					else if (candidate < best.front())
+					{
+						std::pop_heap(best.begin(), best.end());
+						best.back() = candidate;
+						std::push_heap(best.begin(), best.end());
+					}
+				}
+			}
+		}
+	}
+
+	std::sort_heap(best.begin(), best.end());
+	for (auto& e : best)
+		outIds.push_back(e.second);
+}
+
+void SpatialGrid::QueryCone(float x, float z, float dirX, float dirZ, float radius, float halfAngle, std::vector<uint32_t>& outIds) const
+{
+	outIds.clear();
+
+	float length = std::sqrt(dirX * dirX + dirZ * dirZ);
+	if (length <= 0.0f)
+		return;
+	dirX /= length;
+	dirZ /= length;
+
+	// dot(dir, d) >= cos(halfAngle) * |d|, compared squared with the sign kept
+	float cosHalf = std::cos(halfAngle);
+	float cosHalf2 = cosHalf * cosHalf;
+
+	ForEachInRadius(x, z, radius, [&](uint32_t id, float d2)
+	{
+		float dot = dirX * (mX[id] - x) + dirZ * (mZ[id] - z);
+		bool inside = cosHalf >= 0.0f
+			? dot >= 0.0f && dot * dot >= cosHalf2 * d2
+			: dot >= 0.0f || dot * dot <= cosHalf2 * d2;
+		if (inside)
+			outIds.push_back(id);
+	});
+	std::sort(outIds.begin(), outIds.end());
+}
+
+void SpatialGrid::Benchmark(uint32_t characterCount, uint32_t queryCount, BenchmarkResult& result)
+{
+	result = BenchmarkResult();
+
+	float side = std::sqrt((float)characterCount * 25.0f);
+	std::mt19937 engine{ 1234u };
+	std::uniform_real_distribution<float> disPos{ 0.0f, side };
+	std::uniform_real_distribution<float> disStep{ -0.15f, 0.15f };
+	std::uniform_real_distribution<float> disAngle{ 0.0f, 6.2831853f };
+
+	std::vector<float> xs(characterCount), zs(characterCount);
+	for (uint32_t i = 0; i < characterCount; ++i)
+	{
+		xs[i] = disPos(engine);
+		zs[i] = disPos(engine);
+	}
+
+	SpatialGrid grid;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < characterCount; ++i)
+		grid.Insert(i, xs[i], zs[i]);
+	result.BuildTime = ElapsedMs(start);
+
+	// One frame of walking
+	for (uint32_t i = 0; i < characterCount; ++i)
+	{
+		xs[i] += disStep(engine);
+		zs[i] += disStep(engine);
+	}
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < characterCount; ++i)
+		grid.Move(i, xs[i], zs[i]);
+	result.MoveTime = ElapsedMs(start);
+
+	std::vector<float> qx(queryCount), qz(queryCount), qa(queryCount);
+	for (uint32_t i = 0; i < queryCount; ++i)
+	{
+		qx[i] = disPos(engine);
+		qz[i] = disPos(engine);
+		qa[i] = disAngle(engine);
+	}
+
+	const float radius = 5.0f;
+	std::vector<std::vector<uint32_t>> gridResults(queryCount);
+	std::vector<uint32_t> ids;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < queryCount; ++i)
+		grid.QueryRadius(qx[i], qz[i], radius, gridResults[i]);
+	result.RadiusTime = ElapsedMs(start) * 1e6f / (std::max)(queryCount, 1u);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < queryCount; ++i)
+		grid.QueryNearest(qx[i], qz[i], 4, 100.0f, ids);
+	result.NearestTime = ElapsedMs(start) * 1e6f / (std::max)(queryCount, 1u);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < queryCount; ++i)
+		grid.QueryCone(qx[i], qz[i], std::cos(qa[i]), std::sin(qa[i]), 10.0f, 0.7853982f, ids);
+	result.ConeTime = ElapsedMs(start) * 1e6f / (std::max)(queryCount, 1u);
+
+	// The linear scan the grid replaces
+	std::vector<std::vector<uint32_t>> bruteResults(queryCount);
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < queryCount; ++i)
+	{
+		for (uint32_t c = 0; c < characterCount; ++c)
+		{
+			float dx = xs[c] - qx[i];
+			float dz = zs[c] - qz[i];
+			if (dx * dx + dz * dz <= radius * radius)
+				bruteResults[i].push_back(c);
+		}
+	}
+	result.BruteForceTime = ElapsedMs(start) * 1e6f / (std::max)(queryCount, 1u);
+
+	for (uint32_t i = 0; i < queryCount; ++i)
+	{
+		if (gridResults[i] != bruteResults[i])
+			result.Mismatches++;
+	}
+}
+
+int SpatialGrid::CellCoord(float v) const
+{
+	return (int)std::floor(v * mInvCellSize);
+}
+
+uint32_t SpatialGrid::Bucket(int cellX, int cellZ) const
+{
+	return ((uint32_t)cellX * 73856093u ^ (uint32_t)cellZ * 19349663u) & mBucketMask;
+}
+
+void SpatialGrid::Grow()
+{
+	size_t size = mBuckets.size() * 2;
+	mBuckets.assign(size, NoId);
+	mBucketMask = (uint32_t)size - 1;
+
+	// Relink everything present, the new id is linked by Insert
+	for (uint32_t id = 0; id < mPresent.size(); ++id)
+	{
+		if (mPresent[id])
+			Link(id);
+	}
+}
+
+// At the head of its bucket
+void SpatialGrid::Link(uint32_t id)
+{
+	uint32_t& head = mBuckets[Bucket(mCellX[id], mCellZ[id])];
+	mPrev[id] = NoId;
+	mNext[id] = head;
+	if (head != NoId)
+		mPrev[head] = id;
+	head = id;
+	mPresent[id] = 1;
+}
+
+void SpatialGrid::Unlink(uint32_t id)
+{
+	if (mPrev[id] != NoId)
+		mNext[mPrev[id]] = mNext[id];
+	else
+		mBuckets[Bucket(mCellX[id], mCellZ[id])] = mNext[id];
+	if (mNext[id] != NoId)
+		mPrev[mNext[id]] = mPrev[id];
+
+	mPresent[id] = 0;
+}
@@ -0,0 +1,191 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if (threadCount == 0)
+	{
+		unsigned int hardwareCount = std::thread::hardware_concurrency();
+		threadCount = hardwareCount > 1 ? hardwareCount - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; ++i)
+		mWorkers.emplace_back(&ThreadPool::WorkerMain, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mTaskReady.notify_all();
+
+	for (auto& e : mWorkers)
+		e.join();
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return (unsigned int)mWorkers.size();
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(std::move(task));
+		++mActiveTasks;
+	}
+	mTaskReady.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mTaskDone.wait(lock, [this] { return mActiveTasks == 0; });
+}
+
+void ThreadPool::Run(unsigned int count, void (*invoke)(const void*, unsigned int), const void* body)
+{
+	if (count == 0)
+		return;
+
+	// Helpers that join after the loop has drained find nothing left and return
+	unsigned int helpers = (std::min)(count - 1, GetThreadCount());
+
+	Loop* loop;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mFreeLoops.empty())
+		{
+			// Only when more loops run at once than ever before
+			mLoops.push_back(std::make_unique<Loop>());
+			mFreeLoops.reserve(mLoops.size());
+			mLoopQueue.reserve(mLoops.size());
+			mFreeLoops.push_back(mLoops.back().get());
+		}
+		loop = mFreeLoops.back();
+		mFreeLoops.pop_back();
+
+		loop->Invoke = invoke;
+		loop->Body = body;
+		loop->Count = count;
+		loop->Next = 0;
+		loop->Done = 0;
+		loop->Wanted = helpers;
+		loop->Error = nullptr;
+		loop->Failed = false;
+		if (helpers > 0)
+			mLoopQueue.push_back(loop);
+	}
+	if (helpers > 0)
+		mTaskReady.notify_all();
+
+	RunLoop(*loop);
+
+	std::exception_ptr error;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mLoopDone.wait(lock, [loop] { return loop->Done == loop->Count && loop->Active == 0; });
+
+		// Helpers that never joined must not find it once it is reused
+		if (loop->Wanted > 0)
+		{
+			mLoopQueue.erase(std::find(mLoopQueue.begin(), mLoopQueue.end(), loop));
+			loop->Wanted = 0;
+		}
+		error = loop->Error;
+		loop->Error = nullptr;
+		mFreeLoops.push_back(loop);
+	}
+
+	// Every index is done, so nothing still runs the body on the caller's locals
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void ThreadPool::RunLoop(Loop& loop)
+{
+	for (unsigned int i = loop.Next++; i < loop.Count; i = loop.Next++)
+	{
+		// After a failure the remaining indices are only counted
+		if (!loop.Failed)
+		{
+			try
+			{
+				loop.Invoke(loop.Body, i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (!loop.Error)
+					loop.Error = std::current_exception();
+				loop.Failed = true;
+			}
+		}
+
+		++loop.Done;
+	}
+}
+
+void ThreadPool::WorkerMain()
+{
+#ifdef _WIN32
+	// WIC decoders are created on the workers
+	CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+
+	for (;;)
+	{
+		std::function<void()> task;
+		Loop* loop = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mTaskReady.wait(lock, [this] { return mStop || !mTasks.empty() || !mLoopQueue.empty(); });
+
+			// Loops first, their callers are waiting on them
+			if (!mLoopQueue.empty())
+			{
+				loop = mLoopQueue.back();
+				++loop->Active;
+				if (--loop->Wanted == 0)
+					mLoopQueue.pop_back();
+			}
+			else if (mStop && mTasks.empty())
+				break;
+			else
+			{
+				task = std::move(mTasks.front());
+				mTasks.pop_front();
+			}
+		}
+
+		if (loop)
+		{
+			RunLoop(*loop);
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				--loop->Active;
+			}
+			mLoopDone.notify_all();
+			continue;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			--mActiveTasks;
+		}
+		mTaskDone.notify_all();
+	}
+
+#ifdef _WIN32
+	CoUninitialize();
+#endif
+}
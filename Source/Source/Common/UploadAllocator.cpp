@@ -0,0 +1,66 @@
+#include "UploadAllocator.h"
+
+UploadAllocator::UploadAllocator(RenderDevice* device, UINT64 capacity)
+	: mDevice(device),
+	mAllocator(capacity)
+{
+	CreateBuffer(capacity);
+}
+
+void UploadAllocator::Reset()
+{
+	mRetired.clear();
+	mRetiredSize = 0;
+	mAllocator.Reset();
+}
+
+UploadAllocation UploadAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+	// Nothing to place; LinearAllocator would report it as exhaustion
+	if (size == 0)
+		return UploadAllocation();
+
+	UINT64 offset = mAllocator.Allocate(size, alignment);
+	if (offset == LinearAllocator::InvalidOffset)
+	{
+		// Keep the full buffer for this frame and continue in one twice as large
+		UINT64 capacity = (std::max)(mAllocator.GetCapacity() * 2, size + alignment);
+
+		mRetiredSize += mAllocator.GetUsedSize();
+		mRetired.push_back(std::move(mBuffer));
+
+		CreateBuffer(capacity);
+		mAllocator.Reset(capacity);
+		++mGrowCount;
+
+		offset = mAllocator.Allocate(size, alignment);
+		if (offset == LinearAllocator::InvalidOffset)
+			throw std::exception("Upload allocation failed after growing");
+	}
+
+	UploadAllocation allocation;
+	allocation.CPU = mBuffer.GetCPU() + offset;
+	allocation.GPU = mBuffer.GetGPU() + offset;
+	return allocation;
+}
+
+UINT64 UploadAllocator::GetCapacity() const
+{
+	return mAllocator.GetCapacity();
+}
+
+UINT64 UploadAllocator::GetUsedSize() const
+{
+	return mRetiredSize + mAllocator.GetUsedSize();
+}
+
+UINT UploadAllocator::GetGrowCount() const
+{
+	return mGrowCount;
+}
+
+void UploadAllocator::CreateBuffer(UINT64 capacity)
+{
+	// Stays mapped until the buffer is outgrown or destroyed
+	mBuffer = mDevice->CreateUploadBuffer(capacity, L"Frame Upload Allocator");
+}
\ No newline at end of file
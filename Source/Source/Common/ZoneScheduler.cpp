@@ -0,0 +1,112 @@
+#include "ZoneScheduler.h"
+#include <chrono>
+#include "ThreadPool.h"
+
+namespace
+{
+	float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+void ZoneScheduler::SetZoneCount(uint32_t count)
+{
+	mSteps.assign(count, FixedStep(mBackgroundRate));
+	mStats.assign(count, ZoneStats());
+	if (mActiveZone < count)
+		mSteps[mActiveZone].SetRate(mActiveRate);
+}
+
+void ZoneScheduler::SetRates(float activeRate, float backgroundRate)
+{
+	mActiveRate = activeRate;
+	mBackgroundRate = backgroundRate;
+	for (uint32_t i = 0; i < (uint32_t)mSteps.size(); ++i)
+		mSteps[i].SetRate(i == mActiveZone ? mActiveRate : mBackgroundRate);
+}
+
+void ZoneScheduler::SetBudget(float budget)
+{
+	mBudget = budget;
+}
+
+void ZoneScheduler::Run(uint32_t activeZone, float deltaTime, ThreadPool* threadPool, const StepFunction& step)
+{
+	if (activeZone != mActiveZone)
+	{
+		if (mActiveZone < mSteps.size())
+			mSteps[mActiveZone].SetRate(mBackgroundRate);
+		if (activeZone < mSteps.size())
+			mSteps[activeZone].SetRate(mActiveRate);
+		mActiveZone = activeZone;
+	}
+
+	for (auto& e : mSteps)
+		e.Accumulate(deltaTime);
+
+	uint32_t zoneCount = (uint32_t)mSteps.size();
+	if (threadPool)
+		threadPool->ParallelFor(zoneCount, [this, &step](unsigned int zone) { RunZone(zone, step); });
+	else
+	{
+		for (uint32_t zone = 0; zone < zoneCount; ++zone)
+			RunZone(zone, step);
+	}
+}
+
+void ZoneScheduler::RunZone(uint32_t zone, const StepFunction& step)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	FixedStep& fixedStep = mSteps[zone];
+	ZoneStats& stats = mStats[zone];
+	bool limited = mBudget > 0.0f && zone != mActiveZone;
+
+	stats.Steps = 0;
+	while (fixedStep.Step())
+	{
+		step(zone, fixedStep.GetTime(), fixedStep.GetStep());
+		++stats.Steps;
+
+		// The player's zone always catches up, it is the one on screen
+		if (limited && ElapsedMs(start) > mBudget)
+		{
+			// Counted only when steps are left over
+			if (fixedStep.GetAlpha() >= 1.0f)
+				stats.OverBudget++;
+			break;
+		}
+	}
+	stats.Time = ElapsedMs(start);
+}
+
+uint32_t ZoneScheduler::GetZoneCount() const
+{
+	return (uint32_t)mSteps.size();
+}
+
+float ZoneScheduler::GetActiveRate() const
+{
+	return mActiveRate;
+}
+
+float ZoneScheduler::GetBackgroundRate() const
+{
+	return mBackgroundRate;
+}
+
+float ZoneScheduler::GetBudget() const
+{
+	return mBudget;
+}
+
+float ZoneScheduler::GetAlpha(uint32_t zone) const
+{
+	return mSteps[zone].GetAlpha();
+}
+
+const ZoneScheduler::ZoneStats& ZoneScheduler::GetStats(uint32_t zone) const
+{
+	return mStats[zone];
+}
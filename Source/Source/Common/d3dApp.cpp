@@ -607,12 +607,15 @@ void D3DApp::CalculateFrameStats()
 		float fps = (float)frameCnt; // fps = frameCnt / 1
 		float mspf = 1000.0f / fps;
 
+        UpdateFrameStatsText();
+
         wstring fpsStr = to_wstring(fps);
         wstring mspfStr = to_wstring(mspf);
 
         wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            mFrameStatsText;
 
         SetWindowText(mhMainWnd, windowText.c_str());
 		
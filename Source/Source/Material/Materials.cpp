@@ -1,4 +1,5 @@
 #include "Materials.h"
+#include <algorithm>
 
 Materials::Materials()
 {
@@ -10,75 +11,154 @@ Materials::~Materials()
 
 UINT Materials::GetSize() const
 {
-	return (UINT)mMaterials.size();
+	return (UINT)mName.size();
 }
 
-Material * Materials::Get(std::string Name)
+MaterialHandle Materials::Get(const std::string& Name) const
 {
-	return mMaterials[Name].get();
+	auto iter = mLookup.find(Name);
+	if (iter == mLookup.end())
+		return -1;
+
+	return iter->second;
 }
 
-void Materials::SetMaterial(
+const std::string& Materials::GetName(MaterialHandle Handle) const
+{
+	return mName[Handle];
+}
+
+int Materials::GetDiffuseSrvHeapIndex(MaterialHandle Handle) const
+{
+	return mDiffuseSrvHeapIndex[Handle];
+}
+
+int Materials::GetNormalSrvHeapIndex(MaterialHandle Handle) const
+{
+	return mNormalSrvHeapIndex[Handle];
+}
+
+MaterialHandle Materials::SetMaterial(
 	const std::string& Name,
 	const DirectX::XMFLOAT4& DiffuseAlbedo,
 	const DirectX::XMFLOAT3& FresnelR0,
-	const float& Roughness, const int& MatIndex,
+	const float& Roughness,
 	const int& DiffuseSrvHeapIndex,
 	const int& NormalSrvHeapIndex)
 {
-	auto temp = std::make_unique<Material>();
-	temp->Name = Name;
-	temp->MatCBIndex = MatIndex;
-	temp->DiffuseSrvHeapIndex = DiffuseSrvHeapIndex;
-	temp->NormalSrvHeapIndex = NormalSrvHeapIndex;
-	temp->DiffuseAlbedo = DiffuseAlbedo;
-	temp->FresnelR0 = FresnelR0;
-	temp->Roughness = Roughness;
-
-	mMaterials[Name] = std::move(temp);
+	// Overwrite in place so existing handles stay valid
+	MaterialHandle handle = Get(Name);
+	if (handle < 0)
+	{
+		handle = (MaterialHandle)mName.size();
+		mLookup[Name] = handle;
+
+		mName.push_back(Name);
+		mDiffuseSrvHeapIndex.push_back(-1);
+		mNormalSrvHeapIndex.push_back(-1);
+		mNumFramesDirty.push_back(0);
+		mDiffuseAlbedo.push_back(DiffuseAlbedo);
+		mFresnelR0.push_back(FresnelR0);
+		mRoughness.push_back(Roughness);
+		mMatTransform.push_back(MathHelper::Identity4x4());
+	}
+
+	mDiffuseSrvHeapIndex[handle] = DiffuseSrvHeapIndex;
+	mNormalSrvHeapIndex[handle] = NormalSrvHeapIndex;
+	mDiffuseAlbedo[handle] = DiffuseAlbedo;
+	mFresnelR0[handle] = FresnelR0;
+	mRoughness[handle] = Roughness;
+
+	MarkDirty(handle);
+
+	return handle;
 }
 void Materials::SetMaterial(
 	const std::vector<std::string>& Name,
 	const std::vector<DirectX::XMFLOAT4>& DiffuseAlbedo,
 	const std::vector<DirectX::XMFLOAT3>& FresnelR0,
-	const std::vector<float>& Roughness, int MatIndex,
+	const std::vector<float>& Roughness,
 	const std::vector<int>& DiffuseSrvHeapIndex,
 	const std::vector<int>& NormalSrvHeapIndex)
 {
 	for (int i = 0; i < Name.size(); ++i)
 	{
-		auto temp = std::make_unique<Material>();
-		temp->Name = Name[i];
-		temp->MatCBIndex = MatIndex++;
-		temp->DiffuseSrvHeapIndex = DiffuseSrvHeapIndex[i];
-		temp->NormalSrvHeapIndex = NormalSrvHeapIndex[i];
-		temp->DiffuseAlbedo = DiffuseAlbedo[i];
-		temp->FresnelR0 = FresnelR0[i];
-		temp->Roughness = Roughness[i];
-
-		mMaterials[Name[i]] = std::move(temp);
+		SetMaterial(
+			Name[i],
+			DiffuseAlbedo[i],
+			FresnelR0[i],
+			Roughness[i],
+			DiffuseSrvHeapIndex[i],
+			NormalSrvHeapIndex[i]);
 	}
 }
 
-void Materials::UpdateMaterialCB(UploadBuffer<MaterialConstants>* currMaterialCB)
+void Materials::SetDiffuseAlbedo(MaterialHandle Handle, const DirectX::XMFLOAT4 & DiffuseAlbedo)
+{
+	mDiffuseAlbedo[Handle] = DiffuseAlbedo;
+	MarkDirty(Handle);
+}
+
+void Materials::SetMatTransform(MaterialHandle Handle, const DirectX::XMFLOAT4X4 & MatTransform)
+{
+	mMatTransform[Handle] = MatTransform;
+	MarkDirty(Handle);
+}
+
+void Materials::SetNormalSrvHeapOffset(int Offset)
+{
+	mNormalSrvHeapOffset = Offset;
+
+	// Every entry stores the absolute index, so refresh them all
+	for (MaterialHandle i = 0; i < (MaterialHandle)mName.size(); ++i)
+		MarkDirty(i);
+}
+
+void Materials::MarkDirty(MaterialHandle Handle)
 {
-	for (auto& e : mMaterials)
+	// Already queued, just restart the frame countdown
+	if (mNumFramesDirty[Handle] == 0)
+		mDirtyList.push_back(Handle);
+
+	mNumFramesDirty[Handle] = gNumFrameResources;
+}
+
+void Materials::UpdateMaterialBuffer(UploadBuffer<MaterialData>* currMaterialBuffer)
+{
+	if (mDirtyList.empty())
+		return;
+
+	// One block from the lowest to the highest dirty handle; handles are the structured buffer elements.
+	// Clean entries inside the block are written again with the values they already hold.
+	auto range = std::minmax_element(mDirtyList.begin(), mDirtyList.end());
+	MaterialHandle first = *range.first;
+	UINT count = (UINT)(*range.second - first + 1);
+
+	// Only grows, so after the first frames this allocates nothing
+	mUploadData.resize(count);
+	for (UINT i = 0; i < count; ++i)
 	{
-		Material* mat = e.second.get();
-		if (mat->NumFramesDirty > 0)
-		{
-			DirectX::XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+		MaterialHandle handle = first + (MaterialHandle)i;
+		MaterialData& matData = mUploadData[i];
 
-			MaterialConstants matConstants;
-			matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matConstants.FresnelR0 = mat->FresnelR0;
-			matConstants.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matConstants.MatTransform, XMMatrixTranspose(matTransform));
+		DirectX::XMMATRIX matTransform = XMLoadFloat4x4(&mMatTransform[handle]);
 
-			currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
+		matData.DiffuseAlbedo = mDiffuseAlbedo[handle];
+		matData.FresnelR0 = mFresnelR0[handle];
+		matData.Roughness = mRoughness[handle];
+		XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+		matData.DiffuseMapIndex = mDiffuseSrvHeapIndex[handle];
+		matData.NormalMapIndex = mNormalSrvHeapIndex[handle] < 0 ? -1 : mNormalSrvHeapOffset + mNormalSrvHeapIndex[handle];
+	}
+	currMaterialBuffer->CopyData(first, mUploadData.data(), count);
 
-			mat->NumFramesDirty--;
-		}
+	// Keep them on the list until every frame resource has the update
+	size_t remain = 0;
+	for (size_t i = 0; i < mDirtyList.size(); ++i)
+	{
+		MaterialHandle handle = mDirtyList[i];
+		if (--mNumFramesDirty[handle] > 0)
+			mDirtyList[remain++] = handle;
 	}
+	mDirtyList.resize(remain);
 }
-
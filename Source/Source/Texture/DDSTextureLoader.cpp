@@ -1678,7 +1678,9 @@ static HRESULT CreateTextureFromDDS12(
 	_In_ size_t maxsize,
 	_In_ bool forceSRGB,
 	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	D3D12_RESOURCE_DESC* outDesc = nullptr,
+	std::vector<D3D12_SUBRESOURCE_DATA>* outSubresources = nullptr)
 {
 	HRESULT hr = S_OK;
 
@@ -1855,6 +1857,29 @@ static HRESULT CreateTextureFromDDS12(
 		twidth, theight, tdepth, skipMip, initData.get()
 	);
 
+	// CPU decode only, the caller creates the resource and records the upload
+	if (SUCCEEDED(hr) && outDesc && outSubresources)
+	{
+		if (resDim != D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+		ZeroMemory(outDesc, sizeof(D3D12_RESOURCE_DESC));
+		outDesc->Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		outDesc->Alignment = 0;
+		outDesc->Width = twidth;
+		outDesc->Height = (uint32_t)theight;
+		outDesc->DepthOrArraySize = (uint16_t)arraySize;
+		outDesc->MipLevels = (uint16_t)(mipCount - skipMip);
+		outDesc->Format = format;
+		outDesc->SampleDesc.Count = 1;
+		outDesc->SampleDesc.Quality = 0;
+		outDesc->Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		outDesc->Flags = D3D12_RESOURCE_FLAG_NONE;
+
+		outSubresources->assign(initData.get(), initData.get() + (mipCount - skipMip) * arraySize);
+		return hr;
+	}
+
 	if (SUCCEEDED(hr))
 	{
 		hr = CreateD3DResources12(
@@ -2134,6 +2159,36 @@ HRESULT DirectX::CreateDDSTextureFromFile(ID3D11Device* d3dDevice,
 		texture, textureView, alphaMode);
 }
 
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::LoadDDSTextureDataFromFile12(_In_z_ const wchar_t* szFileName,
+	_Out_ std::unique_ptr<uint8_t[]>& ddsData,
+	_Out_ D3D12_RESOURCE_DESC& texDesc,
+	_Out_ std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+	_In_ size_t maxsize)
+{
+	if (!szFileName)
+	{
+		return E_INVALIDARG;
+	}
+
+	DDS_HEADER* header = nullptr;
+	uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+
+	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsData, &header, &bitData, &bitSize);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	ComPtr<ID3D12Resource> unusedTexture;
+	ComPtr<ID3D12Resource> unusedUploadHeap;
+	return CreateTextureFromDDS12(nullptr, nullptr, header,
+		bitData, bitSize, maxsize, false, unusedTexture, unusedUploadHeap,
+		&texDesc, &subresources);
+}
+
+//--------------------------------------------------------------------------------------
 HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 	_In_ ID3D12GraphicsCommandList* cmdList,
 	_In_z_ const wchar_t* szFileName,
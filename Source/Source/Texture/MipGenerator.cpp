@@ -0,0 +1,385 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MIPGEN_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// Same defaults as the NVIDIA texture tools
+	const float KaiserWidth = 3.0f;
+	const float KaiserAlpha = 4.0f;
+
+	const int LinearToSrgbTableSize = 16384;
+	const float Pi = 3.14159265f;
+
+	// One linear RGBA texel
+	struct Float4
+	{
+		float X, Y, Z, W;
+	};
+
+	struct Tap
+	{
+		int Index;
+		float Weight;
+	};
+
+	// Taps of destination texel i are Taps[First[i]] .. Taps[First[i + 1] - 1]
+	struct AxisFilter
+	{
+		std::vector<uint32_t> First;
+		std::vector<Tap> Taps;
+	};
+
+	struct SrgbTables
+	{
+		float ToLinear[256];
+		uint8_t ToSrgb[LinearToSrgbTableSize];
+
+		SrgbTables()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				ToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < LinearToSrgbTableSize; ++i)
+			{
+				float l = (float)i / (LinearToSrgbTableSize - 1);
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+				ToSrgb[i] = (uint8_t)(c * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const SrgbTables& GetSrgbTables()
+	{
+		static SrgbTables tables;
+		return tables;
+	}
+
+	float Bessel0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 16; ++k)
+		{
+			term *= 0.5f * x / k;
+			sum += term * term;
+		}
+		return sum;
+	}
+
+	float Sinc(float x)
+	{
+		if (fabsf(x) < 1e-4f)
+			return 1.0f;
+		x *= Pi;
+		return sinf(x) / x;
+	}
+
+	float Kaiser(float x)
+	{
+		float t = x / KaiserWidth;
+		if (t * t >= 1.0f)
+			return 0.0f;
+		return Bessel0(KaiserAlpha * sqrtf(1.0f - t * t)) / Bessel0(KaiserAlpha);
+	}
+
+	// d is the distance in destination texels
+	float FilterWeight(MipGenerator::Filter filter, float d)
+	{
+		switch (filter)
+		{
+		case MipGenerator::Filter::KAISER:
+			return Sinc(d) * Kaiser(d);
+		case MipGenerator::Filter::BOX:
+		default:
+			d = fabsf(d);
+			return d < 0.5f ? 1.0f : (d == 0.5f ? 0.5f : 0.0f);
+		}
+	}
+
+	float FilterRadius(MipGenerator::Filter filter)
+	{
+		return filter == MipGenerator::Filter::KAISER ? KaiserWidth : 0.5f;
+	}
+
+	AxisFilter BuildAxisFilter(uint32_t srcSize, uint32_t dstSize, MipGenerator::Filter filter, bool wrap)
+	{
+		AxisFilter axis;
+		axis.First.reserve(dstSize + 1);
+
+		float scale = (float)srcSize / dstSize;
+		float radius = FilterRadius(filter) * scale;
+		int size = (int)srcSize;
+
+		for (uint32_t i = 0; i < dstSize; ++i)
+		{
+			size_t begin = axis.Taps.size();
+			axis.First.push_back((uint32_t)begin);
+
+			float center = (i + 0.5f) * scale;
+			int j0 = (int)floorf(center - radius);
+			int j1 = (int)ceilf(center + radius);
+
+			float total = 0.0f;
+			for (int j = j0; j <= j1; ++j)
+			{
+				float w = FilterWeight(filter, (j + 0.5f - center) / scale);
+				if (w == 0.0f)
+					continue;
+
+				int index = wrap ? ((j % size) + size) % size : (std::min)((std::max)(j, 0), size - 1);
+				axis.Taps.push_back({ index, w });
+				total += w;
+			}
+
+			for (size_t k = begin; k < axis.Taps.size(); ++k)
+				axis.Taps[k].Weight /= total;
+		}
+		axis.First.push_back((uint32_t)axis.Taps.size());
+
+		return axis;
+	}
+
+	// dstRow[x] = sum of the taps of x over srcRow
+	void FilterRow(const AxisFilter& filter, const Float4* srcRow, Float4* dstRow, uint32_t dstWidth)
+	{
+		for (uint32_t x = 0; x < dstWidth; ++x)
+		{
+#ifdef MIPGEN_SSE
+			__m128 sum = _mm_setzero_ps();
+			for (uint32_t t = filter.First[x]; t < filter.First[x + 1]; ++t)
+			{
+				const Tap& tap = filter.Taps[t];
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&srcRow[tap.Index].X), _mm_set1_ps(tap.Weight)));
+			}
+			_mm_storeu_ps(&dstRow[x].X, sum);
+#else
+			Float4 sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (uint32_t t = filter.First[x]; t < filter.First[x + 1]; ++t)
+			{
+				const Tap& tap = filter.Taps[t];
+				const Float4& s = srcRow[tap.Index];
+				sum.X += s.X * tap.Weight;
+				sum.Y += s.Y * tap.Weight;
+				sum.Z += s.Z * tap.Weight;
+				sum.W += s.W * tap.Weight;
+			}
+			dstRow[x] = sum;
+#endif
+		}
+	}
+
+	// dstRow[x] += weight * srcRow[x]
+	void AccumulateRow(const Float4* srcRow, float weight, Float4* dstRow, uint32_t width)
+	{
+#ifdef MIPGEN_SSE
+		__m128 w = _mm_set1_ps(weight);
+		for (uint32_t x = 0; x < width; ++x)
+			_mm_storeu_ps(&dstRow[x].X, _mm_add_ps(_mm_loadu_ps(&dstRow[x].X), _mm_mul_ps(_mm_loadu_ps(&srcRow[x].X), w)));
+#else
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			dstRow[x].X += srcRow[x].X * weight;
+			dstRow[x].Y += srcRow[x].Y * weight;
+			dstRow[x].Z += srcRow[x].Z * weight;
+			dstRow[x].W += srcRow[x].W * weight;
+		}
+#endif
+	}
+
+	float Saturate(float x)
+	{
+		return (std::min)((std::max)(x, 0.0f), 1.0f);
+	}
+}
+
+MipGenerator::MipGenerator(ThreadPool* threadPool)
+	: mThreadPool(threadPool)
+{
+}
+
+uint32_t MipGenerator::CalcMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t mipLevels = 1;
+	uint32_t size = (std::max)(width, height);
+	while (size > 1)
+	{
+		size >>= 1;
+		++mipLevels;
+	}
+	return mipLevels;
+}
+
+uint64_t MipGenerator::CalcChainSize(uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	uint64_t result = 0;
+	for (uint32_t i = 1; i < mipLevels; ++i)
+	{
+		width = (std::max)(width / 2, 1u);
+		height = (std::max)(height / 2, 1u);
+		result += (uint64_t)width * height * 4;
+	}
+	return result;
+}
+
+void MipGenerator::Generate(
+	const uint8_t* src, uint32_t width, uint32_t height, uint32_t rowPitch,
+	uint32_t mipLevels, uint8_t* outMips,
+	Filter filter, bool sRGB, bool wrap)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	const SrgbTables& tables = GetSrgbTables();
+	const float toUnorm = 1.0f / 255.0f;
+
+	// Level 0 to linear float4
+	std::vector<Float4> curr((size_t)width * height);
+	ForEachRowBand(height, [&](uint32_t y0, uint32_t y1)
+	{
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			const uint8_t* row = src + (size_t)y * rowPitch;
+			Float4* dst = &curr[(size_t)y * width];
+			for (uint32_t x = 0; x < width; ++x, row += 4)
+			{
+				if (sRGB)
+					dst[x] = { tables.ToLinear[row[0]], tables.ToLinear[row[1]], tables.ToLinear[row[2]], row[3] * toUnorm };
+				else
+					dst[x] = { row[0] * toUnorm, row[1] * toUnorm, row[2] * toUnorm, row[3] * toUnorm };
+			}
+		}
+	});
+
+	uint32_t currWidth = width;
+	uint32_t currHeight = height;
+	std::vector<Float4> temp;
+	std::vector<Float4> next;
+
+	for (uint32_t level = 1; level < mipLevels; ++level)
+	{
+		uint32_t nextWidth = (std::max)(currWidth / 2, 1u);
+		uint32_t nextHeight = (std::max)(currHeight / 2, 1u);
+
+		AxisFilter filterX = BuildAxisFilter(currWidth, nextWidth, filter, wrap);
+		AxisFilter filterY = BuildAxisFilter(currHeight, nextHeight, filter, wrap);
+
+		// Horizontal pass : currWidth x currHeight -> nextWidth x currHeight
+		temp.resize((size_t)nextWidth * currHeight);
+		ForEachRowBand(currHeight, [&](uint32_t y0, uint32_t y1)
+		{
+			for (uint32_t y = y0; y < y1; ++y)
+				FilterRow(filterX, &curr[(size_t)y * currWidth], &temp[(size_t)y * nextWidth], nextWidth);
+		});
+
+		// Vertical pass, whole rows at a time : nextWidth x currHeight -> nextWidth x nextHeight
+		next.resize((size_t)nextWidth * nextHeight);
+		ForEachRowBand(nextHeight, [&](uint32_t y0, uint32_t y1)
+		{
+			for (uint32_t y = y0; y < y1; ++y)
+			{
+				Float4* dstRow = &next[(size_t)y * nextWidth];
+				std::fill(dstRow, dstRow + nextWidth, Float4{ 0.0f, 0.0f, 0.0f, 0.0f });
+
+				for (uint32_t t = filterY.First[y]; t < filterY.First[y + 1]; ++t)
+				{
+					const Tap& tap = filterY.Taps[t];
+					AccumulateRow(&temp[(size_t)tap.Index * nextWidth], tap.Weight, dstRow, nextWidth);
+				}
+
+				// Encode the finished row
+				uint8_t* outRow = outMips + (size_t)y * nextWidth * 4;
+				for (uint32_t x = 0; x < nextWidth; ++x, outRow += 4)
+				{
+					Float4 c = { Saturate(dstRow[x].X), Saturate(dstRow[x].Y), Saturate(dstRow[x].Z), Saturate(dstRow[x].W) };
+					if (sRGB)
+					{
+						outRow[0] = tables.ToSrgb[(int)(c.X * (LinearToSrgbTableSize - 1) + 0.5f)];
+						outRow[1] = tables.ToSrgb[(int)(c.Y * (LinearToSrgbTableSize - 1) + 0.5f)];
+						outRow[2] = tables.ToSrgb[(int)(c.Z * (LinearToSrgbTableSize - 1) + 0.5f)];
+					}
+					else
+					{
+						outRow[0] = (uint8_t)(c.X * 255.0f + 0.5f);
+						outRow[1] = (uint8_t)(c.Y * 255.0f + 0.5f);
+						outRow[2] = (uint8_t)(c.Z * 255.0f + 0.5f);
+					}
+					outRow[3] = (uint8_t)(c.W * 255.0f + 0.5f);
+				}
+			}
+		});
+
+		outMips += (size_t)nextWidth * nextHeight * 4;
+		curr.swap(next);
+		currWidth = nextWidth;
+		currHeight = nextHeight;
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	mLastPixels = (uint64_t)width * height;
+	mLastSeconds = std::chrono::duration<double>(endTime - startTime).count();
+}
+
+uint64_t MipGenerator::GetLastPixels() const
+{
+	return mLastPixels;
+}
+
+double MipGenerator::GetLastSeconds() const
+{
+	return mLastSeconds;
+}
+
+double MipGenerator::Benchmark(uint32_t width, uint32_t height, Filter filter, ThreadPool* threadPool, int runs)
+{
+	std::mt19937 engine{ 1234u };
+	std::uniform_int_distribution<int> dis{ 0, 255 };
+
+	std::vector<uint8_t> image((size_t)width * height * 4);
+	for (auto& c : image)
+		c = (uint8_t)dis(engine);
+
+	uint32_t mipLevels = CalcMipCount(width, height);
+	std::vector<uint8_t> mips((size_t)CalcChainSize(width, height, mipLevels));
+
+	MipGenerator mipGen(threadPool);
+	double best = 0.0;
+	for (int i = 0; i < runs; ++i)
+	{
+		mipGen.Generate(image.data(), width, height, width * 4, mipLevels, mips.data(), filter);
+		if (i == 0 || mipGen.GetLastSeconds() < best)
+			best = mipGen.GetLastSeconds();
+	}
+
+	return best > 0.0 ? mipGen.GetLastPixels() / best * 1e-6 : 0.0;
+}
+
+void MipGenerator::ForEachRowBand(uint32_t rows, const std::function<void(uint32_t, uint32_t)>& body)
+{
+	// Bands of at least 16 rows keep the per-task overhead small
+	const uint32_t minRows = 16;
+	uint32_t bandCount = mThreadPool ? (std::min)((rows + minRows - 1) / minRows, (mThreadPool->GetThreadCount() + 1) * 4) : 1;
+	if (bandCount <= 1)
+	{
+		body(0, rows);
+		return;
+	}
+
+	uint32_t rowsPerBand = (rows + bandCount - 1) / bandCount;
+	mThreadPool->ParallelFor(bandCount, [&](unsigned int band)
+	{
+		uint32_t y0 = band * rowsPerBand;
+		uint32_t y1 = (std::min)(y0 + rowsPerBand, rows);
+		if (y0 < y1)
+			body(y0, y1);
+	});
+}
@@ -0,0 +1,104 @@
+#include "StagingRing.h"
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+StagingRing::StagingRing(uint64_t capacity)
+	: mCapacity(capacity)
+{
+}
+
+uint64_t StagingRing::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0 || size > mCapacity || mUsed == mCapacity)
+		return InvalidOffset;
+
+	// Nothing in flight, start again from the beginning
+	if (mUsed == 0)
+	{
+		mHead = 0;
+		mTail = 0;
+	}
+
+	uint64_t offset = AlignUp(mTail, alignment);
+	uint64_t consumed = 0;
+
+	if (mTail >= mHead)
+	{
+		// Free space is [tail, capacity) and [0, head)
+		if (offset + size <= mCapacity)
+		{
+			consumed = offset + size - mTail;
+		}
+		else if (size <= mHead)
+		{
+			// Wrap, the rest of the end is wasted until this block retires
+			consumed = mCapacity - mTail + size;
+			offset = 0;
+		}
+		else
+		{
+			return InvalidOffset;
+		}
+	}
+	else
+	{
+		// Free space is [tail, head)
+		if (offset + size > mHead)
+			return InvalidOffset;
+
+		consumed = offset + size - mTail;
+	}
+
+	mTail = offset + size;
+	mUsed += consumed;
+	mPendingSize += consumed;
+
+	return offset;
+}
+
+void StagingRing::Retire(uint64_t fenceValue)
+{
+	if (mPendingSize == 0)
+		return;
+
+	Block block;
+	block.FenceValue = fenceValue;
+	block.End = mTail;
+	block.Size = mPendingSize;
+	mRetired.push_back(block);
+
+	mPendingSize = 0;
+}
+
+void StagingRing::Release(uint64_t completedFenceValue)
+{
+	while (!mRetired.empty() && mRetired.front().FenceValue <= completedFenceValue)
+	{
+		mHead = mRetired.front().End;
+		mUsed -= mRetired.front().Size;
+		mRetired.pop_front();
+	}
+}
+
+uint64_t StagingRing::GetCapacity() const
+{
+	return mCapacity;
+}
+
+uint64_t StagingRing::GetUsedSize() const
+{
+	return mUsed;
+}
+
+bool StagingRing::HasPending() const
+{
+	return mPendingSize > 0;
+}
+
+uint64_t StagingRing::GetOldestFence() const
+{
+	return mRetired.empty() ? 0 : mRetired.front().FenceValue;
+}
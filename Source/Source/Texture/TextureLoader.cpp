@@ -1,4 +1,5 @@
 #include "TextureLoader.h"
+#include <mutex>
 
 DXGI_FORMAT DirectX::GetDXGIFormatFromWICFormat(WICPixelFormatGUID& wicFormatGUID)
 {
@@ -95,7 +96,9 @@ int DirectX::LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& textur
 	HRESULT hr;
 
 	// we only need one instance of the imaging factory to create decoders and frames
+	// decode workers may get here concurrently, so the factory is created exactly once
 	static IWICImagingFactory *wicFactory;
+	static std::once_flag wicFactoryOnce;
 
 	// reset decoder, frame and converter since these will be different for each image we load
 	IWICBitmapDecoder *wicDecoder = NULL;
@@ -104,20 +107,20 @@ int DirectX::LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& textur
 
 	bool imageConverted = false;
 
-	if (wicFactory == NULL)
-	{
-		// Initialize the COM library
-		CoInitialize(NULL);
+	// Initialize the COM library (worker threads are already initialized by the pool)
+	CoInitializeEx(NULL, COINIT_MULTITHREADED);
 
+	std::call_once(wicFactoryOnce, []()
+	{
 		// create the WIC factory
-		hr = CoCreateInstance(
+		CoCreateInstance(
 			CLSID_WICImagingFactory,
 			NULL,
 			CLSCTX_INPROC_SERVER,
 			IID_PPV_ARGS(&wicFactory)
 		);
-		if (FAILED(hr)) return 0;
-	}
+	});
+	if (wicFactory == NULL) return 0;
 
 	// load a decoder for the image
 	hr = wicFactory->CreateDecoderFromFilename(
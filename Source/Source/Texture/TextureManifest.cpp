@@ -0,0 +1,163 @@
+#include "TextureManifest.h"
+#include <sys/stat.h>
+
+namespace
+{
+	// File name suffix of each companion slot, used only when cooking
+	const wchar_t* SlotSuffix[(int)eTextureSlot::Count] =
+	{
+		L"_normal.jpg",
+		L"_roughness.jpg",
+		L"_ao.jpg"
+	};
+
+	const char* SlotName[(int)eTextureSlot::Count] =
+	{
+		"Normal",
+		"Roughness",
+		"AO"
+	};
+
+	std::wstring ToWString(const std::string& str)
+	{
+		return std::wstring(str.begin(), str.end());
+	}
+
+	std::string ToString(const std::wstring& str)
+	{
+		return std::string(str.begin(), str.end());
+	}
+}
+
+TextureManifest::TextureManifest()
+	: mDirty(false)
+{
+}
+
+TextureManifest::~TextureManifest()
+{
+}
+
+bool TextureManifest::Load(const std::string& fileName)
+{
+	std::ifstream fileIn(fileName);
+	if (!fileIn)
+		return false;
+
+	std::string ignore;
+	uint32_t textureSize = 0;
+	fileIn >> ignore >> textureSize;
+
+	for (uint32_t i = 0; i < textureSize; ++i)
+	{
+		std::string diffuseFileName;
+		uint32_t slotSize = 0;
+		fileIn >> ignore >> diffuseFileName;
+		fileIn >> ignore >> slotSize;
+
+		Entry entry;
+		entry.DiffuseFileName = ToWString(diffuseFileName);
+		for (uint32_t j = 0; j < slotSize; ++j)
+		{
+			std::string slotName, companionFileName;
+			fileIn >> slotName >> companionFileName;
+
+			for (int k = 0; k < (int)eTextureSlot::Count; ++k)
+			{
+				if (slotName == SlotName[k])
+					entry.Companions[k] = ToWString(companionFileName);
+			}
+		}
+
+		if (!fileIn)
+			return false;
+
+		std::string key = MakeKey(entry.DiffuseFileName);
+		if (mEntries.find(key) == mEntries.end())
+			mOrder.push_back(key);
+		mEntries[key] = std::move(entry);
+	}
+
+	mDirty = false;
+	return true;
+}
+
+bool TextureManifest::Save(const std::string& fileName) const
+{
+	std::ofstream fileOut(fileName);
+	if (!fileOut)
+		return false;
+
+	fileOut << "TextureSize " << mOrder.size() << "\n";
+	for (auto& key : mOrder)
+	{
+		const Entry& entry = mEntries.at(key);
+
+		uint32_t slotSize = 0;
+		for (auto& e : entry.Companions)
+			slotSize += e.empty() ? 0 : 1;
+
+		fileOut << "Texture " << ToString(entry.DiffuseFileName) << "\n";
+		fileOut << "SlotSize " << slotSize << "\n";
+		for (int i = 0; i < (int)eTextureSlot::Count; ++i)
+		{
+			if (!entry.Companions[i].empty())
+				fileOut << SlotName[i] << " " << ToString(entry.Companions[i]) << "\n";
+		}
+	}
+
+	mDirty = false;
+	return true;
+}
+
+const std::wstring& TextureManifest::GetCompanion(const std::wstring& diffuseFileName, eTextureSlot slot)
+{
+	std::string key = MakeKey(diffuseFileName);
+
+	auto it = mEntries.find(key);
+	if (it == mEntries.end())
+	{
+		Entry entry;
+		entry.DiffuseFileName = diffuseFileName;
+		Cook(entry);
+
+		mOrder.push_back(key);
+		it = mEntries.emplace(key, std::move(entry)).first;
+		mDirty = true;
+	}
+
+	return it->second.Companions[(int)slot];
+}
+
+bool TextureManifest::IsDirty() const
+{
+	return mDirty;
+}
+
+// Case and separator insensitive, FBX materials use '\' while the code uses '/'
+std::string TextureManifest::MakeKey(const std::wstring& fileName)
+{
+	std::string key = ToString(fileName);
+	for (auto& c : key)
+	{
+		if (c == '\\')
+			c = '/';
+		else
+			c = (char)tolower((unsigned char)c);
+	}
+	return key;
+}
+
+void TextureManifest::Cook(Entry& entry)
+{
+	std::wstring baseName = entry.DiffuseFileName.substr(0, entry.DiffuseFileName.size() - 4);
+
+	for (int i = 0; i < (int)eTextureSlot::Count; ++i)
+	{
+		std::wstring companionFileName = baseName + SlotSuffix[i];
+
+		struct stat buffer;
+		if (stat(ToString(companionFileName).c_str(), &buffer) == 0)
+			entry.Companions[i] = companionFileName;
+	}
+}
@@ -0,0 +1,301 @@
+#include "TextureUploader.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include "MipGenerator.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// The 8-bit, 4-channel layouts MipGenerator filters; BGR order does not matter to it
+	bool IsMipGeneratorFormat(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_R8G8B8A8_UNORM ||
+			format == DXGI_FORMAT_B8G8R8A8_UNORM ||
+			format == DXGI_FORMAT_B8G8R8X8_UNORM;
+	}
+}
+
+TextureUploader::TextureUploader(ID3D12Device* device, ID3D12CommandQueue* queue, UINT64 stagingSize, ThreadPool* threadPool)
+	: mDevice(device),
+	mCommandQueue(queue),
+	mThreadPool(threadPool),
+	mRing(stagingSize)
+{
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(stagingSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mStagingBuffer)));
+	mStagingBuffer->SetName(L"Texture Staging Ring");
+
+	// Stays mapped for the lifetime of the uploader
+	ThrowIfFailed(mStagingBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedStaging)));
+
+	for (int i = 0; i < NumAllocators; ++i)
+	{
+		ThrowIfFailed(mDevice->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(mAllocators[i].GetAddressOf())));
+	}
+
+	ThrowIfFailed(mDevice->CreateCommandList(
+		0,
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		mAllocators[mCurrAllocator].Get(),
+		nullptr,
+		IID_PPV_ARGS(mCommandList.GetAddressOf())));
+
+	ThrowIfFailed(mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+	mFenceEvent = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+}
+
+TextureUploader::~TextureUploader()
+{
+	// Workers may still hold pointers into mJobs
+	mThreadPool->Wait();
+	WaitIdle();
+
+	if (mStagingBuffer != nullptr)
+		mStagingBuffer->Unmap(0, nullptr);
+	mMappedStaging = nullptr;
+
+	for (auto& job : mJobs)
+		free(job->ImageData);
+
+	if (mFenceEvent)
+		CloseHandle(mFenceEvent);
+}
+
+void TextureUploader::Enqueue(Texture* tex)
+{
+	auto job = std::make_unique<UploadJob>();
+	job->Tex = tex;
+
+	UploadJob* pJob = job.get();
+	mJobs.push_back(std::move(job));
+
+	mThreadPool->Enqueue([this, pJob]() { Decode(pJob); });
+}
+
+void TextureUploader::Flush()
+{
+	mThreadPool->Wait();
+
+	for (auto& job : mJobs)
+		Record(job.get());
+	mJobs.clear();
+
+	if (mHasPendingCommands)
+		Submit();
+}
+
+void TextureUploader::WaitIdle()
+{
+	WaitForFence(mFenceValue);
+	mRing.Release(mFence->GetCompletedValue());
+}
+
+UINT64 TextureUploader::GetUploadedBytes() const
+{
+	return mUploadedBytes;
+}
+
+UINT TextureUploader::GetUploadedCount() const
+{
+	return mUploadedCount;
+}
+
+UINT TextureUploader::GetStallCount() const
+{
+	return mStallCount;
+}
+
+double TextureUploader::GetMipMegapixelsPerSecond() const
+{
+	return mMipSeconds > 0.0 ? mMipPixels / mMipSeconds / 1000000.0 : 0.0;
+}
+
+// Runs on a worker thread, touches no device state
+void TextureUploader::Decode(UploadJob* job) const
+{
+	const std::wstring& fileName = job->Tex->Filename;
+
+	if (fileName.size() >= 3 && fileName.compare(fileName.size() - 3, 3, L"dds") == 0)
+	{
+		job->Result = DirectX::LoadDDSTextureDataFromFile12(fileName.c_str(),
+			job->DdsData, job->Desc, job->Subresources);
+		return;
+	}
+
+	int bytesPerRow = 0;
+	int imageSize = DirectX::LoadImageDataFromFile(&job->ImageData, job->Desc, fileName.c_str(), bytesPerRow);
+	if (imageSize <= 0)
+	{
+		job->Result = E_FAIL;
+		return;
+	}
+
+	D3D12_SUBRESOURCE_DATA textureData = {};
+	textureData.pData = job->ImageData;
+	textureData.RowPitch = bytesPerRow;
+	textureData.SlicePitch = imageSize;
+	job->Subresources.push_back(textureData);
+
+	GenerateMips(job);
+
+	job->Result = S_OK;
+}
+
+// WIC images come with a single level, build the rest before upload
+void TextureUploader::GenerateMips(UploadJob* job) const
+{
+	auto& desc = job->Desc;
+	if (desc.MipLevels != 1 || !IsMipGeneratorFormat(desc.Format))
+		return;
+
+	UINT width = (UINT)desc.Width;
+	UINT height = desc.Height;
+	UINT mipLevels = MipGenerator::CalcMipCount(width, height);
+	if (mipLevels == 1)
+		return;
+
+	job->MipData.reset(new uint8_t[MipGenerator::CalcChainSize(width, height, mipLevels)]);
+
+	// Normal maps hold vectors, not colors
+	bool isNormalMap = job->Tex->Filename.find(L"_normal") != std::wstring::npos;
+
+	MipGenerator mipGen(mThreadPool);
+	mipGen.Generate((const uint8_t*)job->Subresources[0].pData, width, height, (UINT)job->Subresources[0].RowPitch,
+		mipLevels, job->MipData.get(),
+		isNormalMap ? MipGenerator::Filter::BOX : MipGenerator::Filter::KAISER, !isNormalMap);
+
+	BYTE* mip = job->MipData.get();
+	for (UINT i = 1; i < mipLevels; ++i)
+	{
+		width = (std::max)(width / 2, 1u);
+		height = (std::max)(height / 2, 1u);
+
+		D3D12_SUBRESOURCE_DATA mipData = {};
+		mipData.pData = mip;
+		mipData.RowPitch = width * 4;
+		mipData.SlicePitch = mipData.RowPitch * height;
+		job->Subresources.push_back(mipData);
+
+		mip += mipData.SlicePitch;
+	}
+	desc.MipLevels = (UINT16)mipLevels;
+
+	job->MipPixels = mipGen.GetLastPixels();
+	job->MipSeconds = mipGen.GetLastSeconds();
+}
+
+void TextureUploader::Record(UploadJob* job)
+{
+	ThrowIfFailed(job->Result);
+
+	auto& texture = job->Tex->Resource;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&job->Desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&texture)));
+	texture->SetName(job->Tex->Filename.c_str());
+
+	UINT numSubresources = (UINT)job->Subresources.size();
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(numSubresources);
+	std::vector<UINT> numRows(numSubresources);
+	std::vector<UINT64> rowSizes(numSubresources);
+	UINT64 totalBytes = 0;
+	mDevice->GetCopyableFootprints(&job->Desc, 0, numSubresources, 0,
+		layouts.data(), numRows.data(), rowSizes.data(), &totalBytes);
+
+	UINT64 baseOffset = AllocateStaging(totalBytes);
+
+	for (UINT i = 0; i < numSubresources; ++i)
+	{
+		layouts[i].Offset += baseOffset;
+
+		D3D12_MEMCPY_DEST dest = {
+			mMappedStaging + layouts[i].Offset,
+			layouts[i].Footprint.RowPitch,
+			SIZE_T(layouts[i].Footprint.RowPitch) * SIZE_T(numRows[i]) };
+		MemcpySubresource(&dest, &job->Subresources[i], (SIZE_T)rowSizes[i], numRows[i], layouts[i].Footprint.Depth);
+
+		CD3DX12_TEXTURE_COPY_LOCATION dst(texture.Get(), i);
+		CD3DX12_TEXTURE_COPY_LOCATION src(mStagingBuffer.Get(), layouts[i]);
+		mCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+
+	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+	mHasPendingCommands = true;
+
+	// The pixels now live in the staging ring
+	job->Subresources.clear();
+	job->DdsData.reset();
+	job->MipData.reset();
+	free(job->ImageData);
+	job->ImageData = nullptr;
+
+	mUploadedBytes += totalBytes;
+	++mUploadedCount;
+	mMipPixels += job->MipPixels;
+	mMipSeconds += job->MipSeconds;
+}
+
+UINT64 TextureUploader::AllocateStaging(UINT64 size)
+{
+	if (size > mRing.GetCapacity())
+		throw std::exception("Texture does not fit in the staging ring");
+
+	mRing.Release(mFence->GetCompletedValue());
+
+	UINT64 offset = mRing.Allocate(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	while (offset == StagingRing::InvalidOffset)
+	{
+		// Out of space: hand the recorded copies to the GPU and wait for the oldest batch
+		if (mRing.HasPending())
+			Submit();
+
+		++mStallCount;
+		WaitForFence(mRing.GetOldestFence());
+		mRing.Release(mFence->GetCompletedValue());
+
+		offset = mRing.Allocate(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	}
+
+	return offset;
+}
+
+void TextureUploader::Submit()
+{
+	ThrowIfFailed(mCommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), ++mFenceValue));
+	mRing.Retire(mFenceValue);
+	mAllocatorFence[mCurrAllocator] = mFenceValue;
+
+	// Reuse the next allocator once the GPU is done with it
+	mCurrAllocator = (mCurrAllocator + 1) % NumAllocators;
+	WaitForFence(mAllocatorFence[mCurrAllocator]);
+
+	ThrowIfFailed(mAllocators[mCurrAllocator]->Reset());
+	ThrowIfFailed(mCommandList->Reset(mAllocators[mCurrAllocator].Get(), nullptr));
+	mHasPendingCommands = false;
+}
+
+void TextureUploader::WaitForFence(UINT64 fenceValue)
+{
+	if (fenceValue != 0 && mFence->GetCompletedValue() < fenceValue)
+	{
+		ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, mFenceEvent));
+		WaitForSingleObject(mFenceEvent, INFINITE);
+	}
+}
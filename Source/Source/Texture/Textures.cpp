@@ -1,5 +1,8 @@
-#include "TextureLoader.h"
 #include "Textures.h"
+#include "TextureUploader.h"
+#include "RenderDevice.h"
+
+TextureUploader* Textures::mUploader = nullptr;
 
 Textures::Textures()
 	: mInBeginEndPair(false)
@@ -31,6 +34,11 @@ int Textures::GetTextureIndex(std::string Name) const
 	return -1;
 }
 
+void Textures::SetUploader(TextureUploader* uploader)
+{
+	mUploader = uploader;
+}
+
 void Textures::SetTexture(
 	const std::string& Name,
 	const std::wstring& szFileName)
@@ -41,22 +49,8 @@ void Textures::SetTexture(
 	auto temp = std::make_unique<Texture>();
 	temp->Name = Name;
 	temp->Filename = szFileName;
-	std::string format;
-	for (int i = szFileName.size() - 3; i < szFileName.size(); ++i)
-		format.push_back(szFileName[i]);
-		
-	if (format == "dds")
-	{
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(mDevice,
-			mCommandList, temp->Filename.c_str(),
-			temp->Resource, temp->UploadHeap));
-	}
-	else
-	{
-		ThrowIfFailed(DirectX::CreateImageDataTextureFromFile(mDevice,
-			mCommandList, temp->Filename.c_str(),
-			temp->Resource, temp->UploadHeap));
-	}
+
+	LoadTexture(temp.get());
 
 	mOrderTexture.push_back(temp.get());
 	mTextures[temp->Name] = std::move(temp);
@@ -66,43 +60,28 @@ void Textures::SetTexture(
 	const std::vector<std::string>& Name,
 	const std::vector<std::wstring>& szFileName)
 {
-	if (!mInBeginEndPair)
-		throw std::exception("Begin must be called before Set Texture");
-
 	for (int i = 0; i < Name.size(); ++i)
+		SetTexture(Name[i], szFileName[i]);
+}
+
+void Textures::LoadTexture(Texture* tex)
+{
+	// Decoded on the uploader's workers, Resource is created at End
+	if (mUploader)
 	{
-		auto temp = std::make_unique<Texture>();
-		temp->Name = Name[i];
-		temp->Filename = szFileName[i];
-		std::string format;
-		for (int j = szFileName[i].size() - 3; j < szFileName[i].size(); ++j)
-			format.push_back(szFileName[i][j]);
-
-		if (format == "dds")
-		{
-			ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(mDevice,
-				mCommandList, temp->Filename.c_str(),
-				temp->Resource, temp->UploadHeap));
-		}
-		else
-		{
-			ThrowIfFailed(DirectX::CreateImageDataTextureFromFile(mDevice,
-				mCommandList, temp->Filename.c_str(),
-				temp->Resource, temp->UploadHeap));
-		}
-
-		mOrderTexture.push_back(temp.get());
-		mTextures[temp->Name] = std::move(temp);
+		mUploader->Enqueue(tex);
+		return;
 	}
+
+	mDevice->CreateTexture(tex);
 }
 
-void Textures::Begin(ID3D12Device * device, ID3D12GraphicsCommandList * cmdList, ID3D12DescriptorHeap* cbvHeap)
+void Textures::Begin(RenderDevice* device, ID3D12DescriptorHeap* cbvHeap)
 {
 	if (mInBeginEndPair)
 		throw std::exception("Cannot nest Begin calls on a Texture");
 
 	mDevice = device;
-	mCommandList = cmdList;
 	mCbvHeap = cbvHeap;
 	
 	mInBeginEndPair = true;
@@ -113,59 +92,25 @@ void Textures::End()
 	if (!mInBeginEndPair)
 		throw std::exception("Begin must be called before End");
 
+	if (mUploader)
+		mUploader->Flush();
+
 	mDevice = nullptr;
-	mCommandList = nullptr;
 	mInBeginEndPair = false;
 }
 
 
 void Textures::BuildCBVTex2D(const int offset)
 {
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-	UINT mCbvSrvDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> vTex;
-
+	UINT index = offset;
 	for (auto& e : mOrderTexture)
-		vTex.push_back(e->Resource);
-
-	hDescriptor.Offset(offset, mCbvSrvDescriptorSize);
-	for (auto &e : vTex)
-	{
-		srvDesc.Format = e->GetDesc().Format;
-		srvDesc.Texture2D.MipLevels = e->GetDesc().MipLevels;
-		mDevice->CreateShaderResourceView(e.Get(), &srvDesc, hDescriptor);
-
-		hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	}
+		mDevice->CreateTextureView(e->Resource.Get(), D3D12_SRV_DIMENSION_TEXTURE2D, mCbvHeap, index++);
 }
 
 void Textures::BuildCBVTexCube(const int offset)
 {
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-	UINT mCbvSrvDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
-	srvDesc.TextureCube.MostDetailedMip = 0;
-	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
-
-	auto skyTex = mTextures["skyCubeMap"].get()->Resource;
-	hDescriptor = mCbvHeap->GetCPUDescriptorHandleForHeapStart();
-	hDescriptor.Offset(offset, mCbvSrvDescriptorSize);
-
-	srvDesc.Format = skyTex->GetDesc().Format;
-	srvDesc.TextureCube.MipLevels = skyTex->GetDesc().MipLevels;
-	mDevice->CreateShaderResourceView(skyTex.Get(), &srvDesc, hDescriptor);
+	auto& skyTex = mTextures["skyCubeMap"]->Resource;
+	mDevice->CreateTextureView(skyTex.Get(), D3D12_SRV_DIMENSION_TEXTURECUBE, mCbvHeap, offset);
 }
 
 void Textures::BuildConstantBufferViews(Textures::Type texType, const int offset)
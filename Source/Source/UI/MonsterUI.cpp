@@ -26,12 +26,6 @@ void MonsterUI::SetDamageScale(int cIndex, float inScale)
 {
 	mWorldTransform[cIndex].Scale.x = inScale;
 }
-void MonsterUI::DeleteMonsterUI(int cIndex) // cIndex starts zero
-{
-	mAllRitems.erase(mAllRitems.begin() + 4 * cIndex, mAllRitems.begin() + 4 * cIndex + 4);
-	mRitems[(int)eUIList::Rect].erase(mRitems[(int)eUIList::Rect].begin() + 4 * cIndex, mRitems[(int)eUIList::Rect].begin() + 4 * cIndex + 4);
-	mWorldTransform.erase(mWorldTransform.begin() + cIndex);
-}
 
 void MonsterUI::BuildRenderItem(
 	std::unordered_map<std::string,
@@ -147,8 +141,8 @@ void MonsterUI::BuildRenderItem(
 
 void MonsterUI::UpdateUICBs(
 	UploadBuffer<UIConstants>* currUICB,
-	std::vector<XMMATRIX> playerWorlds,
-	std::vector<XMVECTOR> inEyeLeft,
+	const std::vector<XMMATRIX>& playerWorlds,
+	const std::vector<XMVECTOR>& inEyeLeft,
 	bool mTransformDirty)
 {
 	int uIndex = 0;
@@ -46,8 +46,7 @@ void PlayerUI::SetGameover()
 }
 
 void PlayerUI::BuildGeometry(
-	ID3D12Device * device,
-	ID3D12GraphicsCommandList* cmdList,
+	RenderDevice* device,
 	const std::vector<UIVertex>& inVertices,
 	const std::vector<std::uint32_t>& inIndices,
 	std::string geoName)
@@ -68,8 +67,8 @@ void PlayerUI::BuildGeometry(
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), inIndices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList, inVertices.data(), vbByteSize, geo->VertexBufferUploader);
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList, inIndices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->VertexBufferGPU = device->CreateDefaultBuffer(inVertices.data(), vbByteSize, geo->VertexBufferUploader);
+	geo->IndexBufferGPU = device->CreateDefaultBuffer(inIndices.data(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(UIVertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -0,0 +1,67 @@
+#include "Test.h"
+#include "AllocationCounter.h"
+#include <memory>
+#include <thread>
+
+namespace
+{
+#ifdef __cpp_aligned_new
+	struct alignas(64) CacheLine
+	{
+		float Values[16];
+	};
+#endif
+
+	// Publishing each pointer keeps the optimizer from eliding a new/delete pair
+	void* volatile gSink;
+
+	template <typename T>
+	T* Keep(T* p)
+	{
+		gSink = p;
+		return p;
+	}
+}
+
+TEST_CASE(AllocationCounterCountsNew)
+{
+	// The test build defines ALLOCATION_COUNTER
+	CHECK(AllocationCounter::IsCounting());
+
+	uint64_t before = AllocationCounter::GetThreadCount();
+	std::unique_ptr<int> single(Keep(new int(1)));
+	std::unique_ptr<int[]> array(Keep(new int[8]));
+	std::unique_ptr<int> nothrow(Keep(new (std::nothrow) int(2)));
+	CHECK(AllocationCounter::GetThreadCount() - before == 3);
+
+#ifdef __cpp_aligned_new
+	// Over-aligned types go through the align_val_t overloads, which must count and keep the alignment
+	before = AllocationCounter::GetThreadCount();
+	std::unique_ptr<CacheLine> line(Keep(new CacheLine()));
+	std::unique_ptr<CacheLine[]> lines(Keep(new CacheLine[4]));
+	CHECK(AllocationCounter::GetThreadCount() - before == 2);
+	CHECK(reinterpret_cast<uintptr_t>(line.get()) % 64 == 0);
+	CHECK(reinterpret_cast<uintptr_t>(lines.get()) % 64 == 0);
+#endif
+}
+
+TEST_CASE(AllocationCounterSeparatesThreads)
+{
+	uint64_t threadBefore = AllocationCounter::GetThreadCount();
+	uint64_t totalBefore = AllocationCounter::GetTotalCount();
+
+	uint64_t workerCount = 0;
+	std::thread worker([&]()
+	{
+		uint64_t start = AllocationCounter::GetThreadCount();
+		for (int i = 0; i < 10; ++i)
+			delete Keep(new int(i));
+		workerCount = AllocationCounter::GetThreadCount() - start;
+	});
+	worker.join();
+
+	CHECK(workerCount == 10);
+	// Starting the thread may allocate on this one, but the worker's ten are not ours
+	CHECK(AllocationCounter::GetThreadCount() - threadBefore < 10);
+	CHECK(AllocationCounter::GetTotalCount() - totalBefore >= 10);
+}
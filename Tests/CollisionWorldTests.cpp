@@ -0,0 +1,184 @@
+#include "Test.h"
+#include "CollisionWorld.h"
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	CullBox Box(float x, float y, float z, float ex, float ey, float ez)
+	{
+		return { { x, y, z }, { ex, ey, ez } };
+	}
+
+	bool Near(float a, float b, float tolerance = 1e-4f)
+	{
+		return std::fabs(a - b) <= tolerance;
+	}
+
+	bool NormalIs(const SweepHit& hit, float x, float y, float z)
+	{
+		return hit.Normal[0] == x && hit.Normal[1] == y && hit.Normal[2] == z;
+	}
+}
+
+TEST_CASE(CollisionWorldSweepTimeOfImpact)
+{
+	// A unit box ten to the right, and a dynamic one further out
+	CullBox walls[] = { Box(10.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f) };
+	CullBox doors[] = { Box(20.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f) };
+	CollisionWorld world;
+	world.Build(walls, 1);
+	world.SetDynamicBoxes(doors, 1);
+
+	CullBox probe = Box(0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
+	SweepHit hit;
+
+	// Faces meet when the center reaches 8
+	float delta[3] = { 10.0f, 0.0f, 0.0f };
+	CHECK(world.Sweep(probe, delta, hit));
+	CHECK(Near(hit.Time, 0.8f));
+	CHECK(hit.Item == 0);
+
+	// Diagonal: x reaches 8 at a quarter, where y is 1.5, still within the summed extents of 2
+	float diagonal[3] = { 32.0f, 6.0f, 0.0f };
+	CHECK(world.Sweep(probe, diagonal, hit));
+	CHECK(Near(hit.Time, 0.25f));
+
+	// Short of the wall, and passing beside it
+	float shortDelta[3] = { 7.9f, 0.0f, 0.0f };
+	CHECK(!world.Sweep(probe, shortDelta, hit));
+	float beside[3] = { 30.0f, 0.0f, 0.0f };
+	CullBox high = Box(0.0f, 2.5f, 0.0f, 1.0f, 1.0f, 1.0f);
+	CHECK(!world.Sweep(high, beside, hit));
+
+	// Starting past the wall the dynamic box is numbered after the static ones
+	CullBox past = Box(14.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
+	CHECK(world.Sweep(past, delta, hit));
+	CHECK(hit.Item == 1);
+	CHECK(Near(hit.Time, 0.4f));
+}
+
+TEST_CASE(CollisionWorldContactNormals)
+{
+	CullBox walls[] = { Box(0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f) };
+	CollisionWorld world;
+	world.Build(walls, 1);
+
+	// From each side toward the center, the normal points back at the mover
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (float side : { -1.0f, 1.0f })
+		{
+			CullBox probe = Box(0.0f, 0.0f, 0.0f, 0.5f, 0.5f, 0.5f);
+			probe.Center[axis] = 5.0f * side;
+			float delta[3] = { 0.0f, 0.0f, 0.0f };
+			delta[axis] = -5.0f * side;
+
+			SweepHit hit;
+			CHECK(world.Sweep(probe, delta, hit));
+			CHECK(Near(hit.Time, 0.7f));
+
+			float normal[3] = { 0.0f, 0.0f, 0.0f };
+			normal[axis] = side;
+			CHECK(NormalIs(hit, normal[0], normal[1], normal[2]));
+		}
+	}
+}
+
+TEST_CASE(CollisionWorldSlidesAlongWalls)
+{
+	// A long wall across x = 5, and a second along z = 8 making a corner
+	CullBox walls[] =
+	{
+		Box(5.0f, 0.0f, 0.0f, 0.5f, 5.0f, 50.0f),
+		Box(0.0f, 0.0f, 8.0f, 50.0f, 5.0f, 0.5f),
+	};
+	CollisionWorld world;
+	world.Build(walls, 2);
+
+	CullBox probe = Box(0.0f, 0.0f, -20.0f, 0.5f, 0.5f, 0.5f);
+	std::vector<SweepHit> contacts;
+	float outDelta[3];
+
+	// Diagonally into the wall: x stops at the face less the skin, z keeps going
+	float delta[3] = { 10.0f, 0.0f, 10.0f };
+	world.Move(probe, delta, outDelta, contacts);
+	CHECK(contacts.size() == 1);
+	CHECK(NormalIs(contacts[0], -1.0f, 0.0f, 0.0f));
+	CHECK(outDelta[0] < 4.0f && Near(outDelta[0], 4.0f, 0.02f));
+	CHECK(Near(outDelta[1], 0.0f));
+	CHECK(Near(outDelta[2], 10.0f, 1e-3f));
+
+	// Into the corner: stopped on both axes, one contact per wall
+	contacts.clear();
+	CullBox nearCorner = Box(0.0f, 0.0f, 0.0f, 0.5f, 0.5f, 0.5f);
+	world.Move(nearCorner, delta, outDelta, contacts);
+	CHECK(contacts.size() == 2);
+	CHECK(outDelta[0] < 4.0f && Near(outDelta[0], 4.0f, 0.02f));
+	CHECK(outDelta[2] < 7.0f && Near(outDelta[2], 7.0f, 0.02f));
+
+	// A clear path moves the whole way without contacts
+	contacts.clear();
+	float back[3] = { -10.0f, 0.0f, -10.0f };
+	world.Move(probe, back, outDelta, contacts);
+	CHECK(contacts.empty());
+	CHECK(outDelta[0] == -10.0f && outDelta[2] == -10.0f);
+}
+
+TEST_CASE(CollisionWorldPushesOutOfOverlaps)
+{
+	CullBox walls[] = { Box(5.0f, 0.0f, 0.0f, 0.5f, 5.0f, 5.0f) };
+	CollisionWorld world;
+	world.Build(walls, 1);
+
+	// Starts 0.3 into the wall's -x face, the shallowest axis
+	CullBox probe = Box(4.3f, 0.0f, 0.0f, 0.5f, 0.5f, 0.5f);
+	SweepHit hit;
+
+	// Deeper in is blocked at once, with the normal of the face to leave by
+	float deeper[3] = { 1.0f, 0.0f, 0.0f };
+	CHECK(world.Sweep(probe, deeper, hit));
+	CHECK(hit.Time == 0.0f);
+	CHECK(NormalIs(hit, -1.0f, 0.0f, 0.0f));
+
+	// Backing out or moving along the face is not held back
+	float out[3] = { -1.0f, 0.0f, 0.0f };
+	CHECK(!world.Sweep(probe, out, hit));
+	float along[3] = { 0.0f, 0.0f, 1.0f };
+	CHECK(!world.Sweep(probe, along, hit));
+
+	std::vector<SweepHit> contacts;
+	float outDelta[3];
+	world.Move(probe, out, outDelta, contacts);
+	CHECK(contacts.empty());
+	CHECK(outDelta[0] == -1.0f);
+
+	// Pushing in diagonally keeps only the part along the face
+	contacts.clear();
+	float diagonal[3] = { 1.0f, 0.0f, 1.0f };
+	world.Move(probe, diagonal, outDelta, contacts);
+	CHECK(contacts.size() == 1);
+	CHECK(outDelta[0] == 0.0f);
+	CHECK(Near(outDelta[2], 1.0f, 1e-3f));
+}
+
+TEST_CASE(CollisionWorldTreeMatchesBruteForce)
+{
+	for (uint32_t propCount : { 10u, 1000u })
+	{
+		CollisionWorld::BenchmarkResult result;
+		CollisionWorld::Benchmark(propCount, 2000, result);
+		CHECK(result.Mismatches == 0);
+	}
+}
+
+BENCHMARK(CollisionWorldMoves)
+{
+	for (uint32_t propCount : { 100u, 1000u, 10000u })
+	{
+		CollisionWorld::BenchmarkResult result;
+		CollisionWorld::Benchmark(propCount, 1000, result);
+		std::printf("  %u props: move %.0f ns (%.1f tests), linear %.0f ns, mismatches %u\n",
+			propCount, result.TreeTime, result.TestsPerMove, result.BruteForceTime, result.Mismatches);
+	}
+}
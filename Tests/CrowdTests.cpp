@@ -0,0 +1,249 @@
+#include "Test.h"
+#include "Crowd.h"
+#include "FlowField.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	bool Near(float a, float b, float tolerance = 1e-4f)
+	{
+		return std::fabs(a - b) <= tolerance;
+	}
+
+	// One member at (x, z), facing +z
+	void SpawnOne(Crowd& crowd, float x, float z)
+	{
+		std::mt19937 engine{ 1u };
+		crowd.Spawn(1, x, z, x, z, 100.0f, engine);
+	}
+
+	// The lanes of one Update from the spawn state, a member at a time
+	struct Reference
+	{
+		float X, Z, HeadingX, HeadingZ;
+		eCrowdClip Clip;
+		bool Strikes;
+	};
+
+	Reference StepFromSpawn(float x, float z, float health, float targetX, float targetZ, float dt)
+	{
+		Reference r = { x, z, 0.0f, 1.0f, eCrowdClip::Idle, false };
+		bool alive = health > 0.0f;
+
+		float dx = targetX - x;
+		float dz = targetZ - z;
+		float distance = std::sqrt(dx * dx + dz * dz);
+		float invDistance = 1.0f / (std::max)(distance, 1e-6f);
+		dx *= invDistance;
+		dz *= invDistance;
+
+		float turn = (std::min)(0.75f * dt, 1.0f);
+		float nx = r.HeadingX + turn * (dx - r.HeadingX);
+		float nz = r.HeadingZ + turn * (dz - r.HeadingZ);
+		float length = std::sqrt(nx * nx + nz * nz);
+		if (alive && length > 1e-6f)
+		{
+			r.HeadingX = nx / length;
+			r.HeadingZ = nz / length;
+		}
+
+		bool inAttack = distance < 12.0f;
+		bool inStop = distance < 8.0f;
+		bool walk = !inAttack && distance < 100.0f;
+		r.Strikes = alive && inAttack;
+
+		float step = 3.75f * dt;
+		float move = inStop ? -step : walk ? step : 0.0f;
+		if (alive)
+		{
+			r.X += r.HeadingX * move;
+			r.Z += r.HeadingZ * move;
+		}
+
+		r.Clip = !alive ? eCrowdClip::Death : inAttack ? eCrowdClip::Attack : walk ? eCrowdClip::Walking : eCrowdClip::Idle;
+		return r;
+	}
+}
+
+TEST_CASE(CrowdMatchesScalarLanes)
+{
+	const uint32_t count = 203;
+	const float dt = 1.0f / 60.0f;
+
+	uint32_t compared = 0;
+	uint32_t positionMismatches = 0;
+	uint32_t headingMismatches = 0;
+	uint32_t clipMismatches = 0;
+	uint32_t clipsSeen[(uint32_t)eCrowdClip::Count] = {};
+	for (uint32_t round = 0; round < 8; ++round)
+	{
+		// Same population every round, the target next to a different member each time so
+		// every range is covered, and some members killed or hurt first
+		std::mt19937 engine{ 77u };
+		Crowd crowd;
+		crowd.Spawn(count, -150.0f, -150.0f, 150.0f, 150.0f, 100.0f, engine);
+		float targetX = crowd.GetPositionX(round * 13) + 2.0f * round;
+		float targetZ = crowd.GetPositionZ(round * 13) - 1.5f * round;
+		crowd.Damage(targetX, targetZ, 9.0f, 100.0f);
+		crowd.Damage(targetX + 40.0f, targetZ, 20.0f, 30.0f);
+
+		std::vector<float> startX(count), startZ(count), health(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			startX[i] = crowd.GetPositionX(i);
+			startZ[i] = crowd.GetPositionZ(i);
+			health[i] = crowd.GetHealth(i);
+		}
+
+		uint32_t attacks = crowd.Update(targetX, targetZ, dt);
+
+		uint32_t expectedAttacks = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Reference r = StepFromSpawn(startX[i], startZ[i], health[i], targetX, targetZ, dt);
+			expectedAttacks += r.Strikes;
+			clipMismatches += crowd.GetClip(i) != r.Clip;
+			headingMismatches += !Near(crowd.GetHeadingX(i), r.HeadingX) || !Near(crowd.GetHeadingZ(i), r.HeadingZ);
+			++clipsSeen[(uint32_t)r.Clip];
+
+			// Separation moves members with a living neighbour within 5, so only the others
+			// are compared by position
+			bool crowded = false;
+			for (uint32_t j = 0; j < count && !crowded; ++j)
+			{
+				float dx = startX[i] - startX[j];
+				float dz = startZ[i] - startZ[j];
+				crowded = j != i && dx * dx + dz * dz < 5.5f * 5.5f;
+			}
+			if (crowded)
+				continue;
+
+			positionMismatches += !Near(crowd.GetPositionX(i), r.X) || !Near(crowd.GetPositionZ(i), r.Z);
+			++compared;
+		}
+		CHECK(attacks == expectedAttacks);
+	}
+
+	CHECK(positionMismatches == 0);
+	CHECK(headingMismatches == 0);
+	CHECK(clipMismatches == 0);
+	CHECK(compared > count * 8 / 2);
+	// Every branch was taken somewhere
+	for (uint32_t clip = 0; clip < (uint32_t)eCrowdClip::Count; ++clip)
+		CHECK(clipsSeen[clip] > 0);
+}
+
+TEST_CASE(CrowdStrikesOnTheCooldown)
+{
+	// Inside the stop radius: strikes at once and backs off to between stop and attack range
+	Crowd crowd;
+	SpawnOne(crowd, 0.0f, -5.0f);
+
+	std::vector<uint32_t> strikeFrames;
+	for (uint32_t frame = 0; frame < 12; ++frame)
+	{
+		if (crowd.Update(0.0f, 0.0f, 1.0f) > 0)
+			strikeFrames.push_back(frame);
+		CHECK(crowd.GetClip(0) == eCrowdClip::Attack);
+	}
+	CHECK((strikeFrames == std::vector<uint32_t>{ 0, 5, 10 }));
+	CHECK(Near(crowd.GetPositionZ(0), -8.75f));
+	CHECK(Near(crowd.GetPositionX(0), 0.0f));
+
+	// Out of aggro range it stands still
+	SpawnOne(crowd, 0.0f, -150.0f);
+	CHECK(crowd.Update(0.0f, 0.0f, 1.0f) == 0);
+	CHECK(crowd.GetClip(0) == eCrowdClip::Idle);
+	CHECK(crowd.GetPositionZ(0) == -150.0f);
+}
+
+TEST_CASE(CrowdDiesAndRespawns)
+{
+	// Five members leave three padding lanes, which must never come alive
+	std::mt19937 engine{ 9u };
+	Crowd crowd;
+	crowd.Spawn(5, 200.0f, 200.0f, 210.0f, 210.0f, 100.0f, engine);
+	float spawnX = crowd.GetPositionX(2);
+	float spawnZ = crowd.GetPositionZ(2);
+	CHECK(crowd.GetAliveCount() == 5);
+
+	// Walk it away from the spawn point first
+	for (uint32_t frame = 0; frame < 4; ++frame)
+		crowd.Update(150.0f, 150.0f, 1.0f);
+	CHECK(crowd.GetPositionX(2) != spawnX);
+
+	CHECK(crowd.Damage(crowd.GetPositionX(2), crowd.GetPositionZ(2), 0.1f, 60.0f) == 1);
+	CHECK(crowd.GetHealth(2) == 40.0f);
+	CHECK(crowd.Damage(crowd.GetPositionX(2), crowd.GetPositionZ(2), 0.1f, 60.0f) == 1);
+	CHECK(crowd.GetHealth(2) == 0.0f);
+	// The dead are not hit again
+	CHECK(crowd.Damage(crowd.GetPositionX(2), crowd.GetPositionZ(2), 0.1f, 60.0f) == 0);
+
+	// Seven seconds from the frame that sees it die
+	uint32_t deadFrames = 0;
+	do
+	{
+		crowd.Update(150.0f, 150.0f, 1.0f);
+		++deadFrames;
+	} while (crowd.GetClip(2) == eCrowdClip::Death && deadFrames < 20);
+	CHECK(deadFrames == 8);
+	CHECK(crowd.GetHealth(2) == 100.0f);
+
+	// Back at its spawn point, plus the one step it took on the respawn frame
+	float dx = crowd.GetPositionX(2) - spawnX;
+	float dz = crowd.GetPositionZ(2) - spawnZ;
+	CHECK(std::sqrt(dx * dx + dz * dz) < 3.76f + 0.5f);
+	CHECK(crowd.GetAliveCount() == 5);
+}
+
+TEST_CASE(CrowdFollowsTheFlowField)
+{
+	// A wall between the member and the target along x = 0, open past z = 20
+	CullBox walls[] = { { { 0.0f, 0.0f, -20.0f }, { 1.0f, 5.0f, 40.0f } } };
+	FlowField field;
+	field.Build(walls, 1, -50.0f, -50.0f, 50.0f, 50.0f, 1.0f, 0.5f);
+	field.SetGoal(10.0f, -20.0f);
+	field.Step();
+
+	float flowX, flowZ;
+	CHECK(field.GetDirection(-10.0f, -20.0f, flowX, flowZ));
+	CHECK(flowZ > 0.0f);
+
+	// The first step turns toward the field's heading rather than straight at the target
+	const float dt = 1.0f / 30.0f;
+	Crowd crowd;
+	SpawnOne(crowd, -10.0f, -20.0f);
+	Crowd straight;
+	SpawnOne(straight, -10.0f, -20.0f);
+	crowd.Update(10.0f, -20.0f, dt, &field);
+	straight.Update(10.0f, -20.0f, dt);
+
+	float turn = 0.75f * dt;
+	float nx = turn * flowX;
+	float nz = 1.0f + turn * (flowZ - 1.0f);
+	float length = std::sqrt(nx * nx + nz * nz);
+	CHECK(Near(crowd.GetHeadingX(0), nx / length));
+	CHECK(Near(crowd.GetHeadingZ(0), nz / length));
+	CHECK(crowd.GetPositionZ(0) > straight.GetPositionZ(0));
+
+	// Steering has no collision, but it keeps closing in until attack range, where the field is
+	// ignored and it stops
+	for (uint32_t frame = 0; frame < 600; ++frame)
+		crowd.Update(10.0f, -20.0f, dt, &field);
+	float dx = crowd.GetPositionX(0) - 10.0f;
+	float dz = crowd.GetPositionZ(0) + 20.0f;
+	CHECK(std::sqrt(dx * dx + dz * dz) < 12.0f + 0.2f);
+	CHECK(crowd.GetClip(0) == eCrowdClip::Attack);
+}
+
+BENCHMARK(CrowdUpdate)
+{
+	for (uint32_t crowdCount : { 1000u, 4000u, 16000u })
+	{
+		float updateTime = Crowd::Benchmark(crowdCount, 120);
+		std::printf("  %u members: update %.3f ms, %.1f ns/member\n",
+			crowdCount, updateTime, updateTime * 1e6f / crowdCount);
+	}
+}
@@ -0,0 +1,188 @@
+#include "Test.h"
+#include "Culling.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	// Row-major view * perspective for row vectors, left-handed with [0, 1] depth like XMMatrixPerspectiveFovLH
+	void BuildViewProj(const float eye[3], float yaw, float pitch, float fovY, float aspect, float zn, float zf, float m[16])
+	{
+		// Camera basis: right, up, forward
+		float f[3] = { std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw) };
+		float r[3] = { std::cos(yaw), 0.0f, -std::sin(yaw) };
+		float u[3] = { f[1] * r[2] - f[2] * r[1], f[2] * r[0] - f[0] * r[2], f[0] * r[1] - f[1] * r[0] };
+
+		float view[16] = {};
+		for (int i = 0; i < 3; ++i)
+		{
+			view[i * 4 + 0] = r[i];
+			view[i * 4 + 1] = u[i];
+			view[i * 4 + 2] = f[i];
+		}
+		view[12] = -(eye[0] * r[0] + eye[1] * r[1] + eye[2] * r[2]);
+		view[13] = -(eye[0] * u[0] + eye[1] * u[1] + eye[2] * u[2]);
+		view[14] = -(eye[0] * f[0] + eye[1] * f[1] + eye[2] * f[2]);
+		view[15] = 1.0f;
+
+		float yScale = 1.0f / std::tan(0.5f * fovY);
+		float proj[16] = {};
+		proj[0] = yScale / aspect;
+		proj[5] = yScale;
+		proj[10] = zf / (zf - zn);
+		proj[11] = 1.0f;
+		proj[14] = -zn * zf / (zf - zn);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; ++k)
+					sum += view[i * 4 + k] * proj[k * 4 + j];
+				m[i * 4 + j] = sum;
+			}
+		}
+	}
+
+	// The box is culled when all eight corners are behind one plane. Returns 0 or 1 as CullBoxes does,
+	// or -1 when a corner is within epsilon of that decision and float rounding may go either way.
+	int BruteForceVisible(const Frustum& frustum, const CullBox& box, float epsilon)
+	{
+		bool ambiguous = false;
+		for (const auto& p : frustum.Planes)
+		{
+			float nearest = -INFINITY;
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				float distance = p[3];
+				for (int k = 0; k < 3; ++k)
+					distance += p[k] * (box.Center[k] + ((corner >> k) & 1 ? box.Extents[k] : -box.Extents[k]));
+				nearest = (std::max)(nearest, distance);
+			}
+
+			if (nearest < -epsilon)
+				return 0;
+			if (nearest < epsilon)
+				ambiguous = true;
+		}
+		return ambiguous ? -1 : 1;
+	}
+
+	std::vector<CullBox> RandomBoxes(uint32_t count, std::mt19937& engine)
+	{
+		std::uniform_real_distribution<float> position{ -500.0f, 500.0f };
+		std::uniform_real_distribution<float> size{ 0.5f, 20.0f };
+
+		std::vector<CullBox> boxes(count);
+		for (auto& box : boxes)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				box.Center[k] = position(engine);
+				box.Extents[k] = size(engine);
+			}
+		}
+		return boxes;
+	}
+
+	std::vector<Frustum> RandomFrustums(uint32_t count, std::mt19937& engine)
+	{
+		std::uniform_real_distribution<float> position{ -300.0f, 300.0f };
+		std::uniform_real_distribution<float> angle{ -3.14159265f, 3.14159265f };
+
+		std::vector<Frustum> frustums(count);
+		for (auto& frustum : frustums)
+		{
+			float eye[3] = { position(engine), 0.2f * position(engine), position(engine) };
+			float m[16];
+			BuildViewProj(eye, angle(engine), 0.4f * angle(engine), 0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, 400.0f, m);
+			frustum = Frustum::FromViewProj(m);
+		}
+		return frustums;
+	}
+}
+
+TEST_CASE(CullingFrustumPlanesFaceInward)
+{
+	float eye[3] = { 0.0f, 0.0f, 0.0f };
+	float m[16];
+	BuildViewProj(eye, 0.0f, 0.0f, 0.25f * 3.14159265f, 1.0f, 1.0f, 100.0f, m);
+	Frustum frustum = Frustum::FromViewProj(m);
+
+	CullBox boxes[] =
+	{
+		{ { 0.0f, 0.0f, 50.0f }, { 1.0f, 1.0f, 1.0f } },	// ahead
+		{ { 0.0f, 0.0f, -50.0f }, { 1.0f, 1.0f, 1.0f } },	// behind
+		{ { 0.0f, 0.0f, 150.0f }, { 1.0f, 1.0f, 1.0f } },	// past the far plane
+		{ { 100.0f, 0.0f, 50.0f }, { 1.0f, 1.0f, 1.0f } },	// off to the right
+		{ { 0.0f, 0.0f, 0.0f }, { 500.0f, 500.0f, 500.0f } },	// around the whole frustum
+	};
+	uint8_t visible[5];
+	CullBoxes(frustum, boxes, 5, visible);
+
+	CHECK(visible[0] == 1);
+	CHECK(visible[1] == 0);
+	CHECK(visible[2] == 0);
+	CHECK(visible[3] == 0);
+	CHECK(visible[4] == 1);
+}
+
+TEST_CASE(CullingMatchesBruteForce)
+{
+	std::mt19937 engine{ 1234u };
+	// Not a multiple of four, so the last group has unused lanes
+	std::vector<CullBox> boxes = RandomBoxes(4001, engine);
+	std::vector<Frustum> frustums = RandomFrustums(64, engine);
+
+	CullBVH bvh;
+	bvh.Build(boxes.data(), (uint32_t)boxes.size());
+	CHECK(bvh.GetItemCount() == boxes.size());
+
+	std::vector<uint8_t> vectorVisible(boxes.size());
+	std::vector<uint8_t> scalarVisible(boxes.size());
+	std::vector<uint8_t> bvhVisible(boxes.size());
+	std::vector<uint32_t> bvhItems;
+
+	uint32_t vectorMismatches = 0;
+	uint32_t bruteMismatches = 0;
+	uint32_t bvhMismatches = 0;
+	uint32_t visibleCount = 0;
+	for (const Frustum& frustum : frustums)
+	{
+		CullBoxes(frustum, boxes.data(), (uint32_t)boxes.size(), vectorVisible.data());
+		CullBoxesScalar(frustum, boxes.data(), (uint32_t)boxes.size(), scalarVisible.data());
+
+		bvhItems.clear();
+		bvh.Cull(frustum, bvhItems);
+		std::fill(bvhVisible.begin(), bvhVisible.end(), 0);
+		for (uint32_t item : bvhItems)
+		{
+			// Each item at most once
+			CHECK(bvhVisible[item] == 0);
+			bvhVisible[item] = 1;
+		}
+
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			// Same arithmetic in the same order, so these agree exactly
+			vectorMismatches += vectorVisible[i] != scalarVisible[i];
+
+			int reference = BruteForceVisible(frustum, boxes[i], 1e-3f);
+			if (reference < 0)
+				continue;
+
+			bruteMismatches += vectorVisible[i] != reference;
+			// A node fully inside accepts its items without testing them, which is exact for boxes inside it
+			bvhMismatches += bvhVisible[i] != reference;
+			visibleCount += reference;
+		}
+	}
+
+	CHECK(vectorMismatches == 0);
+	CHECK(bruteMismatches == 0);
+	CHECK(bvhMismatches == 0);
+	// The scenes are neither all culled nor all visible
+	CHECK(visibleCount > 0 && visibleCount < boxes.size() * frustums.size());
+}
@@ -0,0 +1,85 @@
+#include "Test.h"
+#include "EntityWorld.h"
+#include "CharacterComponents.h"
+#include <cstdio>
+
+TEST_CASE(EntityWorldKeepsChunksPacked)
+{
+	EntityWorld world;
+	std::vector<Entity> entities;
+	for (int i = 0; i < 1000; ++i)
+	{
+		entities.push_back(world.Create<HealthComponent, RenderComponent>());
+		world.Get<HealthComponent>(entities.back())->Health = i;
+	}
+
+	// Every other one out; the last rows fill the holes
+	for (int i = 0; i < 1000; i += 2)
+		world.Destroy(entities[i]);
+
+	CHECK(world.GetEntityCount() == 500);
+	CHECK(!world.IsAlive(entities[0]));
+	CHECK(world.Get<HealthComponent>(entities[0]) == nullptr);
+
+	bool valuesKept = true;
+	for (int i = 1; i < 1000; i += 2)
+		valuesKept &= world.Get<HealthComponent>(entities[i])->Health == i;
+	CHECK(valuesKept);
+
+	uint32_t visited = 0;
+	bool chunksFull = true;
+	world.Each<HealthComponent>([&](uint32_t count, const Entity* e, HealthComponent* health)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			visited += world.Get<HealthComponent>(e[i]) == &health[i];
+		chunksFull &= count > 0;
+	});
+	CHECK(visited == 500);
+	CHECK(chunksFull);
+}
+
+TEST_CASE(EntityWorldReusesSlots)
+{
+	EntityWorld world;
+	Entity first = world.Create<TransformComponent, BoundsComponent, RenderComponent>();
+	world.Destroy(first);
+	CHECK(world.GetChunkCount() == 0);
+
+	// Same index, new generation, and the stale handle stays dead
+	Entity second = world.Create<TransformComponent, BoundsComponent, RenderComponent>();
+	CHECK(second.Index == first.Index);
+	CHECK(second.Generation != first.Generation);
+	CHECK(!world.IsAlive(first));
+	CHECK(world.IsAlive(second));
+	CHECK(world.GetChunkCount() == 1);
+	// Components start zeroed whatever the reused chunk held
+	CHECK(world.Get<RenderComponent>(second)->MaterialIndex == 0);
+}
+
+TEST_CASE(EntityWorldMovesBetweenArchetypes)
+{
+	EntityWorld world;
+	Entity e = world.Create<HealthComponent>();
+	world.Get<HealthComponent>(e)->Health = 42;
+
+	CHECK(world.Add<AnimationComponent>(e) != nullptr);
+	CHECK(world.Has<AnimationComponent>(e));
+	CHECK(world.Get<HealthComponent>(e)->Health == 42);
+	CHECK(world.GetArchetypeCount() == 2);
+
+	world.Remove<HealthComponent>(e);
+	CHECK(!world.Has<HealthComponent>(e));
+	CHECK(world.Has<AnimationComponent>(e));
+	CHECK(world.GetEntityCount() == 1);
+}
+
+BENCHMARK(EntityWorldCharacterUpdate)
+{
+	for (uint32_t characterCount : { 1000u, 10000u, 50000u, 100000u })
+	{
+		EntityWorld::BenchmarkResult result;
+		EntityWorld::Benchmark(characterCount, 60, result);
+		std::printf("  %u characters: classes %.3f ms, entities %.3f ms, mismatches %u\n",
+			characterCount, result.ClassTime, result.EntityTime, result.Mismatches);
+	}
+}
@@ -0,0 +1,230 @@
+#include "Test.h"
+#include "FlowField.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	const uint32_t Side = 24;
+	const float Straight = 10.0f;
+	const float Diagonal = 14.0f;
+
+	// The same cells Build blocks: centers inside the footprint of a box standing at least a
+	// unit tall, cell size 1 and no radius
+	std::vector<uint8_t> BlockedCells(const std::vector<CullBox>& boxes)
+	{
+		std::vector<uint8_t> blocked(Side * Side, 0);
+		for (uint32_t z = 0; z < Side; ++z)
+		{
+			for (uint32_t x = 0; x < Side; ++x)
+			{
+				float cx = x + 0.5f;
+				float cz = z + 0.5f;
+				for (const auto& b : boxes)
+				{
+					if (b.Center[1] + b.Extents[1] >= 1.0f && std::fabs(cx - b.Center[0]) <= b.Extents[0] && std::fabs(cz - b.Center[2]) <= b.Extents[2])
+						blocked[z * Side + x] = 1;
+				}
+			}
+		}
+		return blocked;
+	}
+
+	// Plain Dijkstra over every cell, the costs the field should find, -1 where unreachable
+	std::vector<float> Distances(const std::vector<uint8_t>& blocked, uint32_t goal)
+	{
+		std::vector<float> distance(Side * Side, -1.0f);
+		std::vector<uint8_t> settled(Side * Side, 0);
+		distance[goal] = 0.0f;
+		for (;;)
+		{
+			int best = -1;
+			for (uint32_t i = 0; i < distance.size(); ++i)
+			{
+				if (!settled[i] && distance[i] >= 0.0f && (best < 0 || distance[i] < distance[best]))
+					best = (int)i;
+			}
+			if (best < 0)
+				break;
+			settled[best] = 1;
+
+			int x = best % Side;
+			int z = best / Side;
+			for (int dz = -1; dz <= 1; ++dz)
+			{
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					int nx = x + dx;
+					int nz = z + dz;
+					if ((dx == 0 && dz == 0) || nx < 0 || nz < 0 || nx >= (int)Side || nz >= (int)Side)
+						continue;
+					if (blocked[nz * Side + nx])
+						continue;
+					if (dx != 0 && dz != 0 && (blocked[z * Side + nx] || blocked[nz * Side + x]))
+						continue;
+
+					float cost = distance[best] + (dx != 0 && dz != 0 ? Diagonal : Straight);
+					float& next = distance[nz * Side + nx];
+					if (next < 0.0f || cost < next)
+						next = cost;
+				}
+			}
+		}
+		return distance;
+	}
+
+	void Build(FlowField& field, const std::vector<CullBox>& boxes)
+	{
+		field.Build(boxes.data(), (uint32_t)boxes.size(), 0.0f, 0.0f, (float)Side, (float)Side, 1.0f, 0.0f);
+	}
+
+	// A wall with a gap, and a closed room in the corner
+	std::vector<CullBox> Walls()
+	{
+		return
+		{
+			{ { 10.0f, 5.0f, 8.0f }, { 0.6f, 5.0f, 8.0f } },
+			{ { 10.0f, 5.0f, 21.5f }, { 0.6f, 5.0f, 2.5f } },
+			{ { 19.0f, 5.0f, 18.0f }, { 5.0f, 5.0f, 0.6f } },
+			{ { 18.0f, 5.0f, 21.0f }, { 0.6f, 5.0f, 3.0f } },
+			// Too low to block
+			{ { 4.0f, 0.2f, 4.0f }, { 2.0f, 0.2f, 2.0f } },
+		};
+	}
+
+	bool DirectionIs(const FlowField& field, float x, float z, float dirX, float dirZ)
+	{
+		float fx, fz;
+		return field.GetDirection(x, z, fx, fz) && fx == dirX && fz == dirZ;
+	}
+}
+
+TEST_CASE(FlowFieldFindsShortestPaths)
+{
+	std::vector<CullBox> boxes = Walls();
+	std::vector<uint8_t> blocked = BlockedCells(boxes);
+	FlowField field;
+	Build(field, boxes);
+	CHECK(field.GetWidth() == Side && field.GetHeight() == Side);
+	CHECK(field.GetBlockedCount() == (uint32_t)std::count(blocked.begin(), blocked.end(), 1));
+
+	uint32_t distanceMismatches = 0;
+	uint32_t directionMismatches = 0;
+	for (uint32_t goal : { 0u, 5u * Side + 3u, 20u * Side + 2u, 12u * Side + 15u })
+	{
+		CHECK(field.SetGoal(goal % Side + 0.5f, goal / Side + 0.5f));
+		CHECK(field.Step());
+		std::vector<float> expected = Distances(blocked, goal);
+
+		for (uint32_t cell = 0; cell < Side * Side; ++cell)
+		{
+			float x = cell % Side + 0.5f;
+			float z = cell / Side + 0.5f;
+			float distance = field.GetDistance(x, z);
+			if (blocked[cell])
+			{
+				distanceMismatches += distance >= 0.0f;
+				continue;
+			}
+			distanceMismatches += std::fabs(distance - (expected[cell] < 0.0f ? -1.0f : expected[cell] * 0.1f)) > 1e-4f;
+
+			// Every reached cell but the goal leads one step closer
+			float dirX, dirZ;
+			bool hasDirection = field.GetDirection(x, z, dirX, dirZ);
+			if (cell == goal || expected[cell] < 0.0f)
+			{
+				directionMismatches += hasDirection;
+				continue;
+			}
+			float step = std::fabs(dirX) > 0.0f && std::fabs(dirZ) > 0.0f ? Diagonal : Straight;
+			float nextX = x + (dirX > 0.0f ? 1.0f : dirX < 0.0f ? -1.0f : 0.0f);
+			float nextZ = z + (dirZ > 0.0f ? 1.0f : dirZ < 0.0f ? -1.0f : 0.0f);
+			directionMismatches += !hasDirection || std::fabs(field.GetDistance(nextX, nextZ) + step * 0.1f - distance) > 1e-4f;
+		}
+	}
+	CHECK(distanceMismatches == 0);
+	CHECK(directionMismatches == 0);
+
+	// The room is closed: nothing inside it is reachable from outside
+	CHECK(field.GetDistance(21.5f, 21.5f) < 0.0f);
+	float dirX, dirZ;
+	CHECK(!field.GetDirection(21.5f, 21.5f, dirX, dirZ));
+	// Off the grid
+	CHECK(!field.GetDirection(-1.0f, 5.0f, dirX, dirZ));
+	CHECK(field.GetDistance(5.0f, 30.0f) < 0.0f);
+}
+
+TEST_CASE(FlowFieldSwapsOnlyWhenDone)
+{
+	std::vector<CullBox> boxes = Walls();
+	FlowField field;
+	Build(field, boxes);
+
+	// Nothing to read before the first rebuild, and nothing happens without a goal
+	float dirX, dirZ;
+	CHECK(!field.GetDirection(5.5f, 5.5f, dirX, dirZ));
+	CHECK(!field.Step());
+	CHECK(!field.SetGoal(-5.0f, 5.0f));
+
+	// Goal to the right of (5, 5)
+	CHECK(field.SetGoal(7.5f, 5.5f));
+	CHECK(!field.SetGoal(7.9f, 5.1f));
+	CHECK(field.Step());
+	CHECK(field.GetRebuildCount() == 1);
+	CHECK(DirectionIs(field, 5.5f, 5.5f, 1.0f, 0.0f));
+	CHECK(!field.Step());
+
+	// Moved to the left: slices leave the old field in place until the last one
+	CHECK(field.SetGoal(2.5f, 5.5f));
+	uint32_t steps = 0;
+	bool swapped = false;
+	while (!swapped && steps < 10000)
+	{
+		CHECK(DirectionIs(field, 5.5f, 5.5f, 1.0f, 0.0f));
+		swapped = field.Step(7);
+		++steps;
+	}
+	CHECK(swapped && steps > 10);
+	CHECK(DirectionIs(field, 5.5f, 5.5f, -1.0f, 0.0f));
+	CHECK(field.GetRebuildCount() == 2);
+
+	// A goal set mid-rebuild waits for the one in progress, then is rebuilt next
+	CHECK(field.SetGoal(5.5f, 8.5f));
+	CHECK(!field.Step(50));
+	CHECK(field.SetGoal(5.5f, 2.5f));
+	while (!field.Step(50))
+		;
+	CHECK(DirectionIs(field, 5.5f, 5.5f, 0.0f, 1.0f));
+	while (!field.Step(50))
+		;
+	CHECK(DirectionIs(field, 5.5f, 5.5f, 0.0f, -1.0f));
+	CHECK(field.GetRebuildCount() == 4);
+	CHECK(!field.Step(50));
+
+	// Build starts over with no field
+	Build(field, boxes);
+	CHECK(field.GetRebuildCount() == 0);
+	CHECK(!field.GetDirection(5.5f, 5.5f, dirX, dirZ));
+}
+
+TEST_CASE(FlowFieldSlicesMatchWholeRebuilds)
+{
+	FlowField::BenchmarkResult result;
+	FlowField::Benchmark(96, 8, 1000, result);
+	CHECK(result.Mismatches == 0);
+	CHECK(result.StepsPerRebuild > 10.0f);
+}
+
+BENCHMARK(FlowFieldRebuild)
+{
+	// A whole rebuild in one frame, against the game's slice of 16384 cells per frame
+	for (uint32_t side : { 128u, 256u, 512u })
+	{
+		FlowField::BenchmarkResult result;
+		FlowField::Benchmark(side, 20, 16384, result);
+		std::printf("  %ux%u cells: rebuild %.3f ms (%.1f ns/cell), sliced worst step %.3f ms over %.1f steps, mismatches %u\n",
+			side, side, result.RebuildTime, result.RebuildTime * 1e6f / (side * side), result.MaxStepTime,
+			result.StepsPerRebuild, result.Mismatches);
+	}
+}
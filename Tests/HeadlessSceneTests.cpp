@@ -0,0 +1,182 @@
+#include "Test.h"
+#include "HeadlessScene.h"
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
+#include <cstdio>
+
+namespace
+{
+	// A small level, enough for every step of the frame to have work
+	HeadlessSettings SmallLevel(uint32_t seed)
+	{
+		HeadlessSettings settings;
+		settings.Seed = seed;
+		settings.Population = 300;
+		settings.PropCount = 500;
+		settings.HouseCount = 8;
+		return settings;
+	}
+
+	struct Run
+	{
+		float Position[3];
+		float Damage;
+		uint32_t Alive;
+		uint64_t Draws;
+		uint64_t Instances;
+		uint64_t FrameAllocations;
+	};
+
+	Run RunFrames(const HeadlessSettings& settings, ThreadPool* threadPool, uint32_t frameCount, uint32_t warmupFrames)
+	{
+		HeadlessScene scene(threadPool);
+		scene.Build(settings);
+
+		Run run = {};
+		for (uint32_t frame = 0; frame < frameCount; ++frame)
+		{
+			uint64_t allocations = AllocationCounter::GetTotalCount();
+			HeadlessFrameStats stats;
+			scene.Frame(1.0f / 60.0f, stats);
+			if (frame >= warmupFrames)
+				run.FrameAllocations += AllocationCounter::GetTotalCount() - allocations;
+			run.Draws += stats.Counts.Draws;
+			run.Instances += stats.Counts.Instances;
+		}
+		scene.GetPlayerPosition(run.Position);
+		run.Damage = scene.GetPlayerDamage();
+		run.Alive = scene.GetAliveCount();
+		return run;
+	}
+}
+
+TEST_CASE(HeadlessSceneRecordsEveryFrame)
+{
+	ThreadPool threadPool(3);
+	HeadlessScene scene(&threadPool);
+	scene.Build(SmallLevel(1));
+
+	bool recorded = true;
+	for (int frame = 0; frame < 30; ++frame)
+	{
+		HeadlessFrameStats stats;
+		scene.Frame(1.0f / 60.0f, stats);
+
+		// The ground around the player, the sky, the UI and the player at least
+		recorded &= stats.Visible > 0 && stats.Counts.Draws >= 1 + 1 + 5 + 8;
+		// Every list sets the viewport, scissor, targets, heap, root signature and stencil reference
+		recorded &= stats.CommandLists >= 1 && stats.Counts.FrameState == 6 * stats.CommandLists;
+		recorded &= stats.RootBindings >= 10 * stats.CommandLists;
+		recorded &= stats.UploadBytes > 0 && stats.Lights > 0;
+	}
+	CHECK(recorded);
+	CHECK(scene.GetZoneScheduler().GetZoneCount() == 3);
+	CHECK(scene.GetFlowField().GetRebuildCount() > 0);
+}
+
+TEST_CASE(HeadlessSceneIsDeterministic)
+{
+	// Same seed, same frames, whatever the number of workers
+	ThreadPool threadPool(3);
+	Run first = RunFrames(SmallLevel(5), &threadPool, 240, 240);
+	Run second = RunFrames(SmallLevel(5), nullptr, 240, 240);
+	CHECK(first.Position[0] == second.Position[0] && first.Position[2] == second.Position[2]);
+	CHECK(first.Damage == second.Damage);
+	CHECK(first.Alive == second.Alive);
+	CHECK(first.Draws == second.Draws);
+	CHECK(first.Instances == second.Instances);
+
+	// The player got somewhere and the crowd reached it
+	CHECK(first.Position[0] != 0.0f || first.Position[2] != 0.0f);
+	CHECK(first.Draws > 0);
+
+	Run other = RunFrames(SmallLevel(6), &threadPool, 240, 240);
+	CHECK(other.Instances != first.Instances || other.Alive != first.Alive);
+}
+
+TEST_CASE(HeadlessSceneBindsTablesOrConstants)
+{
+	HeadlessSettings constantSettings = SmallLevel(3);
+	HeadlessSettings tableSettings = SmallLevel(3);
+	tableSettings.TableBindings = true;
+	HeadlessScene constantScene(nullptr);
+	HeadlessScene tableScene(nullptr);
+	constantScene.Build(constantSettings);
+	tableScene.Build(tableSettings);
+
+	bool same = true;
+	for (int frame = 0; frame < 60; ++frame)
+	{
+		HeadlessFrameStats constants;
+		HeadlessFrameStats tables;
+		constantScene.Frame(1.0f / 60.0f, constants);
+		tableScene.Frame(1.0f / 60.0f, tables);
+
+		// The same draws, seven tables each in place of the root constants
+		same &= constants.Counts.Draws == tables.Counts.Draws && constants.Counts.RootConstants > 0;
+		same &= tables.Counts.RootConstants == 0;
+		same &= tables.Counts.DescriptorTables == constants.Counts.DescriptorTables + 7 * tables.Counts.Draws;
+		same &= tables.Counts.RootBuffers == constants.Counts.RootBuffers;
+		same &= tables.RootBindings == tables.Counts.RootBuffers + tables.Counts.DescriptorTables;
+	}
+	CHECK(same);
+}
+
+TEST_CASE(HeadlessSceneDoesNotAllocateOnceWarm)
+{
+	ThreadPool threadPool(3);
+	Run run = RunFrames(SmallLevel(2), &threadPool, 600, 60);
+	CHECK(run.FrameAllocations == 0);
+}
+
+BENCHMARK(HeadlessSceneDrawBindings)
+{
+	// Recording the same frames with the per-draw tables of before and the root constants of now
+	for (bool tableBindings : { true, false })
+	{
+		ThreadPool threadPool;
+		HeadlessSettings settings;
+		settings.TableBindings = tableBindings;
+		HeadlessScene scene(&threadPool);
+		scene.Build(settings);
+
+		float recordTime = 0.0f;
+		uint64_t bindings = 0;
+		HeadlessFrameStats total;
+		const uint32_t frameCount = 300;
+		for (uint32_t frame = 0; frame < frameCount; ++frame)
+		{
+			HeadlessFrameStats stats;
+			scene.Frame(1.0f / 60.0f, stats);
+			recordTime += stats.RecordTime;
+			bindings += stats.RootBindings;
+			total.Counts += stats.Counts;
+		}
+		std::printf("  %s: %llu bindings, %u draws and %u commands per frame, record %.4f ms\n",
+			tableBindings ? "tables" : "constants", (unsigned long long)(bindings / frameCount),
+			total.Counts.Draws / frameCount, total.Counts.GetCommandCount() / frameCount, recordTime / frameCount);
+	}
+}
+
+BENCHMARK(HeadlessSceneFrame)
+{
+	ThreadPool threadPool;
+	HeadlessScene scene(&threadPool);
+	scene.Build(HeadlessSettings());
+
+	HeadlessFrameStats total;
+	float updateTime = 0.0f;
+	float drawTime = 0.0f;
+	const uint32_t frameCount = 300;
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		HeadlessFrameStats stats;
+		scene.Frame(1.0f / 60.0f, stats);
+		updateTime += stats.UpdateTime;
+		drawTime += stats.DrawTime;
+		total.Counts += stats.Counts;
+	}
+	std::printf("  %u frames: update %.3f ms, draw %.3f ms, %u draws, %u commands and %llu instances per frame\n",
+		frameCount, updateTime / frameCount, drawTime / frameCount, total.Counts.Draws / frameCount,
+		total.Counts.GetCommandCount() / frameCount, (unsigned long long)(total.Counts.Instances / frameCount));
+}
@@ -0,0 +1,158 @@
+#include "Test.h"
+#include "HitQueue.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+	// Zones of attackers striking each other over a few steps, every hit with its own key
+	std::vector<HitEvent> MakeHits(uint32_t zoneCount, uint32_t attackerCount, uint32_t stepCount)
+	{
+		std::vector<HitEvent> hits;
+		for (uint32_t zone = 0; zone < zoneCount; ++zone)
+		{
+			for (uint32_t step = 0; step < stepCount; ++step)
+			{
+				for (uint32_t attacker = 0; attacker < attackerCount; ++attacker)
+				{
+					HitEvent e = {};
+					e.Source = attacker == 0 ? eHitSource::Player : eHitSource::Monster;
+					e.Zone = zone;
+					e.Attacker = attacker;
+					e.Target = (attacker * 7 + step) % attackerCount;
+					e.Sequence = step % 2;
+					e.Time = 0.04f * (step / 2);
+					e.Damage = 1 + (int)((attacker + zone) % 9);
+					hits.push_back(e);
+				}
+			}
+		}
+		return hits;
+	}
+}
+
+TEST_CASE(HitQueueResolvesInTheSameOrder)
+{
+	const uint32_t zoneCount = 4;
+	const uint32_t attackerCount = 50;
+	std::vector<HitEvent> hits = MakeHits(zoneCount, attackerCount, 6);
+
+	ThreadPool threadPool(4);
+	HitQueue queue((uint32_t)hits.size());
+
+	std::vector<uint32_t> firstOrder;
+	std::vector<int> firstHealth;
+	bool sameOrder = true;
+	bool sameHealth = true;
+	for (uint32_t run = 0; run < 16; ++run)
+	{
+		// A different arrival order every run, from several threads at once
+		std::mt19937 engine{ run };
+		std::shuffle(hits.begin(), hits.end(), engine);
+
+		const uint32_t sliceCount = 8;
+		uint32_t sliceSize = ((uint32_t)hits.size() + sliceCount - 1) / sliceCount;
+		threadPool.ParallelFor(sliceCount, [&](unsigned int slice)
+		{
+			uint32_t end = (std::min)((slice + 1) * sliceSize, (uint32_t)hits.size());
+			for (uint32_t i = slice * sliceSize; i < end; ++i)
+				queue.Push(hits[i]);
+		});
+
+		queue.Sort();
+		CHECK(queue.GetCount() == hits.size());
+
+		// Health that wraps around makes the result depend on the order the hits land in
+		std::vector<uint32_t> order;
+		std::vector<int> health(zoneCount * attackerCount, 20);
+		for (uint32_t i = 0; i < queue.GetCount(); ++i)
+		{
+			const HitEvent& e = queue[i];
+			order.push_back(e.Zone * 1000000 + e.Attacker * 1000 + (uint32_t)(e.Time * 100.0f) * 10 + e.Sequence);
+
+			int& target = health[e.Zone * attackerCount + e.Target];
+			target -= e.Damage;
+			if (target <= 0)
+				target += 20 + e.Damage;
+		}
+		queue.Clear();
+
+		if (run == 0)
+		{
+			firstOrder = order;
+			firstHealth = health;
+		}
+		sameOrder &= order == firstOrder;
+		sameHealth &= health == firstHealth;
+	}
+
+	CHECK(sameOrder);
+	CHECK(sameHealth);
+	// The player's hits come first
+	CHECK(firstOrder.size() == hits.size() && firstOrder[0] % 1000000 / 1000 == 0);
+}
+
+TEST_CASE(HitQueueReportsOverflow)
+{
+	HitQueue queue(4);
+	std::vector<HitEvent> hits = MakeHits(1, 5, 1);
+	for (auto& e : hits)
+		queue.Push(e);
+
+	bool thrown = false;
+	try
+	{
+		queue.Sort();
+	}
+	catch (const std::runtime_error&)
+	{
+		thrown = true;
+	}
+	CHECK(thrown);
+
+	// Sized for the worst case it resolves every hit
+	queue.SetCapacity(5);
+	for (auto& e : hits)
+		queue.Push(e);
+	queue.Sort();
+	CHECK(queue.GetCount() == 5);
+}
+
+TEST_CASE(HitQueueRejectsEqualKeys)
+{
+	HitQueue queue(8);
+	std::vector<HitEvent> hits = MakeHits(1, 3, 1);
+	for (auto& e : hits)
+		queue.Push(e);
+
+	// Same key, different damage: nothing decides which lands first
+	HitEvent twin = hits[1];
+	twin.Damage += 1;
+	queue.Push(twin);
+
+	bool thrown = false;
+	try
+	{
+		queue.Sort();
+	}
+	catch (const std::runtime_error&)
+	{
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+BENCHMARK(HitQueueThroughput)
+{
+	ThreadPool threadPool;
+	for (uint32_t combatantCount : { 1000u, 4000u, 16000u })
+	{
+		HitQueue::BenchmarkResult result;
+		HitQueue::Benchmark(combatantCount, 200, &threadPool, result);
+		std::printf("  %u combatants: %.0f hits/frame, push %.1f ns, resolve %.1f ns, mismatches %u\n",
+			combatantCount, result.HitsPerFrame, result.PushTime, result.ResolveTime, result.Mismatches);
+	}
+}
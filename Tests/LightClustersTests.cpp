@@ -0,0 +1,223 @@
+#include "Test.h"
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	const float FovY = 0.25f * 3.14159265f;
+	const float Aspect = 16.0f / 9.0f;
+	const float NearZ = 1.0f;
+	const float FarZ = 1000.0f;
+
+	// Cluster of a view-space point the way the shader finds it, false off screen, out of the
+	// depth range, or too close to a cluster face for rounding to be sure which side it is on
+	bool ClusterOf(const LightClusters& clusters, float x, float y, float z, uint32_t& cluster)
+	{
+		if (z < NearZ || z >= FarZ)
+			return false;
+
+		float tanY = std::tan(0.5f * FovY);
+		float u = (x / (z * tanY * Aspect) + 1.0f) * 0.5f * LightClusters::DimX;
+		float v = (1.0f - y / (z * tanY)) * 0.5f * LightClusters::DimY;
+		float w = std::log(z) * clusters.GetSliceScale() + clusters.GetSliceBias();
+
+		const float edge = 1e-3f;
+		for (float c : { u, v, w })
+		{
+			if (std::fabs(c - std::floor(c + 0.5f)) < edge)
+				return false;
+		}
+		if (u < 0.0f || u >= LightClusters::DimX || v < 0.0f || v >= LightClusters::DimY || w < 0.0f || w >= LightClusters::DimZ)
+			return false;
+
+		cluster = ((uint32_t)w * LightClusters::DimY + (uint32_t)v) * LightClusters::DimX + (uint32_t)u;
+		return true;
+	}
+
+	bool InCluster(const LightClusters& clusters, uint32_t cluster, uint32_t light)
+	{
+		const LightClusters::Range& range = clusters.GetRanges()[cluster];
+		const uint32_t* first = clusters.GetIndices().data() + range.Offset;
+		return std::binary_search(first, first + range.Count, light);
+	}
+
+	std::vector<LightBounds> RandomLights(uint32_t count, uint32_t seed)
+	{
+		float tanY = std::tan(0.5f * FovY);
+		std::mt19937 engine{ seed };
+		std::uniform_real_distribution<float> disDepth{ -10.0f, 400.0f };
+		std::uniform_real_distribution<float> disSide{ -1.3f, 1.3f };
+		std::uniform_real_distribution<float> disRadius{ 0.5f, 25.0f };
+
+		std::vector<LightBounds> lights(count);
+		for (auto& l : lights)
+		{
+			float z = disDepth(engine);
+			float spread = (std::max)(z, 1.0f);
+			l.Center[0] = disSide(engine) * spread * tanY * Aspect;
+			l.Center[1] = disSide(engine) * spread * tanY;
+			l.Center[2] = z;
+			l.Radius = disRadius(engine);
+		}
+		return lights;
+	}
+}
+
+TEST_CASE(LightClustersListEveryLightTheyTouch)
+{
+	LightClusters clusters;
+	clusters.SetProjection(FovY, Aspect, NearZ, FarZ);
+	std::vector<LightBounds> lights = RandomLights(300, 11u);
+	clusters.Build(lights.data(), (uint32_t)lights.size(), nullptr);
+
+	// Points spread through every light: the cluster holding each one must list the light
+	std::mt19937 engine{ 5u };
+	std::uniform_real_distribution<float> disUnit{ -1.0f, 1.0f };
+	uint32_t sampled = 0;
+	uint32_t missed = 0;
+	for (uint32_t i = 0; i < lights.size(); ++i)
+	{
+		const LightBounds& l = lights[i];
+		for (uint32_t s = 0; s < 400; ++s)
+		{
+			float p[3] = { disUnit(engine), disUnit(engine), disUnit(engine) };
+			if (p[0] * p[0] + p[1] * p[1] + p[2] * p[2] > 1.0f)
+				continue;
+
+			uint32_t cluster;
+			if (!ClusterOf(clusters, l.Center[0] + p[0] * l.Radius, l.Center[1] + p[1] * l.Radius, l.Center[2] + p[2] * l.Radius, cluster))
+				continue;
+			++sampled;
+			missed += !InCluster(clusters, cluster, i);
+		}
+	}
+	CHECK(sampled > 10000);
+	CHECK(missed == 0);
+}
+
+TEST_CASE(LightClustersLayout)
+{
+	LightClusters clusters;
+	clusters.SetProjection(FovY, Aspect, NearZ, FarZ);
+	std::vector<LightBounds> lights = RandomLights(500, 12u);
+	clusters.Build(lights.data(), (uint32_t)lights.size(), nullptr);
+
+	// One range per cluster, back to back over the index list, each sorted without repeats
+	const auto& ranges = clusters.GetRanges();
+	const auto& indices = clusters.GetIndices();
+	CHECK(ranges.size() == LightClusters::ClusterCount);
+
+	uint32_t offset = 0;
+	bool contiguous = true;
+	bool sorted = true;
+	for (const auto& r : ranges)
+	{
+		contiguous &= r.Offset == offset;
+		offset += r.Count;
+		for (uint32_t i = 1; i < r.Count; ++i)
+			sorted &= indices[r.Offset + i - 1] < indices[r.Offset + i];
+	}
+	CHECK(contiguous);
+	CHECK(sorted);
+	CHECK(offset == indices.size());
+	CHECK(std::all_of(indices.begin(), indices.end(), [&](uint32_t i) { return i < lights.size(); }));
+
+	// Binned on workers it comes out the same, and a rebuild replaces the previous lists
+	ThreadPool threadPool(3);
+	LightClusters parallel;
+	parallel.SetProjection(FovY, Aspect, NearZ, FarZ);
+	std::vector<LightBounds> others = RandomLights(50, 13u);
+	parallel.Build(others.data(), (uint32_t)others.size(), &threadPool);
+	parallel.Build(lights.data(), (uint32_t)lights.size(), &threadPool);
+	CHECK(parallel.GetIndices() == indices);
+	bool sameRanges = true;
+	for (uint32_t i = 0; i < LightClusters::ClusterCount; ++i)
+		sameRanges &= parallel.GetRanges()[i].Offset == ranges[i].Offset && parallel.GetRanges()[i].Count == ranges[i].Count;
+	CHECK(sameRanges);
+}
+
+TEST_CASE(LightClustersDoNotAllocateOnceReserved)
+{
+	ThreadPool threadPool(3);
+	LightClusters clusters;
+	clusters.SetProjection(FovY, Aspect, NearZ, FarZ);
+	clusters.Reserve(200);
+
+	// A different crowd of lights every build, up to the reserved count
+	std::vector<std::vector<LightBounds>> frames;
+	for (uint32_t i = 0; i < 20; ++i)
+		frames.push_back(RandomLights(10 * (i + 1), 100u + i));
+	threadPool.ParallelFor(1, [](unsigned int) {});
+
+	uint64_t before = AllocationCounter::GetTotalCount();
+	for (const auto& lights : frames)
+	{
+		clusters.Build(lights.data(), (uint32_t)lights.size(), &threadPool);
+		clusters.Build(lights.data(), (uint32_t)lights.size(), nullptr);
+	}
+	CHECK(AllocationCounter::GetTotalCount() - before == 0);
+
+	// Same lists as clusters that never reserved
+	LightClusters fresh;
+	fresh.SetProjection(FovY, Aspect, NearZ, FarZ);
+	fresh.Build(frames.back().data(), (uint32_t)frames.back().size(), nullptr);
+	CHECK(fresh.GetIndices() == clusters.GetIndices());
+}
+
+TEST_CASE(LightClustersStayTight)
+{
+	LightClusters clusters;
+	clusters.SetProjection(FovY, Aspect, NearZ, FarZ);
+
+	// A small light in the middle of the view, one behind the eye and one beyond the far plane
+	LightBounds lights[] =
+	{
+		{ { 0.1f, 0.1f, 110.0f }, 0.5f },
+		{ { 0.0f, 0.0f, -50.0f }, 10.0f },
+		{ { 0.0f, 0.0f, 1200.0f }, 100.0f },
+	};
+	clusters.Build(lights, 3, nullptr);
+
+	// Only the first is listed, in the clusters around its center: the two middle columns
+	// and rows, in one or two slices
+	uint32_t listed = 0;
+	for (uint32_t cluster = 0; cluster < LightClusters::ClusterCount; ++cluster)
+	{
+		const LightClusters::Range& r = clusters.GetRanges()[cluster];
+		for (uint32_t i = 0; i < r.Count; ++i)
+		{
+			uint32_t light = clusters.GetIndices()[r.Offset + i];
+			CHECK(light == 0);
+			++listed;
+		}
+	}
+	CHECK(listed >= 1 && listed <= 8);
+
+	uint32_t center;
+	CHECK(ClusterOf(clusters, 0.1f, 0.1f, 110.0f, center));
+	CHECK(InCluster(clusters, center, 0));
+	CHECK(center % LightClusters::DimX == LightClusters::DimX / 2);
+	CHECK(center / LightClusters::DimX % LightClusters::DimY == LightClusters::DimY / 2 - 1);
+
+	// No lights, nothing listed
+	clusters.Build(nullptr, 0, nullptr);
+	CHECK(clusters.GetIndices().empty());
+	CHECK(clusters.GetRanges().size() == LightClusters::ClusterCount);
+}
+
+BENCHMARK(LightClustersBinning)
+{
+	ThreadPool threadPool;
+	for (uint32_t lightCount : { 16u, 256u, 4096u })
+	{
+		float serialTime = LightClusters::Benchmark(lightCount, 100, nullptr);
+		float binTime = LightClusters::Benchmark(lightCount, 100, &threadPool);
+		std::printf("  %u lights: bin %.3f ms on %u threads, %.3f ms on one\n",
+			lightCount, binTime, threadPool.GetThreadCount(), serialTime);
+	}
+}
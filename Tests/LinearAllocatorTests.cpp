@@ -0,0 +1,60 @@
+#include "Test.h"
+#include "LinearAllocator.h"
+
+TEST_CASE(LinearAllocatorRoundsUpAlignment)
+{
+	LinearAllocator allocator(1024);
+
+	CHECK(allocator.Allocate(1, 1) == 0);
+	CHECK(allocator.Allocate(1, 1) == 1);
+	CHECK(allocator.Allocate(4, 4) == 4);
+	// Constant buffers are 256-byte aligned
+	CHECK(allocator.Allocate(100, 256) == 256);
+	CHECK(allocator.GetUsedSize() == 356);
+	// An already aligned offset is not moved
+	CHECK(allocator.Allocate(156, 4) == 356);
+	CHECK(allocator.Allocate(8, 256) == 512);
+}
+
+TEST_CASE(LinearAllocatorReturnsInvalidWhenExhausted)
+{
+	LinearAllocator allocator(1024);
+
+	CHECK(allocator.Allocate(0, 1) == LinearAllocator::InvalidOffset);
+	CHECK(allocator.Allocate(2048, 1) == LinearAllocator::InvalidOffset);
+	CHECK(allocator.Allocate(1000, 1) == 0);
+
+	// 24 bytes left, but the aligned start is past the end
+	CHECK(allocator.Allocate(8, 256) == LinearAllocator::InvalidOffset);
+	CHECK(allocator.Allocate(25, 1) == LinearAllocator::InvalidOffset);
+	// A failed request leaves the rest usable
+	CHECK(allocator.GetUsedSize() == 1000);
+	CHECK(allocator.Allocate(24, 1) == 1000);
+	CHECK(allocator.GetUsedSize() == allocator.GetCapacity());
+	CHECK(allocator.Allocate(1, 1) == LinearAllocator::InvalidOffset);
+
+	// Sizes near the top of the range must not wrap around
+	CHECK(allocator.Allocate(UINT64_MAX, 1) == LinearAllocator::InvalidOffset);
+}
+
+TEST_CASE(LinearAllocatorResets)
+{
+	LinearAllocator allocator(1024);
+	allocator.Allocate(1024, 1);
+
+	allocator.Reset();
+	CHECK(allocator.GetUsedSize() == 0);
+	CHECK(allocator.Allocate(16, 16) == 0);
+
+	// A new backing range of a different size starts empty
+	allocator.Reset(4096);
+	CHECK(allocator.GetCapacity() == 4096);
+	CHECK(allocator.GetUsedSize() == 0);
+	CHECK(allocator.Allocate(4000, 1) == 0);
+	CHECK(allocator.Allocate(96, 1) == 4000);
+	CHECK(allocator.Allocate(1, 1) == LinearAllocator::InvalidOffset);
+
+	allocator.Reset(64);
+	CHECK(allocator.Allocate(128, 1) == LinearAllocator::InvalidOffset);
+	CHECK(allocator.Allocate(64, 1) == 0);
+}
@@ -0,0 +1,55 @@
+#include "Test.h"
+#include <cstdio>
+#include <cstring>
+
+// Unit tests for the modules that do not depend on the graphics API.
+// Runs on Windows through Tests.vcxproj, and anywhere through the CMakeLists.txt at the root:
+//   cmake -S . -B build && cmake --build build && ctest --test-dir build
+// Exits with the number of failed checks. -benchmark also runs the benchmarks.
+
+namespace
+{
+	int gFailures = 0;
+}
+
+std::vector<Test::Case>& Test::Cases()
+{
+	static std::vector<Case> cases;
+	return cases;
+}
+
+std::vector<Test::Case>& Test::Benchmarks()
+{
+	static std::vector<Case> benchmarks;
+	return benchmarks;
+}
+
+void Test::Fail(const char* file, int line, const char* expression)
+{
+	std::printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	++gFailures;
+}
+
+int main(int argc, char* argv[])
+{
+	bool benchmark = argc > 1 && std::strcmp(argv[1], "-benchmark") == 0;
+
+	for (auto& e : Test::Cases())
+	{
+		int failures = gFailures;
+		e.Body();
+		std::printf("%s %s\n", gFailures == failures ? "passed" : "FAILED", e.Name);
+	}
+
+	if (benchmark)
+	{
+		for (auto& e : Test::Benchmarks())
+		{
+			std::printf("%s\n", e.Name);
+			e.Body();
+		}
+	}
+
+	std::printf("%d tests, %d failed checks\n", (int)Test::Cases().size(), gFailures);
+	return gFailures;
+}
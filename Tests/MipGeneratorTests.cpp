@@ -0,0 +1,94 @@
+#include "Test.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <cstdio>
+#include <cstdlib>
+
+TEST_CASE(MipGeneratorSizesChain)
+{
+	CHECK(MipGenerator::CalcMipCount(1, 1) == 1);
+	CHECK(MipGenerator::CalcMipCount(256, 256) == 9);
+	CHECK(MipGenerator::CalcMipCount(300, 17) == 9);
+
+	// 2x1, 1x1
+	CHECK(MipGenerator::CalcChainSize(4, 2, 3) == (2 + 1) * 4);
+	CHECK(MipGenerator::CalcChainSize(256, 256, 1) == 0);
+}
+
+TEST_CASE(MipGeneratorBoxAverages)
+{
+	// Each 2x2 block of the 4x4 image becomes one texel
+	uint8_t image[4 * 4 * 4];
+	for (int y = 0; y < 4; ++y)
+	{
+		for (int x = 0; x < 4; ++x)
+		{
+			uint8_t* p = &image[(y * 4 + x) * 4];
+			p[0] = (uint8_t)(x < 2 ? 0 : 200);
+			p[1] = (uint8_t)(y < 2 ? 100 : 50);
+			p[2] = (uint8_t)((x + y) % 2 ? 255 : 0);
+			p[3] = 255;
+		}
+	}
+
+	uint8_t mips[(4 + 1) * 4];
+	MipGenerator mipGen;
+	mipGen.Generate(image, 4, 4, 16, 3, mips, MipGenerator::Filter::BOX, false, false);
+
+	CHECK(mips[0] == 0 && mips[4] == 200);
+	CHECK(mips[1] == 100 && mips[9] == 50);
+	CHECK(std::abs(mips[2] - 128) <= 1);
+	CHECK(mips[3] == 255);
+	CHECK(mipGen.GetLastPixels() == 16);
+
+	// Last level is the mean of the whole image
+	CHECK(std::abs(mips[16] - 100) <= 1);
+	CHECK(std::abs(mips[17] - 75) <= 1);
+}
+
+TEST_CASE(MipGeneratorKeepsFlatColor)
+{
+	// The Kaiser weights are renormalized per texel, so a flat image stays flat on every level
+	const uint32_t size = 64;
+	std::vector<uint8_t> image(size * size * 4);
+	for (size_t i = 0; i < image.size(); i += 4)
+	{
+		image[i + 0] = 30;
+		image[i + 1] = 128;
+		image[i + 2] = 220;
+		image[i + 3] = 77;
+	}
+
+	ThreadPool threadPool(2);
+	uint32_t mipLevels = MipGenerator::CalcMipCount(size, size);
+	std::vector<uint8_t> mips((size_t)MipGenerator::CalcChainSize(size, size, mipLevels));
+
+	for (int wrap = 0; wrap < 2; ++wrap)
+	{
+		MipGenerator mipGen(&threadPool);
+		mipGen.Generate(image.data(), size, size, size * 4, mipLevels, mips.data(), MipGenerator::Filter::KAISER, true, wrap != 0);
+
+		int worst = 0;
+		for (size_t i = 0; i < mips.size(); ++i)
+			worst = (std::max)(worst, std::abs(mips[i] - image[i % 4]));
+		CHECK(worst <= 1);
+	}
+}
+
+BENCHMARK(MipGeneratorThroughput)
+{
+	ThreadPool threadPool;
+	const uint32_t sizes[] = { 512, 2048 };
+	for (uint32_t size : sizes)
+	{
+		for (int f = 0; f < (int)MipGenerator::Filter::Count; ++f)
+		{
+			MipGenerator::Filter filter = (MipGenerator::Filter)f;
+			double single = MipGenerator::Benchmark(size, size, filter, nullptr);
+			double pooled = MipGenerator::Benchmark(size, size, filter, &threadPool);
+			std::printf("  %ux%u %s: %.1f MP/s on one thread, %.1f MP/s on %u workers + caller\n",
+				size, size, filter == MipGenerator::Filter::BOX ? "box" : "kaiser",
+				single, pooled, threadPool.GetThreadCount());
+		}
+	}
+}
@@ -0,0 +1,131 @@
+#include "Test.h"
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	const float Identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+	// The eye at the origin looking down +z, 45 degrees vertically at twice as wide
+	void ViewProj(float m[16])
+	{
+		float yScale = 1.0f / std::tan(0.125f * 3.14159265f);
+		float range = 1000.0f / (1000.0f - 1.0f);
+		std::fill(m, m + 16, 0.0f);
+		m[0] = yScale / 2.0f;
+		m[5] = yScale;
+		m[10] = range;
+		m[11] = 1.0f;
+		m[14] = -range;
+	}
+
+	CullBox Box(float x, float y, float z, float e)
+	{
+		return { { x, y, z }, { e, e, e } };
+	}
+
+	// A wall across the middle of the view, about 28 degrees to either side
+	const CullBox Wall = { { 0.0f, 0.0f, 20.0f }, { 10.0f, 10.0f, 1.0f } };
+}
+
+TEST_CASE(OcclusionCullsBehindAWall)
+{
+	float viewProj[16];
+	ViewProj(viewProj);
+
+	// The pyramid is built the same whatever the shape of the buffer
+	for (auto size : { std::make_pair(256u, 128u), std::make_pair(512u, 512u), std::make_pair(64u, 16u) })
+	{
+		OcclusionCuller culler(size.first, size.second);
+		culler.AddOccluder(Wall, Identity);
+		culler.Render(viewProj);
+
+		// Seen from outside only the front faces are drawn
+		CHECK(culler.GetTriangleCount() == 12);
+		CHECK(culler.GetRasterizedCount() > 0 && culler.GetRasterizedCount() <= 6);
+
+		// Well behind it, and behind it up to the edge
+		CHECK(!culler.IsVisible(Box(0.0f, 0.0f, 50.0f, 2.0f)));
+		CHECK(!culler.IsVisible(Box(-5.0f, 5.0f, 200.0f, 10.0f)));
+
+		// Sticking out past its edge, beside it, and in front of it
+		CHECK(culler.IsVisible(Box(25.0f, 0.0f, 50.0f, 2.0f)));
+		CHECK(culler.IsVisible(Box(40.0f, 0.0f, 50.0f, 2.0f)));
+		CHECK(culler.IsVisible(Box(0.0f, 0.0f, 10.0f, 1.0f)));
+		// Crossing the near plane, behind the eye, and off screen
+		CHECK(culler.IsVisible(Box(0.0f, 0.0f, 0.5f, 1.0f)));
+		CHECK(culler.IsVisible(Box(0.0f, 0.0f, -50.0f, 2.0f)));
+		CHECK(culler.IsVisible(Box(500.0f, 0.0f, 50.0f, 2.0f)));
+	}
+}
+
+TEST_CASE(OcclusionHandlesTransformedOccluders)
+{
+	float viewProj[16];
+	ViewProj(viewProj);
+
+	// The wall as a unit box scaled and moved into place, and again mirrored in x
+	float world[16] = { 10, 0, 0, 0, 0, 10, 0, 0, 0, 0, 1, 0, 0, 0, 20, 1 };
+	float mirrored[16] = { -10, 0, 0, 0, 0, 10, 0, 0, 0, 0, 1, 0, 0, 0, 20, 1 };
+	CullBox unit = Box(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (const float* m : { world, mirrored })
+	{
+		OcclusionCuller culler;
+		culler.AddOccluder(unit, m);
+		culler.Render(viewProj);
+		CHECK(culler.GetRasterizedCount() > 0);
+		CHECK(!culler.IsVisible(Box(0.0f, 0.0f, 50.0f, 2.0f)));
+		CHECK(culler.IsVisible(Box(25.0f, 0.0f, 50.0f, 2.0f)));
+	}
+
+	// Nothing is hidden once the occluders are cleared
+	OcclusionCuller culler;
+	culler.AddOccluder(Wall, Identity);
+	culler.ClearOccluders();
+	culler.Render(viewProj);
+	CHECK(culler.GetTriangleCount() == 0);
+	CHECK(culler.IsVisible(Box(0.0f, 0.0f, 50.0f, 2.0f)));
+}
+
+TEST_CASE(OcclusionTestBoxesSkipsCulled)
+{
+	float viewProj[16];
+	ViewProj(viewProj);
+	OcclusionCuller culler;
+	culler.AddOccluder(Wall, Identity);
+	culler.Render(viewProj);
+
+	CullBox boxes[] =
+	{
+		Box(0.0f, 0.0f, 50.0f, 2.0f),
+		Box(0.0f, 0.0f, 60.0f, 2.0f),
+		Box(40.0f, 0.0f, 50.0f, 2.0f),
+		Box(0.0f, 0.0f, 70.0f, 2.0f),
+	};
+	// The last one was already culled by the frustum
+	uint8_t visible[] = { 1, 1, 1, 0 };
+	CHECK(culler.TestBoxes(boxes, 4, visible) == 2);
+	CHECK(visible[0] == 0 && visible[1] == 0 && visible[2] == 1 && visible[3] == 0);
+}
+
+TEST_CASE(OcclusionAgreesWithRayCasts)
+{
+	// Never culls a box a ray reaches, and finds most of those none reach
+	OcclusionCuller::BenchmarkResult result;
+	OcclusionCuller::Benchmark(2048, 1, result);
+	CHECK(result.Tested == 2048);
+	CHECK(result.FalseOccluded == 0);
+	CHECK(result.Occluded <= result.ReferenceOccluded);
+	CHECK(result.Occluded * 2 > result.ReferenceOccluded);
+}
+
+BENCHMARK(OcclusionThroughput)
+{
+	OcclusionCuller::BenchmarkResult result;
+	OcclusionCuller::Benchmark(4096, 100, result);
+	std::printf("  %u boxes: render %.3f ms, test %.1f ns/box, occluded %u (reference %u), false %u\n",
+		result.Tested, result.RenderTime, result.TestTime, result.Occluded, result.ReferenceOccluded, result.FalseOccluded);
+}
@@ -0,0 +1,103 @@
+// SkinnedBounds works on the character vertex and DirectXMath, which come with the Windows SDK
+#ifdef _WIN32
+
+#include "Test.h"
+#include "SkinnedBounds.h"
+#include "FrameResource.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+namespace
+{
+	CharacterVertex MakeVertex(float x, float y, float z, BYTE bone0, float weight0, BYTE bone1 = 0)
+	{
+		CharacterVertex v = CharacterVertex();
+		v.Pos = XMFLOAT3(x, y, z);
+		v.BoneWeights = XMFLOAT3(weight0, 1.0f - weight0, 0.0f);
+		v.BoneIndices[0] = bone0;
+		v.BoneIndices[1] = bone1;
+		return v;
+	}
+
+	bool Near(float a, float b, float tolerance = 1e-4f)
+	{
+		return std::fabs(a - b) <= tolerance;
+	}
+
+	bool BoxIs(const BoundingBox& box, float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+	{
+		return Near(box.Center.x - box.Extents.x, minX) && Near(box.Center.y - box.Extents.y, minY) &&
+			Near(box.Center.z - box.Extents.z, minZ) && Near(box.Center.x + box.Extents.x, maxX) &&
+			Near(box.Center.y + box.Extents.y, maxY) && Near(box.Center.z + box.Extents.z, maxZ);
+	}
+}
+
+TEST_CASE(SkinnedBoundsInBindPose)
+{
+	// Bone 0 moves the lower half, bone 2 the upper half, bone 1 only through a weight
+	// small enough to be the rounding left on the fourth slot, bone 3 is out of range
+	CharacterVertex vertices[] =
+	{
+		MakeVertex(-1.0f, 0.0f, -0.5f, 0, 1.0f),
+		MakeVertex(1.0f, 1.0f, 0.5f, 0, 0.6f, 2),
+		MakeVertex(-0.5f, 2.0f, 0.0f, 2, 1.0f - 1e-5f, 1),
+		MakeVertex(0.5f, 3.0f, 0.25f, 2, 1.0f),
+		MakeVertex(9.0f, 9.0f, 9.0f, 3, 1.0f),
+	};
+
+	SkinnedBounds bounds;
+	BoundingBox box;
+	CHECK(!bounds.Compute(nullptr, XMMatrixIdentity(), box));
+
+	bounds.Build(vertices, 5, 3);
+	CHECK(bounds.GetBoneCount() == 2);
+
+	// Identity bones: the box of the weighted vertices
+	XMFLOAT4X4 palette[3];
+	for (auto& m : palette)
+		XMStoreFloat4x4(&m, XMMatrixIdentity());
+	CHECK(bounds.Compute(palette, XMMatrixIdentity(), box));
+	CHECK(BoxIs(box, -1.0f, 0.0f, -0.5f, 1.0f, 3.0f, 0.5f));
+
+	// The world scales and moves it
+	CHECK(bounds.Compute(palette, XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(10.0f, 0.0f, -10.0f), box));
+	CHECK(BoxIs(box, 8.0f, 0.0f, -11.0f, 12.0f, 6.0f, -9.0f));
+
+	// Lifting bone 2 lifts the top of the box; the palette is transposed like the shader's
+	XMStoreFloat4x4(&palette[2], XMMatrixTranspose(XMMatrixTranslation(0.0f, 5.0f, 0.0f)));
+	CHECK(bounds.Compute(palette, XMMatrixIdentity(), box));
+	CHECK(BoxIs(box, -1.0f, 0.0f, -0.5f, 1.0f, 8.0f, 0.5f));
+
+	// A quarter turn about y swaps the extents of bone 2's box in x and z
+	XMStoreFloat4x4(&palette[2], XMMatrixTranspose(XMMatrixRotationY(XM_PIDIV2)));
+	CHECK(bounds.Compute(palette, XMMatrixIdentity(), box));
+	CHECK(BoxIs(box, -1.0f, 0.0f, -1.0f, 1.0f, 3.0f, 0.5f));
+}
+
+TEST_CASE(SkinnedBoundsHoldEveryPose)
+{
+	// Random poses and monster-like scales: no skinned vertex ever leaves the bone boxes
+	for (uint32_t vertexCount : { 100u, 2000u })
+	{
+		SkinnedBounds::BenchmarkResult result;
+		SkinnedBounds::Benchmark(64, vertexCount, result);
+		CHECK(result.Escapes == 0);
+		CHECK(result.Slack >= 0.999f);
+	}
+}
+
+BENCHMARK(SkinnedBoundsCost)
+{
+	// Posed bounds from the bone boxes, against skinning every vertex on the CPU
+	for (uint32_t vertexCount : { 2000u, 8000u, 32000u })
+	{
+		SkinnedBounds::BenchmarkResult result;
+		SkinnedBounds::Benchmark(256, vertexCount, result);
+		std::printf("  %u vertices: per vertex %.2f us, per bone %.2f us, escapes %u, slack %.2f\n",
+			vertexCount, result.VertexTime, result.BoneTime, result.Escapes, result.Slack);
+	}
+}
+
+#endif
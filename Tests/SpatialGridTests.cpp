@@ -0,0 +1,261 @@
+#include "Test.h"
+#include "SpatialGrid.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	struct Point
+	{
+		float X, Z;
+		bool Present;
+	};
+
+	std::vector<uint32_t> BruteRadius(const std::vector<Point>& points, float x, float z, float radius)
+	{
+		std::vector<uint32_t> ids;
+		for (uint32_t i = 0; i < points.size(); ++i)
+		{
+			float dx = points[i].X - x;
+			float dz = points[i].Z - z;
+			if (points[i].Present && dx * dx + dz * dz <= radius * radius)
+				ids.push_back(i);
+		}
+		return ids;
+	}
+
+	std::vector<uint32_t> BruteNearest(const std::vector<Point>& points, float x, float z, uint32_t k, float maxRadius)
+	{
+		std::vector<std::pair<float, uint32_t>> found;
+		for (uint32_t i = 0; i < points.size(); ++i)
+		{
+			float dx = points[i].X - x;
+			float dz = points[i].Z - z;
+			float d2 = dx * dx + dz * dz;
+			if (points[i].Present && d2 <= maxRadius * maxRadius)
+				found.push_back({ d2, i });
+		}
+		std::sort(found.begin(), found.end());
+
+		std::vector<uint32_t> ids;
+		for (uint32_t i = 0; i < found.size() && i < k; ++i)
+			ids.push_back(found[i].second);
+		return ids;
+	}
+
+	// 1 inside the cone, 0 outside, -1 within epsilon radians of its edge where rounding decides
+	int BruteCone(const Point& p, float x, float z, float dirX, float dirZ, float radius, float halfAngle)
+	{
+		float dx = p.X - x;
+		float dz = p.Z - z;
+		float d2 = dx * dx + dz * dz;
+		if (d2 > radius * radius)
+			return 0;
+		if (d2 == 0.0f)
+			return 1;
+
+		float cosAngle = (dx * dirX + dz * dirZ) / (std::sqrt(d2) * std::sqrt(dirX * dirX + dirZ * dirZ));
+		float angle = std::acos((std::max)(-1.0f, (std::min)(1.0f, cosAngle)));
+		if (std::fabs(angle - halfAngle) < 1e-3f)
+			return -1;
+		return angle <= halfAngle ? 1 : 0;
+	}
+}
+
+TEST_CASE(SpatialGridMatchesBruteForce)
+{
+	const float cellSize = 8.0f;
+	SpatialGrid grid(cellSize);
+
+	std::mt19937 engine{ 4321u };
+	std::uniform_real_distribution<float> disPos{ -60.0f, 60.0f };
+	std::uniform_int_distribution<int> disCell{ -8, 8 };
+	std::uniform_real_distribution<float> disAngle{ 0.0f, 6.2831853f };
+
+	// Around the origin, so cell coordinates go negative, with some exactly on cell edges and
+	// a few far enough out that their cells only meet the others through the hash
+	std::vector<Point> points(600);
+	for (uint32_t i = 0; i < points.size(); ++i)
+	{
+		Point& p = points[i];
+		if (i % 10 == 0)
+			p = { disCell(engine) * cellSize, disCell(engine) * cellSize, true };
+		else if (i % 97 == 0)
+			p = { 1e4f + disPos(engine), -1e4f + disPos(engine), true };
+		else
+			p = { disPos(engine), disPos(engine), true };
+		grid.Insert(i, p.X, p.Z);
+	}
+
+	// Everyone walks, some across cell edges, and some leave
+	for (uint32_t i = 0; i < points.size(); ++i)
+	{
+		Point& p = points[i];
+		if (i % 7 == 0)
+		{
+			grid.Remove(i);
+			p.Present = false;
+			continue;
+		}
+		p.X += 0.25f * disPos(engine);
+		p.Z += 0.25f * disPos(engine);
+		grid.Move(i, p.X, p.Z);
+	}
+	CHECK(grid.GetCount() == (uint32_t)std::count_if(points.begin(), points.end(), [](const Point& p) { return p.Present; }));
+
+	uint32_t radiusMismatches = 0;
+	uint32_t nearestMismatches = 0;
+	uint32_t coneMismatches = 0;
+	uint32_t nonEmpty = 0;
+	std::vector<uint32_t> ids;
+	for (uint32_t q = 0; q < 400; ++q)
+	{
+		// Inside, on cell edges, on a point, and well outside the populated area
+		float x, z;
+		if (q % 4 == 0)
+		{
+			x = disCell(engine) * cellSize;
+			z = disCell(engine) * cellSize;
+		}
+		else if (q % 4 == 1)
+		{
+			const Point& p = points[q % points.size()];
+			x = p.X;
+			z = p.Z;
+		}
+		else if (q % 4 == 2)
+		{
+			x = 3.0f * disPos(engine);
+			z = 3.0f * disPos(engine);
+		}
+		else
+		{
+			x = disPos(engine);
+			z = disPos(engine);
+		}
+
+		// Zero, under a cell, exactly a cell and several cells
+		const float radii[] = { 0.0f, 3.0f, cellSize, 21.0f };
+		float radius = radii[q % 4];
+
+		grid.QueryRadius(x, z, radius, ids);
+		std::vector<uint32_t> expected = BruteRadius(points, x, z, radius);
+		radiusMismatches += ids != expected;
+		nonEmpty += !expected.empty();
+
+		uint32_t k = 1 + q % 6;
+		grid.QueryNearest(x, z, k, 30.0f, ids);
+		nearestMismatches += ids != BruteNearest(points, x, z, k, 30.0f);
+
+		float angle = disAngle(engine);
+		float halfAngle = 0.2f + 0.3f * (q % 8);
+		grid.QueryCone(x, z, std::cos(angle), std::sin(angle), 20.0f, halfAngle, ids);
+		for (uint32_t i = 0; i < points.size(); ++i)
+		{
+			if (!points[i].Present)
+				continue;
+			int reference = BruteCone(points[i], x, z, std::cos(angle), std::sin(angle), 20.0f, halfAngle);
+			if (reference < 0)
+				continue;
+			bool found = std::binary_search(ids.begin(), ids.end(), i);
+			coneMismatches += found != (reference == 1);
+		}
+	}
+
+	CHECK(radiusMismatches == 0);
+	CHECK(nearestMismatches == 0);
+	CHECK(coneMismatches == 0);
+	// The queries are neither all empty nor trivially full
+	CHECK(nonEmpty > 100 && nonEmpty < 400);
+}
+
+TEST_CASE(SpatialGridTracksMembership)
+{
+	SpatialGrid grid(4.0f);
+	std::vector<uint32_t> ids;
+
+	// Moving an id that is not there inserts it
+	grid.Move(5, -1.0f, -1.0f);
+	CHECK(grid.Contains(5));
+	CHECK(!grid.Contains(4));
+	CHECK(grid.GetCount() == 1);
+
+	// Out of its cell and back
+	grid.Insert(2, 0.0f, 0.0f);
+	grid.Move(2, 100.0f, 100.0f);
+	grid.QueryRadius(0.0f, 0.0f, 2.0f, ids);
+	CHECK(ids == std::vector<uint32_t>{ 5 });
+	grid.Move(2, 0.5f, 0.5f);
+	grid.QueryRadius(0.0f, 0.0f, 2.0f, ids);
+	CHECK((ids == std::vector<uint32_t>{ 2, 5 }));
+
+	// Inserting a present id moves it
+	grid.Insert(5, 50.0f, 50.0f);
+	CHECK(grid.GetCount() == 2);
+	grid.QueryRadius(0.0f, 0.0f, 2.0f, ids);
+	CHECK(ids == std::vector<uint32_t>{ 2 });
+
+	grid.Remove(2);
+	grid.Remove(2);
+	CHECK(grid.GetCount() == 1);
+	grid.QueryNearest(0.0f, 0.0f, 3, 1000.0f, ids);
+	CHECK(ids == std::vector<uint32_t>{ 5 });
+
+	grid.Clear();
+	CHECK(grid.GetCount() == 0);
+	CHECK(!grid.Contains(5));
+	grid.QueryRadius(50.0f, 50.0f, 10.0f, ids);
+	CHECK(ids.empty());
+}
+
+TEST_CASE(SpatialGridMovesWithoutAllocating)
+{
+	const uint32_t count = 500;
+	const uint32_t rounds = 50;
+	std::mt19937 engine{ 7u };
+	std::uniform_real_distribution<float> disPos{ 0.0f, 100.0f };
+
+	// Every id wanders to a random spot each round, crowding cells no bucket held before
+	std::vector<Point> points(count);
+	std::vector<Point> moves(count * rounds);
+	for (auto& e : points)
+		e = { disPos(engine), disPos(engine), true };
+	for (auto& e : moves)
+		e = { disPos(engine), disPos(engine), true };
+
+	SpatialGrid grid(4.0f);
+	for (uint32_t i = 0; i < count; ++i)
+		grid.Insert(i, points[i].X, points[i].Z);
+	std::vector<uint32_t> ids;
+	ids.reserve(count);
+
+	uint64_t before = AllocationCounter::GetTotalCount();
+	for (uint32_t round = 0; round < rounds; ++round)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			grid.Move(i, moves[round * count + i].X, moves[round * count + i].Z);
+		grid.Remove(round);
+		grid.Insert(round, moves[round * count + round].X, moves[round * count + round].Z);
+		grid.QueryRadius(50.0f, 50.0f, 20.0f, ids);
+	}
+	CHECK(AllocationCounter::GetTotalCount() - before == 0);
+
+	std::copy(moves.end() - count, moves.end(), points.begin());
+	CHECK(ids == BruteRadius(points, 50.0f, 50.0f, 20.0f));
+	CHECK(grid.GetCount() == count);
+}
+
+BENCHMARK(SpatialGridQueries)
+{
+	for (uint32_t characterCount : { 10u, 100u, 1000u, 10000u })
+	{
+		SpatialGrid::BenchmarkResult result;
+		SpatialGrid::Benchmark(characterCount, 1000, result);
+		std::printf("  %u characters: build %.3f ms, move %.3f ms, radius %.0f ns, nearest %.0f ns, cone %.0f ns, linear %.0f ns, mismatches %u\n",
+			characterCount, result.BuildTime, result.MoveTime, result.RadiusTime, result.NearestTime,
+			result.ConeTime, result.BruteForceTime, result.Mismatches);
+	}
+}
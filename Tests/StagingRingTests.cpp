@@ -0,0 +1,93 @@
+#include "Test.h"
+#include "StagingRing.h"
+
+TEST_CASE(StagingRingAlignsOffsets)
+{
+	StagingRing ring(1024);
+
+	CHECK(ring.Allocate(10, 1) == 0);
+	CHECK(ring.Allocate(16, 256) == 256);
+	// The padding counts as used until the block retires
+	CHECK(ring.GetUsedSize() == 256 + 16);
+	CHECK(ring.HasPending());
+}
+
+TEST_CASE(StagingRingWrapsAround)
+{
+	StagingRing ring(1024);
+
+	CHECK(ring.Allocate(400, 1) == 0);
+	ring.Retire(1);
+	CHECK(ring.Allocate(400, 1) == 400);
+	ring.Retire(2);
+
+	// The first block frees [0, 400); 300 does not fit after 800, so it goes to the start
+	ring.Release(1);
+	CHECK(ring.Allocate(300, 1) == 0);
+	// The tail end [800, 1024) is skipped and held until this block retires
+	CHECK(ring.GetUsedSize() == 400 + 224 + 300);
+
+	// Between the new tail and the head there is only [300, 400)
+	CHECK(ring.Allocate(200, 1) == StagingRing::InvalidOffset);
+	CHECK(ring.Allocate(100, 1) == 300);
+
+	ring.Retire(3);
+	ring.Release(3);
+	CHECK(ring.GetUsedSize() == 0);
+}
+
+TEST_CASE(StagingRingReleasesByFence)
+{
+	StagingRing ring(1024);
+
+	ring.Allocate(100, 1);
+	ring.Retire(5);
+	ring.Allocate(100, 1);
+	ring.Retire(6);
+	CHECK(!ring.HasPending());
+	CHECK(ring.GetOldestFence() == 5);
+
+	// Nothing completes before its fence
+	ring.Release(4);
+	CHECK(ring.GetUsedSize() == 200);
+
+	// Oldest first, one fence at a time
+	ring.Release(5);
+	CHECK(ring.GetUsedSize() == 100);
+	CHECK(ring.GetOldestFence() == 6);
+
+	ring.Release(6);
+	CHECK(ring.GetUsedSize() == 0);
+	CHECK(ring.GetOldestFence() == 0);
+
+	// Retiring with nothing allocated adds no block
+	ring.Retire(7);
+	CHECK(ring.GetOldestFence() == 0);
+}
+
+TEST_CASE(StagingRingPushesBackWhenFull)
+{
+	StagingRing ring(1024);
+
+	// Fill the ring with blocks that are all in flight
+	uint64_t fence = 0;
+	while (ring.Allocate(256, 1) != StagingRing::InvalidOffset)
+		ring.Retire(++fence);
+
+	CHECK(fence == 4);
+	CHECK(ring.GetUsedSize() == ring.GetCapacity());
+	CHECK(ring.Allocate(1, 1) == StagingRing::InvalidOffset);
+	// Larger than the whole ring never fits
+	CHECK(ring.Allocate(2048, 1) == StagingRing::InvalidOffset);
+
+	// Once the GPU passes the oldest fence its space comes back
+	ring.Release(1);
+	CHECK(ring.Allocate(256, 1) == 0);
+	CHECK(ring.Allocate(1, 1) == StagingRing::InvalidOffset);
+
+	// With everything done the ring starts over from the beginning
+	ring.Retire(++fence);
+	ring.Release(fence);
+	CHECK(ring.GetUsedSize() == 0);
+	CHECK(ring.Allocate(1024, 1) == 0);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+// Tests are functions registered by TEST_CASE and run in registration order by Main.cpp.
+// CHECK records a failure and carries on, so one run lists every broken expectation.
+// BENCHMARK registers a function that only runs with -benchmark.
+namespace Test
+{
+	typedef void (*Function)();
+
+	struct Case
+	{
+		const char* Name;
+		Function Body;
+	};
+
+	std::vector<Case>& Cases();
+	std::vector<Case>& Benchmarks();
+	void Fail(const char* file, int line, const char* expression);
+
+	struct Registration
+	{
+		Registration(std::vector<Case>& list, const char* name, Function body)
+		{
+			list.push_back({ name, body });
+		}
+	};
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static Test::Registration name##Registration(Test::Cases(), #name, name); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static Test::Registration name##Registration(Test::Benchmarks(), #name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) Test::Fail(__FILE__, __LINE__, #expression); } while (0)
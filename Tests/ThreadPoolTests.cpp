@@ -0,0 +1,94 @@
+#include "Test.h"
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
+#include <atomic>
+#include <stdexcept>
+
+TEST_CASE(ThreadPoolRunsEveryIndexOnce)
+{
+	ThreadPool threadPool(3);
+	std::vector<std::atomic<int>> visits(1000);
+	for (auto& e : visits)
+		e = 0;
+
+	threadPool.ParallelFor((unsigned int)visits.size(), [&](unsigned int i) { ++visits[i]; });
+
+	bool once = true;
+	for (auto& e : visits)
+		once &= e == 1;
+	CHECK(once);
+}
+
+TEST_CASE(ThreadPoolRethrowsOnTheCaller)
+{
+	ThreadPool threadPool(3);
+
+	for (int round = 0; round < 20; ++round)
+	{
+		// Indices still running when one throws write to this frame's locals, so the caller
+		// must not unwind before they are done
+		std::vector<int> written(256, 0);
+		std::atomic<unsigned int> running{ 0 };
+		bool caught = false;
+		try
+		{
+			threadPool.ParallelFor((unsigned int)written.size(), [&](unsigned int i)
+			{
+				++running;
+				if (i == 7)
+					throw std::runtime_error("body failed");
+				for (volatile int spin = 0; spin < 1000; ++spin)
+					;
+				written[i] = 1;
+				--running;
+			});
+		}
+		catch (const std::runtime_error&)
+		{
+			caught = true;
+		}
+
+		CHECK(caught);
+		// Only the throwing index is left counted as running
+		CHECK(running == 1);
+	}
+
+	// The pool is still usable afterwards
+	std::atomic<unsigned int> count{ 0 };
+	threadPool.ParallelFor(100, [&](unsigned int) { ++count; });
+	CHECK(count == 100);
+}
+
+TEST_CASE(ThreadPoolParallelForDoesNotAllocate)
+{
+	ThreadPool threadPool(3);
+	std::vector<unsigned int> written(64, 0);
+	auto body = [&](unsigned int i) { written[i] += i; };
+
+	// The first call makes the loop state, the rest reuse it
+	threadPool.ParallelFor((unsigned int)written.size(), body);
+	uint64_t before = AllocationCounter::GetTotalCount();
+	for (int round = 0; round < 100; ++round)
+		threadPool.ParallelFor((unsigned int)written.size(), body);
+	CHECK(AllocationCounter::GetTotalCount() - before == 0);
+
+	bool every = true;
+	for (unsigned int i = 0; i < written.size(); ++i)
+		every &= written[i] == 101 * i;
+	CHECK(every);
+}
+
+TEST_CASE(ThreadPoolNestsLoops)
+{
+	// Workers running the outer loop start inner loops of their own
+	ThreadPool threadPool(3);
+	std::atomic<unsigned int> count{ 0 };
+	for (int round = 0; round < 20; ++round)
+	{
+		threadPool.ParallelFor(16, [&](unsigned int)
+		{
+			threadPool.ParallelFor(8, [&](unsigned int) { ++count; });
+		});
+	}
+	CHECK(count == 20 * 16 * 8);
+}